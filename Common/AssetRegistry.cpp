@@ -0,0 +1,368 @@
+#include "AssetRegistry.h"
+#include "MappedFile.h"
+
+std::string AssetRegistry::NormalizePath(const std::string& path)
+{
+    std::vector<std::string> segments;
+    std::string segment;
+    const bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+
+    auto flush = [&]()
+    {
+        if (segment == "..")
+        {
+            if (!segments.empty() && segments.back() != "..")
+            {
+                segments.pop_back();
+            }
+            else if (!absolute)
+            {
+                segments.push_back(segment);
+            }
+        }
+        else if (!segment.empty() && segment != ".")
+        {
+            segments.push_back(segment);
+        }
+        segment.clear();
+    };
+
+    for (char c : path)
+    {
+        if (c == '/' || c == '\\')
+        {
+            flush();
+        }
+        else
+        {
+            // ASCII only, so UTF-8 sequences pass through untouched.
+            segment += (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+        }
+    }
+    flush();
+
+    std::string normalized = absolute ? "/" : "";
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        normalized += (i > 0 ? "/" : "") + segments[i];
+    }
+    return normalized;
+}
+
+std::string AssetRegistry::NormalizePath(const std::wstring& path)
+{
+    const int size = WideCharToMultiByte(CP_UTF8, 0, path.c_str(), (int)path.size(), nullptr, 0, nullptr, nullptr);
+    std::string utf8(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, path.c_str(), (int)path.size(), &utf8[0], size, nullptr, nullptr);
+    return NormalizePath(utf8);
+}
+
+uint64_t AssetRegistry::HashFile(const std::string& path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        return 0;
+    }
+    return HashBytes(file.Data(), file.Size());
+}
+
+uint64_t AssetRegistry::HashFile(const std::wstring& path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        return 0;
+    }
+    return HashBytes(file.Data(), file.Size());
+}
+
+void AssetRegistry::Trim()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    trim();
+}
+
+void AssetRegistry::SetBudget(UINT64 budget)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBudget = budget;
+    trim();
+}
+
+UINT64 AssetRegistry::ResidentBytes() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mResidentBytes;
+}
+
+size_t AssetRegistry::AssetCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+AssetRegistry::Stats AssetRegistry::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+std::string AssetRegistry::ContentKey(const char* type, uint64_t contentHash)
+{
+    char hash[17] = {};
+    sprintf_s(hash, "%016llx", (unsigned long long)contentHash);
+    return std::string(type) + "#" + hash;
+}
+
+std::string AssetRegistry::SizeKey(const char* type, uint64_t size)
+{
+    return std::string(type) + "@" + std::to_string(size);
+}
+
+std::shared_ptr<void> AssetRegistry::findResident(const std::string& pathKey, const char* type, const std::wstring& path,
+    const FileStamp* stamp, uint64_t& contentHash)
+{
+    struct Unhashed
+    {
+        std::shared_ptr<void> Asset;
+        std::wstring SourcePath;
+        FileStamp SourceStamp;
+        uint64_t Hash;
+    };
+
+    contentHash = 0;
+    std::string sizeKey;
+    std::vector<Unhashed> unhashed;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (auto asset = findPath(pathKey, stamp))
+        {
+            return asset;
+        }
+        if (!stamp)
+        {
+            return nullptr;
+        }
+
+        // Nothing resident has this size, so nothing can have these contents.
+        sizeKey = SizeKey(type, stamp->size);
+        auto range = mBySize.equal_range(sizeKey);
+        if (range.first == range.second)
+        {
+            return nullptr;
+        }
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second->ContentKey.empty())
+            {
+                unhashed.push_back({ it->second->Asset, it->second->SourcePath, it->second->SourceStamp, 0 });
+            }
+        }
+    }
+
+    // Hash without the lock held.  A resident asset whose file has changed
+    // since it was loaded can no longer be matched by contents.
+    UINT hashedCount = 0;
+    for (auto& candidate : unhashed)
+    {
+        FileStamp current;
+        if (FileStamp::Get(candidate.SourcePath, current) && current == candidate.SourceStamp)
+        {
+            candidate.Hash = HashFile(candidate.SourcePath);
+            hashedCount++;
+        }
+    }
+    contentHash = HashFile(path);
+    hashedCount++;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.FilesHashed += hashedCount;
+    for (const auto& candidate : unhashed)
+    {
+        if (candidate.Hash == 0)
+        {
+            continue;
+        }
+        auto range = mBySize.equal_range(sizeKey);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            Entry* entry = it->second;
+            if (entry->Asset == candidate.Asset && entry->ContentKey.empty())
+            {
+                const std::string contentKey = ContentKey(type, candidate.Hash);
+                if (mByContent.emplace(contentKey, entry).second)
+                {
+                    entry->ContentKey = contentKey;
+                }
+            }
+        }
+    }
+    if (contentHash == 0)
+    {
+        return nullptr;
+    }
+    return findContent(pathKey, ContentKey(type, contentHash), stamp);
+}
+
+std::shared_ptr<void> AssetRegistry::findPath(const std::string& pathKey, const FileStamp* stamp)
+{
+    auto found = mByPath.find(pathKey);
+    if (found == mByPath.end())
+    {
+        return nullptr;
+    }
+
+    // The file has changed since the path was bound.  The old asset stays
+    // alive for its holders and is found by contents no more.
+    if (stamp && found->second.Stamped && found->second.Stamp != *stamp)
+    {
+        unbindPath(pathKey);
+        return nullptr;
+    }
+
+    Entry* entry = found->second.Asset;
+    entry->LastUsed = ++mTick;
+    mStats.PathHits++;
+    return entry->Asset;
+}
+
+std::shared_ptr<void> AssetRegistry::findContent(const std::string& pathKey, const std::string& contentKey,
+    const FileStamp* stamp)
+{
+    auto found = mByContent.find(contentKey);
+    if (found == mByContent.end())
+    {
+        return nullptr;
+    }
+
+    Entry* entry = found->second;
+    if (mByPath.find(pathKey) == mByPath.end())
+    {
+        bindPath(pathKey, entry, stamp);
+    }
+    entry->LastUsed = ++mTick;
+    mStats.ContentHits++;
+    return entry->Asset;
+}
+
+std::shared_ptr<void> AssetRegistry::insert(const std::string& pathKey, const std::string& contentKey,
+    const std::shared_ptr<void>& asset, UINT64 bytes, const FileStamp* stamp,
+    const char* type, const std::wstring& sourcePath)
+{
+    auto path = mByPath.find(pathKey);
+    if (path != mByPath.end())
+    {
+        if (!stamp || !path->second.Stamped || path->second.Stamp == *stamp)
+        {
+            Entry* entry = path->second.Asset;
+            entry->LastUsed = ++mTick;
+            return entry->Asset;
+        }
+        unbindPath(pathKey);
+    }
+    if (!contentKey.empty())
+    {
+        auto content = mByContent.find(contentKey);
+        if (content != mByContent.end())
+        {
+            return findContent(pathKey, contentKey, stamp);
+        }
+    }
+
+    auto entry = std::make_unique<Entry>();
+    entry->Asset = asset;
+    entry->Bytes = bytes;
+    entry->LastUsed = ++mTick;
+    entry->ContentKey = contentKey;
+    if (type && stamp)
+    {
+        entry->SizeKey = SizeKey(type, stamp->size);
+        entry->SourcePath = sourcePath;
+        entry->SourceStamp = *stamp;
+        mBySize.emplace(entry->SizeKey, entry.get());
+    }
+
+    bindPath(pathKey, entry.get(), stamp);
+    if (!contentKey.empty())
+    {
+        mByContent[contentKey] = entry.get();
+    }
+    mResidentBytes += bytes;
+    mEntries.push_back(std::move(entry));
+    return asset;
+}
+
+void AssetRegistry::bindPath(const std::string& pathKey, Entry* entry, const FileStamp* stamp)
+{
+    PathBinding& binding = mByPath[pathKey];
+    binding.Asset = entry;
+    binding.Stamped = stamp != nullptr;
+    binding.Stamp = stamp ? *stamp : FileStamp();
+    entry->PathKeys.push_back(pathKey);
+}
+
+void AssetRegistry::unbindPath(const std::string& pathKey)
+{
+    auto found = mByPath.find(pathKey);
+    if (found == mByPath.end())
+    {
+        return;
+    }
+    std::vector<std::string>& pathKeys = found->second.Asset->PathKeys;
+    pathKeys.erase(std::remove(pathKeys.begin(), pathKeys.end(), pathKey), pathKeys.end());
+    mByPath.erase(found);
+}
+
+void AssetRegistry::trim()
+{
+    if (mResidentBytes <= mBudget)
+    {
+        return;
+    }
+
+    // The registry holds the only reference to an unreferenced asset, and
+    // only the registry can hand out new ones, so use_count is exact here.
+    std::vector<Entry*> unreferenced;
+    for (const auto& entry : mEntries)
+    {
+        if (entry->Asset.use_count() == 1)
+        {
+            unreferenced.push_back(entry.get());
+        }
+    }
+    std::sort(unreferenced.begin(), unreferenced.end(),
+        [](const Entry* a, const Entry* b) { return a->LastUsed < b->LastUsed; });
+
+    for (Entry* entry : unreferenced)
+    {
+        if (mResidentBytes <= mBudget)
+        {
+            break;
+        }
+
+        for (const auto& pathKey : entry->PathKeys)
+        {
+            mByPath.erase(pathKey);
+        }
+        if (!entry->ContentKey.empty())
+        {
+            mByContent.erase(entry->ContentKey);
+        }
+        auto sized = mBySize.equal_range(entry->SizeKey);
+        for (auto it = sized.first; it != sized.second; ++it)
+        {
+            if (it->second == entry)
+            {
+                mBySize.erase(it);
+                break;
+            }
+        }
+        mResidentBytes -= entry->Bytes;
+        mStats.Evictions++;
+
+        auto owner = std::find_if(mEntries.begin(), mEntries.end(),
+            [entry](const std::unique_ptr<Entry>& e) { return e.get() == entry; });
+        mEntries.erase(owner);
+    }
+}
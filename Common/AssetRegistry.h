@@ -0,0 +1,204 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "MappedFile.h"
+#include <functional>
+#include <mutex>
+
+// Assets shared between loaders and scenes.  An asset is found by its
+// normalized path first and by a hash of the file contents second, so one
+// file reached through two spellings, or copied under another name, is only
+// loaded once.
+//
+// Handles are std::shared_ptr: an asset is referenced while any handle is
+// alive.  Unreferenced assets stay resident so the next scene can pick them
+// up again, until Trim evicts them, least recently used first, to get back
+// under the budget.  Only evict once the GPU is done with them.
+//
+// Lookups are keyed by asset type as well, so a model and a texture loaded
+// from the same path do not collide.  All members are thread safe.
+//
+// Acquire keys a path together with the file's size and write time, so an
+// edited file is loaded again.  Two files can only have the same contents if
+// they have the same size, so it only hashes a file when an asset of the same
+// type and size is already resident, and hashes that one then too.
+class AssetRegistry
+{
+public:
+    static const UINT64 DefaultBudget = 512 * 1024 * 1024;
+
+    struct Stats
+    {
+        UINT PathHits = 0;
+        UINT ContentHits = 0;
+        UINT Loads = 0;
+        UINT Evictions = 0;
+        UINT FilesHashed = 0;
+    };
+
+    explicit AssetRegistry(UINT64 budget = DefaultBudget) : mBudget(budget) {}
+
+    // Lower case, forward slashes, no "." or ".." segments; UTF-8 for wide paths.
+    static std::string NormalizePath(const std::string& path);
+    static std::string NormalizePath(const std::wstring& path);
+
+    // 0 when the file cannot be read.
+    static uint64_t HashFile(const std::string& path);
+    static uint64_t HashFile(const std::wstring& path);
+
+    template <typename T>
+    std::shared_ptr<T> Find(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return std::static_pointer_cast<T>(findPath(PathKey<T>(NormalizePath(path)), nullptr));
+    }
+
+    // On a hit, path becomes another name for the asset.
+    template <typename T>
+    std::shared_ptr<T> FindContent(const std::string& path, uint64_t contentHash)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return std::static_pointer_cast<T>(findContent(PathKey<T>(NormalizePath(path)),
+            ContentKey(typeid(T).name(), contentHash), nullptr));
+    }
+
+    // Returns the asset that ends up registered under path, which is an
+    // existing one if another thread got there first.  contentHash 0 keeps
+    // the asset out of content lookups.
+    template <typename T>
+    std::shared_ptr<T> Insert(const std::string& path, uint64_t contentHash, const std::shared_ptr<T>& asset, UINT64 bytes)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return std::static_pointer_cast<T>(insert(PathKey<T>(NormalizePath(path)),
+            contentHash ? ContentKey(typeid(T).name(), contentHash) : std::string(), asset, bytes, nullptr));
+    }
+
+    // What FindFile learned about a file, for InsertFile to register the
+    // asset loaded from it under.
+    struct FileKey
+    {
+        std::wstring Path;
+        FileStamp Stamp;
+        bool Stamped = false;
+        uint64_t ContentHash = 0;
+    };
+
+    // The lookup half of Acquire, for loaders that load on their own: the
+    // path first, then the contents, hashing only when a resident asset of
+    // this type has the file's size.
+    template <typename T>
+    std::shared_ptr<T> FindFile(const std::wstring& path, FileKey& key)
+    {
+        key.Path = path;
+        key.Stamped = FileStamp::Get(path, key.Stamp);
+        return std::static_pointer_cast<T>(findResident(PathKey<T>(NormalizePath(path)), typeid(T).name(), path,
+            key.Stamped ? &key.Stamp : nullptr, key.ContentHash));
+    }
+
+    // The insert half of Acquire, after FindFile missed.
+    template <typename T>
+    std::shared_ptr<T> InsertFile(const FileKey& key, const std::shared_ptr<T>& asset, UINT64 bytes)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.Loads++;
+        return std::static_pointer_cast<T>(insert(PathKey<T>(NormalizePath(key.Path)),
+            key.ContentHash ? ContentKey(typeid(T).name(), key.ContentHash) : std::string(), asset, bytes,
+            key.Stamped ? &key.Stamp : nullptr, typeid(T).name(), key.Path));
+    }
+
+    // Find, then FindContent, then load.  load runs without the lock held and
+    // reports the asset's size in bytes; a null result is not registered.
+    template <typename T>
+    std::shared_ptr<T> Acquire(const std::string& path, const std::function<std::shared_ptr<T>(UINT64& bytes)>& load)
+    {
+        // Paths that are not files, such as generated primitives, are only
+        // found by path.
+        FileStamp stamp;
+        const FileStamp* fileStamp = FileStamp::Get(path, stamp) ? &stamp : nullptr;
+        const std::string pathKey = PathKey<T>(NormalizePath(path));
+
+        const std::wstring sourcePath(path.begin(), path.end());
+        uint64_t contentHash = 0;
+        if (auto asset = findResident(pathKey, typeid(T).name(), sourcePath, fileStamp, contentHash))
+        {
+            return std::static_pointer_cast<T>(asset);
+        }
+
+        UINT64 bytes = 0;
+        std::shared_ptr<T> asset = load(bytes);
+        if (!asset)
+        {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.Loads++;
+        return std::static_pointer_cast<T>(insert(pathKey,
+            contentHash ? ContentKey(typeid(T).name(), contentHash) : std::string(), asset, bytes, fileStamp,
+            typeid(T).name(), sourcePath));
+    }
+
+    // Evicts unreferenced assets until the resident size fits the budget.
+    void Trim();
+    void SetBudget(UINT64 budget);
+
+    UINT64 ResidentBytes() const;
+    size_t AssetCount() const;
+    Stats GetStats() const;
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<void> Asset;
+        UINT64 Bytes = 0;
+        UINT64 LastUsed = 0;
+        std::string ContentKey;
+        std::vector<std::string> PathKeys;
+
+        // Set for assets Acquire or InsertFile loaded from a file, which can
+        // be hashed later if a file of the same size turns up.
+        std::string SizeKey;
+        std::wstring SourcePath;
+        FileStamp SourceStamp;
+    };
+
+    // A path and the size and write time its file had when it was bound.
+    struct PathBinding
+    {
+        Entry* Asset = nullptr;
+        FileStamp Stamp;
+        bool Stamped = false;
+    };
+
+    template <typename T>
+    static std::string PathKey(const std::string& normalizedPath)
+    {
+        return std::string(typeid(T).name()) + "|" + normalizedPath;
+    }
+
+    static std::string ContentKey(const char* type, uint64_t contentHash);
+    static std::string SizeKey(const char* type, uint64_t size);
+
+    // Path, then content for files the size of a resident asset.  contentHash
+    // is set when the file was hashed and nothing matched.
+    std::shared_ptr<void> findResident(const std::string& pathKey, const char* type, const std::wstring& path,
+        const FileStamp* stamp, uint64_t& contentHash);
+    std::shared_ptr<void> findPath(const std::string& pathKey, const FileStamp* stamp);
+    std::shared_ptr<void> findContent(const std::string& pathKey, const std::string& contentKey, const FileStamp* stamp);
+    std::shared_ptr<void> insert(const std::string& pathKey, const std::string& contentKey,
+        const std::shared_ptr<void>& asset, UINT64 bytes, const FileStamp* stamp,
+        const char* type = nullptr, const std::wstring& sourcePath = std::wstring());
+    void bindPath(const std::string& pathKey, Entry* entry, const FileStamp* stamp);
+    void unbindPath(const std::string& pathKey);
+    void trim();
+
+    mutable std::mutex mMutex;
+    std::vector<std::unique_ptr<Entry>> mEntries;
+    std::unordered_map<std::string, PathBinding> mByPath;
+    std::unordered_map<std::string, Entry*> mByContent;
+    std::unordered_multimap<std::string, Entry*> mBySize;
+    UINT64 mBudget;
+    UINT64 mResidentBytes = 0;
+    UINT64 mTick = 0;
+    Stats mStats;
+};
@@ -0,0 +1,91 @@
+#include "CommandListPool.h"
+
+D3D12CommandListBackend::D3D12CommandListBackend(DX::DeviceResources* devRes) :
+    mDeviceResources(devRes)
+{
+}
+
+void D3D12CommandListBackend::CreateList()
+{
+    auto device = mDeviceResources->GetD3DDevice();
+
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+    DX::ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+        IID_PPV_ARGS(allocator.GetAddressOf())));
+    DX::ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator.Get(), nullptr,
+        IID_PPV_ARGS(commandList.GetAddressOf())));
+    DX::ThrowIfFailed(commandList->Close());
+
+    mLists.push_back({ allocator, commandList, D3D12DrawRecorder(commandList.Get(), 0) });
+}
+
+DrawRecorder& D3D12CommandListBackend::OpenList(UINT list, UINT objectConstantsParameter)
+{
+    auto& current = mLists[list];
+    DX::ThrowIfFailed(current.Allocator->Reset());
+    DX::ThrowIfFailed(current.CommandList->Reset(current.Allocator.Get(), nullptr));
+    current.Recorder.Reset(current.CommandList.Get(), objectConstantsParameter);
+    return current.Recorder;
+}
+
+void D3D12CommandListBackend::CloseList(UINT list)
+{
+    DX::ThrowIfFailed(mLists[list].CommandList->Close());
+}
+
+void D3D12CommandListBackend::Execute(UINT count)
+{
+    mExecuteLists.clear();
+    for (UINT list = 0; list < count; list++)
+    {
+        mExecuteLists.push_back(mLists[list].CommandList.Get());
+    }
+    mDeviceResources->ExecuteAndResume(count, mExecuteLists.data());
+}
+
+CommandListPool::CommandListPool(DX::DeviceResources* devRes) :
+    CommandListPool(std::make_unique<D3D12CommandListBackend>(devRes))
+{
+}
+
+CommandListPool::CommandListPool(std::unique_ptr<CommandListBackend> backend) :
+    mBackend(std::move(backend))
+{
+}
+
+void CommandListPool::SetChunkState(UINT objectConstantsParameter, std::function<void(ID3D12GraphicsCommandList*)> setup)
+{
+    mObjectConstantsParameter = objectConstantsParameter;
+    mSetup = std::move(setup);
+}
+
+void CommandListPool::Reset(UINT chunkCount)
+{
+    for (; mListCount < chunkCount; mListCount++)
+    {
+        mBackend->CreateList();
+    }
+}
+
+DrawRecorder& CommandListPool::BeginChunk(UINT chunk)
+{
+    _ASSERT_EXPR(chunk < mListCount, L"chunk not reset");
+
+    DrawRecorder& recorder = mBackend->OpenList(chunk, mObjectConstantsParameter);
+    if (mSetup)
+    {
+        mSetup(mBackend->CommandList(chunk));
+    }
+    return recorder;
+}
+
+void CommandListPool::EndChunk(UINT chunk)
+{
+    mBackend->CloseList(chunk);
+}
+
+void CommandListPool::Submit(UINT chunkCount)
+{
+    mBackend->Execute(chunkCount);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "DeviceResources.h"
+#include "DrawQueue.h"
+#include <functional>
+
+// The command lists CommandListPool records chunks into.  Lists are created
+// closed and kept; OpenList and CloseList are called from worker threads,
+// never for the same list at once.
+class CommandListBackend
+{
+public:
+    virtual ~CommandListBackend() = default;
+
+    virtual void CreateList() = 0;
+    // Resets the list and its allocator, which the GPU must be done with, and
+    // returns the list's recorder, reset to put object constants in the given
+    // root parameter.
+    virtual DrawRecorder& OpenList(UINT list, UINT objectConstantsParameter) = 0;
+    // The list being recorded, for the chunk setup; null without a device.
+    virtual ID3D12GraphicsCommandList* CommandList(UINT list) = 0;
+    virtual void CloseList(UINT list) = 0;
+    // Executes the first count lists in order, after the frame's main command list.
+    virtual void Execute(UINT count) = 0;
+};
+
+// A command allocator, a graphics command list and its recorder per list.
+class D3D12CommandListBackend : public CommandListBackend
+{
+public:
+    explicit D3D12CommandListBackend(DX::DeviceResources* devRes);
+
+    void CreateList() override;
+    DrawRecorder& OpenList(UINT list, UINT objectConstantsParameter) override;
+    ID3D12GraphicsCommandList* CommandList(UINT list) override { return mLists[list].CommandList.Get(); }
+    void CloseList(UINT list) override;
+    void Execute(UINT count) override;
+
+private:
+    struct List
+    {
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CommandList;
+        D3D12DrawRecorder Recorder;
+    };
+
+    DX::DeviceResources* mDeviceResources;
+    std::vector<List> mLists;
+    std::vector<ID3D12CommandList*> mExecuteLists;
+};
+
+// Records into a MockDrawRecorder per list and keeps what the device would
+// have been asked to do, so the pool can be exercised without one.
+class NullCommandListBackend : public CommandListBackend
+{
+public:
+    struct List
+    {
+        MockDrawRecorder Recorder;
+        UINT ObjectConstantsParameter = 0;
+        UINT OpenCount = 0;
+        bool Open = false;
+    };
+
+    void CreateList() override { mLists.emplace_back(); }
+    DrawRecorder& OpenList(UINT list, UINT objectConstantsParameter) override
+    {
+        auto& current = mLists[list];
+        current.Recorder.mCalls.clear();
+        current.ObjectConstantsParameter = objectConstantsParameter;
+        current.OpenCount++;
+        current.Open = true;
+        return current.Recorder;
+    }
+    ID3D12GraphicsCommandList* CommandList(UINT list) override { return nullptr; }
+    void CloseList(UINT list) override { mLists[list].Open = false; }
+    void Execute(UINT count) override { mExecuted.push_back(count); }
+
+    std::vector<List> mLists;
+    // The count of every Execute.
+    std::vector<UINT> mExecuted;
+};
+
+// Command lists that DrawQueue::RecordParallel records its chunks into,
+// submitted after what the frame's main command list holds.
+//
+// Allocators are reset as chunks begin, so each frame resource needs its
+// own pool and the GPU must be done with the frame that used it last.
+// Lists and their recorders are created on first use and kept.
+class CommandListPool : public ChunkRecorders
+{
+public:
+    explicit CommandListPool(DX::DeviceResources* devRes);
+    explicit CommandListPool(std::unique_ptr<CommandListBackend> backend);
+
+    // Each chunk starts from an empty command list: setup records what the
+    // draws rely on (render targets, viewport, descriptor heaps, root
+    // signature and root arguments) before the chunk's first draw.
+    void SetChunkState(UINT objectConstantsParameter, std::function<void(ID3D12GraphicsCommandList*)> setup);
+
+    void Reset(UINT chunkCount) override;
+    DrawRecorder& BeginChunk(UINT chunk) override;
+    void EndChunk(UINT chunk) override;
+    void Submit(UINT chunkCount) override;
+
+    UINT ListCount() const { return mListCount; }
+
+private:
+    std::unique_ptr<CommandListBackend> mBackend;
+    UINT mObjectConstantsParameter = 0;
+    std::function<void(ID3D12GraphicsCommandList*)> mSetup;
+    UINT mListCount = 0;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// CPU side copy of a per-object constant buffer that is written to each
+// frame resource's mapped buffer only where it changed.
+//
+// Set stores an element and tags it with the current generation; Flush
+// ends the generation.  Every frame resource remembers the generation it
+// was last flushed in, so its flush only has to visit the elements changed
+// by the generations since then.  Those are sorted and merged into runs of
+// adjacent elements, and each run is a single memcpy, padding included,
+// because the staging copy is laid out exactly like the mapped buffer.
+//
+// A frame resource more than frameCount generations behind (the first
+// frames, for instance) gets the whole buffer.
+template<typename T>
+class ConstantBufferStore
+{
+public:
+    struct Stats
+    {
+        size_t Elements = 0;    // written by the last Flush
+        size_t Runs = 0;        // memcpy calls made by the last Flush
+        size_t Bytes = 0;
+    };
+
+    ConstantBufferStore(size_t elementCount, size_t frameCount, size_t elementByteSize) :
+        mElementCount(elementCount),
+        mElementByteSize(elementByteSize),
+        mStaging(new uint8_t[elementCount * elementByteSize]()),
+        mElementGeneration(elementCount, Never),
+        mChanged(frameCount),
+        mFlushedGeneration(frameCount, Never)
+    {
+        assert(elementByteSize >= sizeof(T));
+    }
+
+    ConstantBufferStore(const ConstantBufferStore& rhs) = delete;
+    ConstantBufferStore& operator=(const ConstantBufferStore& rhs) = delete;
+
+    void Set(size_t elementIndex, const T& data)
+    {
+        assert(elementIndex < mElementCount);
+
+        memcpy(&mStaging[elementIndex * mElementByteSize], &data, sizeof(T));
+        if (mElementGeneration[elementIndex] != mGeneration)
+        {
+            mElementGeneration[elementIndex] = mGeneration;
+            mChanged[mGeneration % mChanged.size()].push_back((uint32_t)elementIndex);
+        }
+    }
+
+    const T& Get(size_t elementIndex) const
+    {
+        return *reinterpret_cast<const T*>(&mStaging[elementIndex * mElementByteSize]);
+    }
+
+    // Brings the mapped buffer of frame resource frameIndex up to date and
+    // starts a new generation.  mapped must hold elementCount elements.
+    void Flush(size_t frameIndex, uint8_t* mapped)
+    {
+        mStats = Stats();
+
+        const size_t frameCount = mChanged.size();
+        const uint64_t flushed = mFlushedGeneration[frameIndex];
+        if (flushed == Never || mGeneration - flushed > frameCount)
+        {
+            copyRun(mapped, 0, mElementCount);
+        }
+        else
+        {
+            mPending.clear();
+            for (uint64_t generation = flushed + 1; generation <= mGeneration; generation++)
+            {
+                const auto& changed = mChanged[generation % frameCount];
+                mPending.insert(mPending.end(), changed.begin(), changed.end());
+            }
+            std::sort(mPending.begin(), mPending.end());
+            mPending.erase(std::unique(mPending.begin(), mPending.end()), mPending.end());
+
+            for (size_t i = 0; i < mPending.size();)
+            {
+                size_t end = i + 1;
+                while (end < mPending.size() && mPending[end] == mPending[end - 1] + 1)
+                {
+                    end++;
+                }
+                copyRun(mapped, mPending[i], end - i);
+                i = end;
+            }
+        }
+
+        mFlushedGeneration[frameIndex] = mGeneration;
+        mGeneration++;
+        mChanged[mGeneration % frameCount].clear();
+    }
+
+    const Stats& LastFlush() const { return mStats; }
+    size_t ElementCount() const { return mElementCount; }
+
+private:
+    enum : uint64_t { Never = ~0ull };
+
+    void copyRun(uint8_t* mapped, size_t first, size_t count)
+    {
+        const size_t offset = first * mElementByteSize;
+        const size_t bytes = count * mElementByteSize;
+        memcpy(mapped + offset, &mStaging[offset], bytes);
+
+        mStats.Elements += count;
+        mStats.Runs++;
+        mStats.Bytes += bytes;
+    }
+
+    size_t mElementCount;
+    size_t mElementByteSize;
+    std::unique_ptr<uint8_t[]> mStaging;
+
+    // Generation of the last Set of each element, and the elements first
+    // set in each of the last frameCount generations.
+    uint64_t mGeneration = 0;
+    std::vector<uint64_t> mElementGeneration;
+    std::vector<std::vector<uint32_t>> mChanged;
+
+    std::vector<uint64_t> mFlushedGeneration;
+    std::vector<uint32_t> mPending;
+    Stats mStats;
+};
@@ -0,0 +1,416 @@
+#include "Culling.h"
+#include <cfloat>
+
+using namespace DirectX;
+
+namespace
+{
+    // Nearer than this a point is treated as crossing the camera plane.
+    const float MinClipW = 1e-4f;
+
+    // Clip space corners of a box; false when one of them crosses the camera plane.
+    bool ProjectCorners(const BoundingBox& box, const Matrix& transform, XMFLOAT4 clip[BoundingBox::CORNER_COUNT])
+    {
+        XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+        box.GetCorners(corners);
+
+        const XMMATRIX m = transform;
+        for (size_t i = 0; i < BoundingBox::CORNER_COUNT; i++)
+        {
+            XMStoreFloat4(&clip[i], XMVector3Transform(XMLoadFloat3(&corners[i]), m));
+            if (clip[i].w <= MinClipW)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Twice the signed area of abc, positive when c lies left of ab.
+    inline float Edge(const XMFLOAT3& a, const XMFLOAT3& b, float x, float y)
+    {
+        return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+    }
+
+    // One bit per lane whose all bits are set.
+    inline int LaneMask(FXMVECTOR v)
+    {
+#if defined(_XM_SSE_INTRINSICS_)
+        return _mm_movemask_ps(v);
+#else
+        XMUINT4 lanes;
+        XMStoreUInt4(&lanes, v);
+        return (lanes.x ? 1 : 0) | (lanes.y ? 2 : 0) | (lanes.z ? 4 : 0) | (lanes.w ? 8 : 0);
+#endif
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer(UINT width, UINT height) :
+    mWidth(width),
+    mHeight(height),
+    mTilesX((width + TileSize - 1) / TileSize),
+    mTilesY((height + TileSize - 1) / TileSize),
+    mDepth(width * height, 1.0f),
+    mTileMaxDepth(mTilesX * mTilesY, 1.0f)
+{
+}
+
+void OcclusionBuffer::Begin(const Matrix& viewProj)
+{
+    mViewProj = viewProj;
+    std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+}
+
+void OcclusionBuffer::End()
+{
+    for (UINT ty = 0; ty < mTilesY; ty++)
+    {
+        for (UINT tx = 0; tx < mTilesX; tx++)
+        {
+            const UINT x1 = std::min<UINT>(mWidth, (tx + 1) * TileSize);
+            const UINT y1 = std::min<UINT>(mHeight, (ty + 1) * TileSize);
+            float farthest = 0.0f;
+            for (UINT y = ty * TileSize; y < y1; y++)
+            {
+                const float* row = &mDepth[y * mWidth];
+                for (UINT x = tx * TileSize; x < x1; x++)
+                {
+                    farthest = std::max<float>(farthest, row[x]);
+                }
+            }
+            mTileMaxDepth[ty * mTilesX + tx] = farthest;
+        }
+    }
+}
+
+void OcclusionBuffer::RasterizeOccluder(const BoundingBox& localBox, const Matrix& world)
+{
+    const Matrix transform = world * mViewProj;
+    XMFLOAT4 clip[BoundingBox::CORNER_COUNT];
+    if (!ProjectCorners(localBox, transform, clip))
+    {
+        return;
+    }
+
+    XMFLOAT3 screen[BoundingBox::CORNER_COUNT];
+    for (size_t i = 0; i < BoundingBox::CORNER_COUNT; i++)
+    {
+        const float invW = 1.0f / clip[i].w;
+        screen[i].x = (clip[i].x * invW * 0.5f + 0.5f) * mWidth;
+        screen[i].y = (-clip[i].y * invW * 0.5f + 0.5f) * mHeight;
+        screen[i].z = clip[i].z * invW;
+    }
+
+    // Faces of the box in BoundingBox::GetCorners order, wound the same way
+    // seen from outside.  Which screen winding that is depends on whether
+    // the transform mirrors; back faces are skipped, the front faces of a
+    // box already cover its whole silhouette.
+    static const uint8_t faces[6][4] =
+    {
+        { 0, 1, 2, 3 }, { 4, 7, 6, 5 },
+        { 0, 4, 5, 1 }, { 3, 2, 6, 7 },
+        { 0, 3, 7, 4 }, { 1, 5, 6, 2 },
+    };
+    const float front = XMVectorGetX(XMMatrixDeterminant(transform)) < 0.0f ? -1.0f : 1.0f;
+    for (const auto& face : faces)
+    {
+        const XMFLOAT3& a = screen[face[0]];
+        const XMFLOAT3& c = screen[face[2]];
+        if (Edge(a, screen[face[1]], c.x, c.y) * front < 0.0f)
+        {
+            continue;
+        }
+        rasterizeTriangle(a, screen[face[1]], c);
+        rasterizeTriangle(a, c, screen[face[3]]);
+    }
+}
+
+void OcclusionBuffer::rasterizeTriangle(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+{
+    const float area = Edge(a, b, c.x, c.y);
+    if (area == 0.0f)
+    {
+        return;
+    }
+
+    // Pixels whose centres can be inside the triangle.
+    const int minX = std::max<int>(0, (int)std::ceil(std::min<float>({ a.x, b.x, c.x }) - 0.5f));
+    const int maxX = std::min<int>((int)mWidth - 1, (int)std::floor(std::max<float>({ a.x, b.x, c.x }) - 0.5f));
+    const int minY = std::max<int>(0, (int)std::ceil(std::min<float>({ a.y, b.y, c.y }) - 0.5f));
+    const int maxY = std::min<int>((int)mHeight - 1, (int)std::floor(std::max<float>({ a.y, b.y, c.y }) - 0.5f));
+    if (minX > maxX || minY > maxY)
+    {
+        return;
+    }
+
+    // Edge functions scaled so they are positive inside whatever the
+    // winding, stepped one pixel at a time.
+    const float sign = area < 0.0f ? -1.0f : 1.0f;
+    const float invArea = 1.0f / area;
+    const float stepX0 = (b.y - c.y) * sign, stepY0 = (c.x - b.x) * sign;
+    const float stepX1 = (c.y - a.y) * sign, stepY1 = (a.x - c.x) * sign;
+    const float stepX2 = (a.y - b.y) * sign, stepY2 = (b.x - a.x) * sign;
+    const float startX = minX + 0.5f, startY = minY + 0.5f;
+    float row0 = Edge(b, c, startX, startY) * sign;
+    float row1 = Edge(c, a, startX, startY) * sign;
+    float row2 = Edge(a, b, startX, startY) * sign;
+
+    // Depth is affine in screen space; z = z0 + w1 * dz1 + w2 * dz2.
+    const float dz1 = (b.z - a.z) * invArea * sign;
+    const float dz2 = (c.z - a.z) * invArea * sign;
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        float w0 = row0, w1 = row1, w2 = row2;
+        float* depth = &mDepth[y * mWidth];
+        for (int x = minX; x <= maxX; x++)
+        {
+            if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+            {
+                depth[x] = std::min<float>(depth[x], a.z + w1 * dz1 + w2 * dz2);
+            }
+            w0 += stepX0;
+            w1 += stepX1;
+            w2 += stepX2;
+        }
+        row0 += stepY0;
+        row1 += stepY1;
+        row2 += stepY2;
+    }
+}
+
+bool OcclusionBuffer::IsVisible(const BoundingBox& worldBox) const
+{
+    XMFLOAT4 clip[BoundingBox::CORNER_COUNT];
+    if (!ProjectCorners(worldBox, mViewProj, clip))
+    {
+        return true;
+    }
+
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for (const auto& corner : clip)
+    {
+        const float invW = 1.0f / corner.w;
+        const float x = (corner.x * invW * 0.5f + 0.5f) * mWidth;
+        const float y = (-corner.y * invW * 0.5f + 0.5f) * mHeight;
+        minX = std::min<float>(minX, x);
+        maxX = std::max<float>(maxX, x);
+        minY = std::min<float>(minY, y);
+        maxY = std::max<float>(maxY, y);
+        minZ = std::min<float>(minZ, corner.z * invW);
+    }
+
+    // Every pixel the box touches, not just the centres it covers.
+    const int x0 = std::max<int>(0, (int)std::floor(minX));
+    const int x1 = std::min<int>((int)mWidth - 1, (int)std::floor(maxX));
+    const int y0 = std::max<int>(0, (int)std::floor(minY));
+    const int y1 = std::min<int>((int)mHeight - 1, (int)std::floor(maxY));
+    if (x0 > x1 || y0 > y1)
+    {
+        return true;
+    }
+
+    // Tiles entirely nearer than the box are skipped without reading their
+    // pixels; a tile the rectangle covers completely answers for all of them.
+    for (int ty = y0 / (int)TileSize; ty <= y1 / (int)TileSize; ty++)
+    {
+        for (int tx = x0 / (int)TileSize; tx <= x1 / (int)TileSize; tx++)
+        {
+            if (mTileMaxDepth[ty * mTilesX + tx] < minZ)
+            {
+                continue;
+            }
+
+            const int tileX0 = tx * TileSize, tileY0 = ty * TileSize;
+            const int tileX1 = std::min<int>((int)mWidth, tileX0 + (int)TileSize) - 1;
+            const int tileY1 = std::min<int>((int)mHeight, tileY0 + (int)TileSize) - 1;
+            if (x0 <= tileX0 && tileX1 <= x1 && y0 <= tileY0 && tileY1 <= y1)
+            {
+                return true;
+            }
+
+            for (int y = std::max<int>(y0, tileY0); y <= std::min<int>(y1, tileY1); y++)
+            {
+                const float* row = &mDepth[y * mWidth];
+                for (int x = std::max<int>(x0, tileX0); x <= std::min<int>(x1, tileX1); x++)
+                {
+                    if (row[x] >= minZ)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+UINT CullingStage::Add(const BoundingBox& localBounds, RenderLayer layer)
+{
+    const UINT item = mItemCount++;
+    const size_t padded = (mItemCount + 3) & ~size_t(3);
+
+    // Padding lanes are zero sized boxes at the origin; their results are ignored.
+    mCenterX.resize(padded);
+    mCenterY.resize(padded);
+    mCenterZ.resize(padded);
+    mExtentX.resize(padded);
+    mExtentY.resize(padded);
+    mExtentZ.resize(padded);
+
+    mLocalBounds.push_back(localBounds);
+    mWorlds.push_back(Matrix::Identity);
+    mLayers.push_back((uint8_t)layer);
+
+    SetWorld(item, Matrix::Identity);
+    return item;
+}
+
+void CullingStage::SetWorld(UINT item, const Matrix& world)
+{
+    _ASSERT_EXPR(item < mItemCount, L"unknown culling item");
+
+    mWorlds[item] = world;
+
+    // Arvo's method: the world AABB of a transformed local AABB.
+    const BoundingBox& local = mLocalBounds[item];
+    const float c[3] = { local.Center.x, local.Center.y, local.Center.z };
+    const float e[3] = { local.Extents.x, local.Extents.y, local.Extents.z };
+    float center[3];
+    float extent[3];
+    for (int j = 0; j < 3; j++)
+    {
+        center[j] = world.m[3][j];
+        extent[j] = 0.0f;
+        for (int i = 0; i < 3; i++)
+        {
+            center[j] += c[i] * world.m[i][j];
+            extent[j] += e[i] * std::abs(world.m[i][j]);
+        }
+    }
+
+    mCenterX[item] = center[0];
+    mCenterY[item] = center[1];
+    mCenterZ[item] = center[2];
+    mExtentX[item] = extent[0];
+    mExtentY[item] = extent[1];
+    mExtentZ[item] = extent[2];
+}
+
+void CullingStage::SetOccluder(UINT item, const BoundingBox& localBox)
+{
+    _ASSERT_EXPR(item < mItemCount, L"unknown culling item");
+
+    mOccluders.push_back({ item, localBox });
+}
+
+void CullingStage::Cull(const Matrix& viewProj, OcclusionBuffer* occlusion)
+{
+    mStats = Stats();
+    mStats.Tested = mItemCount;
+    for (auto& visible : mVisible)
+    {
+        visible.clear();
+    }
+
+    // Frustum planes from the columns of viewProj (row vectors, D3D depth
+    // range), pointing inwards.
+    const Matrix& m = viewProj;
+    const XMFLOAT4 planes[6] =
+    {
+        { m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41 },     // left
+        { m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41 },     // right
+        { m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42 },     // bottom
+        { m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42 },     // top
+        { m._13, m._23, m._33, m._43 },                                     // near
+        { m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43 },     // far
+    };
+
+    // Four boxes per iteration: a box is outside when it lies entirely on
+    // the negative side of any plane, i.e. dot(n, c) + d + dot(|n|, e) < 0.
+    XMVECTOR normals[6][3];
+    XMVECTOR absNormals[6][3];
+    XMVECTOR distances[6];
+    for (int i = 0; i < 6; i++)
+    {
+        const XMVECTOR plane = XMLoadFloat4(&planes[i]);
+        normals[i][0] = XMVectorSplatX(plane);
+        normals[i][1] = XMVectorSplatY(plane);
+        normals[i][2] = XMVectorSplatZ(plane);
+        distances[i] = XMVectorSplatW(plane);
+        for (int j = 0; j < 3; j++)
+        {
+            absNormals[i][j] = XMVectorAbs(normals[i][j]);
+        }
+    }
+
+    mInFrustum.clear();
+    const XMVECTOR zero = XMVectorZero();
+    for (UINT first = 0; first < mItemCount; first += 4)
+    {
+        const XMVECTOR cx = XMLoadFloat4((const XMFLOAT4*)&mCenterX[first]);
+        const XMVECTOR cy = XMLoadFloat4((const XMFLOAT4*)&mCenterY[first]);
+        const XMVECTOR cz = XMLoadFloat4((const XMFLOAT4*)&mCenterZ[first]);
+        const XMVECTOR ex = XMLoadFloat4((const XMFLOAT4*)&mExtentX[first]);
+        const XMVECTOR ey = XMLoadFloat4((const XMFLOAT4*)&mExtentY[first]);
+        const XMVECTOR ez = XMLoadFloat4((const XMFLOAT4*)&mExtentZ[first]);
+
+        XMVECTOR inside = XMVectorTrueInt();
+        for (int i = 0; i < 6; i++)
+        {
+            XMVECTOR distance = XMVectorMultiplyAdd(cx, normals[i][0], distances[i]);
+            distance = XMVectorMultiplyAdd(cy, normals[i][1], distance);
+            distance = XMVectorMultiplyAdd(cz, normals[i][2], distance);
+            distance = XMVectorMultiplyAdd(ex, absNormals[i][0], distance);
+            distance = XMVectorMultiplyAdd(ey, absNormals[i][1], distance);
+            distance = XMVectorMultiplyAdd(ez, absNormals[i][2], distance);
+            inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, zero));
+        }
+
+        const int mask = LaneMask(inside);
+        const UINT lanes = std::min<UINT>(4u, mItemCount - first);
+        for (UINT lane = 0; lane < lanes; lane++)
+        {
+            if (mask & (1 << lane))
+            {
+                mInFrustum.push_back(first + lane);
+            }
+            else
+            {
+                mStats.FrustumCulled++;
+            }
+        }
+    }
+
+    if (occlusion)
+    {
+        occlusion->Begin(viewProj);
+
+        // Occluders outside the frustum cover no pixels.
+        for (const auto& occluder : mOccluders)
+        {
+            if (std::binary_search(mInFrustum.begin(), mInFrustum.end(), occluder.Item))
+            {
+                occlusion->RasterizeOccluder(occluder.LocalBox, mWorlds[occluder.Item]);
+            }
+        }
+        occlusion->End();
+    }
+
+    for (UINT item : mInFrustum)
+    {
+        if (occlusion)
+        {
+            const BoundingBox worldBox(
+                XMFLOAT3(mCenterX[item], mCenterY[item], mCenterZ[item]),
+                XMFLOAT3(mExtentX[item], mExtentY[item], mExtentZ[item]));
+            if (!occlusion->IsVisible(worldBox))
+            {
+                mStats.OcclusionCulled++;
+                continue;
+            }
+        }
+        mVisible[mLayers[item]].push_back(item);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// A small CPU depth buffer that occluders are rasterized into and occludees
+// are tested against.  Occluders are boxes that must lie entirely inside
+// the geometry they stand for (walls, terrain blocks, the mesh bounds of a
+// box); occludees are tested with their world bounds.  Coverage is sampled
+// at pixel centres, like the GPU does.
+class OcclusionBuffer
+{
+public:
+    static const UINT DefaultWidth = 256;
+    static const UINT DefaultHeight = 128;
+    static const UINT TileSize = 8;
+
+    OcclusionBuffer(UINT width = DefaultWidth, UINT height = DefaultHeight);
+
+    // Clears to the far plane and sets the camera for everything that follows.
+    void Begin(const Matrix& viewProj);
+
+    // Occluders crossing the near plane are skipped, which only costs culling.
+    void RasterizeOccluder(const DirectX::BoundingBox& localBox, const Matrix& world);
+
+    // Call after the last occluder and before the first IsVisible.
+    void End();
+
+    // False only when every pixel the box could cover is nearer in the buffer.
+    bool IsVisible(const DirectX::BoundingBox& worldBox) const;
+
+    UINT Width() const { return mWidth; }
+    UINT Height() const { return mHeight; }
+    const std::vector<float>& Depth() const { return mDepth; }
+
+private:
+    void rasterizeTriangle(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c);
+
+    UINT mWidth;
+    UINT mHeight;
+    UINT mTilesX;
+    UINT mTilesY;
+    Matrix mViewProj;
+    std::vector<float> mDepth;
+    // Farthest depth in each TileSize square.
+    std::vector<float> mTileMaxDepth;
+};
+
+// Keeps the world bounds of every render item as packed arrays and culls
+// them against the camera frustum four at a time, optionally followed by an
+// occlusion test.  Cull produces one compacted list of visible items per
+// RenderLayer.
+class CullingStage
+{
+public:
+    struct Stats
+    {
+        UINT Tested = 0;
+        UINT FrustumCulled = 0;
+        UINT OcclusionCulled = 0;
+    };
+
+    // Returns the item's index for the calls below.
+    UINT Add(const DirectX::BoundingBox& localBounds, RenderLayer layer);
+    void SetWorld(UINT item, const Matrix& world);
+
+    // Also rasterizes localBox, which must lie inside the item's geometry,
+    // into the occlusion buffer when the item is in view.
+    void SetOccluder(UINT item, const DirectX::BoundingBox& localBox);
+
+    void Cull(const Matrix& viewProj, OcclusionBuffer* occlusion = nullptr);
+
+    // Indices of the items that survived the last Cull, in ascending order.
+    const std::vector<UINT>& Visible(RenderLayer layer) const { return mVisible[(int)layer]; }
+    const Stats& GetStats() const { return mStats; }
+    UINT ItemCount() const { return mItemCount; }
+
+private:
+    struct Occluder
+    {
+        UINT Item;
+        DirectX::BoundingBox LocalBox;
+    };
+
+    UINT mItemCount = 0;
+
+    // World space AABBs, padded to a multiple of four.
+    std::vector<float> mCenterX;
+    std::vector<float> mCenterY;
+    std::vector<float> mCenterZ;
+    std::vector<float> mExtentX;
+    std::vector<float> mExtentY;
+    std::vector<float> mExtentZ;
+
+    std::vector<DirectX::BoundingBox> mLocalBounds;
+    std::vector<Matrix> mWorlds;
+    std::vector<uint8_t> mLayers;
+    std::vector<Occluder> mOccluders;
+
+    std::vector<UINT> mInFrustum;
+    std::vector<UINT> mVisible[(int)RenderLayer::Count];
+    Stats mStats;
+};
@@ -580,6 +580,20 @@ void DeviceResources::Present(D3D12_RESOURCE_STATES beforeState)
     }
 }
 
+// Submit what the command list holds so far, followed by other command lists,
+// and reopen it so whatever it records next runs after them.
+void DeviceResources::ExecuteAndResume(UINT count, ID3D12CommandList* const* commandLists)
+{
+    std::vector<ID3D12CommandList*> lists(1, m_commandList.Get());
+    lists.insert(lists.end(), commandLists, commandLists + count);
+
+    ThrowIfFailed(m_commandList->Close());
+    m_commandQueue->ExecuteCommandLists(static_cast<UINT>(lists.size()), lists.data());
+
+    // The allocator only has to be idle to be reset, not to be recorded into.
+    ThrowIfFailed(m_commandList->Reset(m_commandAllocators[m_backBufferIndex].Get(), nullptr));
+}
+
 // Wait for pending GPU work to complete.
 void DeviceResources::WaitForGpu() noexcept
 {
@@ -66,6 +66,7 @@ namespace DX
         void Prepare(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_PRESENT,
             D3D12_RESOURCE_STATES afterState = D3D12_RESOURCE_STATE_RENDER_TARGET);
         void Present(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_RENDER_TARGET);
+        void ExecuteAndResume(UINT count, ID3D12CommandList* const* commandLists);
         void WaitForGpu() noexcept;
 
         // Device Accessors.
@@ -92,6 +93,8 @@ namespace DX
         unsigned int                GetDeviceOptions() const noexcept { return m_options; }
         // device resources DLC
         ID3D12Fence* GetFence() const noexcept { return m_fence.Get(); }
+        // Fence value signalled after the last submitted frame.
+        UINT64 GetSubmittedFenceValue() const noexcept { return m_fenceValues[m_backBufferIndex] - 1; }
         
         CD3DX12_CPU_DESCRIPTOR_HANDLE GetRenderTargetView() const noexcept
         {
@@ -0,0 +1,208 @@
+#include "DrawQueue.h"
+#include "ParallelFor.h"
+
+UINT64 DrawQueue::MakeKey(RenderLayer layer, UINT pipeline, UINT material, UINT geometry, float depth)
+{
+    _ASSERT_EXPR((UINT)layer < 16 && pipeline < 4096 && material < 65536 && geometry < 65536,
+        L"draw key field out of range");
+
+    return SetDepth(((UINT64)layer << 60) | ((UINT64)pipeline << 48) | ((UINT64)material << 32) |
+        ((UINT64)geometry << 16), depth);
+}
+
+UINT64 DrawQueue::SetDepth(UINT64 key, float depth)
+{
+    const UINT64 quantized = (UINT64)(std::min<float>(std::max<float>(depth, 0.0f), 1.0f) * 65535.0f);
+    return (key & ~0xFFFFull) | quantized;
+}
+
+DrawQueue::Stats& DrawQueue::Stats::operator+=(const Stats& rhs)
+{
+    Draws += rhs.Draws;
+    PipelineChanges += rhs.PipelineChanges;
+    TopologyChanges += rhs.TopologyChanges;
+    VertexBufferChanges += rhs.VertexBufferChanges;
+    IndexBufferChanges += rhs.IndexBufferChanges;
+    ConstantBufferChanges += rhs.ConstantBufferChanges;
+    RedundantSkipped += rhs.RedundantSkipped;
+    return *this;
+}
+
+void DrawQueue::Clear()
+{
+    mCommands.clear();
+    mPackets.clear();
+}
+
+void DrawQueue::Add(UINT64 key, const DrawCommand& command)
+{
+    mPackets.push_back({ key, (UINT)mCommands.size() });
+    mCommands.push_back(command);
+}
+
+void DrawQueue::Sort()
+{
+    const size_t count = mPackets.size();
+    mScratch.resize(count);
+
+    // Bytes where keys differ; the rest would be no-op passes.
+    UINT64 differing = 0;
+    for (const auto& packet : mPackets)
+    {
+        differing |= packet.Key ^ mPackets[0].Key;
+    }
+
+    for (UINT shift = 0; shift < 64; shift += 8)
+    {
+        if (((differing >> shift) & 0xFF) == 0)
+        {
+            continue;
+        }
+
+        size_t offsets[256] = {};
+        for (const auto& packet : mPackets)
+        {
+            offsets[(packet.Key >> shift) & 0xFF]++;
+        }
+        size_t sum = 0;
+        for (auto& offset : offsets)
+        {
+            const size_t bucket = offset;
+            offset = sum;
+            sum += bucket;
+        }
+        for (const auto& packet : mPackets)
+        {
+            mScratch[offsets[(packet.Key >> shift) & 0xFF]++] = packet;
+        }
+        mPackets.swap(mScratch);
+    }
+}
+
+void DrawQueue::Record(DrawRecorder& recorder)
+{
+    mStats = Stats();
+    recordRange(recorder, 0, Size(), mStats);
+}
+
+UINT DrawQueue::RecordParallel(ChunkRecorders& recorders, UINT maxChunks, UINT minDrawsPerChunk)
+{
+    UINT totalDraws = 0;
+    for (const auto& packet : mPackets)
+    {
+        totalDraws += drawCount(packet);
+    }
+    const UINT chunkCount = std::max<UINT>(1u, std::min<UINT>(maxChunks, totalDraws / std::max<UINT>(1u, minDrawsPerChunk)));
+
+    // Chunk c starts at the first packet with c * totalDraws / chunkCount
+    // draws before it.
+    mChunkStarts.assign(1, 0);
+    UINT drawsBefore = 0;
+    for (UINT packet = 0; packet < Size() && mChunkStarts.size() < chunkCount; packet++)
+    {
+        if (drawsBefore >= (UINT64)mChunkStarts.size() * totalDraws / chunkCount)
+        {
+            mChunkStarts.push_back(packet);
+        }
+        drawsBefore += drawCount(mPackets[packet]);
+    }
+    mChunkStarts.resize(chunkCount, Size());
+    mChunkStarts.push_back(Size());
+
+    recorders.Reset(chunkCount);
+    mChunkStats.assign(chunkCount, Stats());
+    ParallelFor(0u, chunkCount, [&](UINT chunk)
+    {
+        DrawRecorder& recorder = recorders.BeginChunk(chunk);
+        recordRange(recorder, mChunkStarts[chunk], mChunkStarts[chunk + 1], mChunkStats[chunk]);
+        recorders.EndChunk(chunk);
+    });
+    recorders.Submit(chunkCount);
+
+    mStats = Stats();
+    for (const auto& stats : mChunkStats)
+    {
+        mStats += stats;
+    }
+    return chunkCount;
+}
+
+UINT DrawQueue::drawCount(const DrawPacket& packet) const
+{
+    const auto ranges = mCommands[packet.Command].IndexRanges;
+    return ranges && !ranges->empty() ? (UINT)ranges->size() : 1;
+}
+
+void DrawQueue::recordRange(DrawRecorder& recorder, UINT begin, UINT end, Stats& stats) const
+{
+    const DrawCommand* current = nullptr;
+    for (UINT packet = begin; packet < end; packet++)
+    {
+        const DrawCommand& command = mCommands[mPackets[packet].Command];
+
+        if (!current || command.Pso != current->Pso)
+        {
+            recorder.SetPipelineState(command.Pso);
+            stats.PipelineChanges++;
+        }
+        else
+        {
+            stats.RedundantSkipped++;
+        }
+
+        if (!current || command.Topology != current->Topology)
+        {
+            recorder.SetPrimitiveTopology(command.Topology);
+            stats.TopologyChanges++;
+        }
+        else
+        {
+            stats.RedundantSkipped++;
+        }
+
+        if (!current || memcmp(&command.VertexBuffer, &current->VertexBuffer, sizeof(command.VertexBuffer)) != 0)
+        {
+            recorder.SetVertexBuffer(command.VertexBuffer);
+            stats.VertexBufferChanges++;
+        }
+        else
+        {
+            stats.RedundantSkipped++;
+        }
+
+        if (!current || memcmp(&command.IndexBuffer, &current->IndexBuffer, sizeof(command.IndexBuffer)) != 0)
+        {
+            recorder.SetIndexBuffer(command.IndexBuffer);
+            stats.IndexBufferChanges++;
+        }
+        else
+        {
+            stats.RedundantSkipped++;
+        }
+
+        if (!current || command.ObjectConstants != current->ObjectConstants)
+        {
+            recorder.SetObjectConstants(command.ObjectConstants);
+            stats.ConstantBufferChanges++;
+        }
+        else
+        {
+            stats.RedundantSkipped++;
+        }
+
+        if (!command.IndexRanges || command.IndexRanges->empty())
+        {
+            recorder.DrawIndexed(command.IndexCount, command.StartIndexLocation, command.BaseVertexLocation);
+            stats.Draws++;
+        }
+        else
+        {
+            for (const auto& range : *command.IndexRanges)
+            {
+                recorder.DrawIndexed(range.IndexCount, range.StartIndexLocation, range.BaseVertexLocation);
+                stats.Draws++;
+            }
+        }
+        current = &command;
+    }
+}
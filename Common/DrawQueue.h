@@ -0,0 +1,224 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <thread>
+
+// Everything needed to record one draw, resolved before recording so
+// nothing is looked up by name per draw.
+struct DrawCommand
+{
+    ID3D12PipelineState* Pso = nullptr;
+    D3D12_PRIMITIVE_TOPOLOGY Topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+    D3D12_VERTEX_BUFFER_VIEW VertexBuffer = {};
+    D3D12_INDEX_BUFFER_VIEW IndexBuffer = {};
+    D3D12_GPU_VIRTUAL_ADDRESS ObjectConstants = 0;
+
+    UINT IndexCount = 0;
+    UINT StartIndexLocation = 0;
+    INT BaseVertexLocation = 0;
+
+    // Drawn range by range instead of the range above when not empty.
+    const std::vector<SubmeshGeometry>* IndexRanges = nullptr;
+};
+
+// The command list calls DrawQueue::Record makes.
+class DrawRecorder
+{
+public:
+    virtual ~DrawRecorder() = default;
+
+    virtual void SetPipelineState(ID3D12PipelineState* pso) = 0;
+    virtual void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) = 0;
+    virtual void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) = 0;
+    virtual void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) = 0;
+    virtual void SetObjectConstants(D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+    virtual void DrawIndexed(UINT indexCount, UINT startIndexLocation, INT baseVertexLocation) = 0;
+};
+
+// Records into a graphics command list; object constants go to one root CBV.
+class D3D12DrawRecorder : public DrawRecorder
+{
+public:
+    D3D12DrawRecorder(ID3D12GraphicsCommandList* cmdList, UINT objectConstantsParameter) :
+        mCommandList(cmdList), mObjectConstantsParameter(objectConstantsParameter) {}
+
+    // Points a kept recorder at the list it records next.
+    void Reset(ID3D12GraphicsCommandList* cmdList, UINT objectConstantsParameter)
+    {
+        mCommandList = cmdList;
+        mObjectConstantsParameter = objectConstantsParameter;
+    }
+
+    void SetPipelineState(ID3D12PipelineState* pso) override { mCommandList->SetPipelineState(pso); }
+    void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override { mCommandList->IASetPrimitiveTopology(topology); }
+    void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) override { mCommandList->IASetVertexBuffers(0, 1, &view); }
+    void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) override { mCommandList->IASetIndexBuffer(&view); }
+    void SetObjectConstants(D3D12_GPU_VIRTUAL_ADDRESS address) override
+    {
+        mCommandList->SetGraphicsRootConstantBufferView(mObjectConstantsParameter, address);
+    }
+    void DrawIndexed(UINT indexCount, UINT startIndexLocation, INT baseVertexLocation) override
+    {
+        mCommandList->DrawIndexedInstanced(indexCount, 1, startIndexLocation, baseVertexLocation, 0);
+    }
+
+private:
+    ID3D12GraphicsCommandList* mCommandList;
+    UINT mObjectConstantsParameter;
+};
+
+// Keeps every call in order, so sorting and state filtering can be checked
+// without a device.
+class MockDrawRecorder : public DrawRecorder
+{
+public:
+    enum class Call
+    {
+        PipelineState,
+        PrimitiveTopology,
+        VertexBuffer,
+        IndexBuffer,
+        ObjectConstants,
+        DrawIndexed,
+    };
+
+    struct Record
+    {
+        Call Type;
+        UINT64 Value;       // the PSO, topology, buffer location or address; index count for draws
+    };
+
+    void SetPipelineState(ID3D12PipelineState* pso) override { mCalls.push_back({ Call::PipelineState, (UINT64)pso }); }
+    void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override { mCalls.push_back({ Call::PrimitiveTopology, (UINT64)topology }); }
+    void SetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) override { mCalls.push_back({ Call::VertexBuffer, view.BufferLocation }); }
+    void SetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) override { mCalls.push_back({ Call::IndexBuffer, view.BufferLocation }); }
+    void SetObjectConstants(D3D12_GPU_VIRTUAL_ADDRESS address) override { mCalls.push_back({ Call::ObjectConstants, address }); }
+    void DrawIndexed(UINT indexCount, UINT startIndexLocation, INT baseVertexLocation) override { mCalls.push_back({ Call::DrawIndexed, indexCount }); }
+
+    std::vector<Record> mCalls;
+};
+
+// Where DrawQueue::RecordParallel records: one recorder per chunk of the
+// draws, each used by one worker thread between BeginChunk and EndChunk.
+class ChunkRecorders
+{
+public:
+    virtual ~ChunkRecorders() = default;
+
+    // Called once per frame before any chunk is begun.
+    virtual void Reset(UINT chunkCount) = 0;
+    virtual DrawRecorder& BeginChunk(UINT chunk) = 0;
+    virtual void EndChunk(UINT chunk) = 0;
+    // Queues every chunk for execution, in chunk order.
+    virtual void Submit(UINT chunkCount) = 0;
+};
+
+// A MockDrawRecorder per chunk, plus the thread that recorded each chunk and
+// the chunks that had ended by the time they were submitted.
+class MockChunkRecorders : public ChunkRecorders
+{
+public:
+    struct Chunk
+    {
+        MockDrawRecorder Recorder;
+        std::thread::id Thread;
+        bool Ended = false;
+    };
+
+    void Reset(UINT chunkCount) override
+    {
+        mChunks.clear();
+        mChunks.resize(chunkCount);
+        mSubmitted.clear();
+    }
+    DrawRecorder& BeginChunk(UINT chunk) override
+    {
+        mChunks[chunk].Thread = std::this_thread::get_id();
+        return mChunks[chunk].Recorder;
+    }
+    void EndChunk(UINT chunk) override { mChunks[chunk].Ended = true; }
+    void Submit(UINT chunkCount) override
+    {
+        for (UINT chunk = 0; chunk < chunkCount; chunk++)
+        {
+            if (mChunks[chunk].Ended)
+            {
+                mSubmitted.push_back(chunk);
+            }
+        }
+    }
+
+    std::vector<Chunk> mChunks;
+    std::vector<UINT> mSubmitted;
+};
+
+// Draws collected for a frame, sorted by a 64-bit key and recorded with
+// every state change that would not change anything left out.
+//
+// Key layout, most significant first, so that the most expensive state
+// changes happen least often:
+//   layer 4 bits | pipeline 12 | material 16 | geometry 16 | depth 16
+// Depth is quantized front to back, which is what opaque layers want;
+// layers drawn back to front pass 1 - depth.
+class DrawQueue
+{
+public:
+    struct Stats
+    {
+        UINT Draws = 0;
+        UINT PipelineChanges = 0;
+        UINT TopologyChanges = 0;
+        UINT VertexBufferChanges = 0;
+        UINT IndexBufferChanges = 0;
+        UINT ConstantBufferChanges = 0;
+        // State sets skipped because the state was already current.
+        UINT RedundantSkipped = 0;
+
+        Stats& operator+=(const Stats& rhs);
+    };
+
+    enum : UINT { MinDrawsPerChunk = 256 };
+
+    // depth is view depth over the far plane distance, clamped to [0, 1].
+    static UINT64 MakeKey(RenderLayer layer, UINT pipeline, UINT material, UINT geometry, float depth = 0.0f);
+    // Replaces the depth of a key, for keys whose other fields are made once.
+    static UINT64 SetDepth(UINT64 key, float depth);
+
+    void Clear();
+    void Add(UINT64 key, const DrawCommand& command);
+
+    // Stable LSD radix sort on the keys, one byte per pass; passes where
+    // every key has the same byte are skipped.
+    void Sort();
+
+    // Records in sorted order; the recorder's state is unknown beforehand.
+    void Record(DrawRecorder& recorder);
+
+    // Splits the sorted draws into at most maxChunks contiguous chunks with
+    // about as many draw calls each, records the chunks concurrently and
+    // submits them in order.  Chunks get at least minDrawsPerChunk draws,
+    // so small queues use fewer chunks.  Returns the number of chunks.
+    UINT RecordParallel(ChunkRecorders& recorders, UINT maxChunks, UINT minDrawsPerChunk = MinDrawsPerChunk);
+    // First packet of each chunk of the last RecordParallel, and Size().
+    const std::vector<UINT>& ChunkStarts() const { return mChunkStarts; }
+
+    UINT Size() const { return (UINT)mPackets.size(); }
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    struct DrawPacket
+    {
+        UINT64 Key;
+        UINT Command;
+    };
+
+    UINT drawCount(const DrawPacket& packet) const;
+    void recordRange(DrawRecorder& recorder, UINT begin, UINT end, Stats& stats) const;
+
+    std::vector<DrawCommand> mCommands;
+    std::vector<DrawPacket> mPackets;
+    std::vector<DrawPacket> mScratch;
+    std::vector<UINT> mChunkStarts;
+    std::vector<Stats> mChunkStats;
+    Stats mStats;
+};
@@ -0,0 +1,145 @@
+#include "FramePacer.h"
+#include <chrono>
+#include <system_error>
+
+D3D12FrameFence::D3D12FrameFence(DX::DeviceResources* devRes) :
+    mDeviceResources(devRes)
+{
+    mEvent.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
+    if (!mEvent.IsValid())
+    {
+        throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateEventEx");
+    }
+}
+
+void D3D12FrameFence::Wait(UINT64 value)
+{
+    auto fence = mDeviceResources->GetFence();
+    if (fence->GetCompletedValue() < value)
+    {
+        DX::ThrowIfFailed(fence->SetEventOnCompletion(value, mEvent.Get()));
+        WaitForSingleObjectEx(mEvent.Get(), INFINITE, FALSE);
+    }
+}
+
+double D3D12FrameFence::Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SimulatedFrameFence::Submit(double gpuSeconds)
+{
+    const double start = mCompletionTimes.empty() ? mNow : std::max<double>(mNow, mCompletionTimes.back());
+    mCompletionTimes.push_back(start + gpuSeconds);
+}
+
+UINT64 SimulatedFrameFence::Completed()
+{
+    // Completion times never decrease.
+    return std::upper_bound(mCompletionTimes.begin(), mCompletionTimes.end(), mNow) - mCompletionTimes.begin();
+}
+
+void SimulatedFrameFence::Wait(UINT64 value)
+{
+    if (value > 0 && value <= mCompletionTimes.size())
+    {
+        mNow = std::max<double>(mNow, mCompletionTimes[value - 1]);
+    }
+}
+
+void FrameHistogram::Add(double seconds)
+{
+    const UINT bucket = (UINT)std::max<double>(0.0, seconds / BucketSeconds);
+    Counts[std::min<UINT>(bucket, BucketCount - 1)]++;
+    Total++;
+}
+
+double FrameHistogram::Percentile(double fraction) const
+{
+    const UINT wanted = (UINT)std::ceil(fraction * Total);
+    UINT seen = 0;
+    for (UINT bucket = 0; bucket < BucketCount; bucket++)
+    {
+        seen += Counts[bucket];
+        if (seen >= wanted && seen > 0)
+        {
+            return (bucket + 1) * BucketSeconds;
+        }
+    }
+    return 0.0;
+}
+
+FramePacer::FramePacer(std::unique_ptr<FrameFence> fence, UINT capacity) :
+    mFence(std::move(fence)),
+    mCapacity(capacity),
+    mFramesInFlight(capacity)
+{
+    _ASSERT_EXPR(capacity > 0, L"FramePacer needs at least one frame resource");
+}
+
+void FramePacer::SetFramesInFlight(UINT frames)
+{
+    mFramesInFlight = std::max<UINT>(1u, std::min<UINT>(frames, mCapacity));
+}
+
+UINT FramePacer::BeginFrame()
+{
+    // Whatever the previous frame submitted has been signalled by now.
+    if (!mFrames.empty())
+    {
+        mFrames.back().Fence = mFence->Submitted();
+    }
+    retireCompleted();
+
+    if (mLatencyTarget > 0.0 && mFrameNumber > 0 && mFrameNumber % AdaptInterval == 0)
+    {
+        adapt();
+    }
+
+    // Frame n may start once frame n - FramesInFlight() has completed.
+    const double waitStart = mFence->Now();
+    if (mFrames.size() >= mFramesInFlight)
+    {
+        mFence->Wait(mFrames[mFrames.size() - mFramesInFlight].Fence);
+        retireCompleted();
+    }
+    const double wait = mFence->Now() - waitStart;
+    mCpuWaits.Add(wait);
+    mWindowWaits.Add(wait);
+
+    mFrames.push_back({ mFence->Now(), 0 });
+    return (UINT)(mFrameNumber++ % mCapacity);
+}
+
+void FramePacer::retireCompleted()
+{
+    const UINT64 completed = mFence->Completed();
+    const double now = mFence->Now();
+    while (!mFrames.empty() && mFrames.front().Fence <= completed)
+    {
+        const double latency = now - mFrames.front().Start;
+        mLatencies.Add(latency);
+        mWindowLatencies.Add(latency);
+        mFrames.pop_front();
+    }
+}
+
+void FramePacer::adapt()
+{
+    const double latency = mWindowLatencies.Percentile(0.9);
+    const double wait = mWindowWaits.Percentile(0.5);
+    if (mWindowLatencies.Total > 0)
+    {
+        if (latency > mLatencyTarget && mFramesInFlight > 1)
+        {
+            mFramesInFlight--;
+        }
+        else if (wait > FrameHistogram::BucketSeconds && mFramesInFlight < mCapacity &&
+            latency * (mFramesInFlight + 1) / mFramesInFlight <= mLatencyTarget)
+        {
+            mFramesInFlight++;
+        }
+    }
+    mWindowLatencies.Clear();
+    mWindowWaits.Clear();
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "DeviceResources.h"
+#include <deque>
+
+// The GPU timeline frames are paced against: a fence whose value grows by
+// at least one per submitted frame, and the clock the pacer measures with.
+class FrameFence
+{
+public:
+    virtual ~FrameFence() = default;
+
+    // Fence value that completes with the newest submitted frame.
+    virtual UINT64 Submitted() = 0;
+    virtual UINT64 Completed() = 0;
+    // Blocks until Completed() >= value.
+    virtual void Wait(UINT64 value) = 0;
+    // Seconds, from an arbitrary origin.
+    virtual double Now() = 0;
+};
+
+// DeviceResources' fence, waited on through one event kept for the
+// lifetime of the pacer.
+class D3D12FrameFence : public FrameFence
+{
+public:
+    explicit D3D12FrameFence(DX::DeviceResources* devRes);
+
+    UINT64 Submitted() override { return mDeviceResources->GetSubmittedFenceValue(); }
+    UINT64 Completed() override { return mDeviceResources->GetFence()->GetCompletedValue(); }
+    void Wait(UINT64 value) override;
+    double Now() override;
+
+private:
+    DX::DeviceResources* mDeviceResources;
+    Microsoft::WRL::Wrappers::Event mEvent;
+};
+
+// A GPU that runs submitted frames back to back, on a clock that only
+// moves when told to, so pacing policy can be exercised without a device.
+class SimulatedFrameFence : public FrameFence
+{
+public:
+    // Queues a frame that takes gpuSeconds once the GPU gets to it.
+    void Submit(double gpuSeconds);
+    // CPU work between waits.
+    void Advance(double seconds) { mNow += seconds; }
+
+    UINT64 Submitted() override { return mCompletionTimes.size(); }
+    UINT64 Completed() override;
+    void Wait(UINT64 value) override;
+    double Now() override { return mNow; }
+
+    double mNow = 0.0;
+    std::vector<double> mCompletionTimes;   // of fence value i + 1
+};
+
+// Fixed width buckets of durations, with everything past the last bucket
+// counted in the last one.
+struct FrameHistogram
+{
+    static const UINT BucketCount = 64;
+    static constexpr double BucketSeconds = 0.0005;
+
+    void Add(double seconds);
+    void Clear() { *this = FrameHistogram(); }
+    // Upper bound of the bucket holding the given fraction of samples.
+    double Percentile(double fraction) const;
+
+    UINT Counts[BucketCount] = {};
+    UINT Total = 0;
+};
+
+// Decides when the CPU may start a frame and which frame resource it uses.
+//
+// The frame resource ring holds capacity slots; at most FramesInFlight()
+// frames, never more than capacity, are queued on the GPU at once.  Frame
+// n waits for frame n - FramesInFlight() to complete and uses slot
+// n % capacity, which frees up no later than that.
+//
+// BeginFrame records how long the CPU waited, and the latency from the
+// start of every frame to its GPU completion as observed at the next
+// BeginFrame.  With a latency target set, every AdaptInterval frames the
+// pacer drops a frame in flight when the 90th percentile latency is over
+// the target, and adds one when the CPU had to wait and one more frame
+// would still fit under the target.
+class FramePacer
+{
+public:
+    static const UINT AdaptInterval = 60;
+
+    FramePacer(std::unique_ptr<FrameFence> fence, UINT capacity);
+
+    // Waits as needed and returns the frame resource slot for the frame.
+    UINT BeginFrame();
+
+    void SetFramesInFlight(UINT frames);
+    UINT FramesInFlight() const { return mFramesInFlight; }
+    UINT Capacity() const { return mCapacity; }
+
+    // Zero turns adaptation off.
+    void SetLatencyTarget(double seconds) { mLatencyTarget = seconds; }
+    double LatencyTarget() const { return mLatencyTarget; }
+
+    // Since the pacer was created.
+    const FrameHistogram& CpuWaits() const { return mCpuWaits; }
+    const FrameHistogram& Latencies() const { return mLatencies; }
+
+private:
+    struct Frame
+    {
+        double Start;
+        UINT64 Fence;
+    };
+
+    void retireCompleted();
+    void adapt();
+
+    std::unique_ptr<FrameFence> mFence;
+    UINT mCapacity;
+    UINT mFramesInFlight;
+    double mLatencyTarget = 0.0;
+    UINT64 mFrameNumber = 0;
+
+    // Started frames that have not been seen to complete, oldest first.
+    // The newest one's Fence is only known at the next BeginFrame.
+    std::deque<Frame> mFrames;
+
+    FrameHistogram mCpuWaits;
+    FrameHistogram mLatencies;
+    FrameHistogram mWindowWaits;
+    FrameHistogram mWindowLatencies;
+};
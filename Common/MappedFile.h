@@ -0,0 +1,240 @@
+//
+// MappedFile.h - Read-only memory mapped view of a file on disk
+//
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+// Maps a whole file into the address space so loaders can parse it in place
+// instead of copying it through an iostream.  The view stays valid until the
+// object is destroyed or Close() is called.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::wstring& filename) { Open(filename); }
+    explicit MappedFile(const std::string& filename) { Open(filename); }
+    MappedFile(const MappedFile& rhs) = delete;
+    MappedFile& operator=(const MappedFile& rhs) = delete;
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::wstring& filename)
+    {
+        Close();
+
+        mFile = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (mFile == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size = {};
+        if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+
+        mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mMapping == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        mData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        if (mData == nullptr)
+        {
+            Close();
+            return false;
+        }
+
+        mSize = static_cast<size_t>(size.QuadPart);
+        return true;
+    }
+
+    bool Open(const std::string& filename)
+    {
+        return Open(std::wstring(filename.begin(), filename.end()));
+    }
+
+    void Close()
+    {
+        if (mData != nullptr)
+        {
+            UnmapViewOfFile(mData);
+            mData = nullptr;
+        }
+        if (mMapping != nullptr)
+        {
+            CloseHandle(mMapping);
+            mMapping = nullptr;
+        }
+        if (mFile != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(mFile);
+            mFile = INVALID_HANDLE_VALUE;
+        }
+        mSize = 0;
+    }
+
+    bool IsOpen()const { return mData != nullptr; }
+    const uint8_t* Data()const { return mData; }
+    size_t Size()const { return mSize; }
+
+private:
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+};
+
+// Size and last write time of a file, read from its directory entry without
+// opening it.  Cheap enough to check on every load, unlike hashing the bytes.
+struct FileStamp
+{
+    uint64_t size = 0;
+    uint64_t writeTime = 0;
+
+    bool operator==(const FileStamp& rhs)const { return size == rhs.size && writeTime == rhs.writeTime; }
+    bool operator!=(const FileStamp& rhs)const { return !(*this == rhs); }
+
+    static bool Get(const std::wstring& filename, FileStamp& stamp)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data = {};
+        if (!GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &data))
+        {
+            return false;
+        }
+        stamp.size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+        stamp.writeTime = (uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+        return true;
+    }
+
+    static bool Get(const std::string& filename, FileStamp& stamp)
+    {
+        return Get(std::wstring(filename.begin(), filename.end()), stamp);
+    }
+};
+
+// FNV-1a over 64-bit words rather than bytes, so hashing a large file runs
+// close to memory bandwidth.  The content key of AssetRegistry and MeshCache.
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+{
+    const uint64_t prime = 1099511628211ull;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+
+    // Fold in the length and mix the high bits down.
+    hash = (hash ^ size) * prime;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Forward-only cursor over a byte span such as a MappedFile view.  Every read
+// checks the remaining byte count first, so a truncated or corrupt file fails
+// cleanly instead of reading past the end of the view.
+class SpanReader
+{
+public:
+    SpanReader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    size_t Offset()const { return mOffset; }
+    size_t Remaining()const { return mSize - mOffset; }
+
+    bool Skip(size_t byteSize)
+    {
+        if (byteSize > Remaining())
+        {
+            return false;
+        }
+        mOffset += byteSize;
+        return true;
+    }
+
+    // Skips padding up to the next multiple of alignment.
+    bool Align(size_t alignment)
+    {
+        return Skip((alignment - mOffset % alignment) % alignment);
+    }
+
+    template <typename T>
+    bool Read(T& out)
+    {
+        if (sizeof(T) > Remaining())
+        {
+            return false;
+        }
+        memcpy(&out, mData + mOffset, sizeof(T));
+        mOffset += sizeof(T);
+        return true;
+    }
+
+    // Copies count packed elements in one go.
+    template <typename T>
+    bool ReadArray(std::vector<T>& out, size_t count)
+    {
+        if (count > Remaining() / sizeof(T))
+        {
+            return false;
+        }
+        out.resize(count);
+        if (count > 0)
+        {
+            memcpy(out.data(), mData + mOffset, count * sizeof(T));
+        }
+        mOffset += count * sizeof(T);
+        return true;
+    }
+
+    // Returns a pointer to count elements inside the span without copying.
+    // The caller is responsible for the span being suitably aligned for T.
+    template <typename T>
+    bool ReadView(const T*& out, size_t count)
+    {
+        if (count > Remaining() / sizeof(T))
+        {
+            return false;
+        }
+        out = reinterpret_cast<const T*>(mData + mOffset);
+        mOffset += count * sizeof(T);
+        return true;
+    }
+
+    bool ReadString(char* out, size_t length)
+    {
+        if (length > Remaining())
+        {
+            return false;
+        }
+        memcpy(out, mData + mOffset, length);
+        mOffset += length;
+        return true;
+    }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mOffset = 0;
+};
@@ -0,0 +1,194 @@
+#include "MeshUploader.h"
+
+namespace
+{
+    // Vertex buffer views only need 4 byte alignment and index buffer views
+    // the index size; 16 keeps every range on a cache friendly boundary.
+    const UINT64 RangeAlignment = 16;
+}
+
+BufferRangeAllocator::Range BufferRangeAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+    Range range;
+    if (!mPageSizes.empty())
+    {
+        const UINT64 offset = (mPageSizes.back() + alignment - 1) / alignment * alignment;
+        if (offset + size <= mPageSize)
+        {
+            range.Page = (UINT)mPageSizes.size() - 1;
+            range.Offset = offset;
+            mPageSizes.back() = offset + size;
+            return range;
+        }
+    }
+
+    range.Page = (UINT)mPageSizes.size();
+    range.Offset = 0;
+    mPageSizes.push_back(size);
+    return range;
+}
+
+D3D12MeshUploadBackend::D3D12MeshUploadBackend(DX::DeviceResources* devRes) :
+    mDeviceResources(devRes),
+    mUpload(devRes->GetD3DDevice())
+{
+}
+
+void D3D12MeshUploadBackend::Begin()
+{
+    mUpload.Begin();
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> D3D12MeshUploadBackend::CreateBuffer(UINT64 size, D3D12_RESOURCE_STATES finalState, void** data)
+{
+    auto dev = mDeviceResources->GetD3DDevice();
+
+    PendingBuffer buffer;
+    buffer.Staging = GraphicsMemory::Get(dev).Allocate(size);
+    buffer.FinalState = finalState;
+
+    auto desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+
+    DX::ThrowIfFailed(dev->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(buffer.Resource.GetAddressOf())
+    ));
+
+    *data = buffer.Staging.Memory();
+    mPending.push_back(std::move(buffer));
+    return mPending.back().Resource;
+}
+
+void D3D12MeshUploadBackend::End()
+{
+    for (auto& buffer : mPending)
+    {
+        mUpload.Upload(buffer.Resource.Get(), buffer.Staging);
+        mUpload.Transition(buffer.Resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, buffer.FinalState);
+    }
+
+    auto finish = mUpload.End(mDeviceResources->GetCommandQueue());
+    finish.wait();
+
+    mPending.clear();
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> NullMeshUploadBackend::CreateBuffer(UINT64 size, D3D12_RESOURCE_STATES, void** data)
+{
+    mBuffers.emplace_back((size_t)size);
+    *data = mBuffers.back().data();
+    return nullptr;
+}
+
+MeshUploader::MeshUploader(DX::DeviceResources* devRes, UINT64 pageSize) :
+    MeshUploader(std::make_unique<D3D12MeshUploadBackend>(devRes), pageSize)
+{
+}
+
+MeshUploader::MeshUploader(std::unique_ptr<MeshUploadBackend> backend, UINT64 pageSize) :
+    mBackend(std::move(backend)),
+    mVertexAllocator(pageSize),
+    mIndexAllocator(pageSize)
+{
+}
+
+void MeshUploader::Add(MeshGeometry* geo, const std::string& name,
+    const void* vertices, size_t vertexCount, UINT vertexStride,
+    const void* indices, size_t indexCount, UINT sourceIndexSize, UINT indexSize)
+{
+    PendingMesh mesh;
+    mesh.Geo = geo;
+    mesh.Name = name;
+    mesh.Vertices = vertices;
+    mesh.VertexCount = (UINT)vertexCount;
+    mesh.VertexStride = vertexStride;
+    mesh.Indices = indices;
+    mesh.IndexCount = (UINT)indexCount;
+    mesh.SourceIndexSize = sourceIndexSize;
+    mesh.IndexSize = indexSize;
+    mesh.VertexRange = mVertexAllocator.Allocate((UINT64)vertexCount * vertexStride, RangeAlignment);
+    mesh.IndexRange = mIndexAllocator.Allocate((UINT64)indexCount * indexSize, RangeAlignment);
+    mPending.push_back(std::move(mesh));
+}
+
+void MeshUploader::Upload()
+{
+    if (mPending.empty())
+    {
+        return;
+    }
+
+    mBackend->Begin();
+
+    // One buffer per page.  Empty pages only come from empty meshes and get
+    // no resource.
+    auto createPages = [this](const BufferRangeAllocator& allocator, D3D12_RESOURCE_STATES finalState,
+        std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>& resources, std::vector<uint8_t*>& data)
+    {
+        for (UINT64 size : allocator.PageSizes())
+        {
+            void* memory = nullptr;
+            resources.push_back(size > 0 ? mBackend->CreateBuffer(size, finalState, &memory) : nullptr);
+            data.push_back(static_cast<uint8_t*>(memory));
+        }
+    };
+
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> vertexBuffers;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> indexBuffers;
+    std::vector<uint8_t*> vertexData;
+    std::vector<uint8_t*> indexData;
+    createPages(mVertexAllocator, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, vertexBuffers, vertexData);
+    createPages(mIndexAllocator, D3D12_RESOURCE_STATE_INDEX_BUFFER, indexBuffers, indexData);
+
+    for (auto& mesh : mPending)
+    {
+        const UINT vbByteSize = mesh.VertexCount * mesh.VertexStride;
+        const UINT ibByteSize = mesh.IndexCount * mesh.IndexSize;
+
+        if (vbByteSize > 0)
+        {
+            memcpy(vertexData[mesh.VertexRange.Page] + mesh.VertexRange.Offset, mesh.Vertices, vbByteSize);
+        }
+
+        uint8_t* dst = indexData[mesh.IndexRange.Page] + mesh.IndexRange.Offset;
+        if (mesh.SourceIndexSize == mesh.IndexSize)
+        {
+            if (ibByteSize > 0)
+            {
+                memcpy(dst, mesh.Indices, ibByteSize);
+            }
+        }
+        else
+        {
+            const uint32_t* src = static_cast<const uint32_t*>(mesh.Indices);
+            uint16_t* dst16 = reinterpret_cast<uint16_t*>(dst);
+            for (UINT i = 0; i < mesh.IndexCount; i++)
+            {
+                dst16[i] = (uint16_t)src[i];
+            }
+        }
+
+        MeshGeometry* geo = mesh.Geo;
+        geo->Name = mesh.Name;
+        geo->VertexBuffer = vertexBuffers[mesh.VertexRange.Page];
+        geo->VertexBufferOffset = mesh.VertexRange.Offset;
+        geo->VertexByteStride = mesh.VertexStride;
+        geo->VertexBufferByteSize = vbByteSize;
+        geo->IndexBuffer = indexBuffers[mesh.IndexRange.Page];
+        geo->IndexBufferOffset = mesh.IndexRange.Offset;
+        geo->IndexFormat = mesh.IndexSize == sizeof(uint32_t) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+        geo->IndexBufferByteSize = ibByteSize;
+        geo->TotalIndexCount = mesh.IndexCount;
+    }
+
+    mBackend->End();
+
+    mPending.clear();
+    mVertexAllocator.Reset();
+    mIndexAllocator.Reset();
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// Hands out aligned ranges from a sequence of fixed size pages.  A range that
+// does not fit in the current page starts a new one; a range larger than a
+// page gets a page of its own.
+class BufferRangeAllocator
+{
+public:
+    struct Range
+    {
+        UINT Page = 0;
+        UINT64 Offset = 0;
+    };
+
+    explicit BufferRangeAllocator(UINT64 pageSize) : mPageSize(pageSize) {}
+
+    Range Allocate(UINT64 size, UINT64 alignment);
+    void Reset() { mPageSizes.clear(); }
+
+    // Bytes used in each page so far, which is also the size to create it with.
+    const std::vector<UINT64>& PageSizes() const { return mPageSizes; }
+
+private:
+    UINT64 mPageSize;
+    std::vector<UINT64> mPageSizes;
+};
+
+// Where MeshUploader gets its buffers from.  Between Begin and End every
+// created buffer exposes CPU memory to fill; End makes the contents visible
+// in the returned resources and blocks until they are.
+class MeshUploadBackend
+{
+public:
+    virtual ~MeshUploadBackend() = default;
+
+    virtual void Begin() = 0;
+    virtual Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(UINT64 size, D3D12_RESOURCE_STATES finalState, void** data) = 0;
+    virtual void End() = 0;
+};
+
+// Uploads through a single ResourceUploadBatch submission.
+class D3D12MeshUploadBackend : public MeshUploadBackend
+{
+public:
+    explicit D3D12MeshUploadBackend(DX::DeviceResources* devRes);
+
+    void Begin() override;
+    Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(UINT64 size, D3D12_RESOURCE_STATES finalState, void** data) override;
+    void End() override;
+
+private:
+    struct PendingBuffer
+    {
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+        SharedGraphicsResource Staging;
+        D3D12_RESOURCE_STATES FinalState;
+    };
+
+    DX::DeviceResources* mDeviceResources;
+    ResourceUploadBatch mUpload;
+    std::vector<PendingBuffer> mPending;
+};
+
+// Keeps the buffers in system memory and hands out null resources, so the
+// range and batching logic can be exercised without a device.
+class NullMeshUploadBackend : public MeshUploadBackend
+{
+public:
+    void Begin() override {}
+    Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(UINT64 size, D3D12_RESOURCE_STATES finalState, void** data) override;
+    void End() override { mSubmitCount++; }
+
+    std::vector<std::vector<uint8_t>> mBuffers;
+    UINT mSubmitCount = 0;
+};
+
+// Collects the meshes of a load and uploads them together: vertex and index
+// data are suballocated from a few shared buffers, staged once and submitted
+// with one End() instead of one round trip per mesh.  Each MeshGeometry ends
+// up with views into the shared buffers.
+//
+// Add only records pointers; the vertex and index data must stay alive until
+// Upload returns.
+class MeshUploader
+{
+public:
+    static const UINT64 DefaultPageSize = 64 * 1024 * 1024;
+
+    explicit MeshUploader(DX::DeviceResources* devRes, UINT64 pageSize = DefaultPageSize);
+    explicit MeshUploader(std::unique_ptr<MeshUploadBackend> backend, UINT64 pageSize = DefaultPageSize);
+
+    template <typename VertexTypes, typename IndexTypes>
+    void Add(MeshGeometry* geo, const std::string& name,
+        const VertexTypes* vertices, size_t vertexCount,
+        const IndexTypes* indices, size_t indexCount)
+    {
+        static_assert(sizeof(IndexTypes) == sizeof(uint16_t) || sizeof(IndexTypes) == sizeof(uint32_t),
+            "index buffers are either 16 or 32 bit");
+        Add(geo, name, vertices, vertexCount, sizeof(VertexTypes),
+            indices, indexCount, sizeof(IndexTypes), sizeof(IndexTypes));
+    }
+
+    template <typename VertexTypes>
+    void Add(MeshGeometry* geo, const std::string& name,
+        const vector<VertexTypes>& vertices, const vector<uint16_t>& indices)
+    {
+        Add(geo, name, vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    // Like MeshGeometry::Set, 32-bit indices are narrowed while staging when
+    // every vertex is reachable with 16 bits.
+    template <typename VertexTypes>
+    void Add(MeshGeometry* geo, const std::string& name,
+        const vector<VertexTypes>& vertices, const vector<uint32_t>& indices)
+    {
+        const UINT indexSize = vertices.size() <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+        Add(geo, name, vertices.data(), vertices.size(), sizeof(VertexTypes),
+            indices.data(), indices.size(), sizeof(uint32_t), indexSize);
+    }
+
+    void Add(MeshGeometry* geo, const std::string& name,
+        const void* vertices, size_t vertexCount, UINT vertexStride,
+        const void* indices, size_t indexCount, UINT sourceIndexSize, UINT indexSize);
+
+    // Creates the shared buffers, fills every added MeshGeometry and waits
+    // for the copy to finish.  The uploader can be reused afterwards.
+    void Upload();
+
+    size_t PendingCount() const { return mPending.size(); }
+
+private:
+    struct PendingMesh
+    {
+        MeshGeometry* Geo;
+        std::string Name;
+        const void* Vertices;
+        UINT VertexCount;
+        UINT VertexStride;
+        const void* Indices;
+        UINT IndexCount;
+        UINT SourceIndexSize;
+        UINT IndexSize;
+        BufferRangeAllocator::Range VertexRange;
+        BufferRangeAllocator::Range IndexRange;
+    };
+
+    std::unique_ptr<MeshUploadBackend> mBackend;
+    BufferRangeAllocator mVertexAllocator;
+    BufferRangeAllocator mIndexAllocator;
+    std::vector<PendingMesh> mPending;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+// concurrency::parallel_for where PPL is available, and a fork/join over
+// std::thread everywhere else, so code that only needs a parallel loop does
+// not tie itself to MSVC.
+#if defined(_MSC_VER)
+#include <ppl.h>
+#else
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#endif
+
+// Calls function(i) for every i in [first, last), in no particular order.
+template <typename Index, typename Function>
+void ParallelFor(Index first, Index last, const Function& function)
+{
+#if defined(_MSC_VER)
+    concurrency::parallel_for(first, last, function);
+#else
+    if (first >= last)
+    {
+        return;
+    }
+
+    const Index count = last - first;
+    const unsigned workerCount = (unsigned)std::min<Index>(count,
+        (Index)std::max<unsigned>(1u, std::thread::hardware_concurrency()));
+
+    // Several chunks per worker so uneven iterations still balance out.
+    const Index chunk = std::max<Index>(1, count / (Index)(workerCount * 8));
+    std::atomic<Index> next(first);
+    auto work = [&]()
+    {
+        for (;;)
+        {
+            const Index begin = next.fetch_add(chunk);
+            if (begin >= last)
+            {
+                break;
+            }
+            const Index end = std::min<Index>(last, begin + chunk);
+            for (Index i = begin; i < end; i++)
+            {
+                function(i);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < workerCount; i++)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+#endif
+}
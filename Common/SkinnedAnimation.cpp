@@ -0,0 +1,169 @@
+#include "SkinnedAnimation.h"
+#include "ParallelFor.h"
+
+const D3D12_INPUT_ELEMENT_DESC VertexPositionNormalTextureSkinned::InputElements[] =
+{
+    { "SV_Position",  0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "NORMAL",       0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD",     0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "BLENDINDICES", 0, DXGI_FORMAT_R8G8B8A8_UINT,      0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "BLENDWEIGHT",  0, DXGI_FORMAT_R8G8B8A8_UNORM,     0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+};
+
+static_assert(sizeof(VertexPositionNormalTextureSkinned) == 40, "Vertex struct/layout mismatch");
+
+const D3D12_INPUT_LAYOUT_DESC VertexPositionNormalTextureSkinned::InputLayout =
+{
+    VertexPositionNormalTextureSkinned::InputElements,
+    VertexPositionNormalTextureSkinned::InputElementCount
+};
+
+namespace
+{
+    // Instances handed to one task by EvaluateInstances; enough to amortize
+    // the scratch allocation without starving the other workers.
+    const size_t InstancesPerTask = 8;
+}
+
+int Skeleton::FindBone(const std::string& name) const
+{
+    for (size_t i = 0; i < BoneNames.size(); i++)
+    {
+        if (BoneNames[i] == name)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+namespace SkinnedAnimation
+{
+    void QuantizeWeights(const float* weights, UINT count, uint8_t* quantized)
+    {
+        float sum = 0.0f;
+        for (UINT i = 0; i < count; i++)
+        {
+            sum += std::max<float>(weights[i], 0.0f);
+        }
+
+        // Round every weight down, then give the units lost to rounding to
+        // the largest remainders.  Fewer than count units are ever missing.
+        float remainders[MaxBoneInfluences] = {};
+        UINT total = 0;
+        for (UINT i = 0; i < MaxBoneInfluences; i++)
+        {
+            quantized[i] = 0;
+            if (i < count && sum > 0.0f)
+            {
+                const float scaled = std::max<float>(weights[i], 0.0f) / sum * 255.0f;
+                quantized[i] = (uint8_t)std::min<float>(floorf(scaled), 255.0f);
+                remainders[i] = scaled - quantized[i];
+                total += quantized[i];
+            }
+        }
+        for (; sum > 0.0f && total < 255; total++)
+        {
+            UINT largest = 0;
+            for (UINT i = 1; i < count; i++)
+            {
+                if (remainders[i] > remainders[largest])
+                {
+                    largest = i;
+                }
+            }
+            quantized[largest]++;
+            remainders[largest] = -1.0f;
+        }
+    }
+
+    void SampleLocalPose(const AnimationClip& clip, float time, XMMATRIX* local)
+    {
+        const UINT boneCount = clip.BoneCount;
+        if (clip.KeyCount == 0)
+        {
+            for (UINT i = 0; i < boneCount; i++)
+            {
+                local[i] = XMMatrixIdentity();
+            }
+            return;
+        }
+
+        const float duration = clip.Duration();
+        if (duration > 0.0f)
+        {
+            time = fmodf(time, duration);
+            if (time < 0.0f)
+            {
+                time += duration;
+            }
+        }
+        else
+        {
+            time = 0.0f;
+        }
+
+        const float key = time * clip.SampleRate;
+        const UINT key0 = std::min<UINT>((UINT)key, clip.KeyCount - 1);
+        const UINT key1 = std::min<UINT>(key0 + 1, clip.KeyCount - 1);
+        const float t = key - key0;
+
+        const XMFLOAT4* r0 = &clip.Rotations[key0 * boneCount];
+        const XMFLOAT4* r1 = &clip.Rotations[key1 * boneCount];
+        const XMFLOAT3* t0 = &clip.Translations[key0 * boneCount];
+        const XMFLOAT3* t1 = &clip.Translations[key1 * boneCount];
+        const XMFLOAT3* s0 = &clip.Scales[key0 * boneCount];
+        const XMFLOAT3* s1 = &clip.Scales[key1 * boneCount];
+        const XMVECTOR zero = XMVectorZero();
+
+        for (UINT i = 0; i < boneCount; i++)
+        {
+            const XMVECTOR rotation = XMQuaternionSlerp(XMLoadFloat4(&r0[i]), XMLoadFloat4(&r1[i]), t);
+            const XMVECTOR translation = XMVectorLerp(XMLoadFloat3(&t0[i]), XMLoadFloat3(&t1[i]), t);
+            const XMVECTOR scale = XMVectorLerp(XMLoadFloat3(&s0[i]), XMLoadFloat3(&s1[i]), t);
+            local[i] = XMMatrixAffineTransformation(scale, zero, rotation, translation);
+        }
+    }
+
+    void ConcatenateHierarchy(const Skeleton& skeleton, const XMMATRIX* local, XMMATRIX* global)
+    {
+        const UINT boneCount = skeleton.BoneCount();
+        for (UINT i = 0; i < boneCount; i++)
+        {
+            const int parent = skeleton.ParentIndices[i];
+            global[i] = parent < 0 ? local[i] : XMMatrixMultiply(local[i], global[parent]);
+        }
+    }
+
+    void BuildPalette(const Skeleton& skeleton, const XMMATRIX* global, Matrix* palette)
+    {
+        const UINT boneCount = skeleton.BoneCount();
+        for (UINT i = 0; i < boneCount; i++)
+        {
+            const XMMATRIX inverseBind = XMLoadFloat4x4(&skeleton.InverseBindPose[i]);
+            XMStoreFloat4x4(&palette[i], XMMatrixMultiply(inverseBind, global[i]));
+        }
+    }
+
+    void EvaluateInstances(const Skeleton& skeleton, const AnimationClip& clip,
+        const float* times, size_t instanceCount, Matrix* palettes)
+    {
+        const UINT boneCount = skeleton.BoneCount();
+        _ASSERT_EXPR(clip.BoneCount == boneCount, L"Animation clip does not match the skeleton");
+
+        const size_t taskCount = (instanceCount + InstancesPerTask - 1) / InstancesPerTask;
+        ParallelFor(size_t(0), taskCount, [&](size_t task)
+        {
+            std::vector<XMMATRIX> local(boneCount);
+            std::vector<XMMATRIX> global(boneCount);
+
+            const size_t end = std::min<size_t>(instanceCount, (task + 1) * InstancesPerTask);
+            for (size_t i = task * InstancesPerTask; i < end; i++)
+            {
+                SampleLocalPose(clip, times[i], local.data());
+                ConcatenateHierarchy(skeleton, local.data(), global.data());
+                BuildPalette(skeleton, global.data(), palettes + i * boneCount);
+            }
+        });
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+static const UINT MaxBoneInfluences = 4;
+
+// Bone indices are stored as 8 bits, so larger skeletons cannot be skinned.
+static const UINT MaxSkeletonBones = 256;
+
+// VertexPositionNormalTexture plus the four strongest bone influences, with
+// 8-bit indices and 8-bit unorm weights that sum to exactly 255.
+struct VertexPositionNormalTextureSkinned
+{
+    XMFLOAT3 position;
+    XMFLOAT3 normal;
+    XMFLOAT2 textureCoordinate;
+    uint8_t boneIndices[MaxBoneInfluences] = {};
+    uint8_t boneWeights[MaxBoneInfluences] = {};
+
+    static const D3D12_INPUT_LAYOUT_DESC InputLayout;
+
+private:
+    static const UINT InputElementCount = 5;
+    static const D3D12_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+};
+
+// Bones are ordered so that every parent comes before its children, which
+// lets the hierarchy be concatenated in one forward pass.
+struct Skeleton
+{
+    std::vector<std::string> BoneNames;
+    std::vector<int> ParentIndices;         // -1 for roots
+    std::vector<Matrix> InverseBindPose;    // model space -> bone space at bind time
+
+    UINT BoneCount() const { return (UINT)ParentIndices.size(); }
+    int FindBone(const std::string& name) const;
+};
+
+// Local bone transforms sampled at a fixed rate.  The tracks are stored
+// structure-of-arrays and bone-major within a key ([key * BoneCount + bone]),
+// so evaluating a pose reads two contiguous runs per track.
+struct AnimationClip
+{
+    std::string Name;
+    float SampleRate = 30.0f;   // keys per second
+    UINT BoneCount = 0;
+    UINT KeyCount = 0;
+    std::vector<XMFLOAT4> Rotations;    // quaternions
+    std::vector<XMFLOAT3> Translations;
+    std::vector<XMFLOAT3> Scales;
+
+    float Duration() const { return KeyCount > 1 ? (KeyCount - 1) / SampleRate : 0.0f; }
+};
+
+// Pose evaluation from a clip to a skinning palette.  The per-bone work is
+// done with DirectXMath, the palettes of many instances in parallel.
+namespace SkinnedAnimation
+{
+    // Quantizes count (at most MaxBoneInfluences) non-negative weights to
+    // boneWeights, keeping their sum at exactly 255 so the shader still blends
+    // to 1.  Weights past count are zeroed; all zero weights stay zero.
+    void QuantizeWeights(const float* weights, UINT count, uint8_t* quantized);
+
+    // Interpolates the two keys around time, wrapped to the clip duration.
+    void SampleLocalPose(const AnimationClip& clip, float time, XMMATRIX* local);
+
+    // Bone local -> model space.
+    void ConcatenateHierarchy(const Skeleton& skeleton, const XMMATRIX* local, XMMATRIX* global);
+
+    // InverseBindPose * global per bone, laid out like ObjectConstants::world.
+    void BuildPalette(const Skeleton& skeleton, const XMMATRIX* global, Matrix* palette);
+
+    // All of the above for instanceCount instances, each sampled at times[i].
+    // palettes holds BoneCount matrices per instance.
+    void EvaluateInstances(const Skeleton& skeleton, const AnimationClip& clip,
+        const float* times, size_t instanceCount, Matrix* palettes);
+}
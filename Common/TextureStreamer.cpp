@@ -0,0 +1,463 @@
+#include "TextureStreamer.h"
+#include "../DirectXTK12/Inc/WICTextureLoader.h"
+
+HRESULT D3D12TextureDecoder::Decode(const std::wstring& path, DecodedTexture& texture)
+{
+    auto device = mDeviceResources->GetD3DDevice();
+
+    HRESULT hr;
+    const size_t dot = path.find_last_of(L'.');
+    if (dot != std::wstring::npos && _wcsicmp(path.c_str() + dot, L".dds") == 0)
+    {
+        hr = LoadDDSTextureFromFile(device, path.c_str(), texture.Resource.ReleaseAndGetAddressOf(),
+            texture.Data, texture.Mips);
+    }
+    else
+    {
+        texture.Mips.resize(1);
+        hr = LoadWICTextureFromFile(device, path.c_str(), texture.Resource.ReleaseAndGetAddressOf(),
+            texture.Data, texture.Mips[0]);
+    }
+
+    // The mips of a cube map or array would interleave with its slices.
+    if (SUCCEEDED(hr))
+    {
+        const auto desc = texture.Resource->GetDesc();
+        if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || desc.DepthOrArraySize != 1)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+    }
+    return hr;
+}
+
+D3D12TextureUploadBackend::D3D12TextureUploadBackend(DX::DeviceResources* devRes, DescriptorHeap* heap) :
+    mDeviceResources(devRes),
+    mHeap(heap),
+    mUpload(devRes->GetD3DDevice())
+{
+}
+
+void D3D12TextureUploadBackend::Begin()
+{
+    mUpload.Begin();
+}
+
+void D3D12TextureUploadBackend::Upload(ID3D12Resource* resource, UINT firstMip, const D3D12_SUBRESOURCE_DATA* mips, UINT mipCount, bool firstUpload)
+{
+    if (!firstUpload)
+    {
+        mUpload.Transition(resource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+    }
+    mUpload.Upload(resource, firstMip, mips, mipCount);
+    mUpload.Transition(resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+}
+
+UINT64 D3D12TextureUploadBackend::End()
+{
+    mInFlight.push_back(mUpload.End(mDeviceResources->GetCommandQueue()));
+    return ++mSubmitted;
+}
+
+UINT64 D3D12TextureUploadBackend::CompletedSubmission()
+{
+    // Submissions go to one queue and finish in order.
+    while (!mInFlight.empty() &&
+        mInFlight.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        mInFlight.front().get();
+        mInFlight.pop_front();
+        mCompleted++;
+    }
+    return mCompleted;
+}
+
+void D3D12TextureUploadBackend::CreateNullSrv(UINT descriptor)
+{
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    srvDesc.Texture2D.MipLevels = 1;
+    mDeviceResources->GetD3DDevice()->CreateShaderResourceView(nullptr, &srvDesc, mHeap->GetCpuHandle(descriptor));
+}
+
+void D3D12TextureUploadBackend::CreateSrv(UINT descriptor, ID3D12Resource* resource, UINT mostDetailedMip)
+{
+    const auto desc = resource->GetDesc();
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Format = desc.Format;
+    srvDesc.Texture2D.MostDetailedMip = mostDetailedMip;
+    srvDesc.Texture2D.MipLevels = desc.MipLevels - mostDetailedMip;
+    srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+    mDeviceResources->GetD3DDevice()->CreateShaderResourceView(resource, &srvDesc, mHeap->GetCpuHandle(descriptor));
+}
+
+void NullTextureUploadBackend::Upload(ID3D12Resource* resource, UINT firstMip, const D3D12_SUBRESOURCE_DATA* mips, UINT mipCount, bool)
+{
+    UploadRecord record = { resource, firstMip, mipCount, 0, mSubmitted + 1 };
+    for (UINT i = 0; i < mipCount; i++)
+    {
+        record.Bytes += mips[i].SlicePitch;
+    }
+    mUploads.push_back(record);
+}
+
+TextureStreamer::TextureStreamer(DX::DeviceResources* devRes, DescriptorHeap* heap, UINT firstDescriptor, UINT capacity,
+    UINT64 frameBudget, UINT workerCount) :
+    TextureStreamer(std::make_unique<D3D12TextureDecoder>(devRes), std::make_unique<D3D12TextureUploadBackend>(devRes, heap),
+        firstDescriptor, capacity, frameBudget, workerCount)
+{
+}
+
+TextureStreamer::TextureStreamer(std::unique_ptr<TextureDecoder> decoder, std::unique_ptr<TextureUploadBackend> backend,
+    UINT firstDescriptor, UINT capacity, UINT64 frameBudget, UINT workerCount) :
+    mDecoder(std::move(decoder)),
+    mBackend(std::move(backend)),
+    mFirstDescriptor(firstDescriptor),
+    mCapacity(capacity),
+    mFrameBudget(frameBudget)
+{
+    // Handles index into mTextures, which never reallocates.
+    mTextures.reserve(capacity);
+    mBackend->CreateNullSrv(NullSrvIndex());
+    for (UINT i = 0; i < workerCount; i++)
+    {
+        mWorkers.emplace_back(&TextureStreamer::workerLoop, this);
+    }
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mWork.notify_all();
+    for (auto& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+UINT TextureStreamer::Request(const std::wstring& path, int priority)
+{
+    const std::string normalizedPath = AssetRegistry::NormalizePath(path);
+    std::shared_ptr<Texture> shared = mRegistry ? mRegistry->Find<Texture>(normalizedPath) : nullptr;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (size_t i = 0; i < mTextures.size(); i++)
+    {
+        if (mTextures[i]->NormalizedPath == normalizedPath)
+        {
+            mTextures[i]->Priority = std::max<int>(mTextures[i]->Priority, priority);
+            return (UINT)i;
+        }
+    }
+    _ASSERT_EXPR(mTextures.size() < mCapacity, L"TextureStreamer capacity exceeded");
+
+    auto texture = std::make_unique<StreamedTexture>();
+    texture->Path = path;
+    texture->NormalizedPath = normalizedPath;
+    texture->Priority = priority;
+    texture->Sequence = mSequence++;
+    if (shared)
+    {
+        shareResident(*texture, shared);
+    }
+    mTextures.push_back(std::move(texture));
+    mWork.notify_one();
+    return (UINT)mTextures.size() - 1;
+}
+
+void TextureStreamer::SetPriority(UINT texture, int priority)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTextures[texture]->Priority = priority;
+}
+
+void TextureStreamer::Update(UINT64 frame, UINT framesInFlight)
+{
+    if (mWorkers.empty())
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (decodeNext(lock))
+        {
+        }
+    }
+
+    retireSubmissions();
+    publish(frame, framesInFlight);
+    uploadMips();
+}
+
+UINT TextureStreamer::SrvIndex(UINT texture) const
+{
+    const StreamedTexture& streamed = *mTextures[texture];
+    if (streamed.Slot < 0)
+    {
+        return NullSrvIndex();
+    }
+    return mFirstDescriptor + 1 + texture * SlotsPerTexture + streamed.Slot;
+}
+
+UINT TextureStreamer::ResidentMipCount(UINT texture) const
+{
+    const StreamedTexture& streamed = *mTextures[texture];
+    return streamed.MipCount - streamed.Published;
+}
+
+bool TextureStreamer::Failed(UINT texture) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTextures[texture]->Status == State::Failed;
+}
+
+bool TextureStreamer::Idle() const
+{
+    if (!mSubmissions.empty())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& texture : mTextures)
+    {
+        if (texture->Status == State::Queued || texture->Status == State::Decoding ||
+            (texture->Status == State::Decoded && texture->Published > 0))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TextureStreamer::shareResident(StreamedTexture& texture, const std::shared_ptr<Texture>& shared)
+{
+    // Every mip is already on the GPU; publish picks it up like a finished upload.
+    texture.Shared = shared;
+    texture.Decoded.Resource = shared->Resource;
+    texture.MipCount = shared->Resource->GetDesc().MipLevels;
+    texture.NextUpload = 0;
+    texture.Resident = 0;
+    texture.Published = texture.MipCount;
+    texture.Status = State::Decoded;
+}
+
+void TextureStreamer::workerLoop()
+{
+    // WIC needs COM on every thread that decodes.
+    const HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mExit)
+    {
+        if (!decodeNext(lock))
+        {
+            mWork.wait(lock);
+        }
+    }
+    lock.unlock();
+
+    if (SUCCEEDED(com))
+    {
+        CoUninitialize();
+    }
+}
+
+bool TextureStreamer::decodeNext(std::unique_lock<std::mutex>& lock)
+{
+    StreamedTexture* next = nullptr;
+    for (const auto& texture : mTextures)
+    {
+        if (texture->Status == State::Queued &&
+            (!next || texture->Priority > next->Priority ||
+            (texture->Priority == next->Priority && texture->Sequence < next->Sequence)))
+        {
+            next = texture.get();
+        }
+    }
+    if (!next)
+    {
+        return false;
+    }
+
+    next->Status = State::Decoding;
+    const std::wstring path = next->Path;
+    lock.unlock();
+
+    // The same file may already be resident under another name.  It is
+    // only hashed if a resident texture has the same size.
+    AssetRegistry::FileKey fileKey;
+    if (mRegistry)
+    {
+        std::shared_ptr<Texture> shared = mRegistry->FindFile<Texture>(path, fileKey);
+        if (shared)
+        {
+            lock.lock();
+            shareResident(*next, shared);
+            return true;
+        }
+    }
+
+    DecodedTexture decoded;
+    HRESULT hr = mDecoder->Decode(path, decoded);
+    if (SUCCEEDED(hr) && decoded.Mips.empty())
+    {
+        hr = E_FAIL;
+    }
+    if (FAILED(hr))
+    {
+        OutputDebugStringW((L"TextureStreamer: failed to load " + path + L"\n").c_str());
+    }
+
+    lock.lock();
+    if (SUCCEEDED(hr))
+    {
+        next->Decoded = std::move(decoded);
+        next->File = std::move(fileKey);
+        next->MipCount = (UINT)next->Decoded.Mips.size();
+        next->NextUpload = next->MipCount;
+        next->Resident = next->MipCount;
+        next->Published = next->MipCount;
+        next->Status = State::Decoded;
+    }
+    else
+    {
+        next->Status = State::Failed;
+    }
+    return true;
+}
+
+int TextureStreamer::nextToUpload() const
+{
+    // Highest priority first; within a priority, textures with the fewest
+    // mips submitted so far, so every texture gets its small mips before any
+    // gets its large ones.
+    std::lock_guard<std::mutex> lock(mMutex);
+    int next = -1;
+    UINT nextSubmitted = 0;
+    for (size_t i = 0; i < mTextures.size(); i++)
+    {
+        const StreamedTexture& texture = *mTextures[i];
+        if (texture.Status != State::Decoded || texture.NextUpload == 0)
+        {
+            continue;
+        }
+
+        const UINT submitted = texture.MipCount - texture.NextUpload;
+        if (next >= 0)
+        {
+            const StreamedTexture& best = *mTextures[next];
+            if (texture.Priority < best.Priority ||
+                (texture.Priority == best.Priority && submitted >= nextSubmitted))
+            {
+                continue;
+            }
+        }
+        next = (int)i;
+        nextSubmitted = submitted;
+    }
+    return next;
+}
+
+void TextureStreamer::uploadMips()
+{
+    UINT64 bytes = 0;
+    std::vector<SubmittedMip> submitted;
+
+    for (int index = nextToUpload(); index >= 0; index = nextToUpload())
+    {
+        StreamedTexture& texture = *mTextures[index];
+        const UINT mip = texture.NextUpload - 1;
+        const D3D12_SUBRESOURCE_DATA& data = texture.Decoded.Mips[mip];
+
+        // A mip larger than the whole budget still goes up on its own, so
+        // nothing waits forever.
+        if (bytes > 0 && bytes + data.SlicePitch > mFrameBudget)
+        {
+            break;
+        }
+
+        if (submitted.empty())
+        {
+            mBackend->Begin();
+        }
+        mBackend->Upload(texture.Decoded.Resource.Get(), mip, &data, 1, mip + 1 == texture.MipCount);
+        texture.NextUpload = mip;
+        bytes += data.SlicePitch;
+        submitted.push_back({ (UINT)index, mip });
+    }
+
+    if (!submitted.empty())
+    {
+        const UINT64 submission = mBackend->End();
+        mSubmissions.emplace_back(submission, std::move(submitted));
+    }
+    mBytesUploadedLastFrame = bytes;
+}
+
+void TextureStreamer::retireSubmissions()
+{
+    const UINT64 completed = mBackend->CompletedSubmission();
+    std::lock_guard<std::mutex> lock(mMutex);
+    while (!mSubmissions.empty() && mSubmissions.front().first <= completed)
+    {
+        for (const auto& mip : mSubmissions.front().second)
+        {
+            StreamedTexture& texture = *mTextures[mip.Texture];
+            texture.Resident = std::min<UINT>(texture.Resident, mip.Mip);
+        }
+        mSubmissions.pop_front();
+    }
+}
+
+void TextureStreamer::publish(UINT64 frame, UINT framesInFlight)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (size_t i = 0; i < mTextures.size(); i++)
+    {
+        StreamedTexture& texture = *mTextures[i];
+        if (texture.Resident >= texture.Published)
+        {
+            continue;
+        }
+
+        // The other slot was last visible to frames before PublishedFrame.
+        if (texture.Slot >= 0 && frame < texture.PublishedFrame + framesInFlight)
+        {
+            continue;
+        }
+
+        const int slot = texture.Slot < 0 ? 0 : 1 - texture.Slot;
+        mBackend->CreateSrv(mFirstDescriptor + 1 + (UINT)i * SlotsPerTexture + slot,
+            texture.Decoded.Resource.Get(), texture.Resident);
+        texture.Slot = slot;
+        texture.Published = texture.Resident;
+        texture.PublishedFrame = frame;
+
+        // Fully resident; the CPU copy is no longer needed.
+        if (texture.Published == 0 && !texture.Shared)
+        {
+            if (mRegistry)
+            {
+                UINT64 bytes = 0;
+                for (const auto& mip : texture.Decoded.Mips)
+                {
+                    bytes += mip.SlicePitch;
+                }
+                auto shared = std::make_shared<Texture>();
+                shared->Name = texture.NormalizedPath;
+                shared->Filename = texture.Path;
+                shared->Resource = texture.Decoded.Resource;
+                texture.Shared = mRegistry->InsertFile(texture.File, shared, bytes);
+            }
+            texture.Decoded.Data.reset();
+            texture.Decoded.Mips.clear();
+            texture.Decoded.Mips.shrink_to_fit();
+        }
+    }
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "AssetRegistry.h"
+#include "../DirectXTK12/Inc/DescriptorHeap.h"
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+
+// Output of reading and decoding one texture file.  Resource is created by
+// the decoder in D3D12_RESOURCE_STATE_COPY_DEST; Mips are its subresources,
+// most detailed first, pointing into Data.
+struct DecodedTexture
+{
+    Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+    std::unique_ptr<uint8_t[]> Data;
+    std::vector<D3D12_SUBRESOURCE_DATA> Mips;
+};
+
+// Reads and decodes texture files.  Called from the streamer's worker threads.
+class TextureDecoder
+{
+public:
+    virtual ~TextureDecoder() = default;
+
+    virtual HRESULT Decode(const std::wstring& path, DecodedTexture& texture) = 0;
+};
+
+// .dds files through LoadDDSTextureFromFile, everything else through WIC.
+class D3D12TextureDecoder : public TextureDecoder
+{
+public:
+    explicit D3D12TextureDecoder(DX::DeviceResources* devRes) : mDeviceResources(devRes) {}
+
+    HRESULT Decode(const std::wstring& path, DecodedTexture& texture) override;
+
+private:
+    DX::DeviceResources* mDeviceResources;
+};
+
+// Copies mips into textures and writes the SRVs for them.  Uploads between
+// Begin and End form one submission; End returns its id, and
+// CompletedSubmission the newest id the GPU has finished.
+class TextureUploadBackend
+{
+public:
+    virtual ~TextureUploadBackend() = default;
+
+    virtual void Begin() = 0;
+    // firstUpload is set for the first mips of a resource, which is still in
+    // COPY_DEST; later uploads find it in PIXEL_SHADER_RESOURCE.
+    virtual void Upload(ID3D12Resource* resource, UINT firstMip, const D3D12_SUBRESOURCE_DATA* mips, UINT mipCount, bool firstUpload) = 0;
+    virtual UINT64 End() = 0;
+    virtual UINT64 CompletedSubmission() = 0;
+
+    virtual void CreateNullSrv(UINT descriptor) = 0;
+    virtual void CreateSrv(UINT descriptor, ID3D12Resource* resource, UINT mostDetailedMip) = 0;
+};
+
+// One ResourceUploadBatch per submission, polled instead of waited on.
+class D3D12TextureUploadBackend : public TextureUploadBackend
+{
+public:
+    D3D12TextureUploadBackend(DX::DeviceResources* devRes, DescriptorHeap* heap);
+
+    void Begin() override;
+    void Upload(ID3D12Resource* resource, UINT firstMip, const D3D12_SUBRESOURCE_DATA* mips, UINT mipCount, bool firstUpload) override;
+    UINT64 End() override;
+    UINT64 CompletedSubmission() override;
+
+    void CreateNullSrv(UINT descriptor) override;
+    void CreateSrv(UINT descriptor, ID3D12Resource* resource, UINT mostDetailedMip) override;
+
+private:
+    DX::DeviceResources* mDeviceResources;
+    DescriptorHeap* mHeap;
+    ResourceUploadBatch mUpload;
+    std::deque<std::future<void>> mInFlight;
+    UINT64 mSubmitted = 0;
+    UINT64 mCompleted = 0;
+};
+
+// Records what would have been uploaded and completes every submission at
+// once, so queueing and budgeting can be exercised without a device.
+class NullTextureUploadBackend : public TextureUploadBackend
+{
+public:
+    struct UploadRecord
+    {
+        ID3D12Resource* Resource;
+        UINT FirstMip;
+        UINT MipCount;
+        UINT64 Bytes;
+        UINT64 Submission;
+    };
+
+    void Begin() override {}
+    void Upload(ID3D12Resource* resource, UINT firstMip, const D3D12_SUBRESOURCE_DATA* mips, UINT mipCount, bool firstUpload) override;
+    UINT64 End() override { return ++mSubmitted; }
+    UINT64 CompletedSubmission() override { return mSubmitted; }
+
+    void CreateNullSrv(UINT descriptor) override { mSrvs[descriptor] = UINT(-1); }
+    void CreateSrv(UINT descriptor, ID3D12Resource* resource, UINT mostDetailedMip) override { mSrvs[descriptor] = mostDetailedMip; }
+
+    std::vector<UploadRecord> mUploads;
+    std::unordered_map<UINT, UINT> mSrvs;   // descriptor -> most detailed mip, -1 for null
+    UINT64 mSubmitted = 0;
+};
+
+// Loads textures in the background and makes them resident a few mips at a
+// time, smallest mips first:
+//   - Request queues a file and returns a handle right away.  Worker threads
+//     read and decode the queue in priority order.
+//   - Update, once per frame on the render thread, uploads decoded mips until
+//     the frame's byte budget is spent and publishes an SRV over the mips whose
+//     upload has finished.
+//   - SrvIndex is the null SRV until the first mip is resident.
+//
+// With a registry set, fully resident textures are shared through it as
+// Texture assets.  A request the registry can answer, by path or by file
+// contents, skips decoding and uploading altogether.
+//
+// Each texture alternates between two descriptors, and a descriptor is only
+// rewritten framesInFlight frames after it was last published, so frames
+// still in flight keep sampling a valid view.  Pass the count the frame was
+// paced with (FramePacer::FramesInFlight after BeginFrame): frame n only
+// starts once frame n - framesInFlight has completed, so the count may change
+// from frame to frame.
+class TextureStreamer
+{
+public:
+    static const UINT64 DefaultFrameBudget = 4 * 1024 * 1024;
+    static const UINT SlotsPerTexture = 2;
+
+    // Descriptors used from firstDescriptor on: one null SRV plus
+    // SlotsPerTexture per texture.
+    static UINT DescriptorCount(UINT capacity) { return 1 + SlotsPerTexture * capacity; }
+
+    TextureStreamer(DX::DeviceResources* devRes, DescriptorHeap* heap, UINT firstDescriptor, UINT capacity,
+        UINT64 frameBudget = DefaultFrameBudget, UINT workerCount = 1);
+    // workerCount 0 decodes on the calling thread inside Update.
+    TextureStreamer(std::unique_ptr<TextureDecoder> decoder, std::unique_ptr<TextureUploadBackend> backend,
+        UINT firstDescriptor, UINT capacity, UINT64 frameBudget = DefaultFrameBudget, UINT workerCount = 1);
+    ~TextureStreamer();
+
+    // Call before the first Request.
+    void SetRegistry(AssetRegistry* registry) { mRegistry = registry; }
+
+    // Higher priorities are decoded and uploaded first; equal priorities in
+    // request order.  Requesting a path again returns the same handle.
+    UINT Request(const std::wstring& path, int priority = 0);
+    void SetPriority(UINT texture, int priority);
+
+    void Update(UINT64 frame, UINT framesInFlight);
+
+    UINT SrvIndex(UINT texture) const;
+    UINT NullSrvIndex() const { return mFirstDescriptor; }
+
+    // Mips visible through SrvIndex, counted from the smallest.
+    UINT ResidentMipCount(UINT texture) const;
+    bool Failed(UINT texture) const;
+    // Nothing left to decode, upload or publish.
+    bool Idle() const;
+
+    UINT64 BytesUploadedLastFrame() const { return mBytesUploadedLastFrame; }
+    UINT TextureCount() const { return (UINT)mTextures.size(); }
+
+private:
+    enum class State
+    {
+        Queued,
+        Decoding,
+        Decoded,
+        Failed,
+    };
+
+    struct StreamedTexture
+    {
+        std::wstring Path;
+        std::string NormalizedPath;
+        AssetRegistry::FileKey File;
+        std::shared_ptr<Texture> Shared;
+        int Priority = 0;
+        UINT64 Sequence = 0;
+        State Status = State::Queued;
+        DecodedTexture Decoded;
+        UINT MipCount = 0;
+
+        // Mips [NextUpload, MipCount) are submitted, [Resident, MipCount)
+        // finished and [Published, MipCount) visible through the SRV.
+        UINT NextUpload = 0;
+        UINT Resident = 0;
+        UINT Published = 0;
+
+        int Slot = -1;
+        UINT64 PublishedFrame = 0;
+    };
+
+    struct SubmittedMip
+    {
+        UINT Texture;
+        UINT Mip;
+    };
+
+    void shareResident(StreamedTexture& texture, const std::shared_ptr<Texture>& shared);
+    void workerLoop();
+    bool decodeNext(std::unique_lock<std::mutex>& lock);
+    int nextToUpload() const;
+    void uploadMips();
+    void retireSubmissions();
+    void publish(UINT64 frame, UINT framesInFlight);
+
+    std::unique_ptr<TextureDecoder> mDecoder;
+    std::unique_ptr<TextureUploadBackend> mBackend;
+    UINT mFirstDescriptor;
+    UINT mCapacity;
+    UINT64 mFrameBudget;
+    AssetRegistry* mRegistry = nullptr;
+
+    // Guards the texture list and each texture's Priority and Status.  A
+    // worker fills in Decoded and MipCount before setting Status to Decoded;
+    // from then on the texture is only touched by the render thread.
+    mutable std::mutex mMutex;
+    std::condition_variable mWork;
+    bool mExit = false;
+    std::vector<std::thread> mWorkers;
+    std::vector<std::unique_ptr<StreamedTexture>> mTextures;
+    UINT64 mSequence = 0;
+
+    std::deque<std::pair<UINT64, std::vector<SubmittedMip>>> mSubmissions;
+    UINT64 mBytesUploadedLastFrame = 0;
+};
@@ -0,0 +1,177 @@
+#include "TransformHierarchy.h"
+#include "ParallelFor.h"
+
+using namespace DirectX;
+
+UINT TransformHierarchy::Add(UINT parent)
+{
+    _ASSERT_EXPR(parent == NoParent || parent < mSlots.size(), L"unknown parent node");
+
+    const UINT handle = (UINT)mSlots.size();
+    const UINT slot = (UINT)mParent.size();
+    const UINT depth = parent == NoParent ? 0 : mDepth[mSlots[parent]] + 1;
+
+    mSlots.push_back(slot);
+    mHandles.push_back(handle);
+    mParent.push_back(parent == NoParent ? parent : mSlots[parent]);
+    mDepth.push_back(depth);
+    mTranslation.push_back(Vector3::Zero);
+    mRotation.push_back(Quaternion::Identity);
+    mScale.push_back(Vector3::One);
+    mLocal.push_back(Matrix::Identity);
+    mWorld.push_back(Matrix::Identity);
+    mLocalDirty.push_back(1);
+    mWorldChanged.push_back(0);
+
+    // Appending keeps the depth order as long as depths never decrease.
+    if (mNeedsSort || depth + 1 < LevelCount())
+    {
+        mNeedsSort = true;
+    }
+    else
+    {
+        if (depth + 1 > LevelCount())
+        {
+            mLevelStart.push_back(slot);
+        }
+        mLevelStart.back() = slot + 1;
+    }
+    return handle;
+}
+
+void TransformHierarchy::SetLocal(UINT node, const Vector3& translation, const Quaternion& rotation, const Vector3& scale)
+{
+    const UINT slot = mSlots[node];
+    mTranslation[slot] = translation;
+    mRotation[slot] = rotation;
+    mScale[slot] = scale;
+    mLocalDirty[slot] = 1;
+}
+
+void TransformHierarchy::Update()
+{
+    if (mNeedsSort)
+    {
+        sortByDepth();
+    }
+
+    // A level only reads the level above it, which is complete by then.
+    mUpdatedLastFrame = 0;
+    for (UINT level = 0; level < LevelCount(); level++)
+    {
+        const UINT begin = mLevelStart[level];
+        const UINT end = mLevelStart[level + 1];
+        if (end - begin < ParallelThreshold)
+        {
+            mUpdatedLastFrame += updateRange(begin, end);
+            continue;
+        }
+
+        const UINT chunkSize = ParallelThreshold / 4;
+        const UINT chunkCount = (end - begin + chunkSize - 1) / chunkSize;
+        std::vector<UINT> updated(chunkCount);
+        ParallelFor(0u, chunkCount, [&](UINT chunk)
+        {
+            const UINT first = begin + chunk * chunkSize;
+            updated[chunk] = updateRange(first, std::min<UINT>(end, first + chunkSize));
+        });
+        for (UINT count : updated)
+        {
+            mUpdatedLastFrame += count;
+        }
+    }
+}
+
+UINT TransformHierarchy::updateRange(UINT begin, UINT end)
+{
+    UINT updated = 0;
+    for (UINT slot = begin; slot < end; slot++)
+    {
+        const UINT parent = mParent[slot];
+        const bool parentChanged = parent != NoParent && mWorldChanged[parent];
+        if (!mLocalDirty[slot] && !parentChanged)
+        {
+            mWorldChanged[slot] = 0;
+            continue;
+        }
+
+        XMMATRIX local;
+        if (mLocalDirty[slot])
+        {
+            local = XMMatrixMultiply(
+                XMMatrixScalingFromVector(XMLoadFloat3(&mScale[slot])),
+                XMMatrixRotationQuaternion(XMLoadFloat4(&mRotation[slot])));
+            local.r[3] = XMVectorSetW(XMLoadFloat3(&mTranslation[slot]), 1.0f);
+            XMStoreFloat4x4(&mLocal[slot], local);
+            mLocalDirty[slot] = 0;
+        }
+        else
+        {
+            local = XMLoadFloat4x4(&mLocal[slot]);
+        }
+
+        // Row vectors: the child's local transform applies first.
+        const XMMATRIX world = parent == NoParent ? local : XMMatrixMultiply(local, XMLoadFloat4x4(&mWorld[parent]));
+        XMStoreFloat4x4(&mWorld[slot], world);
+        mWorldChanged[slot] = 1;
+        updated++;
+    }
+    return updated;
+}
+
+void TransformHierarchy::sortByDepth()
+{
+    // Counting sort on depth; stable, so siblings keep their order.
+    const UINT count = (UINT)mParent.size();
+    const UINT levels = 1 + *std::max_element(mDepth.begin(), mDepth.end());
+
+    mLevelStart.assign(levels + 1, 0);
+    for (UINT depth : mDepth)
+    {
+        mLevelStart[depth + 1]++;
+    }
+    for (UINT level = 0; level < levels; level++)
+    {
+        mLevelStart[level + 1] += mLevelStart[level];
+    }
+
+    std::vector<UINT> newSlot(count);
+    std::vector<UINT> next(mLevelStart.begin(), mLevelStart.end() - 1);
+    for (UINT slot = 0; slot < count; slot++)
+    {
+        newSlot[slot] = next[mDepth[slot]]++;
+    }
+
+    auto permute = [&](auto& values)
+    {
+        std::remove_reference_t<decltype(values)> sorted(values.size());
+        for (UINT slot = 0; slot < count; slot++)
+        {
+            sorted[newSlot[slot]] = std::move(values[slot]);
+        }
+        values.swap(sorted);
+    };
+    for (auto& parent : mParent)
+    {
+        if (parent != NoParent)
+        {
+            parent = newSlot[parent];
+        }
+    }
+    permute(mHandles);
+    permute(mParent);
+    permute(mDepth);
+    permute(mTranslation);
+    permute(mRotation);
+    permute(mScale);
+    permute(mLocal);
+    permute(mWorld);
+    permute(mLocalDirty);
+    permute(mWorldChanged);
+
+    for (UINT slot = 0; slot < count; slot++)
+    {
+        mSlots[mHandles[slot]] = slot;
+    }
+    mNeedsSort = false;
+}
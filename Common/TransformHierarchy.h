@@ -0,0 +1,61 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// Parent/child transforms kept as flat arrays ordered by depth, so every
+// parent is updated before its children and each depth can be updated in
+// parallel.
+//
+// Nodes are addressed by the handle Add returns.  Adding a node shallower
+// than the deepest one so far reorders the arrays at the next Update;
+// handles stay valid.  SetLocal marks a node dirty and Update recomputes
+// the world matrix of dirty nodes and of everything below them, nothing
+// else.
+class TransformHierarchy
+{
+public:
+    static const UINT NoParent = UINT(-1);
+
+    // Nodes per level below which a level is updated on the calling thread.
+    static const UINT ParallelThreshold = 4096;
+
+    UINT Add(UINT parent = NoParent);
+
+    void SetLocal(UINT node, const Vector3& translation,
+        const Quaternion& rotation = Quaternion::Identity, const Vector3& scale = Vector3::One);
+
+    void Update();
+
+    const Matrix& World(UINT node) const { return mWorld[mSlots[node]]; }
+    // True when the node's world matrix was recomputed by the last Update.
+    bool WorldChanged(UINT node) const { return mWorldChanged[mSlots[node]] != 0; }
+
+    UINT NodeCount() const { return (UINT)mSlots.size(); }
+    UINT LevelCount() const { return (UINT)mLevelStart.size() - 1; }
+    // World matrices recomputed by the last Update.
+    UINT UpdatedLastFrame() const { return mUpdatedLastFrame; }
+
+private:
+    void sortByDepth();
+    UINT updateRange(UINT begin, UINT end);
+
+    // Slot of each handle, and the handle in each slot.
+    std::vector<UINT> mSlots;
+    std::vector<UINT> mHandles;
+
+    // Per slot, in depth order.  mParent holds slots, not handles.
+    std::vector<UINT> mParent;
+    std::vector<UINT> mDepth;
+    std::vector<Vector3> mTranslation;
+    std::vector<Quaternion> mRotation;
+    std::vector<Vector3> mScale;
+    std::vector<Matrix> mLocal;
+    std::vector<Matrix> mWorld;
+    std::vector<uint8_t> mLocalDirty;
+    std::vector<uint8_t> mWorldChanged;
+
+    // Slots [mLevelStart[d], mLevelStart[d + 1]) are at depth d.
+    std::vector<UINT> mLevelStart = { 0 };
+    bool mNeedsSort = false;
+    UINT mUpdatedLastFrame = 0;
+};
@@ -73,6 +73,17 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // For writers that copy many elements at once, laid out mElementByteSize apart.
+    BYTE* MappedData()const
+    {
+        return mMappedData;
+    }
+
+    UINT ElementByteSize()const
+    {
+        return mElementByteSize;
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
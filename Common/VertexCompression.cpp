@@ -0,0 +1,296 @@
+#include "VertexCompression.h"
+#include <cfloat>
+
+using namespace DirectX::PackedVector;
+
+const D3D12_INPUT_ELEMENT_DESC VertexPositionNormalTextureCompact::InputElements[] =
+{
+    { "SV_Position", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "NORMAL",      0, DXGI_FORMAT_R8G8B8A8_SNORM,     0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD",    0, DXGI_FORMAT_R16G16_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+};
+
+static_assert(sizeof(VertexPositionNormalTextureCompact) == 16, "Vertex struct/layout mismatch");
+
+const D3D12_INPUT_LAYOUT_DESC VertexPositionNormalTextureCompact::InputLayout =
+{
+    VertexPositionNormalTextureCompact::InputElements,
+    VertexPositionNormalTextureCompact::InputElementCount
+};
+
+namespace
+{
+    const float UnormMax = 65535.0f;
+    const float SnormMax = 127.0f;
+
+    float SignNotZero(float v)
+    {
+        return v >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    float AngleDegrees(const Vector3& a, const Vector3& b)
+    {
+        const float lengths = a.Length() * b.Length();
+        if (lengths == 0.0f)
+        {
+            return 0.0f;
+        }
+        const float cosine = std::max<float>(-1.0f, std::min<float>(1.0f, a.Dot(b) / lengths));
+        return XMConvertToDegrees(acosf(cosine));
+    }
+
+    // Unit vector orthogonal to the unit (or zero) vector n.
+    Vector3 Perpendicular(const Vector3& n)
+    {
+        const Vector3 axis = fabsf(n.x) < 0.9f ? Vector3(1.0f, 0.0f, 0.0f) : Vector3(0.0f, 1.0f, 0.0f);
+        Vector3 t = axis - n * n.Dot(axis);
+        t.Normalize();
+        return t;
+    }
+
+    template <typename IndexTypes>
+    void AccumulateTangents(const VertexPositionNormalTexture* vertices, size_t vertexCount,
+        const IndexTypes* indices, size_t indexCount, INT baseVertex, Vector3* tangents)
+    {
+        for (size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            const size_t corners[3] =
+            {
+                (size_t)(indices[i] + baseVertex),
+                (size_t)(indices[i + 1] + baseVertex),
+                (size_t)(indices[i + 2] + baseVertex),
+            };
+            if (corners[0] >= vertexCount || corners[1] >= vertexCount || corners[2] >= vertexCount)
+            {
+                continue;
+            }
+
+            const VertexPositionNormalTexture& v0 = vertices[corners[0]];
+            const VertexPositionNormalTexture& v1 = vertices[corners[1]];
+            const VertexPositionNormalTexture& v2 = vertices[corners[2]];
+            const Vector3 e1 = Vector3(v1.position) - Vector3(v0.position);
+            const Vector3 e2 = Vector3(v2.position) - Vector3(v0.position);
+            const float du1 = v1.textureCoordinate.x - v0.textureCoordinate.x;
+            const float dv1 = v1.textureCoordinate.y - v0.textureCoordinate.y;
+            const float du2 = v2.textureCoordinate.x - v0.textureCoordinate.x;
+            const float dv2 = v2.textureCoordinate.y - v0.textureCoordinate.y;
+
+            // Solve e = du * T + dv * B for T.  Each triangle counts the
+            // same however large its UVs are.
+            const float det = du1 * dv2 - du2 * dv1;
+            if (det == 0.0f)
+            {
+                continue;
+            }
+            Vector3 tangent = (e1 * dv2 - e2 * dv1) / det;
+            if (tangent.Length() == 0.0f)
+            {
+                continue;
+            }
+            tangent.Normalize();
+            for (size_t corner : corners)
+            {
+                tangents[corner] = tangents[corner] + tangent;
+            }
+        }
+    }
+}
+
+VertexQuantization VertexQuantization::FromBounds(const Vector3& minimum, const Vector3& maximum)
+{
+    VertexQuantization quantization;
+    quantization.Scale = maximum - minimum;
+    quantization.Bias = minimum;
+    return quantization;
+}
+
+VertexCompressionError VertexCompressionError::Tolerance(const VertexQuantization& quantization)
+{
+    VertexCompressionError tolerance;
+    // Half a quantization step, plus float rounding in the decode itself.
+    const Vector3 step = quantization.Scale / UnormMax;
+    const Vector3 magnitude = Vector3(fabsf(quantization.Bias.x), fabsf(quantization.Bias.y), fabsf(quantization.Bias.z)) + quantization.Scale;
+    tolerance.Position = 0.5f * std::max<float>(step.x, std::max<float>(step.y, step.z)) +
+        4.0f * FLT_EPSILON * std::max<float>(magnitude.x, std::max<float>(magnitude.y, magnitude.z));
+    tolerance.NormalDegrees = 1.0f;
+    tolerance.TangentDegrees = 1.0f;
+    tolerance.TexCoord = 1.0f / 1024.0f;
+    return tolerance;
+}
+
+namespace VertexCompression
+{
+    void EncodeOctahedral(const Vector3& n, int8_t out[2])
+    {
+        const float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+        if (l1 == 0.0f)
+        {
+            out[0] = 0;
+            out[1] = 0;
+            return;
+        }
+
+        // Work from n / l1 throughout; tiny inputs would underflow n.Length().
+        const Vector3 scaled = n / l1;
+        float x = scaled.x;
+        float y = scaled.y;
+        if (n.z < 0.0f)
+        {
+            const float fx = (1.0f - fabsf(y)) * SignNotZero(x);
+            const float fy = (1.0f - fabsf(x)) * SignNotZero(y);
+            x = fx;
+            y = fy;
+        }
+
+        // Of the four neighbouring grid points, keep the one that decodes
+        // closest to the input; plain rounding is up to twice as far off.
+        const Vector3 target = scaled / scaled.Length();
+        const float fx = floorf(x * SnormMax);
+        const float fy = floorf(y * SnormMax);
+        float bestDot = -2.0f;
+        for (int i = 0; i < 4; i++)
+        {
+            int8_t candidate[2] =
+            {
+                (int8_t)std::max<float>(-SnormMax, std::min<float>(SnormMax, fx + (i & 1))),
+                (int8_t)std::max<float>(-SnormMax, std::min<float>(SnormMax, fy + (i >> 1))),
+            };
+            const float dot = DecodeOctahedral(candidate).Dot(target);
+            if (dot > bestDot)
+            {
+                bestDot = dot;
+                out[0] = candidate[0];
+                out[1] = candidate[1];
+            }
+        }
+    }
+
+    Vector3 DecodeOctahedral(const int8_t in[2])
+    {
+        Vector3 v(in[0] / SnormMax, in[1] / SnormMax, 0.0f);
+        v.z = 1.0f - fabsf(v.x) - fabsf(v.y);
+        const float t = std::max<float>(-v.z, 0.0f);
+        v.x += v.x >= 0.0f ? -t : t;
+        v.y += v.y >= 0.0f ? -t : t;
+        v.Normalize();
+        return v;
+    }
+
+    VertexPositionNormalTextureCompact Encode(const VertexPositionNormalTexture& vertex,
+        const VertexQuantization& quantization, const Vector3& tangent)
+    {
+        VertexPositionNormalTextureCompact out;
+
+        const float position[3] = { vertex.position.x, vertex.position.y, vertex.position.z };
+        const float scale[3] = { quantization.Scale.x, quantization.Scale.y, quantization.Scale.z };
+        const float bias[3] = { quantization.Bias.x, quantization.Bias.y, quantization.Bias.z };
+        for (int i = 0; i < 3; i++)
+        {
+            const float unorm = scale[i] > 0.0f ? (position[i] - bias[i]) / scale[i] : 0.0f;
+            out.position[i] = (uint16_t)(std::max<float>(0.0f, std::min<float>(1.0f, unorm)) * UnormMax + 0.5f);
+        }
+        out.position[3] = 0;
+
+        EncodeOctahedral(vertex.normal, out.normalTangent);
+        EncodeOctahedral(tangent, out.normalTangent + 2);
+
+        out.textureCoordinate[0] = XMConvertFloatToHalf(vertex.textureCoordinate.x);
+        out.textureCoordinate[1] = XMConvertFloatToHalf(vertex.textureCoordinate.y);
+        return out;
+    }
+
+    VertexPositionNormalTexture Decode(const VertexPositionNormalTextureCompact& vertex,
+        const VertexQuantization& quantization)
+    {
+        VertexPositionNormalTexture out;
+        out.position.x = vertex.position[0] / UnormMax * quantization.Scale.x + quantization.Bias.x;
+        out.position.y = vertex.position[1] / UnormMax * quantization.Scale.y + quantization.Bias.y;
+        out.position.z = vertex.position[2] / UnormMax * quantization.Scale.z + quantization.Bias.z;
+        out.normal = DecodeOctahedral(vertex.normalTangent);
+        out.textureCoordinate.x = XMConvertHalfToFloat(vertex.textureCoordinate[0]);
+        out.textureCoordinate.y = XMConvertHalfToFloat(vertex.textureCoordinate[1]);
+        return out;
+    }
+
+    Vector3 DecodeTangent(const VertexPositionNormalTextureCompact& vertex)
+    {
+        return DecodeOctahedral(vertex.normalTangent + 2);
+    }
+
+    template <typename IndexTypes>
+    void ComputeTangents(const VertexPositionNormalTexture* vertices, size_t vertexCount,
+        const IndexTypes* indices, size_t indexCount,
+        const SubmeshGeometry* ranges, size_t rangeCount, Vector3* tangents)
+    {
+        std::fill(tangents, tangents + vertexCount, Vector3(0.0f, 0.0f, 0.0f));
+        if (rangeCount == 0)
+        {
+            AccumulateTangents(vertices, vertexCount, indices, indexCount, 0, tangents);
+        }
+        for (size_t i = 0; i < rangeCount; i++)
+        {
+            const SubmeshGeometry& range = ranges[i];
+            if (range.StartIndexLocation <= indexCount)
+            {
+                AccumulateTangents(vertices, vertexCount, indices + range.StartIndexLocation,
+                    std::min<size_t>(range.IndexCount, indexCount - range.StartIndexLocation),
+                    range.BaseVertexLocation, tangents);
+            }
+        }
+
+        // Gram-Schmidt against the normal, so the shader's TBN is orthonormal.
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            Vector3 normal = vertices[i].normal;
+            normal.Normalize();
+            Vector3 tangent = tangents[i] - normal * normal.Dot(tangents[i]);
+            if (tangent.Length() <= 1e-6f)
+            {
+                tangent = Perpendicular(normal);
+            }
+            tangent.Normalize();
+            tangents[i] = tangent;
+        }
+    }
+
+    template void ComputeTangents<uint16_t>(const VertexPositionNormalTexture*, size_t,
+        const uint16_t*, size_t, const SubmeshGeometry*, size_t, Vector3*);
+    template void ComputeTangents<uint32_t>(const VertexPositionNormalTexture*, size_t,
+        const uint32_t*, size_t, const SubmeshGeometry*, size_t, Vector3*);
+
+    void Encode(const VertexPositionNormalTexture* vertices, const Vector3* tangents, size_t vertexCount,
+        const VertexQuantization& quantization, VertexPositionNormalTextureCompact* out)
+    {
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            out[i] = Encode(vertices[i], quantization, tangents[i]);
+        }
+    }
+
+    VertexCompressionError MeasureError(const VertexPositionNormalTexture* vertices, const Vector3* tangents,
+        const VertexPositionNormalTextureCompact* compact, size_t vertexCount,
+        const VertexQuantization& quantization)
+    {
+        VertexCompressionError error;
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const VertexPositionNormalTexture& source = vertices[i];
+            const VertexPositionNormalTexture decoded = Decode(compact[i], quantization);
+
+            const Vector3 position = decoded.position;
+            const Vector3 delta = position - Vector3(source.position);
+            error.Position = std::max<float>(error.Position,
+                std::max<float>(fabsf(delta.x), std::max<float>(fabsf(delta.y), fabsf(delta.z))));
+
+            error.NormalDegrees = std::max<float>(error.NormalDegrees, AngleDegrees(source.normal, decoded.normal));
+            error.TangentDegrees = std::max<float>(error.TangentDegrees, AngleDegrees(tangents[i], DecodeTangent(compact[i])));
+
+            const float u = fabsf(decoded.textureCoordinate.x - source.textureCoordinate.x) /
+                std::max<float>(1.0f, fabsf(source.textureCoordinate.x));
+            const float v = fabsf(decoded.textureCoordinate.y - source.textureCoordinate.y) /
+                std::max<float>(1.0f, fabsf(source.textureCoordinate.y));
+            error.TexCoord = std::max<float>(error.TexCoord, std::max<float>(u, v));
+        }
+        return error;
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// 16 byte replacement for VertexPositionNormalTexture (32 bytes):
+//   position   R16G16B16A16_UNORM  relative to the mesh bounds, w unused
+//   normal     R8G8B8A8_SNORM      octahedral normal in xy, tangent in zw
+// The source format has no tangent, so one is derived from the triangles and
+// UVs (VertexCompression::ComputeTangents) when encoding.
+//   texcoord   R16G16_FLOAT
+// The shaders decode it when compiled with COMPACT_VERTEX; the position is
+// mapped back to object space with gPosScale/gPosBias from cbPerObject.
+struct VertexPositionNormalTextureCompact
+{
+    uint16_t position[4];
+    int8_t normalTangent[4];
+    DirectX::PackedVector::HALF textureCoordinate[2];
+
+    static const D3D12_INPUT_LAYOUT_DESC InputLayout;
+
+private:
+    static const UINT InputElementCount = 3;
+    static const D3D12_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+};
+
+// Maps object space positions to [0, 1] per axis: p = unorm * Scale + Bias.
+struct VertexQuantization
+{
+    Vector3 Scale = Vector3(1.0f, 1.0f, 1.0f);
+    Vector3 Bias = Vector3(0.0f, 0.0f, 0.0f);
+
+    static VertexQuantization FromBounds(const Vector3& minimum, const Vector3& maximum);
+
+    template <typename VertexTypes>
+    static VertexQuantization FromVertices(const VertexTypes* vertices, size_t vertexCount)
+    {
+        if (vertexCount == 0)
+        {
+            return VertexQuantization();
+        }
+
+        Vector3 minimum = vertices[0].position;
+        Vector3 maximum = vertices[0].position;
+        for (size_t i = 1; i < vertexCount; i++)
+        {
+            minimum = Vector3::Min(minimum, vertices[i].position);
+            maximum = Vector3::Max(maximum, vertices[i].position);
+        }
+        return FromBounds(minimum, maximum);
+    }
+};
+
+// Largest differences seen when decoding compact vertices again.
+struct VertexCompressionError
+{
+    float Position = 0.0f;      // object space units
+    float NormalDegrees = 0.0f;
+    float TangentDegrees = 0.0f;
+    float TexCoord = 0.0f;      // relative to max(1, |uv|)
+
+    // Worst case the encoding is expected to stay within for a mesh quantized
+    // with quantization: half a 16-bit step per axis, the octahedral 8-bit
+    // normal and tangent error and half precision UVs.
+    static VertexCompressionError Tolerance(const VertexQuantization& quantization);
+
+    bool Within(const VertexCompressionError& tolerance) const
+    {
+        return Position <= tolerance.Position &&
+            NormalDegrees <= tolerance.NormalDegrees &&
+            TangentDegrees <= tolerance.TangentDegrees &&
+            TexCoord <= tolerance.TexCoord;
+    }
+};
+
+namespace VertexCompression
+{
+    VertexPositionNormalTextureCompact Encode(const VertexPositionNormalTexture& vertex,
+        const VertexQuantization& quantization, const Vector3& tangent);
+    VertexPositionNormalTexture Decode(const VertexPositionNormalTextureCompact& vertex,
+        const VertexQuantization& quantization);
+    Vector3 DecodeTangent(const VertexPositionNormalTextureCompact& vertex);
+
+    // Octahedral mapping of a unit vector to [-1, 1]^2, stored as 8-bit snorm.
+    void EncodeOctahedral(const Vector3& n, int8_t out[2]);
+    Vector3 DecodeOctahedral(const int8_t in[2]);
+
+    // Unit tangents along +u, averaged over the triangles using each vertex
+    // and made orthogonal to its normal.  Vertices whose triangles give no u
+    // direction (unused, or degenerate UVs) get an arbitrary perpendicular.
+    // With ranges, each range's indices are relative to its BaseVertexLocation
+    // (see ModelLoader::splitMesh); otherwise the whole index buffer is used.
+    template <typename IndexTypes>
+    void ComputeTangents(const VertexPositionNormalTexture* vertices, size_t vertexCount,
+        const IndexTypes* indices, size_t indexCount,
+        const SubmeshGeometry* ranges, size_t rangeCount, Vector3* tangents);
+
+    void Encode(const VertexPositionNormalTexture* vertices, const Vector3* tangents, size_t vertexCount,
+        const VertexQuantization& quantization, VertexPositionNormalTextureCompact* out);
+
+    // Decodes every vertex again and reports the largest errors.
+    VertexCompressionError MeasureError(const VertexPositionNormalTexture* vertices, const Vector3* tangents,
+        const VertexPositionNormalTextureCompact* compact, size_t vertexCount,
+        const VertexQuantization& quantization);
+}
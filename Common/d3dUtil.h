@@ -201,7 +201,10 @@ struct MeshGeometry
     Microsoft::WRL::ComPtr<ID3D12Resource> VertexBuffer = nullptr;
     Microsoft::WRL::ComPtr<ID3D12Resource> IndexBuffer = nullptr;
 
-    // Data about the buffers.
+    // Data about the buffers.  The buffers may be shared with other meshes
+    // (see MeshUploader), in which case this mesh starts at the offsets.
+    UINT64 VertexBufferOffset = 0;
+    UINT64 IndexBufferOffset = 0;
     UINT VertexByteStride = 0;
     UINT VertexBufferByteSize = 0;
     DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -209,15 +212,39 @@ struct MeshGeometry
 
     UINT TotalIndexCount = 0;
 
+    // Set for VertexPositionNormalTextureCompact buffers, whose positions are
+    // stored relative to the mesh bounds: p = unorm * PositionScale + PositionBias.
+    bool CompactVertices = false;
+    Vector3 PositionScale = Vector3(1.0f, 1.0f, 1.0f);
+    Vector3 PositionBias = Vector3(0.0f, 0.0f, 0.0f);
+
     // A MeshGeometry may store multiple geometries in one vertex/index buffer.
     // Use this container to define the Submesh geometries so we can draw
     // the Submeshes individually.
     std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
 
+    // Meshes too large for 16-bit indices can instead be split into ranges
+    // that each address at most 65536 vertices from their BaseVertexLocation.
+    // When this is not empty the whole mesh is drawn range by range.
+    std::vector<SubmeshGeometry> IndexRanges;
+
+    // Object space bounds of every vertex, for culling.
+    DirectX::BoundingBox Bounds;
+
+    // Takes the bounds from the float3 position member of each vertex.
+    template <typename VertexTypes>
+    void SetBounds(const VertexTypes* vertices, size_t vertexCount)
+    {
+        if (vertexCount > 0)
+        {
+            DirectX::BoundingBox::CreateFromPoints(Bounds, vertexCount, &vertices[0].position, sizeof(VertexTypes));
+        }
+    }
+
     D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
     {
         D3D12_VERTEX_BUFFER_VIEW vbv;
-        vbv.BufferLocation = VertexBuffer->GetGPUVirtualAddress();
+        vbv.BufferLocation = VertexBuffer->GetGPUVirtualAddress() + VertexBufferOffset;
         vbv.StrideInBytes = VertexByteStride;
         vbv.SizeInBytes = VertexBufferByteSize;
 
@@ -227,7 +254,7 @@ struct MeshGeometry
     D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
     {
         D3D12_INDEX_BUFFER_VIEW ibv;
-        ibv.BufferLocation = IndexBuffer->GetGPUVirtualAddress();
+        ibv.BufferLocation = IndexBuffer->GetGPUVirtualAddress() + IndexBufferOffset;
         ibv.Format = IndexFormat;
         ibv.SizeInBytes = IndexBufferByteSize;
 
@@ -237,7 +264,39 @@ struct MeshGeometry
     void Set(DX::DeviceResources* devRes, const std::string name, const vector<VertexTypes>& vertices,
         const vector<uint16_t>& indices)
     {
+        Set(devRes, name, vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    // 32-bit indices are narrowed to 16-bit when every vertex is reachable
+    // with them, so small meshes don't pay twice the index bandwidth.
+    template <typename VertexTypes>
+    void Set(DX::DeviceResources* devRes, const std::string name, const vector<VertexTypes>& vertices,
+        const vector<uint32_t>& indices)
+    {
+        if (vertices.size() <= 0x10000)
+        {
+            vector<uint16_t> indices16(indices.begin(), indices.end());
+            Set(devRes, name, vertices.data(), vertices.size(), indices16.data(), indices16.size());
+        }
+        else
+        {
+            Set(devRes, name, vertices.data(), vertices.size(), indices.data(), indices.size());
+        }
+    }
+
+    // Same as above, but reads from raw arrays so callers holding the streams
+    // somewhere other than a vector (e.g. a memory mapped cache) avoid a copy.
+    // The index format follows IndexTypes.
+    template <typename VertexTypes, typename IndexTypes>
+    void Set(DX::DeviceResources* devRes, const std::string name,
+        const VertexTypes* vertices, size_t vertexCount,
+        const IndexTypes* indices, size_t indexCount)
+    {
+        static_assert(sizeof(IndexTypes) == sizeof(uint16_t) || sizeof(IndexTypes) == sizeof(uint32_t),
+            "index buffers are either 16 or 32 bit");
+
         Name = name;
+        SetBounds(vertices, vertexCount);
 
         auto dev = devRes->GetD3DDevice();
 
@@ -245,17 +304,17 @@ struct MeshGeometry
 
         upload.Begin();
 
-        TotalIndexCount = indices.size();
+        TotalIndexCount = (UINT)indexCount;
 
-        const UINT vbByteSize = (UINT)vertices.size() * sizeof(VertexTypes);
-        const UINT ibByteSize = (UINT)indices.size() * sizeof(uint16_t);
+        const UINT vbByteSize = (UINT)vertexCount * sizeof(VertexTypes);
+        const UINT ibByteSize = (UINT)indexCount * sizeof(IndexTypes);
 
         // Copy data into the upload heap
         SharedGraphicsResource vertexUploadBuffer = GraphicsMemory::Get(dev).Allocate(vbByteSize);
         SharedGraphicsResource indexUploadBuffer = GraphicsMemory::Get(dev).Allocate(ibByteSize);
 
-        memcpy(vertexUploadBuffer.Memory(), vertices.data(), vbByteSize);
-        memcpy(indexUploadBuffer.Memory(), indices.data(), ibByteSize);
+        memcpy(vertexUploadBuffer.Memory(), vertices, vbByteSize);
+        memcpy(indexUploadBuffer.Memory(), indices, ibByteSize);
 
         auto vbdesc = CD3DX12_RESOURCE_DESC::Buffer(vbByteSize);
         auto ibdesc = CD3DX12_RESOURCE_DESC::Buffer(ibByteSize);
@@ -295,9 +354,11 @@ struct MeshGeometry
         // Wait for the upload thread to terminate
         finish.wait();
 
+        VertexBufferOffset = 0;
+        IndexBufferOffset = 0;
         VertexByteStride = sizeof(VertexTypes);
         VertexBufferByteSize = vbByteSize;
-        IndexFormat = DXGI_FORMAT_R16_UINT;
+        IndexFormat = sizeof(IndexTypes) == sizeof(uint32_t) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
         IndexBufferByteSize = ibByteSize;
     }
 };
@@ -381,6 +442,15 @@ struct RenderItem
     // Index into GPU constant buffer corresponding to the ObjectCB for this render item.
     UINT ObjCBIndex = -1;
 
+    // Index of this render item in the scene's CullingStage.
+    UINT CullIndex = -1;
+
+    // Node of the scene's TransformHierarchy that world follows, if any.
+    UINT TransformNode = -1;
+
+    // DrawQueue key of this render item without its depth.
+    UINT64 DrawKey = 0;
+
     Material* Mat = nullptr;
     MeshGeometry* Geo = nullptr;
 
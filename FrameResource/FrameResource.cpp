@@ -15,6 +15,8 @@ FrameResource::FrameResource(DX::DeviceResources* devRes, UINT passCount, UINT o
         MaterialBuffer = std::make_unique<UploadBuffer<MaterialData>>(dev, materialCount, false);
     if (objectCount > 0)
         ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(dev, objectCount, true);
+
+    DrawLists = std::make_unique<CommandListPool>(devRes);
 }
 
 FrameResource::~FrameResource()
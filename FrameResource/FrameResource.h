@@ -2,6 +2,7 @@
 #include "../DirectXTK12/Inc/SimpleMath.h"
 #include "../Common/DeviceResources.h"
 #include "../Common/UploadBuffer.h"
+#include "../Common/CommandListPool.h"
 #include "../Common/d3dUtil.h"
 
 using namespace DirectX;
@@ -17,6 +18,12 @@ struct ObjectConstants
     UINT     ObjPad0;
     UINT     ObjPad1;
     UINT     ObjPad2;
+
+    // Dequantization of compact vertex positions; identity otherwise.
+    Vector3  posScale = Vector3(1.0f, 1.0f, 1.0f);
+    float    ObjPad3;
+    Vector3  posBias = Vector3(0.0f, 0.0f, 0.0f);
+    float    ObjPad4;
 };
 
 struct PassConstants
@@ -84,6 +91,9 @@ public:
 
     std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
 
+    // Command lists the frame's draws are recorded into on worker threads.
+    std::unique_ptr<CommandListPool> DrawLists = nullptr;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
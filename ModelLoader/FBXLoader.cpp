@@ -1,6 +1,107 @@
 #include "FBXLoader.h"
+#include "MeshOptimizer.h"
+#include "../Common/MeshUploader.h"
 #include "../SystemTable.h"
 
+namespace
+{
+    Matrix ToMatrix(const FbxAMatrix& m)
+    {
+        Matrix out;
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                out.m[row][column] = static_cast<float>(m[row][column]);
+            }
+        }
+        return out;
+    }
+
+    // The strongest MaxBoneInfluences weights of one control point.
+    struct BoneInfluences
+    {
+        UINT count = 0;
+        uint8_t indices[MaxBoneInfluences] = {};
+        float weights[MaxBoneInfluences] = {};
+
+        void Add(int bone, float weight)
+        {
+            UINT slot = count;
+            if (count < MaxBoneInfluences)
+            {
+                count++;
+            }
+            else if (weight > weights[MaxBoneInfluences - 1])
+            {
+                slot = MaxBoneInfluences - 1;
+            }
+            else
+            {
+                return;
+            }
+            for (; slot > 0 && weights[slot - 1] < weight; slot--)
+            {
+                indices[slot] = indices[slot - 1];
+                weights[slot] = weights[slot - 1];
+            }
+            indices[slot] = (uint8_t)bone;
+            weights[slot] = weight;
+        }
+
+        // Dropped influences are redistributed over the kept ones.
+        void Normalize()
+        {
+            float sum = 0.0f;
+            for (UINT i = 0; i < count; i++)
+            {
+                sum += weights[i];
+            }
+            for (UINT i = 0; sum > 0.0f && i < count; i++)
+            {
+                weights[i] /= sum;
+            }
+        }
+    };
+
+    // Returns false when the mesh has no skin bound to known bones.
+    bool FetchBoneInfluences(FbxMesh* fbxMesh, const std::unordered_map<FbxNode*, int>& boneIndices,
+        std::vector<BoneInfluences>& influences)
+    {
+        influences.assign(fbxMesh->GetControlPointsCount(), BoneInfluences());
+
+        bool skinned = false;
+        const int numberOfSkins = fbxMesh->GetDeformerCount(FbxDeformer::eSkin);
+        for (int index_of_skin = 0; index_of_skin < numberOfSkins; index_of_skin++)
+        {
+            FbxSkin* skin = static_cast<FbxSkin*>(fbxMesh->GetDeformer(index_of_skin, FbxDeformer::eSkin));
+            for (int index_of_cluster = 0; index_of_cluster < skin->GetClusterCount(); index_of_cluster++)
+            {
+                FbxCluster* cluster = skin->GetCluster(index_of_cluster);
+                auto bone = boneIndices.find(cluster->GetLink());
+                if (bone == boneIndices.end())
+                {
+                    continue;
+                }
+
+                const int* controlPoints = cluster->GetControlPointIndices();
+                const double* weights = cluster->GetControlPointWeights();
+                for (int i = 0; i < cluster->GetControlPointIndicesCount(); i++)
+                {
+                    influences.at(controlPoints[i]).Add(bone->second, static_cast<float>(weights[i]));
+                    skinned = true;
+                }
+            }
+        }
+
+        for (auto& influence : influences)
+        {
+            influence.Normalize();
+        }
+        return skinned;
+    }
+}
+
 void FBXLoader::Load(const std::string& filename)
 {
    
@@ -53,10 +154,22 @@ void FBXLoader::Load(const std::string& filename)
 
     };
     traverse(scene->GetRootNode());
+    if (!fetchSkeleton(boneNodes))
+    {
+        // Without a skeleton the meshes load unskinned and no clips are read.
+        boneNodes.clear();
+    }
 
     if (fetchedMeshes.size() > 0)
     {
         mGeometries.resize(fetchedMeshes.size());
+
+        // All meshes go up in one submission; the uploader reads the streams
+        // at Upload(), so they are kept here until then.
+        MeshUploader uploader(g_pSys->pDeviceResources.get());
+        std::vector<std::vector<VertexPositionNormalTexture>> meshVertices(fetchedMeshes.size());
+        std::vector<std::vector<VertexPositionNormalTextureSkinned>> meshSkinnedVertices(fetchedMeshes.size());
+        std::vector<std::vector<uint32_t>> meshIndices(fetchedMeshes.size());
         for (int index_of_mesh = 0; index_of_mesh < fetchedMeshes.size(); index_of_mesh++)
         {
             FbxMesh* fbxMesh = fetchedMeshes.at(index_of_mesh)->GetMesh();
@@ -66,14 +179,13 @@ void FBXLoader::Load(const std::string& filename)
             mMaterialData.resize(numberOfMaterials);
 
             //load bone_node influence per mesh
-            //std::vector<bone_influences_per_control_point> bone_influences;
-            //Fetch_bone_influences(fbxMesh, bone_influences);
+            std::vector<BoneInfluences> bone_influences;
+            const bool skinned = FetchBoneInfluences(fbxMesh, mBoneIndices, bone_influences);
 
             FbxTime::EMode time_mode = fbxMesh->GetScene()->GetGlobalSettings().GetTimeMode();
             FbxTime frame_time;
             frame_time.SetTime(0, 0, 0, 1, 0, time_mode);
 
-            //Fetch_bone_matrices(fbxMesh);
 
             FbxAMatrix global_transform = fbxMesh->GetNode()->EvaluateGlobalTransform(0);
 
@@ -167,8 +279,8 @@ void FBXLoader::Load(const std::string& filename)
                 }
             }
 
-            std::vector<VertexPositionNormalTexture> vertices;
-            std::vector<uint16_t> indices;
+            std::vector<VertexPositionNormalTextureSkinned> vertices;
+            std::vector<uint32_t> indices;
             u_int vertex_count = 0;
 
             //Tangent
@@ -196,7 +308,7 @@ void FBXLoader::Load(const std::string& filename)
 
                 for (int index_of_vertex = 0; index_of_vertex < 3; index_of_vertex++)
                 {
-                    VertexPositionNormalTexture vertex;
+                    VertexPositionNormalTextureSkinned vertex;
                     const int index_of_control_point = fbxMesh->GetPolygonVertex(index_of_polygon, index_of_vertex);
                     vertex.position.x = static_cast<float>(array_of_control_points[index_of_control_point][0]);
                     vertex.position.y = static_cast<float>(array_of_control_points[index_of_control_point][1]);
@@ -240,38 +352,179 @@ void FBXLoader::Load(const std::string& filename)
                     //    vertex.TangentU.z = 0;
                     //}
 
-                    //bone_influences_per_control_point influences_per_control_point = bone_influences.at(index_of_control_point);
-
-                    //for (size_t bone_index = 0; bone_index < influences_per_control_point.size(); ++bone_index)
-                    //{
-
-                    //    if (bone_index < MAX_BONE_INFLUENCES)
-                    //    {
-                    //        vertex.BoneIndices[bone_index] = influences_per_control_point.at(bone_index).index;
-                    //        vertex.BoneWeights[bone_index] = influences_per_control_point.at(bone_index).weight;
-                    //    }
-                    //}
+                    const BoneInfluences& influences_per_control_point = bone_influences.at(index_of_control_point);
+                    for (UINT bone_index = 0; bone_index < influences_per_control_point.count; ++bone_index)
+                    {
+                        vertex.boneIndices[bone_index] = influences_per_control_point.indices[bone_index];
+                    }
+                    SkinnedAnimation::QuantizeWeights(influences_per_control_point.weights,
+                        influences_per_control_point.count, vertex.boneWeights);
 
                     vertices.push_back(vertex);
 
-                    indices.at(static_cast<std::vector<uint16_t, std::allocator<uint16_t>>::size_type>(index_offset) + index_of_vertex) = static_cast<uint16_t>(vertex_count);
+                    indices.at(static_cast<std::vector<uint32_t, std::allocator<uint32_t>>::size_type>(index_offset) + index_of_vertex) = static_cast<uint32_t>(vertex_count);
 
                     vertex_count += 1;
                 }
                 subset.IndexCount += 3;
             }
 
-            mesh->Set(g_pSys->pDeviceResources.get(),
-                mesh->Name,
-                vertices, indices);
+            if (mOptimizeMeshes)
+            {
+                // Corners are emitted unshared, so deduplication does most of the work here.
+                std::vector<SubmeshGeometry> subsets;
+                for (auto& subset : mesh->DrawArgs)
+                {
+                    subsets.push_back(subset.second);
+                }
+                const MeshOptimizer::Report report = MeshOptimizer::Optimize(vertices, indices, subsets);
+                OutputDebugStringA(("FBXLoader: " + mesh->Name + " " + report.ToString() + "\n").c_str());
+            }
+
+            mesh->SetBounds(vertices.data(), vertices.size());
+            meshIndices[index_of_mesh] = std::move(indices);
+            if (skinned)
+            {
+                meshSkinnedVertices[index_of_mesh] = std::move(vertices);
+                uploader.Add(mesh.get(), mesh->Name, meshSkinnedVertices[index_of_mesh], meshIndices[index_of_mesh]);
+            }
+            else
+            {
+                std::vector<VertexPositionNormalTexture>& unskinned = meshVertices[index_of_mesh];
+                unskinned.reserve(vertices.size());
+                for (const auto& vertex : vertices)
+                {
+                    unskinned.emplace_back(vertex.position, vertex.normal, vertex.textureCoordinate);
+                }
+                uploader.Add(mesh.get(), mesh->Name, unskinned, meshIndices[index_of_mesh]);
+            }
             mGeometries.push_back(std::move(mesh));
         }
+        uploader.Upload();
         
     }
-    //if (boneNodes.size() > 0)
-    //{
-    //    scene->SetName(_filename.c_str());
-    //    Fetch_bone_animations(boneNodes, extra_animations);
-    //}
+    if (boneNodes.size() > 0)
+    {
+        fetchAnimations(scene, boneNodes);
+    }
     manager->Destroy();
 }
+
+bool FBXLoader::fetchSkeleton(const std::vector<FbxNode*>& boneNodes)
+{
+    mSkeleton = Skeleton();
+    mBoneIndices.clear();
+
+    if (boneNodes.size() > MaxSkeletonBones)
+    {
+        OutputDebugStringA(("FBXLoader: skeleton has " + std::to_string(boneNodes.size()) +
+            " bones but 8-bit bone indices address " + std::to_string(MaxSkeletonBones) +
+            "; loading the meshes unskinned\n").c_str());
+        return false;
+    }
+
+    // boneNodes comes from a depth first walk, so parents are already in the
+    // map when their children are added.
+    for (FbxNode* node : boneNodes)
+    {
+        int parent = -1;
+        for (FbxNode* ancestor = node->GetParent(); ancestor && parent < 0; ancestor = ancestor->GetParent())
+        {
+            auto found = mBoneIndices.find(ancestor);
+            if (found != mBoneIndices.end())
+            {
+                parent = found->second;
+            }
+        }
+
+        mBoneIndices[node] = (int)mSkeleton.ParentIndices.size();
+        mSkeleton.BoneNames.push_back(node->GetName());
+        mSkeleton.ParentIndices.push_back(parent);
+        // Bones without a cluster keep their default pose as the bind pose.
+        mSkeleton.InverseBindPose.push_back(ToMatrix(node->EvaluateGlobalTransform().Inverse()));
+    }
+
+    // The bind pose of skinned bones comes from their clusters.  When several
+    // meshes share a bone, the first cluster wins.
+    if (boneNodes.empty())
+    {
+        return true;
+    }
+    FbxScene* scene = boneNodes.front()->GetScene();
+    std::vector<bool> bound(boneNodes.size(), false);
+    for (int index_of_skin = 0; index_of_skin < scene->GetSrcObjectCount<FbxSkin>(); index_of_skin++)
+    {
+        FbxSkin* skin = scene->GetSrcObject<FbxSkin>(index_of_skin);
+        for (int index_of_cluster = 0; index_of_cluster < skin->GetClusterCount(); index_of_cluster++)
+        {
+            FbxCluster* cluster = skin->GetCluster(index_of_cluster);
+            auto bone = mBoneIndices.find(cluster->GetLink());
+            if (bone == mBoneIndices.end() || bound[bone->second])
+            {
+                continue;
+            }
+
+            FbxAMatrix reference_global_init_position;
+            FbxAMatrix cluster_global_init_position;
+            cluster->GetTransformMatrix(reference_global_init_position);
+            cluster->GetTransformLinkMatrix(cluster_global_init_position);
+            mSkeleton.InverseBindPose[bone->second] =
+                ToMatrix(cluster_global_init_position.Inverse() * reference_global_init_position);
+            bound[bone->second] = true;
+        }
+    }
+    return true;
+}
+
+void FBXLoader::fetchAnimations(FbxScene* scene, const std::vector<FbxNode*>& boneNodes)
+{
+    const FbxTime::EMode time_mode = scene->GetGlobalSettings().GetTimeMode();
+    FbxTime frame_time;
+    frame_time.SetTime(0, 0, 0, 1, 0, time_mode);
+
+    const UINT boneCount = mSkeleton.BoneCount();
+    std::vector<XMMATRIX> global(boneCount);
+
+    mAnimations.clear();
+    for (int index_of_stack = 0; index_of_stack < scene->GetSrcObjectCount<FbxAnimStack>(); index_of_stack++)
+    {
+        FbxAnimStack* stack = scene->GetSrcObject<FbxAnimStack>(index_of_stack);
+        scene->SetCurrentAnimationStack(stack);
+
+        const FbxTimeSpan span = stack->GetLocalTimeSpan();
+        const FbxTime start = span.GetStart();
+        const FbxLongLong frames = (span.GetStop() - start).Get() / frame_time.Get();
+
+        AnimationClip clip;
+        clip.Name = stack->GetName();
+        clip.SampleRate = static_cast<float>(FbxTime::GetFrameRate(time_mode));
+        clip.BoneCount = boneCount;
+        clip.KeyCount = static_cast<UINT>(std::max<FbxLongLong>(frames + 1, 1));
+        clip.Rotations.resize((size_t)clip.KeyCount * boneCount);
+        clip.Translations.resize((size_t)clip.KeyCount * boneCount);
+        clip.Scales.resize((size_t)clip.KeyCount * boneCount);
+
+        for (UINT key = 0; key < clip.KeyCount; key++)
+        {
+            const FbxTime time = start + frame_time * static_cast<int>(key);
+            for (UINT bone = 0; bone < boneCount; bone++)
+            {
+                // Locals are taken relative to the parent bone rather than the
+                // parent node, so helper nodes in between are folded in.
+                global[bone] = ToMatrix(boneNodes[bone]->EvaluateGlobalTransform(time));
+                const int parent = mSkeleton.ParentIndices[bone];
+                const XMMATRIX local = parent < 0 ? global[bone] :
+                    XMMatrixMultiply(global[bone], XMMatrixInverse(nullptr, global[parent]));
+
+                XMVECTOR scale, rotation, translation;
+                XMMatrixDecompose(&scale, &rotation, &translation, local);
+
+                const size_t i = (size_t)key * boneCount + bone;
+                XMStoreFloat4(&clip.Rotations[i], rotation);
+                XMStoreFloat3(&clip.Translations[i], translation);
+                XMStoreFloat3(&clip.Scales[i], scale);
+            }
+        }
+        mAnimations.push_back(std::move(clip));
+    }
+}
@@ -2,6 +2,7 @@
 
 #include "../Include/FBXSDK/fbxsdk.h"
 #include "../Common/d3dUtil.h"
+#include "../Common/SkinnedAnimation.h"
 
 using namespace fbxsdk;
 
@@ -23,7 +24,21 @@ public:
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::vector<FBXMaterialData> mMaterialData;
 
+	// Bones of every skin in the file and one clip per animation stack,
+	// sampled at the scene frame rate.  Skinned meshes are uploaded as
+	// VertexPositionNormalTextureSkinned indexing into mSkeleton.
+	Skeleton mSkeleton;
+	std::vector<AnimationClip> mAnimations;
+
+	// Run MeshOptimizer over each mesh before upload.
+	bool mOptimizeMeshes = false;
+
 
 private:
+	// Returns false, leaving no skeleton, when it has too many bones to skin.
+	bool fetchSkeleton(const std::vector<FbxNode*>& boneNodes);
+	void fetchAnimations(FbxScene* scene, const std::vector<FbxNode*>& boneNodes);
+
 	Matrix m_global_transform;
+	std::unordered_map<FbxNode*, int> mBoneIndices;
 };
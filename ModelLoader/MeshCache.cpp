@@ -0,0 +1,332 @@
+#include "MeshCache.h"
+#include "ModelLoader.h"
+#include "../Common/AssetRegistry.h"
+
+namespace
+{
+	struct MeshCacheHeader
+	{
+		char		magic[4];
+		uint32_t	version;
+		uint64_t	sourceHash;
+		uint64_t	sourceSize;
+		uint64_t	sourceWriteTime;
+		uint64_t	flagsHash;
+		uint32_t	vertexStride;
+		uint32_t	meshCount;
+		uint32_t	materialCount;
+		uint32_t	pad;
+	};
+
+	const char MeshCacheMagic[4] = { 'M', 'S', 'H', 'C' };
+
+	// The smallest encodings of a mesh and a material record, used to reject
+	// counts the rest of the file could not possibly hold before allocating.
+	const size_t MinMeshRecordSize = 5 * sizeof(uint32_t);
+	const size_t MinMaterialRecordSize = 4 * sizeof(uint32_t);
+
+	void CreateParentDirectories(const string& path)
+	{
+		for (size_t slash = path.find('/'); slash != string::npos; slash = path.find('/', slash + 1))
+		{
+			CreateDirectoryA(path.substr(0, slash).c_str(), nullptr);
+		}
+	}
+
+	void WritePadding(ofstream& out)
+	{
+		static const char zeros[4] = {};
+		const std::streamoff offset = out.tellp();
+		out.write(zeros, (4 - offset % 4) % 4);
+	}
+
+	template <typename T>
+	void WriteValue(ofstream& out, const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template <typename CharType>
+	void WriteString(ofstream& out, const basic_string<CharType>& str)
+	{
+		WriteValue(out, (uint32_t)str.size());
+		out.write(reinterpret_cast<const char*>(str.data()), str.size() * sizeof(CharType));
+		WritePadding(out);
+	}
+
+	template <typename CharType>
+	bool ReadString(SpanReader& reader, basic_string<CharType>& str)
+	{
+		uint32_t length = 0;
+		const CharType* chars = nullptr;
+		if (!reader.Read(length) ||
+			!reader.ReadView(chars, length) ||
+			!reader.Align(4))
+		{
+			return false;
+		}
+		str.assign(chars, chars + length);
+		return true;
+	}
+
+	template <typename IndexType>
+	bool IndicesBelow(const IndexType* indices, uint32_t first, uint32_t count, uint64_t baseVertex, uint32_t vertexCount)
+	{
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			if (baseVertex + indices[i] >= vertexCount)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// A corrupt or stale cache must not hand the GPU indices past the end of
+	// its vertex buffer.  Split meshes are drawn range by range, so their
+	// indices are checked relative to each range's base vertex.
+	template <typename IndexType>
+	bool IndicesInRange(const IndexType* indices, const MeshCache::MeshView& mesh)
+	{
+		if (mesh.ranges.empty())
+		{
+			return IndicesBelow(indices, 0, mesh.indexCount, 0, mesh.vertexCount);
+		}
+		for (const auto& range : mesh.ranges)
+		{
+			if (range.BaseVertexLocation < 0 ||
+				!IndicesBelow(indices, range.StartIndexLocation, range.IndexCount, (uint64_t)range.BaseVertexLocation, mesh.vertexCount))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+MeshCache::MeshView MeshCache::View(const ModelMeshData& mesh)
+{
+	MeshView view;
+	view.name = mesh.name;
+	view.vertices = mesh.vertices.data();
+	view.vertexCount = (uint32_t)mesh.vertices.size();
+	if (mesh.indices32.empty())
+	{
+		view.indices = mesh.indices.data();
+		view.indexCount = (uint32_t)mesh.indices.size();
+		view.indexSize = sizeof(uint16_t);
+	}
+	else
+	{
+		view.indices = mesh.indices32.data();
+		view.indexCount = (uint32_t)mesh.indices32.size();
+		view.indexSize = sizeof(uint32_t);
+	}
+	view.ranges = mesh.ranges;
+	return view;
+}
+
+const char* const MeshCache::CacheDirectory = "Cache/Meshes";
+
+bool MeshCache::GetSourceKey(const std::string& filename, SourceKey& key)
+{
+	key = SourceKey();
+	key.path = filename;
+	return FileStamp::Get(filename, key.stamp);
+}
+
+bool MeshCache::HashSource(SourceKey& key)
+{
+	if (!key.hashed)
+	{
+		MappedFile source(key.path);
+		if (!source.IsOpen())
+		{
+			return false;
+		}
+		key.hash = HashBytes(source.Data(), source.Size());
+		key.hashed = true;
+	}
+	return true;
+}
+
+std::string MeshCache::CachePath(const std::string& filename)
+{
+	// Models in different directories often share a file name, so the name is
+	// prefixed with a hash of the whole path.
+	const string path = AssetRegistry::NormalizePath(filename);
+
+	char prefix[17];
+	sprintf_s(prefix, "%016llx", (unsigned long long)HashBytes(path.data(), path.size()));
+
+	return string(CacheDirectory) + '/' + prefix + '_' + path.substr(path.find_last_of('/') + 1) + ".meshcache";
+}
+
+bool MeshCache::Write(const std::string& cachePath, const SourceKey& sourceKey, uint64_t flagsHash,
+	const std::vector<ModelMeshData>& meshes, const std::vector<ModelMaterialData>& materials)
+{
+	// Write to a temporary file and move it into place, so an interrupted bake
+	// never leaves a truncated cache behind.
+	const string tempPath = cachePath + ".tmp";
+	CreateParentDirectories(cachePath);
+	{
+		ofstream out(tempPath, ios::out | ios::binary | ios::trunc);
+		if (!out.is_open())
+		{
+			return false;
+		}
+
+		MeshCacheHeader header = {};
+		memcpy(header.magic, MeshCacheMagic, sizeof(header.magic));
+		header.version = Version;
+		header.sourceHash = sourceKey.hash;
+		header.sourceSize = sourceKey.stamp.size;
+		header.sourceWriteTime = sourceKey.stamp.writeTime;
+		header.flagsHash = flagsHash;
+		header.vertexStride = sizeof(VertexPositionNormalTexture);
+		header.meshCount = (uint32_t)meshes.size();
+		header.materialCount = (uint32_t)materials.size();
+		WriteValue(out, header);
+
+		for (const auto& mesh : meshes)
+		{
+			const MeshView view = View(mesh);
+			WriteString(out, view.name);
+			WriteValue(out, view.vertexCount);
+			WriteValue(out, view.indexCount);
+			WriteValue(out, view.indexSize);
+			WriteValue(out, (uint32_t)view.ranges.size());
+			for (const auto& range : view.ranges)
+			{
+				WriteValue(out, range.IndexCount);
+				WriteValue(out, range.StartIndexLocation);
+				WriteValue(out, range.BaseVertexLocation);
+			}
+			out.write(reinterpret_cast<const char*>(view.vertices),
+				view.vertexCount * sizeof(VertexPositionNormalTexture));
+			out.write(static_cast<const char*>(view.indices),
+				view.indexCount * view.indexSize);
+			WritePadding(out);
+		}
+
+		for (const auto& mat : materials)
+		{
+			WriteString(out, mat.materialname);
+			WriteString(out, mat.meshname);
+			WriteString(out, mat.diffuse);
+			WriteString(out, mat.normal);
+		}
+
+		if (!out.good())
+		{
+			out.close();
+			DeleteFileA(tempPath.c_str());
+			return false;
+		}
+	}
+
+	if (!MoveFileExA(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool MeshCache::Open(const std::string& cachePath, SourceKey& sourceKey, uint64_t flagsHash,
+	std::vector<ModelMaterialData>& materials)
+{
+	Close();
+
+	if (!mFile.Open(cachePath))
+	{
+		return false;
+	}
+
+	SpanReader reader(mFile.Data(), mFile.Size());
+
+	MeshCacheHeader header;
+	if (!reader.Read(header) ||
+		memcmp(header.magic, MeshCacheMagic, sizeof(header.magic)) != 0 ||
+		header.version != Version ||
+		header.sourceSize != sourceKey.stamp.size ||
+		(header.sourceWriteTime != sourceKey.stamp.writeTime &&
+			(!HashSource(sourceKey) || header.sourceHash != sourceKey.hash)) ||
+		header.flagsHash != flagsHash ||
+		header.vertexStride != sizeof(VertexPositionNormalTexture) ||
+		header.meshCount > reader.Remaining() / MinMeshRecordSize ||
+		header.materialCount > (reader.Remaining() - header.meshCount * MinMeshRecordSize) / MinMaterialRecordSize)
+	{
+		Close();
+		return false;
+	}
+
+	std::vector<MeshView> meshes(header.meshCount);
+	for (auto& mesh : meshes)
+	{
+		uint32_t rangeCount = 0;
+		if (!ReadString(reader, mesh.name) ||
+			!reader.Read(mesh.vertexCount) ||
+			!reader.Read(mesh.indexCount) ||
+			!reader.Read(mesh.indexSize) ||
+			(mesh.indexSize != sizeof(uint16_t) && mesh.indexSize != sizeof(uint32_t)) ||
+			mesh.vertexCount > reader.Remaining() / sizeof(VertexPositionNormalTexture) ||
+			mesh.indexCount > reader.Remaining() / mesh.indexSize ||
+			!reader.Read(rangeCount) ||
+			rangeCount > reader.Remaining() / (3 * sizeof(uint32_t)))
+		{
+			Close();
+			return false;
+		}
+
+		mesh.ranges.resize(rangeCount);
+		for (auto& range : mesh.ranges)
+		{
+			if (!reader.Read(range.IndexCount) ||
+				!reader.Read(range.StartIndexLocation) ||
+				!reader.Read(range.BaseVertexLocation) ||
+				range.StartIndexLocation > mesh.indexCount ||
+				range.IndexCount > mesh.indexCount - range.StartIndexLocation)
+			{
+				Close();
+				return false;
+			}
+		}
+
+		const uint8_t* indices = nullptr;
+		if (!reader.ReadView(mesh.vertices, mesh.vertexCount) ||
+			!reader.ReadView(indices, (size_t)mesh.indexCount * mesh.indexSize) ||
+			!reader.Align(4) ||
+			!(mesh.indexSize == sizeof(uint32_t) ?
+				IndicesInRange(reinterpret_cast<const uint32_t*>(indices), mesh) :
+				IndicesInRange(reinterpret_cast<const uint16_t*>(indices), mesh)))
+		{
+			Close();
+			return false;
+		}
+		mesh.indices = indices;
+	}
+
+	std::vector<ModelMaterialData> cachedMaterials(header.materialCount);
+	for (auto& mat : cachedMaterials)
+	{
+		if (!ReadString(reader, mat.materialname) ||
+			!ReadString(reader, mat.meshname) ||
+			!ReadString(reader, mat.diffuse) ||
+			!ReadString(reader, mat.normal))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	mMeshes = std::move(meshes);
+	materials = std::move(cachedMaterials);
+	return true;
+}
+
+void MeshCache::Close()
+{
+	mMeshes.clear();
+	mFile.Close();
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "../Common/d3dUtil.h"
+#include "../Common/MappedFile.h"
+
+struct ModelMaterialData;
+struct ModelMeshData;
+
+// On-disk copy of the vertex/index streams and material data ModelLoader
+// produces from an Assimp import.  A cache file is only accepted when it was
+// written by the same format version with the same importer flags, from a
+// source file with the same size and write time.  Only when the write time
+// differs is the source hashed and compared with the bytes the cache was
+// baked from, so a touched but unchanged asset keeps its cache while editing
+// the asset or the import settings rebakes it.  Cache files live under
+// CacheDirectory rather than next to the assets.
+//
+// Layout (everything 4-byte aligned):
+//   MeshCacheHeader
+//   meshCount x { name, vertexCount, indexCount, indexSize, rangeCount,
+//                 ranges, vertices, indices }
+//   materialCount x { materialname, meshname, diffuse, normal }
+// Strings are a uint32 length followed by the characters.
+class MeshCache
+{
+public:
+	static const uint32_t Version = 3;
+	static const char* const CacheDirectory;
+
+	// Identifies the source file a cache was baked from.  hash is filled
+	// lazily by HashSource, since a matching stamp never needs it.
+	struct SourceKey
+	{
+		string path;
+		FileStamp stamp;
+		uint64_t hash = 0;
+		bool hashed = false;
+	};
+
+	// Points into the mapped cache file; valid while the MeshCache is open.
+	struct MeshView
+	{
+		string name;
+		const VertexPositionNormalTexture* vertices = nullptr;
+		uint32_t vertexCount = 0;
+		const void* indices = nullptr;
+		uint32_t indexCount = 0;
+		uint32_t indexSize = sizeof(uint16_t);
+		vector<SubmeshGeometry> ranges;
+	};
+
+	// Views the streams of a freshly processed mesh the same way as a cached one.
+	static MeshView View(const ModelMeshData& mesh);
+
+	static bool GetSourceKey(const std::string& filename, SourceKey& key);
+	static bool HashSource(SourceKey& key);
+	static std::string CachePath(const std::string& filename);
+
+	static bool Write(const std::string& cachePath, const SourceKey& sourceKey, uint64_t flagsHash,
+		const std::vector<ModelMeshData>& meshes, const std::vector<ModelMaterialData>& materials);
+
+	// Maps cachePath and validates it against the keys, hashing the source
+	// into sourceKey if its stamp differs, and checks every index against its
+	// mesh's vertices.  On success mMeshes and materials are filled; on
+	// failure both are left untouched.
+	bool Open(const std::string& cachePath, SourceKey& sourceKey, uint64_t flagsHash,
+		std::vector<ModelMaterialData>& materials);
+	void Close();
+
+	std::vector<MeshView> mMeshes;
+
+private:
+	MappedFile mFile;
+};
@@ -0,0 +1,226 @@
+#include "MeshOptimizer.h"
+
+namespace
+{
+	const uint32_t Unused = ~0u;
+
+	uint64_t HashBytes(const uint8_t* bytes, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+string MeshOptimizer::Report::ToString() const
+{
+	char buff[128] = {};
+	sprintf_s(buff, "vertices %u -> %u, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+		vertexCountBefore, vertexCountAfter, before.acmr, after.acmr, before.atvr, after.atvr);
+	return buff;
+}
+
+MeshOptimizer::Stats MeshOptimizer::Analyze(const uint32_t* indices, size_t indexCount, size_t vertexCount, UINT cacheSize)
+{
+	// A vertex is still cached while fewer than cacheSize misses have
+	// happened since it was loaded.
+	vector<size_t> loadedAt(vertexCount, 0);
+	vector<bool> referenced(vertexCount, false);
+	size_t misses = 0;
+	size_t uniqueVertices = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		const uint32_t v = indices[i];
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			uniqueVertices++;
+		}
+		else if (misses - loadedAt[v] < cacheSize)
+		{
+			continue;
+		}
+		loadedAt[v] = misses++;
+	}
+
+	Stats stats;
+	if (indexCount >= 3)
+	{
+		stats.acmr = (float)misses / (indexCount / 3);
+	}
+	if (uniqueVertices > 0)
+	{
+		stats.atvr = (float)misses / uniqueVertices;
+	}
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, UINT cacheSize)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Vertex -> triangle adjacency, stored as offsets into one array.
+	vector<uint32_t> live(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		live[indices[i]]++;
+	}
+	vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		offsets[v + 1] = offsets[v] + live[v];
+	}
+	vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	vector<uint32_t> adjacency(triangleCount * 3);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (size_t c = 0; c < 3; c++)
+		{
+			adjacency[fill[indices[t * 3 + c]]++] = (uint32_t)t;
+		}
+	}
+
+	const vector<uint32_t> source(indices, indices + triangleCount * 3);
+	uint32_t* dst = indices;
+
+	vector<bool> emitted(triangleCount, false);
+	vector<size_t> cacheTime(vertexCount, 0);
+	vector<uint32_t> deadEnd;
+	vector<uint32_t> candidates;
+	size_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	// Returns the next vertex that still has triangles left, or Unused.
+	auto skipDeadEnd = [&]() -> uint32_t
+	{
+		while (!deadEnd.empty())
+		{
+			const uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0)
+			{
+				return v;
+			}
+		}
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (live[cursor] > 0)
+			{
+				return (uint32_t)cursor;
+			}
+		}
+		return Unused;
+	};
+
+	uint32_t fan = skipDeadEnd();
+	while (fan != Unused)
+	{
+		// Emit every remaining triangle around the fanning vertex.
+		candidates.clear();
+		for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++)
+		{
+			const uint32_t t = adjacency[a];
+			if (emitted[t])
+			{
+				continue;
+			}
+			emitted[t] = true;
+
+			for (size_t c = 0; c < 3; c++)
+			{
+				const uint32_t v = source[t * 3 + c];
+				*dst++ = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+				}
+			}
+		}
+
+		// Prefer the candidate that entered the cache earliest but will still
+		// be resident after its remaining triangles are emitted.  Candidates
+		// that would not (priority 0) are left to skipDeadEnd instead.
+		uint32_t next = Unused;
+		size_t bestPriority = 0;
+		for (const uint32_t v : candidates)
+		{
+			if (live[v] == 0)
+			{
+				continue;
+			}
+			size_t priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+			{
+				priority = time - cacheTime[v];
+			}
+			if (priority > bestPriority)
+			{
+				next = v;
+				bestPriority = priority;
+			}
+		}
+		fan = next != Unused ? next : skipDeadEnd();
+	}
+}
+
+vector<uint32_t> MeshOptimizer::DeduplicateRemap(const void* vertices, size_t vertexCount, size_t vertexStride, size_t& uniqueCount)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+
+	// Open addressing table of vertex indices, at most half full.
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+	{
+		tableSize *= 2;
+	}
+	vector<uint32_t> table(tableSize, Unused);
+
+	vector<uint32_t> remap(vertexCount);
+	uniqueCount = 0;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const uint8_t* vertex = bytes + i * vertexStride;
+		size_t slot = HashBytes(vertex, vertexStride) & (tableSize - 1);
+		while (table[slot] != Unused &&
+			memcmp(bytes + table[slot] * vertexStride, vertex, vertexStride) != 0)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table[slot] == Unused)
+		{
+			table[slot] = (uint32_t)i;
+			remap[i] = (uint32_t)uniqueCount++;
+		}
+		else
+		{
+			remap[i] = remap[table[slot]];
+		}
+	}
+	return remap;
+}
+
+vector<uint32_t> MeshOptimizer::VertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t& usedCount)
+{
+	vector<uint32_t> remap(vertexCount, Unused);
+	usedCount = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == Unused)
+		{
+			remap[indices[i]] = (uint32_t)usedCount++;
+		}
+	}
+	return remap;
+}
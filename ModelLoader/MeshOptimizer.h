@@ -0,0 +1,94 @@
+#pragma once
+#include "../Common/d3dUtil.h"
+
+// Import-time reordering of indexed triangle lists so fewer vertices go
+// through the vertex shader.  Every step is deterministic: the same input
+// always produces the same buffers.
+class MeshOptimizer
+{
+public:
+	// Size of the FIFO post-transform cache that is optimized for and simulated.
+	static const UINT CacheSize = 16;
+
+	struct Stats
+	{
+		float acmr = 0.0f;	// transformed vertices per triangle
+		float atvr = 0.0f;	// transformed vertices per referenced vertex
+	};
+
+	struct Report
+	{
+		UINT vertexCountBefore = 0;
+		UINT vertexCountAfter = 0;
+		Stats before;
+		Stats after;
+
+		string ToString() const;
+	};
+
+	static Stats Analyze(const uint32_t* indices, size_t indexCount, size_t vertexCount, UINT cacheSize = CacheSize);
+
+	// Tipsify (Sander et al. 2007): reorders the triangles of a list in place
+	// for a FIFO cache of cacheSize entries, in time linear in the mesh size.
+	static void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, UINT cacheSize = CacheSize);
+
+	// Both return a remap table (old -> new vertex) and the new vertex count.
+	// Deduplicate merges bit-identical vertices keeping the first occurrence;
+	// fetch order numbers vertices by first use and drops unreferenced ones.
+	static vector<uint32_t> DeduplicateRemap(const void* vertices, size_t vertexCount, size_t vertexStride, size_t& uniqueCount);
+	static vector<uint32_t> VertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t& usedCount);
+
+	// Runs deduplication, cache reordering and fetch reordering.  Triangles
+	// are only reordered within each of ranges, so DrawArgs stay valid; an
+	// empty list treats the whole buffer as one range.
+	template <typename VertexTypes>
+	static Report Optimize(vector<VertexTypes>& vertices, vector<uint32_t>& indices,
+		const vector<SubmeshGeometry>& ranges = vector<SubmeshGeometry>())
+	{
+		Report report;
+		report.vertexCountBefore = (UINT)vertices.size();
+		report.before = Analyze(indices.data(), indices.size(), vertices.size());
+
+		size_t vertexCount = 0;
+		vector<uint32_t> remap = DeduplicateRemap(vertices.data(), vertices.size(), sizeof(VertexTypes), vertexCount);
+		Remap(vertices, indices, remap, vertexCount);
+
+		if (ranges.empty())
+		{
+			OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+		}
+		for (const auto& range : ranges)
+		{
+			OptimizeVertexCache(indices.data() + range.StartIndexLocation, range.IndexCount, vertices.size());
+		}
+
+		remap = VertexFetchRemap(indices.data(), indices.size(), vertices.size(), vertexCount);
+		Remap(vertices, indices, remap, vertexCount);
+
+		report.vertexCountAfter = (UINT)vertices.size();
+		report.after = Analyze(indices.data(), indices.size(), vertices.size());
+		return report;
+	}
+
+private:
+	template <typename VertexTypes>
+	static void Remap(vector<VertexTypes>& vertices, vector<uint32_t>& indices, const vector<uint32_t>& remap, size_t newCount)
+	{
+		const uint32_t unused = ~0u;
+
+		vector<VertexTypes> remapped(newCount);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			if (remap[i] != unused)
+			{
+				remapped[remap[i]] = vertices[i];
+			}
+		}
+		vertices.swap(remapped);
+
+		for (auto& index : indices)
+		{
+			index = remap[index];
+		}
+	}
+};
@@ -1,57 +1,224 @@
 #include "ModelLoader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "../Common/MeshUploader.h"
+#include "../Common/VertexCompression.h"
+#include "../Common/ParallelFor.h"
 #include "../SystemTable.h"
 
 void ModelLoader::Load(const std::string& filename)
 {
-	Assimp::Importer importer;
-
-	const aiScene* pScene = importer.ReadFile(filename,
+	const unsigned int importFlags =
 		aiProcess_Triangulate |
-		aiProcess_ConvertToLeftHanded);
-	
+		aiProcess_ConvertToLeftHanded;
+
 	this->mDirectory = filename.substr(0, filename.find_last_of('/'));
 
-	processNode(pScene->mRootNode, pScene);
+	// Warm path: the baked streams are keyed on the source file, the import
+	// flags and the loader options that change the output, and go straight
+	// from the mapping to the upload heap.
+	const string cachePath = MeshCache::CachePath(filename);
+	const uint32_t bakeOptions[] = { importFlags, (uint32_t)mSplitLargeMeshes, (uint32_t)mOptimizeMeshes };
+	const uint64_t flagsHash = HashBytes(bakeOptions, sizeof(bakeOptions));
+	MeshCache::SourceKey sourceKey;
+	const bool cacheable = mUseMeshCache && MeshCache::GetSourceKey(filename, sourceKey);
+
+	if (cacheable)
+	{
+		MeshCache cache;
+		std::vector<ModelMaterialData> cachedMaterials;
+		if (cache.Open(cachePath, sourceKey, flagsHash, cachedMaterials))
+		{
+			uploadMeshes(cache.mMeshes);
+			mMaterialData.insert(mMaterialData.end(),
+				std::make_move_iterator(cachedMaterials.begin()), std::make_move_iterator(cachedMaterials.end()));
+			return;
+		}
+	}
+
+	Assimp::Importer importer;
+
+	const aiScene* pScene = importer.ReadFile(filename, importFlags);
+	if (!pScene)
+	{
+		return;
+	}
+
+	// Gather the meshes in node order first so each one can be converted
+	// independently into its own slot.
+	std::vector<aiMesh*> sceneMeshes;
+	processNode(pScene->mRootNode, pScene, sceneMeshes);
+
+	// Materials are resolved first on this thread, since a bad one is
+	// reported with a message box and fails the whole load.
+	std::vector<ModelMaterialData> materials(sceneMeshes.size());
+	for (size_t i = 0; i < sceneMeshes.size(); i++)
+	{
+		if (!processMaterial(sceneMeshes[i], pScene, materials[i]))
+		{
+			return;
+		}
+	}
+
+	std::vector<ModelMeshData> meshes;
+	ConvertMeshes(sceneMeshes, meshes);
+
+	std::vector<MeshCache::MeshView> views;
+	for (const auto& mesh : meshes)
+	{
+		views.push_back(MeshCache::View(mesh));
+	}
+	uploadMeshes(views);
+
+	// mMaterialData also holds the materials of earlier loads, which do not
+	// belong in this model's cache.  The source is only hashed here if the
+	// cache lookup above did not already need to.
+	if (cacheable && MeshCache::HashSource(sourceKey))
+	{
+		MeshCache::Write(cachePath, sourceKey, flagsHash, meshes, materials);
+	}
+	mMaterialData.insert(mMaterialData.end(),
+		std::make_move_iterator(materials.begin()), std::make_move_iterator(materials.end()));
 }
 
-void ModelLoader::processNode(aiNode* node, const aiScene* scene)
+void ModelLoader::ConvertMeshes(const std::vector<aiMesh*>& sceneMeshes, std::vector<ModelMeshData>& meshes)
 {
-	for (UINT i = 0; i < node->mNumMeshes; i++) 
+	meshes.clear();
+	meshes.resize(sceneMeshes.size());
+	auto convert = [&](size_t i)
+	{
+		processMesh(sceneMeshes[i], meshes[i]);
+	};
+	if (mParallelProcessing)
 	{
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		mGeometries.push_back(std::move(this->processMesh(mesh, scene)));
+		ParallelFor(size_t(0), sceneMeshes.size(), convert);
+	}
+	else
+	{
+		for (size_t i = 0; i < sceneMeshes.size(); i++)
+		{
+			convert(i);
+		}
+	}
+}
+
+void ModelLoader::uploadMeshes(const std::vector<MeshCache::MeshView>& views)
+{
+	// Compact vertices are encoded here rather than baked, so the cache and
+	// the encoding can change independently.
+	std::vector<std::vector<VertexPositionNormalTextureCompact>> compactVertices(views.size());
+	std::vector<VertexQuantization> quantizations(views.size());
+	if (mCompactVertices)
+	{
+		auto encode = [&](size_t i)
+		{
+			const MeshCache::MeshView& view = views[i];
+			quantizations[i] = VertexQuantization::FromVertices(view.vertices, view.vertexCount);
+			std::vector<Vector3> tangents(view.vertexCount);
+			if (view.indexSize == sizeof(uint32_t))
+			{
+				VertexCompression::ComputeTangents(view.vertices, view.vertexCount,
+					static_cast<const uint32_t*>(view.indices), view.indexCount,
+					view.ranges.data(), view.ranges.size(), tangents.data());
+			}
+			else
+			{
+				VertexCompression::ComputeTangents(view.vertices, view.vertexCount,
+					static_cast<const uint16_t*>(view.indices), view.indexCount,
+					view.ranges.data(), view.ranges.size(), tangents.data());
+			}
+			compactVertices[i].resize(view.vertexCount);
+			VertexCompression::Encode(view.vertices, tangents.data(), view.vertexCount, quantizations[i], compactVertices[i].data());
+#ifdef _DEBUG
+			const VertexCompressionError error = VertexCompression::MeasureError(
+				view.vertices, tangents.data(), compactVertices[i].data(), view.vertexCount, quantizations[i]);
+			_ASSERT_EXPR(error.Within(VertexCompressionError::Tolerance(quantizations[i])),
+				L"compact vertex round trip is out of tolerance");
+#endif
+		};
+		if (mParallelProcessing)
+		{
+			ParallelFor(size_t(0), views.size(), encode);
+		}
+		else
+		{
+			for (size_t i = 0; i < views.size(); i++)
+			{
+				encode(i);
+			}
+		}
 	}
 
-	for (UINT i = 0; i < node->mNumChildren; i++) 
+	MeshUploader uploader(g_pSys->pDeviceResources.get());
+	for (size_t i = 0; i < views.size(); i++)
 	{
-		this->processNode(node->mChildren[i], scene);
+		const MeshCache::MeshView& view = views[i];
+		auto meshGeometry = make_unique<MeshGeometry>();
+		meshGeometry->SetBounds(view.vertices, view.vertexCount);
+		if (mCompactVertices)
+		{
+			uploadMesh(uploader, meshGeometry.get(), view, compactVertices[i].data());
+			meshGeometry->CompactVertices = true;
+			meshGeometry->PositionScale = quantizations[i].Scale;
+			meshGeometry->PositionBias = quantizations[i].Bias;
+		}
+		else
+		{
+			uploadMesh(uploader, meshGeometry.get(), view, view.vertices);
+		}
+		meshGeometry->IndexRanges = view.ranges;
+		mGeometries.push_back(std::move(meshGeometry));
 	}
+	uploader.Upload();
 }
 
-std::unique_ptr<MeshGeometry> ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene)
+template <typename VertexTypes>
+void ModelLoader::uploadMesh(MeshUploader& uploader, MeshGeometry* geo, const MeshCache::MeshView& view, const VertexTypes* vertices)
 {
-	// Data to fill
-	vector<VertexPositionNormalTexture> vertices;
-	vector<uint16_t> indices;
-	vector<Texture> textures;	
+	if (view.indexSize == sizeof(uint32_t))
+	{
+		uploader.Add(geo, view.name, vertices, view.vertexCount,
+			static_cast<const uint32_t*>(view.indices), view.indexCount);
+	}
+	else
+	{
+		uploader.Add(geo, view.name, vertices, view.vertexCount,
+			static_cast<const uint16_t*>(view.indices), view.indexCount);
+	}
+}
 
-	
-	if (mesh->mMaterialIndex >= 0)
+void ModelLoader::processNode(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes)
+{
+	for (UINT i = 0; i < node->mNumMeshes; i++)
 	{
-		aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-		ModelMaterialData matData;
-		matData.materialname = mat->GetName().C_Str();
-		matData.meshname = mesh->mName.C_Str();
-		matData.diffuse = loadMaterialTextures(mat, aiTextureType_DIFFUSE, scene);
-		matData.normal = loadMaterialTextures(mat, aiTextureType_NORMALS, scene);
-		mMaterialData.push_back(matData);
+		meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+	}
 
+	for (UINT i = 0; i < node->mNumChildren; i++)
+	{
+		this->processNode(node->mChildren[i], scene, meshes);
 	}
+}
+
+bool ModelLoader::processMaterial(aiMesh* mesh, const aiScene* scene, ModelMaterialData& matData)
+{
+	aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
+	matData.materialname = mat->GetName().C_Str();
+	matData.meshname = mesh->mName.C_Str();
+	return loadMaterialTextures(mat, aiTextureType_DIFFUSE, matData.diffuse) &&
+		loadMaterialTextures(mat, aiTextureType_NORMALS, matData.normal);
+}
+
+void ModelLoader::processMesh(aiMesh* mesh, ModelMeshData& meshData)
+{
+	meshData.name = mesh->mName.C_Str();
 
 	// Walk through each of the mesh's vertices
+	vector<VertexPositionNormalTexture>& vertices = meshData.vertices;
+	vertices.resize(mesh->mNumVertices);
 	for (UINT i = 0; i < mesh->mNumVertices; i++)
 	{
-		VertexPositionNormalTexture vertex;
+		VertexPositionNormalTexture& vertex = vertices[i];
 
 		vertex.position.x = mesh->mVertices[i].x;
 		vertex.position.y = mesh->mVertices[i].y;
@@ -64,45 +231,149 @@ std::unique_ptr<MeshGeometry> ModelLoader::processMesh(aiMesh* mesh, const aiSce
 			vertex.normal.z = mesh->mNormals[i].z;
 		}
 
-
 		if (mesh->mTextureCoords[0])
 		{
 			vertex.textureCoordinate.x = (float)mesh->mTextureCoords[0][i].x;
 			vertex.textureCoordinate.y = (float)mesh->mTextureCoords[0][i].y;
 		}
-
-		vertices.push_back(vertex);
 	}
 
+	// Size the index buffer up front; after aiProcess_Triangulate nearly every
+	// face is a triangle, but points and lines can still come through.
+	size_t indexCount = 0;
 	for (UINT i = 0; i < mesh->mNumFaces; i++)
 	{
-		aiFace face = mesh->mFaces[i];
+		indexCount += mesh->mFaces[i].mNumIndices;
+	}
+
+	const bool optimize = mOptimizeMeshes && mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+	if (!optimize && mesh->mNumVertices <= MaxRangeVertices)
+	{
+		copyIndices(mesh, meshData.indices, indexCount);
+		return;
+	}
+
+	vector<uint32_t> indices;
+	copyIndices(mesh, indices, indexCount);
+
+	if (optimize)
+	{
+		const MeshOptimizer::Report report = MeshOptimizer::Optimize(vertices, indices);
+		OutputDebugStringA(("ModelLoader: " + meshData.name + " " + report.ToString() + "\n").c_str());
+	}
+
+	// Deduplication may have brought the mesh back under the 16-bit limit.
+	if (vertices.size() <= MaxRangeVertices)
+	{
+		meshData.indices.assign(indices.begin(), indices.end());
+	}
+	else if (mSplitLargeMeshes)
+	{
+		splitMesh(indices, meshData);
+	}
+	else
+	{
+		meshData.indices32.swap(indices);
+	}
+}
 
+template <typename IndexType>
+void ModelLoader::copyIndices(aiMesh* mesh, vector<IndexType>& indices, size_t indexCount)
+{
+	indices.resize(indexCount);
+	IndexType* dst = indices.data();
+	for (UINT i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
 		for (UINT j = 0; j < face.mNumIndices; j++)
-			indices.push_back(face.mIndices[j]);
+		{
+			*dst++ = (IndexType)face.mIndices[j];
+		}
 	}
+}
 
-	auto meshGeometry = make_unique<MeshGeometry>();
+void ModelLoader::splitMesh(const vector<uint32_t>& indices, ModelMeshData& meshData)
+{
+	// Walk the triangles in order and start a new range whenever the next one
+	// would reference more vertices than 16-bit indices can address.  Vertices
+	// shared across a range boundary are duplicated into both ranges.
+	const UINT noRange = ~0u;
+	const size_t vertexCount = meshData.vertices.size();
+	vector<UINT> vertexRange(vertexCount, noRange);
+	vector<uint16_t> localIndex(vertexCount);
+	vector<UINT> order;
+	order.reserve(vertexCount);
+
+	meshData.indices.resize(indices.size());
+	uint16_t* dst = meshData.indices.data();
+
+	SubmeshGeometry range;
+	UINT rangeIndex = 0;
+	UINT rangeVertices = 0;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const size_t cornerCount = std::min<size_t>(3, indices.size() - i);
+
+		UINT newVertices = 0;
+		for (size_t j = 0; j < cornerCount; j++)
+		{
+			newVertices += vertexRange[indices[i + j]] != rangeIndex;
+		}
+		if (rangeVertices + newVertices > MaxRangeVertices)
+		{
+			meshData.ranges.push_back(range);
+			range.StartIndexLocation += range.IndexCount;
+			range.IndexCount = 0;
+			range.BaseVertexLocation = (INT)order.size();
+			rangeIndex++;
+			rangeVertices = 0;
+		}
 
-	meshGeometry->Set(g_pSys->pDeviceResources.get(), mesh->mName.C_Str(), vertices, indices);
+		for (size_t j = 0; j < cornerCount; j++)
+		{
+			const UINT v = indices[i + j];
+			if (vertexRange[v] != rangeIndex)
+			{
+				vertexRange[v] = rangeIndex;
+				localIndex[v] = (uint16_t)rangeVertices++;
+				order.push_back(v);
+			}
+			*dst++ = localIndex[v];
+		}
+		range.IndexCount += (UINT)cornerCount;
+	}
+	meshData.ranges.push_back(range);
 
-	return meshGeometry;
+	vector<VertexPositionNormalTexture> vertices(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		vertices[i] = meshData.vertices[order[i]];
+	}
+	meshData.vertices.swap(vertices);
 }
-wstring ModelLoader::loadMaterialTextures(aiMaterial* mat, aiTextureType type, const aiScene* scene)
+
+bool ModelLoader::loadMaterialTextures(aiMaterial* mat, aiTextureType type, wstring& texture)
 {
-	if (mat->GetTextureCount(type) > 1)
+	texture.clear();
+	const unsigned int textureCount = mat->GetTextureCount(type);
+	if (textureCount > 1)
 	{
 		MessageBoxW(g_pSys->pDeviceResources->GetWindow(), L"texture more than 1", L"warning", MB_OK);
+		return false;
 	}
-	else
+	if (textureCount == 0)
+	{
+		return true;
+	}
+
+	aiString str;
+	if (mat->GetTexture(type, 0, &str) != aiReturn_SUCCESS)
 	{
-		aiString str;
-		mat->GetTexture(type, 0, &str);
-		string filename = string(str.C_Str());
-		filename = filename.substr(filename.find_last_of("/\\") + 1);
-		filename = mDirectory + '/' + filename;
-		wstring filenamews = wstring(filename.begin(), filename.end());
-		return filenamews;
+		return false;
 	}
-	
-}
\ No newline at end of file
+	string filename = string(str.C_Str());
+	filename = filename.substr(filename.find_last_of("/\\") + 1);
+	filename = mDirectory + '/' + filename;
+	texture = wstring(filename.begin(), filename.end());
+	return true;
+}
@@ -1,11 +1,14 @@
 #pragma once
 #include "../Common/d3dUtil.h"
+#include "MeshCache.h"
 
 #include "../Include/assimp/Importer.hpp"
 #include "../Include/assimp/scene.h"
 #include "../Include/assimp/postprocess.h"
 
 
+class MeshUploader;
+
 struct ModelMaterialData
 {
 	string materialname;
@@ -14,22 +17,74 @@ struct ModelMaterialData
 	wstring normal;
 };
 
+// Processed vertex/index streams for one aiMesh, before they are uploaded.
+// Exactly one of indices/indices32 is filled.  ranges is only set when a
+// large mesh was split to stay on 16-bit indices.
+struct ModelMeshData
+{
+	string name;
+	vector<VertexPositionNormalTexture> vertices;
+	vector<uint16_t> indices;
+	vector<uint32_t> indices32;
+	vector<SubmeshGeometry> ranges;
+};
+
 class ModelLoader
 {
 public:
+	// Vertices addressable by one 16-bit index buffer or range.
+	static const UINT MaxRangeVertices = 0x10000;
+
 	ModelLoader() {};
 	~ModelLoader() {};
 	void Load(const std::string& filename);
+
+	// The CPU half of Load: converts each aiMesh into meshes[i] with the
+	// options below, concurrently when mParallelProcessing is set.  Touches no
+	// GPU state, so it can be run and timed headlessly.
+	void ConvertMeshes(const std::vector<aiMesh*>& sceneMeshes, std::vector<ModelMeshData>& meshes);
+
 	std::vector<std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::vector<ModelMaterialData> mMaterialData;
 
 	string mDirectory;
+
+	// Reuse the model's file under MeshCache::CacheDirectory when it matches
+	// the source file, import flags and options below, and write it after an
+	// Assimp import otherwise.
+	bool mUseMeshCache = true;
+
+	// Convert the meshes of an import concurrently. Output order matches the
+	// serial node walk either way.
+	bool mParallelProcessing = true;
+
+	// Meshes with more than 65536 vertices use 32-bit indices unless this is
+	// set, in which case they are split into 16-bit IndexRanges instead.
+	bool mSplitLargeMeshes = false;
+
+	// Deduplicate vertices and reorder triangles and vertices for the
+	// post-transform cache (see MeshOptimizer).  Stats go to the debug output.
+	bool mOptimizeMeshes = false;
+
+	// Upload VertexPositionNormalTextureCompact instead of full precision
+	// vertices.  Draw these with the COMPACT_VERTEX shader variants.
+	bool mCompactVertices = false;
+
 private:
-	void processNode(aiNode* node, const aiScene* scene);
-	std::unique_ptr<MeshGeometry> processMesh(aiMesh* mesh, const aiScene* scene);
+	void processNode(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes);
+	bool processMaterial(aiMesh* mesh, const aiScene* scene, ModelMaterialData& matData);
+	void processMesh(aiMesh* mesh, ModelMeshData& meshData);
+	template <typename IndexType>
+	void copyIndices(aiMesh* mesh, vector<IndexType>& indices, size_t indexCount);
+	void splitMesh(const vector<uint32_t>& indices, ModelMeshData& meshData);
+
+	void uploadMeshes(const std::vector<MeshCache::MeshView>& views);
+	template <typename VertexTypes>
+	void uploadMesh(MeshUploader& uploader, MeshGeometry* geo, const MeshCache::MeshView& view, const VertexTypes* vertices);
 
-	wstring loadMaterialTextures(aiMaterial* mat, aiTextureType type, const aiScene* scene);
+	// texture is left empty when the material has none of this type.
+	bool loadMaterialTextures(aiMaterial* mat, aiTextureType type, wstring& texture);
 
 };
 
@@ -1,25 +1,339 @@
 #include "PMDLoader.h"
+#include "../Common/MappedFile.h"
+#include "../SystemTable.h"
+
+namespace
+{
+	// PMD strings are fixed width and only null terminated when shorter than the field.
+	string FixedString(const char* str, size_t length)
+	{
+		return string(str, std::find(str, str + length, '\0'));
+	}
+
+	bool ParseIk(SpanReader& reader, PMDFile& pmd)
+	{
+		uint16_t ikCount = 0;
+		if (!reader.Read(ikCount))
+		{
+			return false;
+		}
+
+		pmd.m_iks.resize(ikCount);
+		for (auto& ik : pmd.m_iks)
+		{
+			if (!reader.Read(ik.m_ikNode) ||
+				!reader.Read(ik.m_ikTarget) ||
+				!reader.Read(ik.m_numChain) ||
+				!reader.Read(ik.m_numIteration) ||
+				!reader.Read(ik.m_rotateLimit) ||
+				!reader.ReadArray(ik.m_chanins, ik.m_numChain))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ParseMorphs(SpanReader& reader, PMDFile& pmd)
+	{
+		uint16_t morphCount = 0;
+		if (!reader.Read(morphCount))
+		{
+			return false;
+		}
+
+		pmd.m_morphs.resize(morphCount);
+		for (auto& morph : pmd.m_morphs)
+		{
+			uint32_t vertexCount = 0;
+			if (!reader.ReadString(morph.m_morphName, sizeof(morph.m_morphName)) ||
+				!reader.Read(vertexCount) ||
+				!reader.Read(morph.m_morphType) ||
+				!reader.ReadArray(morph.m_vertices, vertexCount))
+			{
+				return false;
+			}
+			memset(morph.m_englishShapeNameExt, 0, sizeof(morph.m_englishShapeNameExt));
+		}
+		return true;
+	}
+
+	bool ParseDisplayLists(SpanReader& reader, PMDFile& pmd)
+	{
+		uint8_t morphDisplayCount = 0;
+		if (!reader.Read(morphDisplayCount) ||
+			!reader.ReadArray(pmd.m_morphDisplayList.m_displayList, morphDisplayCount))
+		{
+			return false;
+		}
+
+		uint8_t boneDisplayNameCount = 0;
+		if (!reader.Read(boneDisplayNameCount))
+		{
+			return false;
+		}
+		// The bones are appended below, so lists left from an earlier parse must go.
+		pmd.m_boneDisplayLists.clear();
+		pmd.m_boneDisplayLists.resize(boneDisplayNameCount);
+		for (auto& displayList : pmd.m_boneDisplayLists)
+		{
+			if (!reader.ReadString(displayList.m_name, sizeof(displayList.m_name)))
+			{
+				return false;
+			}
+			memset(displayList.m_englishNameExt, 0, sizeof(displayList.m_englishNameExt));
+		}
+
+		// Each entry names a bone and the 1-based display frame it belongs to.
+		uint32_t boneDisplayCount = 0;
+		if (!reader.Read(boneDisplayCount))
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < boneDisplayCount; i++)
+		{
+			uint16_t boneIndex = 0;
+			uint8_t frameIndex = 0;
+			if (!reader.Read(boneIndex) || !reader.Read(frameIndex))
+			{
+				return false;
+			}
+			if (frameIndex > 0 && frameIndex <= pmd.m_boneDisplayLists.size())
+			{
+				pmd.m_boneDisplayLists[frameIndex - 1].m_displayList.push_back(boneIndex);
+			}
+		}
+		return true;
+	}
+
+	bool ParseEnglishNames(SpanReader& reader, PMDFile& pmd)
+	{
+		uint8_t hasEnglishNames = 0;
+		if (!reader.Read(hasEnglishNames))
+		{
+			return false;
+		}
+		if (hasEnglishNames == 0)
+		{
+			return true;
+		}
+
+		// Model name, comment and bone names have nowhere to go in PMDFile.
+		if (!reader.Skip(20 + 256) ||
+			!reader.Skip(20 * pmd.m_bones.size()))
+		{
+			return false;
+		}
+
+		// The base morph has no english name.
+		for (size_t i = 1; i < pmd.m_morphs.size(); i++)
+		{
+			auto& morph = pmd.m_morphs[i];
+			if (!reader.ReadString(morph.m_englishShapeNameExt, sizeof(morph.m_englishShapeNameExt)))
+			{
+				return false;
+			}
+		}
+
+		for (auto& displayList : pmd.m_boneDisplayLists)
+		{
+			if (!reader.ReadString(displayList.m_englishNameExt, sizeof(displayList.m_englishNameExt)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool PMDLoader::Parse(const uint8_t* data, size_t size, PMDFile& pmd)
+{
+	SpanReader reader(data, size);
+
+	if (!reader.Read(pmd.m_header) ||
+		memcmp(pmd.m_header.m_magic, "Pmd", 3) != 0)
+	{
+		return false;
+	}
+
+	uint32_t vertexCount = 0;
+	if (!reader.Read(vertexCount) ||
+		!reader.ReadArray(pmd.m_vertices, vertexCount))
+	{
+		return false;
+	}
+
+	// The file stores the number of face indices, not faces.
+	uint32_t faceVertexCount = 0;
+	if (!reader.Read(faceVertexCount) ||
+		faceVertexCount % 3 != 0 ||
+		!reader.ReadArray(pmd.m_faces, faceVertexCount / 3))
+	{
+		return false;
+	}
+
+	// processMesh uploads the faces as they are, so every index has to name a vertex.
+	for (const PMDFace& face : pmd.m_faces)
+	{
+		for (uint16_t index : face.m_vertices)
+		{
+			if (index >= vertexCount)
+			{
+				return false;
+			}
+		}
+	}
+
+	uint32_t materialCount = 0;
+	if (!reader.Read(materialCount) ||
+		!reader.ReadArray(pmd.m_materials, materialCount))
+	{
+		return false;
+	}
+
+	// Materials become submeshes over consecutive runs of the index buffer, which
+	// must stay inside it.
+	uint64_t materialIndexCount = 0;
+	for (const PMDMaterial& mat : pmd.m_materials)
+	{
+		materialIndexCount += mat.m_faceVertexCount;
+	}
+	if (materialIndexCount > faceVertexCount)
+	{
+		return false;
+	}
+
+	uint16_t boneCount = 0;
+	if (!reader.Read(boneCount) ||
+		!reader.ReadArray(pmd.m_bones, boneCount))
+	{
+		return false;
+	}
+
+	if (!ParseIk(reader, pmd) ||
+		!ParseMorphs(reader, pmd) ||
+		!ParseDisplayLists(reader, pmd))
+	{
+		return false;
+	}
+
+	// Everything past this point is an optional extension; older exporters stop here.
+	for (auto& toonName : pmd.m_toonTextureNames)
+	{
+		toonName.fill('\0');
+	}
+	pmd.m_rigidBodies.clear();
+	pmd.m_joints.clear();
+
+	if (reader.Remaining() == 0)
+	{
+		return true;
+	}
+	if (!ParseEnglishNames(reader, pmd))
+	{
+		return false;
+	}
+
+	if (reader.Remaining() == 0)
+	{
+		return true;
+	}
+	for (auto& toonName : pmd.m_toonTextureNames)
+	{
+		if (!reader.ReadString(toonName.data(), toonName.size()))
+		{
+			return false;
+		}
+	}
+
+	if (reader.Remaining() == 0)
+	{
+		return true;
+	}
+	uint32_t rigidBodyCount = 0;
+	if (!reader.Read(rigidBodyCount) ||
+		!reader.ReadArray(pmd.m_rigidBodies, rigidBodyCount))
+	{
+		return false;
+	}
+
+	uint32_t jointCount = 0;
+	if (!reader.Read(jointCount) ||
+		!reader.ReadArray(pmd.m_joints, jointCount))
+	{
+		return false;
+	}
+
+	return true;
+}
 
 void PMDLoader::Load(const std::string& filename)
 {
-	ifstream infile;
-	infile.open(filename, ios::in | ios::binary);
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		return;
+	}
 
-	if (!infile.is_open())
+	if (!Parse(file.Data(), file.Size(), mPMDData))
 	{
+		OutputDebugStringA(("PMDLoader: failed to parse " + filename + "\n").c_str());
 		return;
 	}
 
+	this->mDirectory = filename.substr(0, filename.find_last_of('/'));
+
+	processMesh(FixedString(mPMDData.m_header.m_modelName, sizeof(mPMDData.m_header.m_modelName)));
+}
+
+void PMDLoader::processMesh(const std::string& name)
+{
+	vector<VertexPositionNormalTexture> vertices(mPMDData.m_vertices.size());
+	for (size_t i = 0; i < mPMDData.m_vertices.size(); i++)
+	{
+		const PMDVertex& src = mPMDData.m_vertices[i];
+		vertices[i].position = src.m_position;
+		vertices[i].normal = src.m_normal;
+		vertices[i].textureCoordinate = src.m_uv;
+	}
+
+	// Faces are packed as three uint16 indices, which is exactly the index buffer layout.
+	const uint16_t* faceIndices = reinterpret_cast<const uint16_t*>(mPMDData.m_faces.data());
+	vector<uint16_t> indices(faceIndices, faceIndices + mPMDData.m_faces.size() * 3);
 
-	PMDFile m_PMDData;
+	auto meshGeometry = make_unique<MeshGeometry>();
 
-	infile >> m_PMDData.m_header.m_magic;
-	infile >> m_PMDData.m_header.m_version;
-	infile >> m_PMDData.m_header.m_modelName;
-	infile >> m_PMDData.m_header.m_comment;
-	
-	
+	// Materials consume consecutive runs of the index buffer, one submesh each.
+	UINT startIndex = 0;
+	for (size_t i = 0; i < mPMDData.m_materials.size(); i++)
+	{
+		const PMDMaterial& mat = mPMDData.m_materials[i];
+
+		PMDMaterialData matData;
+		matData.materialname = name + "_" + std::to_string(i);
+		matData.meshname = name;
+
+		// "diffuse.bmp*sphere.spa" carries a sphere map after the '*'; a lone
+		// .sph/.spa entry is a sphere map with no diffuse texture.
+		string texture = FixedString(mat.m_textureName, sizeof(mat.m_textureName));
+		texture = texture.substr(0, texture.find('*'));
+		string extension = texture.substr(texture.find_last_of('.') + 1);
+		if (!texture.empty() && extension != "sph" && extension != "spa")
+		{
+			matData.diffuse = mDirectory + '/' + texture;
+		}
+		mMaterialData.push_back(matData);
 
+		SubmeshGeometry submesh;
+		submesh.IndexCount = mat.m_faceVertexCount;
+		submesh.StartIndexLocation = startIndex;
+		submesh.BaseVertexLocation = 0;
+		meshGeometry->DrawArgs[matData.materialname] = submesh;
+
+		startIndex += mat.m_faceVertexCount;
+	}
 
+	meshGeometry->Set(g_pSys->pDeviceResources.get(), name, vertices, indices);
 
+	mGeometries.push_back(std::move(meshGeometry));
 }
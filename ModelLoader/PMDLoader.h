@@ -1,6 +1,11 @@
 #pragma once
 #include "../Common/d3dUtil.h"
 
+// The structs marked with #pragma pack(1) mirror the on-disk PMD layout byte for
+// byte, so PMDLoader::Parse can copy whole arrays of them straight out of the
+// mapped file.  The static_asserts below keep them honest.
+
+#pragma pack(1)
 struct PMDHeader
 {
 	char			m_magic[3];
@@ -8,7 +13,9 @@ struct PMDHeader
 	char			m_modelName[20];
 	char			m_comment[256];
 };
+#pragma pack()
 
+#pragma pack(1)
 struct PMDVertex
 {
 	Vector3		m_position;
@@ -18,6 +25,7 @@ struct PMDVertex
 	uint8_t		m_boneWeight;
 	uint8_t		m_edge;
 };
+#pragma pack()
 
 struct PMDFace
 {
@@ -119,6 +127,7 @@ enum class PMDRigidBodyOperation : uint8_t
 	DynamicAdjustBone	
 };
 
+#pragma pack(1)
 struct PMDRigidBodyExt
 {
 	char			m_rigidBodyName[20];
@@ -138,7 +147,9 @@ struct PMDRigidBodyExt
 	float			m_rigidBodyFriction;
 	PMDRigidBodyOperation	m_rigidBodyType;
 };
+#pragma pack()
 
+#pragma pack(1)
 struct PMDJointExt
 {
 	enum { NumJointName = 20 };
@@ -155,6 +166,16 @@ struct PMDJointExt
 	Vector3			m_springPos;
 	Vector3			m_springRot;
 };
+#pragma pack()
+
+static_assert(sizeof(PMDHeader) == 283, "PMDHeader must match the file layout");
+static_assert(sizeof(PMDVertex) == 38, "PMDVertex must match the file layout");
+static_assert(sizeof(PMDFace) == 6, "PMDFace must match the file layout");
+static_assert(sizeof(PMDMaterial) == 70, "PMDMaterial must match the file layout");
+static_assert(sizeof(PMDBone) == 39, "PMDBone must match the file layout");
+static_assert(sizeof(PMDMorph::Vertex) == 16, "PMDMorph::Vertex must match the file layout");
+static_assert(sizeof(PMDRigidBodyExt) == 83, "PMDRigidBodyExt must match the file layout");
+static_assert(sizeof(PMDJointExt) == 124, "PMDJointExt must match the file layout");
 
 struct PMDFile
 {
@@ -167,7 +188,7 @@ struct PMDFile
 	std::vector<PMDMorph>			m_morphs;
 	PMDMorphDisplayList				m_morphDisplayList;
 	std::vector<PMDBoneDisplayList>	m_boneDisplayLists;
-	std::array<unsigned char, 10>	m_toonTextureNames[100];
+	std::array<char, 100>			m_toonTextureNames[10];
 	std::vector<PMDRigidBodyExt>	m_rigidBodies;
 	std::vector<PMDJointExt>		m_joints;
 };
@@ -186,11 +207,22 @@ public:
 	PMDLoader() {};
 	~PMDLoader() {};
 	void Load(const std::string& filename);
+
+	// Decodes a complete PMD image held in memory.  Every read is bounds checked
+	// against size; returns false on a truncated or malformed file.  Does not
+	// touch the GPU, so it can be driven headlessly.
+	static bool Parse(const uint8_t* data, size_t size, PMDFile& pmd);
+
 	std::vector<std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::vector<PMDMaterialData> mMaterialData;
 
+	// Skeleton, IK, morph and physics data for the last loaded model.
+	PMDFile mPMDData;
+
+	string mDirectory;
 private:
-	
+	void processMesh(const std::string& name);
+
 	Matrix m_global_transform;
 };
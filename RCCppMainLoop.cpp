@@ -27,7 +27,19 @@ RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("imgui/imgui_tables", ".cpp");
 RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/DeviceResources", ".cpp");
 RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/d3dUtil", ".cpp");
 RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/Camera", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/MeshUploader", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/VertexCompression", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/SkinnedAnimation", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/TextureStreamer", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/AssetRegistry", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/Culling", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/TransformHierarchy", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/FramePacer", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/DrawQueue", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Common/CommandListPool", ".cpp");
 RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("ModelLoader/ModelLoader", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("ModelLoader/MeshCache", ".cpp");
+RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("ModelLoader/MeshOptimizer", ".cpp");
 RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("FrameResource/FrameResource", ".cpp");
 RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("TextureRender/ShadowMap", ".cpp");
 RUNTIME_COMPILER_SOURCEDEPENDENCY_FILE("Scene/SceneManager", ".cpp");
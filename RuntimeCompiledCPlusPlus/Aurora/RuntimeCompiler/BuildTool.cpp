@@ -20,6 +20,7 @@
 #include <fstream>
 #include <algorithm>
 #include "ICompilerLogger.h"
+#include "ObjectCache.h"
 
 using namespace std;
 using namespace FileSystemUtils;
@@ -49,6 +50,17 @@ void BuildTool::Clean( const FileSystemUtils::Path& temporaryPath_ ) const
 			pathIter.GetPath().Remove();
 		}
 	}
+
+	// Objects cached by the compiler, when it keeps a cache
+	FileSystemUtils::Path cacheDir = temporaryPath_ / "ObjectCache";
+	if( cacheDir.Exists() )
+	{
+		const size_t numRemoved = ObjectCache::Clear( cacheDir );
+		if( m_pLogger )
+		{
+			m_pLogger->LogInfo( "Deleted %d objects from RCC++ object cache: %s\n", (int)numRemoved, cacheDir.c_str() );
+		}
+	}
 }
 
 
@@ -106,13 +118,17 @@ void BuildTool::BuildModule( const std::vector<FileToBuild>&		buildFileList_,
 		if( find( forcedCompileFileList.begin(), forcedCompileFileList.end(), buildFile ) == forcedCompileFileList.end() )
 		{
 			// Check if we have a pre-compiled object version of this file, and if so use that.
+			// A compiler with an object cache checks contents instead of times, which also
+			// catches changed headers and options.
 			Path objectFileName = compilerOptions_.intermediatePath / buildFile.Filename();
 			objectFileName.ReplaceExtension(objectFileExtension.c_str());
 
-			if( objectFileName.Exists() && buildFile.Exists() )
+			if( !m_Compiler.GetHasObjectCache() && objectFileName.Exists() && buildFile.Exists() )
             {
+                // objects from before the precompiled header changed would link against the wrong one
                 FileSystemUtils::filetime_t objTime = objectFileName.GetLastWriteTime();
-                if( objTime > buildFile.GetLastWriteTime() )
+                if( objTime > buildFile.GetLastWriteTime() &&
+                    ( compilerOptions_.precompiledHeader.m_string.empty() || objTime > compilerOptions_.precompiledHeader.GetLastWriteTime() ) )
  			    {
                     // we only want to use the object file if it's newer than the source file
 				    buildFile = objectFileName;
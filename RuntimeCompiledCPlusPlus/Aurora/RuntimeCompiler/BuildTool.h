@@ -63,6 +63,16 @@ public:
     {
         m_Compiler.SetFastCompileMode( bFast );
     }
+
+    void SetMaxCompileJobs( unsigned int maxJobs )
+    {
+        m_Compiler.SetMaxCompileJobs( maxJobs );
+    }
+
+    void SetMaxObjectCacheBytes( uint64_t maxBytes )
+    {
+        m_Compiler.SetMaxObjectCacheBytes( maxBytes );
+    }
     
 
 private:
@@ -36,6 +36,7 @@ struct CompilerOptions
 	FileSystemUtils::Path				baseIntermediatePath;
 	FileSystemUtils::Path				intermediatePath;
 	FileSystemUtils::Path				compilerLocation;
+	FileSystemUtils::Path				precompiledHeader;	// included before anything else in every file, empty for none
 };
 
 class Compiler
@@ -62,7 +63,28 @@ public:
         }
     }
 
+    // Most compiler processes run at once when a module has several files to
+    // compile; 0, the default, uses one per online processor.  Only the POSIX
+    // compiler compiles files separately, the Win32 one ignores this.
+    void SetMaxCompileJobs( unsigned int maxJobs )
+    {
+        m_MaxCompileJobs = maxJobs;
+    }
+
+    // Largest size the object cache may grow to before the least recently
+    // used objects are removed, checked after each build that stores objects.
+    // Only the POSIX compiler has an object cache, the Win32 one ignores this.
+    void SetMaxObjectCacheBytes( uint64_t maxBytes )
+    {
+        m_MaxObjectCacheBytes = maxBytes;
+    }
+
     std::string GetObjectFileExtension() const;
+
+    // True when RunCompile itself decides which sources need compiling, from
+    // a cache of objects keyed by their preprocessed source and options, so
+    // callers should pass sources rather than previously built objects.
+    bool GetHasObjectCache() const;
 	void RunCompile( const std::vector<FileSystemUtils::Path>&	filesToCompile_,
                      const CompilerOptions&						compilerOptions_,
 					 std::vector<FileSystemUtils::Path>			linkLibraryList_,
@@ -73,4 +95,6 @@ public:
 private:
 	PlatformCompilerImplData* m_pImplData;
     bool                      m_bFastCompileMode;
+    unsigned int              m_MaxCompileJobs;
+    uint64_t                  m_MaxObjectCacheBytes;
 };
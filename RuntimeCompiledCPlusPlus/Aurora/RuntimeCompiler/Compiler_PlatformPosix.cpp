@@ -20,7 +20,24 @@
 //   - We use a single intermediate directory for compiled .obj files, which means
 //     we don't support compiling multiple files with the same name. Could fix this
 //     with either mangling names to include paths,  or recreating folder structure
-//
+//   - Each source file is compiled by its own compiler process, at most
+//     SetMaxCompileJobs() at once, and the objects are linked by a final process.
+//     Jobs are started and reaped from GetIsComplete(), so the application keeps
+//     running and the logger hears about each file as it finishes.
+//   - Objects are cached in the "ObjectCache" folder of the intermediate folder,
+//     keyed by a hash of the preprocessed source, the compiler's --version output
+//     and the compile options.  Every file is preprocessed first, and only
+//     compiled when its key is not in the cache.  Objects taken from the cache are
+//     marked used, and after a build that stored objects the least recently used
+//     are removed until the cache fits in SetMaxObjectCacheBytes().
+//   - A precompiled header is built in the "PCH" folder of the intermediate folder
+//     and included through a stub header of the same name next to it, which
+//     includes the real header, so that the compiler falls back to the text of the
+//     header whenever the precompiled one is missing or unusable.  It is keyed like
+//     the objects, plus the modification times of the files it was built from, as
+//     clang rejects a precompiled header older than any of those.  It is only rebuilt
+//     once some file misses the object cache; preprocesses run while it builds,
+//     compiles wait for it.
 //
 
 #ifndef _WIN32
@@ -29,42 +46,547 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <deque>
 #include <iostream>
 
 #include <fstream>
+#include <set>
 #include <sstream>
 
 #include "assert.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
 #include "ICompilerLogger.h"
+#include "ObjectCache.h"
 
 using namespace std;
 //const char	c_CompletionToken[] = "_COMPLETION_TOKEN_" ;
 
+// One compiler process: a preprocess or compile of a single file, or the link.
+struct CompileJob
+{
+	enum Type
+	{
+		PREPROCESS,		// writes m_PreprocessedFile, and the compiler version to stdout
+		COMPILE,
+		LINK,
+		PREPROCESS_HEADER,	// as PREPROCESS, for the precompiled header
+		PRECOMPILE_HEADER,
+	};
+
+	CompileJob()
+		: m_Type( LINK )
+		, m_PID( 0 )
+		, m_StartTime( 0.0 )
+	{
+		m_PipeStdOut[0] = -1;
+		m_PipeStdOut[1] = -1;
+		m_PipeStdErr[0] = -1;
+		m_PipeStdErr[1] = -1;
+	}
+
+	Type				m_Type;
+	std::string			m_Command;
+	std::string			m_Name;		// what the status lines call the job
+	std::string			m_CompileCommand;		// run after a PREPROCESS on a cache miss
+	FileSystemUtils::Path	m_PreprocessedFile;
+	FileSystemUtils::Path	m_ObjectFile;		// the precompiled header for header jobs
+	FileSystemUtils::Path	m_CacheFile;		// where a COMPILE stores its object, if anywhere; the key file for header jobs
+	pid_t				m_PID;
+	double				m_StartTime;
+	int					m_PipeStdOut[2];
+	int					m_PipeStdErr[2];
+	std::string			m_Output;
+	std::string			m_Errors;
+};
+
+static double GetTimeSeconds()
+{
+	timeval now;
+	gettimeofday( &now, 0 );
+	return now.tv_sec + now.tv_usec * 1e-6;
+}
+
+static void ClosePipe( int* pipe_ )
+{
+	for( int i = 0; i < 2; ++i )
+	{
+		if( pipe_[i] >= 0 )
+		{
+			close( pipe_[i] );
+			pipe_[i] = -1;
+		}
+	}
+}
+
+// Reads whatever is in the pipe without blocking, so a chatty compiler never
+// stalls on a full pipe.
+static void DrainPipe( int fd_, std::string& out_ )
+{
+	if( fd_ < 0 )
+	{
+		return;
+	}
+	char buffer[4096];
+	ssize_t numread = 0;
+	while( ( numread = read( fd_, buffer, sizeof( buffer ) ) ) > 0 )
+	{
+		out_.append( buffer, numread );
+	}
+}
+
+static bool ReadFile( const FileSystemUtils::Path& path_, std::string& contents_ )
+{
+	std::ifstream file( path_.c_str(), std::ios::in | std::ios::binary );
+	if( !file )
+	{
+		return false;
+	}
+	std::ostringstream stream;
+	stream << file.rdbuf();
+	contents_ = stream.str();
+	return true;
+}
+
+// Copies through a temporary file, so readers never see a partial copy.
+static bool CopyFileAtomic( const FileSystemUtils::Path& from_, const FileSystemUtils::Path& to_ )
+{
+	std::string contents;
+	if( !ReadFile( from_, contents ) )
+	{
+		return false;
+	}
+	std::string temp = to_.m_string + ".tmp";
+	{
+		std::ofstream file( temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+		if( !file.write( contents.data(), contents.size() ) )
+		{
+			return false;
+		}
+	}
+	return rename( temp.c_str(), to_.c_str() ) == 0;
+}
+
+// Lists the files named by the line markers of preprocessed output, one per
+// line with its modification time.  Relative names are relative to baseDir_.
+static std::string GetIncludedFileTimes( const std::string& preprocessed_, const FileSystemUtils::Path& baseDir_ )
+{
+	std::set<std::string> files;
+	size_t line = 0;
+	while( line < preprocessed_.size() )
+	{
+		size_t end = preprocessed_.find( '\n', line );
+		if( end == std::string::npos )
+		{
+			end = preprocessed_.size();
+		}
+		// # <line number> "<file>" <flags>
+		if( preprocessed_.compare( line, 2, "# " ) == 0 )
+		{
+			size_t open = preprocessed_.find_first_not_of( "0123456789", line + 2 );
+			if( open > line + 2 && open < end && preprocessed_.compare( open, 2, " \"" ) == 0 )
+			{
+				// skips <built-in> and the like, and the working directory gcc
+				// names with -g, which ends in a separator
+				size_t close = preprocessed_.find( '"', open + 2 );
+				if( close < end && preprocessed_[ open + 2 ] != '<' && preprocessed_[ close - 1 ] != '/' )
+				{
+					files.insert( preprocessed_.substr( open + 2, close - open - 2 ) );
+				}
+			}
+		}
+		line = end + 1;
+	}
+
+	std::string times;
+	for( std::set<std::string>::const_iterator it = files.begin(); it != files.end(); ++it )
+	{
+		FileSystemUtils::Path file = *it;
+		if( it->size() && (*it)[0] != '/' )
+		{
+			file = baseDir_ / file;
+		}
+		char time[32];
+		snprintf( time, sizeof( time ), " %lld\n", (long long)file.GetLastWriteTime() );
+		times += *it + time;
+	}
+	return times;
+}
+
 class PlatformCompilerImplData
 {
 public:
 	PlatformCompilerImplData()
-		: m_bCompileIsComplete( false )
+		: m_bCompileIsComplete( true )
         , m_pLogger( 0 )
-        , m_ChildForCompilationPID( 0 )
+		, m_bLinkStarted( false )
+		, m_bFailed( false )
+		, m_bMoveOutput( false )
+		, m_bWaitForHeader( false )
+		, m_NumCompileJobs( 0 )
+		, m_NumCompileJobsDone( 0 )
+		, m_NumCacheHits( 0 )
+		, m_NumCacheStores( 0 )
+		, m_MaxCacheBytes( ObjectCache::DEFAULT_MAX_BYTES )
+		, m_StartTime( 0.0 )
+	{
+	}
+
+	~PlatformCompilerImplData()
 	{
-        m_PipeStdOut[0] = 0;
-        m_PipeStdOut[1] = 1;
-        m_PipeStdErr[0] = 0;
-        m_PipeStdErr[1] = 1;
+		for( size_t i = 0; i < m_RunningJobs.size(); ++i )
+		{
+			ClosePipe( m_RunningJobs[i].m_PipeStdOut );
+			ClosePipe( m_RunningJobs[i].m_PipeStdErr );
+		}
 	}
 
-	volatile bool		m_bCompileIsComplete;
-	ICompilerLogger*	m_pLogger;
-    pid_t               m_ChildForCompilationPID;
-    int                 m_PipeStdOut[2];
-    int                 m_PipeStdErr[2];
+	bool StartJob( CompileJob& job_ );
+	bool PollJob( CompileJob& job_, bool& bSucceeded_ );
+	bool FinishPreprocess( CompileJob& job_ );
+	void FinishHeader( CompileJob& job_, bool bSucceeded_ );
+	void Update( unsigned int maxJobs_ );
+
+	volatile bool			m_bCompileIsComplete;
+	ICompilerLogger*		m_pLogger;
+
+	std::deque<CompileJob>	m_PendingJobs;
+	std::vector<CompileJob>	m_RunningJobs;
+	CompileJob				m_LinkJob;
+	CompileJob				m_PrecompileJob;	// queued once a file needs compiling
+	bool					m_bLinkStarted;
+	bool					m_bFailed;
+	bool					m_bMoveOutput;		// link output is moved over the module once linked
+	bool					m_bWaitForHeader;	// compiles wait until the precompiled header is ready
+	FileSystemUtils::Path	m_LinkOutput;
+	FileSystemUtils::Path	m_ModuleName;
+	size_t					m_NumCompileJobs;
+	size_t					m_NumCompileJobsDone;
+	size_t					m_NumCacheHits;
+	size_t					m_NumCacheStores;
+	FileSystemUtils::Path	m_CacheDir;
+	uint64_t				m_MaxCacheBytes;
+	std::string				m_CacheKeyOptions;	// compiler and options the objects depend on
+	double					m_StartTime;
 };
 
+bool PlatformCompilerImplData::StartJob( CompileJob& job_ )
+{
+	if( pipe( job_.m_PipeStdOut ) != 0 || pipe( job_.m_PipeStdErr ) != 0 )
+	{
+		ClosePipe( job_.m_PipeStdOut );
+		if( m_pLogger ) { m_pLogger->LogError( "Error in Compiler::RunCompile, cannot create pipe - perhaps insufficient memory?\n"); }
+		return false;
+	}
+	// Keep other jobs from inheriting these pipes, and never block on reads.
+	for( int i = 0; i < 2; ++i )
+	{
+		fcntl( job_.m_PipeStdOut[i], F_SETFD, FD_CLOEXEC );
+		fcntl( job_.m_PipeStdErr[i], F_SETFD, FD_CLOEXEC );
+	}
+	fcntl( job_.m_PipeStdOut[0], F_SETFL, O_NONBLOCK );
+	fcntl( job_.m_PipeStdErr[0], F_SETFL, O_NONBLOCK );
+
+	std::cout << job_.m_Command << std::endl << std::endl;
+
+	pid_t retPID;
+	switch( retPID = fork() )
+	{
+		case -1: // error, no fork
+			ClosePipe( job_.m_PipeStdOut );
+			ClosePipe( job_.m_PipeStdErr );
+			if( m_pLogger ) { m_pLogger->LogError( "Error in Compiler::RunCompile, cannot fork() process - perhaps insufficient memory?\n"); }
+			return false;
+		case 0: // child process - becomes the compiler
+			//duplicate the pipe to stdout, so output goes to pipe
+			dup2( job_.m_PipeStdErr[1], STDERR_FILENO );
+			dup2( job_.m_PipeStdOut[1], STDOUT_FILENO );
+			execl("/bin/sh", "sh", "-c", job_.m_Command.c_str(), (const char*)NULL);
+			_exit( 127 );
+		default: // current process - only needs the read ends
+			close( job_.m_PipeStdOut[1] );
+			job_.m_PipeStdOut[1] = -1;
+			close( job_.m_PipeStdErr[1] );
+			job_.m_PipeStdErr[1] = -1;
+			job_.m_PID = retPID;
+			job_.m_StartTime = GetTimeSeconds();
+			return true;
+	}
+}
+
+// Returns true once the job's process has exited.
+bool PlatformCompilerImplData::PollJob( CompileJob& job_, bool& bSucceeded_ )
+{
+	DrainPipe( job_.m_PipeStdOut[0], job_.m_Output );
+	DrainPipe( job_.m_PipeStdErr[0], job_.m_Errors );
+
+	int procStatus;
+	pid_t ret = waitpid( job_.m_PID, &procStatus, WNOHANG );
+	if( ret == 0 || ( ret < 0 && errno == EINTR ) )
+	{
+		return false;
+	}
+
+	// Everything the process wrote is in the pipes by now.
+	DrainPipe( job_.m_PipeStdOut[0], job_.m_Output );
+	DrainPipe( job_.m_PipeStdErr[0], job_.m_Errors );
+	ClosePipe( job_.m_PipeStdOut );
+	ClosePipe( job_.m_PipeStdErr );
+	job_.m_PID = 0;
+
+	bSucceeded_ = ret > 0 && WIFEXITED( procStatus ) && WEXITSTATUS( procStatus ) == 0;
+	if( m_pLogger )
+	{
+		if( job_.m_Output.size() && job_.m_Type != CompileJob::PREPROCESS && job_.m_Type != CompileJob::PREPROCESS_HEADER )
+		{
+			m_pLogger->LogInfo( "%s", job_.m_Output.c_str() );
+		}
+		if( job_.m_Errors.size() )
+		{
+			m_pLogger->LogError( "%s", job_.m_Errors.c_str() );    //TODO: seperate warnings from errors.
+		}
+	}
+	return true;
+}
+
+// Takes the object from the cache, or queues the compile that fills it.
+// Returns true when the object is ready.
+bool PlatformCompilerImplData::FinishPreprocess( CompileJob& job_ )
+{
+	std::string key = job_.m_Output + "\n" + m_CacheKeyOptions + "\n";
+	std::string preprocessed;
+	const bool bRead = ReadFile( job_.m_PreprocessedFile, preprocessed );
+	job_.m_PreprocessedFile.Remove();
+	if( bRead )
+	{
+		key += preprocessed;
+		job_.m_CacheFile = job_.m_CacheFile / ( ObjectCache::HashToHex( key ) + ".o" );
+		if( job_.m_CacheFile.Exists() && CopyFileAtomic( job_.m_CacheFile, job_.m_ObjectFile ) )
+		{
+			ObjectCache::MarkUsed( job_.m_CacheFile );
+			return true;
+		}
+	}
+	else
+	{
+		job_.m_CacheFile = FileSystemUtils::Path();
+	}
+
+	CompileJob compile;
+	compile.m_Type = CompileJob::COMPILE;
+	compile.m_Command = job_.m_CompileCommand;
+	compile.m_Name = job_.m_Name;
+	compile.m_ObjectFile = job_.m_ObjectFile;
+	compile.m_CacheFile = job_.m_CacheFile;
+	m_PendingJobs.push_front( compile );
+	return false;
+}
+
+// Reuses the precompiled header when its key is unchanged, or sets up the job
+// that rebuilds it.  Compiles may start once there is no header job left.
+void PlatformCompilerImplData::FinishHeader( CompileJob& job_, bool bSucceeded_ )
+{
+	if( job_.m_Type == CompileJob::PRECOMPILE_HEADER )
+	{
+		m_bWaitForHeader = false;
+		if( m_pLogger )
+		{
+			if( bSucceeded_ )
+			{
+				m_pLogger->LogInfo( "Precompiled %s (%.2fs)\n", job_.m_Name.c_str(), GetTimeSeconds() - job_.m_StartTime );
+			}
+			else
+			{
+				m_pLogger->LogWarning( "Could not precompile %s, compiling without it\n", job_.m_Name.c_str() );
+			}
+		}
+		return;
+	}
+
+	std::string preprocessed;
+	const bool bRead = bSucceeded_ && ReadFile( job_.m_PreprocessedFile, preprocessed );
+	job_.m_PreprocessedFile.Remove();
+	// Never leave a precompiled header that does not match its key.
+	if( !bRead )
+	{
+		job_.m_ObjectFile.Remove();
+		m_bWaitForHeader = false;
+		return;
+	}
+
+	std::string key = ObjectCache::HashToHex( job_.m_Output + "\n" + m_CacheKeyOptions + "\n" + preprocessed +
+		GetIncludedFileTimes( preprocessed, job_.m_PreprocessedFile.ParentPath() ) );
+	std::string oldKey;
+	if( job_.m_ObjectFile.Exists() && ReadFile( job_.m_CacheFile, oldKey ) && oldKey == key )
+	{
+		m_bWaitForHeader = false;
+		if( m_pLogger ) { m_pLogger->LogInfo( "Unchanged, reused precompiled %s\n", job_.m_Name.c_str() ); }
+		return;
+	}
+
+	job_.m_ObjectFile.Remove();
+	std::ofstream keyFile( job_.m_CacheFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+	keyFile << key;
+
+	m_PrecompileJob.m_Type = CompileJob::PRECOMPILE_HEADER;
+	m_PrecompileJob.m_Command = job_.m_CompileCommand;
+	m_PrecompileJob.m_Name = job_.m_Name;
+}
+
+void PlatformCompilerImplData::Update( unsigned int maxJobs_ )
+{
+	if( m_bCompileIsComplete )
+	{
+		return;
+	}
+
+	// Reap finished preprocesses and compiles.
+	for( size_t i = 0; i < m_RunningJobs.size(); )
+	{
+		CompileJob& job = m_RunningJobs[i];
+		bool bSucceeded = false;
+		if( !PollJob( job, bSucceeded ) )
+		{
+			++i;
+			continue;
+		}
+		if( job.m_Type == CompileJob::PREPROCESS_HEADER || job.m_Type == CompileJob::PRECOMPILE_HEADER )
+		{
+			FinishHeader( job, bSucceeded );
+			m_RunningJobs.erase( m_RunningJobs.begin() + i );
+			continue;
+		}
+
+		const char* pStatus = bSucceeded ? "Compiled" : "FAILED to compile";
+		bool bDone = true;
+		if( bSucceeded && job.m_Type == CompileJob::PREPROCESS )
+		{
+			bDone = FinishPreprocess( job );
+			pStatus = "Unchanged, reused cached object for";
+			m_NumCacheHits += bDone ? 1 : 0;
+		}
+		else if( bSucceeded && job.m_CacheFile.m_string.size() )
+		{
+			if( CopyFileAtomic( job.m_ObjectFile, job.m_CacheFile ) )
+			{
+				++m_NumCacheStores;
+			}
+			else if( m_pLogger )
+			{
+				m_pLogger->LogWarning( "Could not store \"%s\" in the object cache\n", job.m_ObjectFile.c_str() );
+			}
+		}
+
+		if( bDone )
+		{
+			++m_NumCompileJobsDone;
+			if( m_pLogger )
+			{
+				m_pLogger->LogInfo( "[%d/%d] %s %s (%.2fs)\n", (int)m_NumCompileJobsDone, (int)m_NumCompileJobs,
+					pStatus, job.m_Name.c_str(), GetTimeSeconds() - job.m_StartTime );
+			}
+		}
+		m_bFailed = m_bFailed || !bSucceeded;
+		m_RunningJobs.erase( m_RunningJobs.begin() + i );
+	}
+
+	// Once a file fails the module cannot link, so stop starting compiles.
+	if( m_bFailed )
+	{
+		m_PendingJobs.clear();
+	}
+	// When every object comes from the cache the header is not precompiled.
+	if( m_PrecompileJob.m_Command.size() )
+	{
+		for( size_t i = 0; i < m_PendingJobs.size(); ++i )
+		{
+			if( m_PendingJobs[i].m_Type == CompileJob::COMPILE )
+			{
+				m_PendingJobs.push_front( m_PrecompileJob );
+				m_PrecompileJob = CompileJob();
+				break;
+			}
+		}
+	}
+	while( m_RunningJobs.size() < maxJobs_ )
+	{
+		std::deque<CompileJob>::iterator next = m_PendingJobs.begin();
+		while( m_bWaitForHeader && next != m_PendingJobs.end() && next->m_Type == CompileJob::COMPILE )
+		{
+			++next;
+		}
+		if( next == m_PendingJobs.end() )
+		{
+			break;
+		}
+		m_RunningJobs.push_back( *next );
+		m_PendingJobs.erase( next );
+		if( !StartJob( m_RunningJobs.back() ) )
+		{
+			m_RunningJobs.pop_back();
+			m_PendingJobs.clear();
+			m_bFailed = true;
+		}
+	}
+	if( m_RunningJobs.size() || m_PendingJobs.size() )
+	{
+		return;
+	}
+
+	if( !m_bFailed && !m_bLinkStarted )
+	{
+		m_bLinkStarted = true;
+		m_bFailed = !StartJob( m_LinkJob );
+	}
+	if( m_bFailed )
+	{
+		if( m_pLogger ) { m_pLogger->LogError( "Build of %s failed after %.2fs, not linked\n", m_LinkJob.m_Name.c_str(), GetTimeSeconds() - m_StartTime ); }
+	}
+	else
+	{
+		bool bSucceeded = false;
+		if( !PollJob( m_LinkJob, bSucceeded ) )
+		{
+			return;
+		}
+		if( bSucceeded && m_bMoveOutput && rename( m_LinkOutput.c_str(), m_ModuleName.c_str() ) != 0 )
+		{
+			if( m_pLogger ) { m_pLogger->LogError( "Error moving \"%s\" to \"%s\"\n", m_LinkOutput.c_str(), m_ModuleName.c_str() ); }
+			bSucceeded = false;
+		}
+		if( m_pLogger )
+		{
+			m_pLogger->LogInfo( "%s %s (%.2fs), build took %.2fs, %d of %d objects from cache\n", bSucceeded ? "Linked" : "FAILED to link",
+				m_LinkJob.m_Name.c_str(), GetTimeSeconds() - m_LinkJob.m_StartTime, GetTimeSeconds() - m_StartTime,
+				(int)m_NumCacheHits, (int)m_NumCompileJobs );
+		}
+	}
+
+	// Only stores grow the cache, so only they need a trim.
+	if( m_NumCacheStores )
+	{
+		const size_t numRemoved = ObjectCache::Trim( m_CacheDir, m_MaxCacheBytes );
+		if( numRemoved && m_pLogger )
+		{
+			m_pLogger->LogInfo( "Removed %d least recently used objects from the object cache\n", (int)numRemoved );
+		}
+	}
+	m_bCompileIsComplete = true;
+}
+
 Compiler::Compiler() 
 	: m_pImplData( 0 )
+	, m_bFastCompileMode( false )
+	, m_MaxCompileJobs( 0 )
+	, m_MaxObjectCacheBytes( ObjectCache::DEFAULT_MAX_BYTES )
 {
 }
 
@@ -78,45 +600,20 @@ std::string Compiler::GetObjectFileExtension() const
 	return ".o";
 }
 
+bool Compiler::GetHasObjectCache() const
+{
+	return true;
+}
+
 bool Compiler::GetIsComplete() const
 {
-    if( !m_pImplData->m_bCompileIsComplete && m_pImplData->m_ChildForCompilationPID )
-    {
-        
-        // check for whether process is closed
-        int procStatus;
-        pid_t ret = waitpid( m_pImplData->m_ChildForCompilationPID, &procStatus, WNOHANG);
-        if( ret && ( WIFEXITED(procStatus) || WIFSIGNALED(procStatus) ) )
-        {
-            m_pImplData->m_bCompileIsComplete = true;
-            m_pImplData->m_ChildForCompilationPID = 0;
- 
-            // get output and log
-            if( m_pImplData->m_pLogger )
-            {
-                const size_t buffSize = 256 * 80; //should allow for a few lines...
-                char buffer[buffSize];
-                ssize_t numread = 0;
-                while( ( numread = read( m_pImplData->m_PipeStdOut[0], buffer, buffSize-1 ) ) > 0 )
-                {
-                    buffer[numread] = 0;
-                    m_pImplData->m_pLogger->LogInfo( buffer );
-                }
-                
-                while( ( numread = read( m_pImplData->m_PipeStdErr[0], buffer, buffSize-1 ) )> 0 )
-                {
-                    buffer[numread] = 0;
-                    m_pImplData->m_pLogger->LogError( buffer );    //TODO: seperate warnings from errors.
-                }
-            }
-
-            // close the pipes as this process no longer needs them.
-            close( m_pImplData->m_PipeStdOut[0] );
-            m_pImplData->m_PipeStdOut[0] = 0;
-            close( m_pImplData->m_PipeStdErr[0] );
-            m_pImplData->m_PipeStdErr[0] = 0;
-        }
-    }
+	unsigned int maxJobs = m_MaxCompileJobs;
+	if( maxJobs == 0 )
+	{
+		long numProcessors = sysconf( _SC_NPROCESSORS_ONLN );
+		maxJobs = numProcessors > 0 ? (unsigned int)numProcessors : 1;
+	}
+	m_pImplData->Update( maxJobs );
 	return m_pImplData->m_bCompileIsComplete;
 }
 
@@ -148,58 +645,23 @@ void Compiler::RunCompile( const std::vector<FileSystemUtils::Path>&	filesToComp
 
     //NOTE: Currently doesn't check if a prior compile is ongoing or not, which could lead to memory leaks
 	m_pImplData->m_bCompileIsComplete = false;
-    
-    //create pipes
-    if ( pipe( m_pImplData->m_PipeStdOut ) != 0 )
-    {
-        if( m_pImplData->m_pLogger )
-        {
-            m_pImplData->m_pLogger->LogError( "Error in Compiler::RunCompile, cannot create pipe - perhaps insufficient memory?\n");
-        }
-        return;
-    }
-    //create pipes
-    if ( pipe( m_pImplData->m_PipeStdErr ) != 0 )
-    {
-        if( m_pImplData->m_pLogger )
-        {
-            m_pImplData->m_pLogger->LogError( "Error in Compiler::RunCompile, cannot create pipe - perhaps insufficient memory?\n");
-        }
-        return;
-    }
-    
-    pid_t retPID;
-    switch( retPID = fork() )
-    {
-        case -1: // error, no fork
-            if( m_pImplData->m_pLogger )
-            {
-                m_pImplData->m_pLogger->LogError( "Error in Compiler::RunCompile, cannot fork() process - perhaps insufficient memory?\n");
-            }
-            return;
-        case 0: // child process - carries on below.
-            break;
-        default: // current process - returns to allow application to run whilst compiling
-            close( m_pImplData->m_PipeStdOut[1] );
-            m_pImplData->m_PipeStdOut[1] = 0;
-            close( m_pImplData->m_PipeStdErr[1] );
-            m_pImplData->m_PipeStdErr[1] = 0;
-            m_pImplData->m_ChildForCompilationPID = retPID;
-           return;
-    }
-    
-    //duplicate the pipe to stdout, so output goes to pipe
-    dup2( m_pImplData->m_PipeStdErr[1], STDERR_FILENO );
-    dup2( m_pImplData->m_PipeStdOut[1], STDOUT_FILENO );
-    close( m_pImplData->m_PipeStdOut[0] );
-    m_pImplData->m_PipeStdOut[0] = 0;
-    close( m_pImplData->m_PipeStdErr[0] );
-    m_pImplData->m_PipeStdErr[0] = 0;
+	m_pImplData->m_PendingJobs.clear();
+	m_pImplData->m_LinkJob = CompileJob();
+	m_pImplData->m_PrecompileJob = CompileJob();
+	m_pImplData->m_bLinkStarted = false;
+	m_pImplData->m_bFailed = false;
+	m_pImplData->m_bWaitForHeader = false;
+	m_pImplData->m_NumCompileJobsDone = 0;
+	m_pImplData->m_NumCacheHits = 0;
+	m_pImplData->m_NumCacheStores = 0;
+	m_pImplData->m_MaxCacheBytes = m_MaxObjectCacheBytes;
+	m_pImplData->m_StartTime = GetTimeSeconds();
 
-	std::string compileString = compilerLocation + " " + "-g -fPIC -fvisibility=hidden -shared ";
+	// Options shared by compiles and the link.
+	std::string commonOptions = " -g -fPIC -fvisibility=hidden ";
 
 #ifndef __LP64__
-	compileString += "-m32 ";
+	commonOptions += "-m32 ";
 #endif
 
 	RCppOptimizationLevel optimizationLevel = GetActualOptimizationLevel( compilerOptions_.optimizationLevel );
@@ -208,14 +670,20 @@ void Compiler::RunCompile( const std::vector<FileSystemUtils::Path>&	filesToComp
 	case RCCPPOPTIMIZATIONLEVEL_DEFAULT:
 		assert(false);
 	case RCCPPOPTIMIZATIONLEVEL_DEBUG:
-		compileString += "-O0 ";
+		commonOptions += "-O0 ";
 		break;
 	case RCCPPOPTIMIZATIONLEVEL_PERF:
-		compileString += "-Os ";
+		commonOptions += "-Os ";
 		break;
 	case RCCPPOPTIMIZATIONLEVEL_NOT_SET:;
 	case RCCPPOPTIMIZATIONLEVEL_SIZE:;
 	}
+
+	if( pCompileOptions )
+	{
+		commonOptions += pCompileOptions;
+		commonOptions += " ";
+	}
     
 	// Check for intermediate directory, create it if required
 	// There are a lot more checks and robustness that could be added here
@@ -226,70 +694,159 @@ void Compiler::RunCompile( const std::vector<FileSystemUtils::Path>&	filesToComp
 		else if( m_pImplData->m_pLogger ) { m_pImplData->m_pLogger->LogError("Error creating intermediate folder \"%s\"\n", compilerOptions_.intermediatePath.c_str()); }
 	}
 
+	// Without an intermediate folder there is nowhere to put objects, so the
+	// link job compiles everything itself as one process.
+	const bool bSeparateCompile = compilerOptions_.intermediatePath.Exists();
+	std::string directoryChange;
 	FileSystemUtils::Path	output = moduleName_;
-	bool bCopyOutput = false;
-	if( compilerOptions_.intermediatePath.Exists() )
+	if( bSeparateCompile )
 	{
-		// add save object files
-        compileString = "cd \"" + compilerOptions_.intermediatePath.m_string + "\"\n" + compileString + " --save-temps ";
+		directoryChange = "cd \"" + compilerOptions_.intermediatePath.m_string + "\"\n";
 		output = compilerOptions_.intermediatePath / "a.out";
-		bCopyOutput = true;
 	}
-	
-	
+	m_pImplData->m_LinkOutput = output;
+	m_pImplData->m_CacheKeyOptions = compilerLocation + commonOptions;
+
+	FileSystemUtils::Path cacheDir = compilerOptions_.intermediatePath / "ObjectCache";
+	const bool bUseCache = bSeparateCompile && ( cacheDir.Exists() || cacheDir.CreateDir() );
+	m_pImplData->m_CacheDir = cacheDir;
+	m_pImplData->m_ModuleName = moduleName_;
+	m_pImplData->m_bMoveOutput = bSeparateCompile;
+
     // include directories
+	std::string includeOptions;
     for( size_t i = 0; i < includeDirList.size(); ++i )
 	{
-        compileString += "-I\"" + includeDirList[i].m_string + "\" ";
+        includeOptions += "-I\"" + includeDirList[i].m_string + "\" ";
     }
-    
-    // library and framework directories
-    for( size_t i = 0; i < libraryDirList.size(); ++i )
+
+	// precompiled header, included by the preprocesses as the header itself and
+	// by the compiles as the stub next to the precompiled one, which is built
+	// from the stub so that the header is not the main file
+	const FileSystemUtils::Path& header = compilerOptions_.precompiledHeader;
+	std::string preprocessHeaderOptions;
+	std::string compileHeaderOptions;
+	CompileJob headerJob;
+	if( header.m_string.size() )
 	{
-        compileString += "-L\"" + libraryDirList[i].m_string + "\" ";
-        compileString += "-F\"" + libraryDirList[i].m_string + "\" ";
+		preprocessHeaderOptions = "-include \"" + header.m_string + "\" ";
+		compileHeaderOptions = preprocessHeaderOptions;
+
+		FileSystemUtils::Path pchDir = compilerOptions_.intermediatePath / "PCH";
+		if( bSeparateCompile && ( pchDir.Exists() || pchDir.CreateDir() ) )
+		{
+			FileSystemUtils::Path stub = pchDir / header.Filename();
+			std::string stubText = "#include \"" + header.m_string + "\"\n";
+			std::string oldStubText;
+			if( !ReadFile( stub, oldStubText ) || oldStubText != stubText )
+			{
+				std::ofstream stubFile( stub.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+				stubFile << stubText;
+			}
+			compileHeaderOptions = "-include \"" + stub.m_string + "\" ";
+
+			// clang looks for <header>.pch, gcc for <header>.gch
+			const bool bClang = compilerLocation.find( "clang" ) != std::string::npos;
+			headerJob.m_Type = CompileJob::PREPROCESS_HEADER;
+			headerJob.m_Name = header.Filename().m_string;
+			headerJob.m_ObjectFile = stub.m_string + ( bClang ? ".pch" : ".gch" );
+			headerJob.m_CacheFile = stub.m_string + ".key";
+			headerJob.m_PreprocessedFile = compilerOptions_.intermediatePath / ( headerJob.m_Name + ".ii" );
+			headerJob.m_Command = directoryChange + compilerLocation + commonOptions + includeOptions +
+				"-x c++-header -E \"" + stub.m_string + "\" -o \"" + headerJob.m_PreprocessedFile.m_string + "\" && " +
+				compilerLocation + " --version";
+			const std::string temp = headerJob.m_ObjectFile.m_string + ".tmp";
+			headerJob.m_CompileCommand = directoryChange + compilerLocation + commonOptions + includeOptions +
+				"-x c++-header \"" + stub.m_string + "\" -o \"" + temp + "\" && mv \"" + temp + "\" \"" +
+				headerJob.m_ObjectFile.m_string + "\"";
+		}
+	}
+
+	// files to compile, objects to link
+	const std::string objectExtension = GetObjectFileExtension();
+	std::string linkInputs;
+    for( size_t i = 0; i < filesToCompile_.size(); ++i )
+    {
+		const FileSystemUtils::Path& file = filesToCompile_[i];
+		if( !bSeparateCompile || file.Extension() == objectExtension )
+		{
+			linkInputs += "\"" + file.m_string + "\" ";
+			continue;
+		}
+
+		FileSystemUtils::Path objectFile = compilerOptions_.intermediatePath / file.Filename();
+		objectFile.ReplaceExtension( objectExtension );
+
+		CompileJob job;
+		job.m_Type = CompileJob::COMPILE;
+		job.m_Name = file.Filename().m_string;
+		job.m_Command = directoryChange + compilerLocation + commonOptions + includeOptions + compileHeaderOptions +
+			"-c \"" + file.m_string + "\" -o \"" + objectFile.m_string + "\"";
+		job.m_ObjectFile = objectFile;
+		if( bUseCache )
+		{
+			// The compile runs only on a cache miss; it compiles the source
+			// rather than the preprocessed file so diagnostics show macros.
+			job.m_Type = CompileJob::PREPROCESS;
+			job.m_CompileCommand = job.m_Command;
+			job.m_PreprocessedFile = objectFile;
+			job.m_PreprocessedFile.ReplaceExtension( ".ii" );
+			job.m_CacheFile = cacheDir;
+			job.m_Command = directoryChange + compilerLocation + commonOptions + includeOptions + preprocessHeaderOptions +
+				"-E \"" + file.m_string + "\" -o \"" + job.m_PreprocessedFile.m_string + "\" && " +
+				compilerLocation + " --version";
+		}
+		m_pImplData->m_PendingJobs.push_back( job );
+		linkInputs += "\"" + objectFile.m_string + "\" ";
     }
-    
-	if( !bCopyOutput )
+	m_pImplData->m_NumCompileJobs = m_pImplData->m_PendingJobs.size();
+	if( headerJob.m_Type == CompileJob::PREPROCESS_HEADER && m_pImplData->m_NumCompileJobs )
 	{
-	    // output file
-	    compileString += "-o " + output.m_string + " ";
+		m_pImplData->m_PendingJobs.push_front( headerJob );
+		m_pImplData->m_bWaitForHeader = true;
 	}
 
-
-	if( pCompileOptions )
+	std::string linkString = directoryChange + compilerLocation + commonOptions + "-shared ";
+	if( !bSeparateCompile )
 	{
-		compileString += pCompileOptions;
-		compileString += " ";
+		linkString += includeOptions + compileHeaderOptions;
 	}
+
+    // library and framework directories
+    for( size_t i = 0; i < libraryDirList.size(); ++i )
+	{
+        linkString += "-L\"" + libraryDirList[i].m_string + "\" ";
+        linkString += "-F\"" + libraryDirList[i].m_string + "\" ";
+    }
+    
+    // output file
+    linkString += "-o \"" + output.m_string + "\" ";
+
 	if( pLinkOptions && strlen(pLinkOptions) )
 	{
-		compileString += "-Wl,";
-		compileString += pLinkOptions;
-		compileString += " ";
+		linkString += "-Wl,";
+		linkString += pLinkOptions;
+		linkString += " ";
 	}
-	
-    // files to compile
-    for( size_t i = 0; i < filesToCompile_.size(); ++i )
-    {
-        compileString += "\"" + filesToCompile_[i].m_string + "\" ";
-    }
+
+	linkString += linkInputs;
     
     // libraries to link
     for( size_t i = 0; i < linkLibraryList_.size(); ++i )
     {
-        compileString += " " + linkLibraryList_[i].m_string + " ";
+        linkString += " " + linkLibraryList_[i].m_string + " ";
     }
+	m_pImplData->m_LinkJob.m_Command = linkString;
+	m_pImplData->m_LinkJob.m_Name = moduleName_.Filename().m_string;
 
-	if( bCopyOutput )
+	if( m_pImplData->m_pLogger && m_pImplData->m_NumCompileJobs )
 	{
-        compileString += "\n mv \"" + output.m_string + "\" \"" + moduleName_.m_string + "\"\n";
+		m_pImplData->m_pLogger->LogInfo( "Compiling %d files%s\n", (int)m_pImplData->m_NumCompileJobs,
+			bUseCache ? ", unchanged ones from the object cache" : "" );
 	}
 
-    
-    std::cout << compileString << std::endl << std::endl;
-
-    execl("/bin/sh", "sh", "-c", compileString.c_str(), (const char*)NULL);
+	// Start the first jobs straight away rather than at the next poll.
+	GetIsComplete();
 }
 
 
@@ -20,18 +20,23 @@
 //   - We use a single intermediate directory for compiled .obj files, which means
 //     we don't support compiling multiple files with the same name. Could fix this
 //     with either mangling names to include paths,  or recreating folder structure
-//
+//   - A precompiled header is created from a stub source that only includes it, in
+//     the "PCH" folder of the intermediate folder, and recreated when the options
+//     change or the header or any header it includes with quotes is modified.
 //
 
 #ifdef _WIN32
 
 
 #include "Compiler.h"
+#include "ObjectCache.h"
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <string>
+#include <string.h>
 #include <sstream>
+#include <functional>
 #include <vector>
 #include <set>
 #include "FileSystemUtils.h"
@@ -89,6 +94,8 @@ public:
 Compiler::Compiler() 
 	: m_pImplData( 0 )
     , m_bFastCompileMode( false )
+    , m_MaxCompileJobs( 0 )
+    , m_MaxObjectCacheBytes( ObjectCache::DEFAULT_MAX_BYTES )
 {
 }
 
@@ -102,6 +109,11 @@ std::string Compiler::GetObjectFileExtension() const
 	return ".obj";
 }
 
+bool Compiler::GetHasObjectCache() const
+{
+	return false;
+}
+
 bool Compiler::GetIsComplete() const
 {
     bool bComplete = m_pImplData->m_CmdProcess.m_bIsComplete;
@@ -119,6 +131,62 @@ void Compiler::Initialise( ICompilerLogger * pLogger )
 	m_pImplData->m_CmdProcess.m_pLogger = pLogger;
 }
 
+// Newest modification time of a header and of the headers it includes with
+// quotes, looked for next to the including file and then in the include folders.
+static filetime_t GetNewestIncludeTime( const Path& header_, const std::vector<Path>& includeDirList_ )
+{
+	filetime_t newest = 0;
+	std::vector<Path> toScan( 1, header_ );
+	std::set<std::string> scanned;
+	while( toScan.size() )
+	{
+		Path file = toScan.back();
+		toScan.pop_back();
+		std::string lowerPath = file.m_string;
+		FileSystemUtils::ToLowerInPlace( lowerPath );
+		if( !scanned.insert( lowerPath ).second || !file.Exists() )
+		{
+			continue;
+		}
+		filetime_t fileTime = file.GetLastWriteTime();
+		if( fileTime > newest )
+		{
+			newest = fileTime;
+		}
+
+		FILE* pFile = FileSystemUtils::fopen( file, "r" );
+		if( !pFile )
+		{
+			continue;
+		}
+		char line[4096];
+		while( fgets( line, sizeof( line ), pFile ) )
+		{
+			const char* pos = line + strspn( line, " \t" );
+			if( *pos != '#' )
+			{
+				continue;
+			}
+			pos += 1 + strspn( pos + 1, " \t" );
+			const char* open = strncmp( pos, "include", 7 ) == 0 ? strchr( pos + 7, '"' ) : 0;
+			const char* close = open ? strchr( open + 1, '"' ) : 0;
+			if( !close )
+			{
+				continue;
+			}
+			std::string name( open + 1, close );
+			Path found = file.ParentPath() / name;
+			for( size_t i = 0; !found.Exists() && i < includeDirList_.size(); ++i )
+			{
+				found = includeDirList_[i] / name;
+			}
+			toScan.push_back( found );
+		}
+		fclose( pFile );
+	}
+	return newest;
+}
+
 void Compiler::RunCompile(	const std::vector<FileSystemUtils::Path>&	filesToCompile_,
 							const CompilerOptions&						compilerOptions_,
 							std::vector<FileSystemUtils::Path>			linkLibraryList_,
@@ -280,8 +348,67 @@ void Compiler::RunCompile(	const std::vector<FileSystemUtils::Path>&	filesToComp
 #endif
 	}
 
+	// precompiled header: /FI includes it first in every file, /Yu uses the
+	// precompiled one, which is created before the compile when out of date
+	std::string strPrecompiledHeader;
+	std::string strPrecompile;
+	const Path& header = compilerOptions_.precompiledHeader;
+	if( header.m_string.size() )
+	{
+		strPrecompiledHeader = " /FI\"" + header.m_string + "\"";
+		Path pchDir = compilerOptions_.intermediatePath / "PCH";
+		if( pchDir.Exists() || pchDir.CreateDir() )
+		{
+			Path stub = pchDir / header.Filename();
+			stub.ReplaceExtension( ".cpp" );
+			Path pch = stub;
+			pch.ReplaceExtension( ".pch" );
+			Path pchObject = stub;
+			pchObject.ReplaceExtension( ".obj" );
+			Path keyFile = stub;
+			keyFile.ReplaceExtension( ".key" );
+
+			std::stringstream key;
+			key << std::hex << std::hash<std::string>()( compilerLocation + flags + pCharTypeFlags + strIncludeFiles + header.m_string )
+				<< " " << std::dec << GetNewestIncludeTime( header, compilerOptions_.includeDirList );
+			std::string oldKey;
+			FILE* pKeyFile = FileSystemUtils::fopen( keyFile, "r" );
+			if( pKeyFile )
+			{
+				char buffer[256];
+				if( fgets( buffer, sizeof( buffer ), pKeyFile ) )
+				{
+					oldKey = buffer;
+				}
+				fclose( pKeyFile );
+			}
+
+			if( oldKey != key.str() || !pch.Exists() || !pchObject.Exists() )
+			{
+				pch.Remove();
+				FILE* pStubFile = FileSystemUtils::fopen( stub, "w" );
+				if( pStubFile )
+				{
+					fprintf( pStubFile, "#include \"%s\"\n", header.c_str() );
+					fclose( pStubFile );
+				}
+				pKeyFile = FileSystemUtils::fopen( keyFile, "w" );
+				if( pKeyFile )
+				{
+					fputs( key.str().c_str(), pKeyFile );
+					fclose( pKeyFile );
+				}
+				strPrecompile = compilerLocation + flags + pCharTypeFlags + " /D WIN32 /EHa /c /Yc\"" + header.m_string +
+					"\" /Fp\"" + pch.m_string + "\" /Fo\"" + pchObject.m_string + "\"" + strIncludeFiles + " \"" + stub.m_string + "\"\n";
+			}
+			strPrecompiledHeader = " /Yu\"" + header.m_string + "\" /Fp\"" + pch.m_string + "\"" + strPrecompiledHeader;
+			// holds the debug information and any code of the precompiled header
+			strFilesToCompile += " \"" + pchObject.m_string + "\"";
+		}
+	}
+
 	// /MP - use multiple processes to compile if possible. Only speeds up compile for multiple files and not link
-	std::string cmdToSend = compilerLocation + flags + pCharTypeFlags
+	std::string cmdToSend = strPrecompile + compilerLocation + flags + pCharTypeFlags + strPrecompiledHeader
 		+ " /MP /Fo\"" + compilerOptions_.intermediatePath.m_string + "\\\\\" "
 		+ "/D WIN32 /EHa /Fe" + moduleName_.m_string;
 	cmdToSend += " " + strIncludeFiles + " " + strFilesToCompile + strLinkLibraries + linkOptions
@@ -127,9 +127,9 @@ void FileChangeNotifier::handleFileAction( FW::WatchID watchid, const FW::String
 
 		// Check for multiple hits on the same file in close succession 
 		// (Can be caused by NTFS system making multiple changes even though only
-		//  one actual change occurred)
-		bool bIgnoreFileChange = (filePath == m_LastFileChanged) && 
-			m_fFileChangeSpamTimeRemaining > 0.0f;
+		//  one actual change occurred), unless the watcher already merged them
+		bool bIgnoreFileChange = !m_pFileWatcher->coalescesChanges() &&
+			(filePath == m_LastFileChanged) && m_fFileChangeSpamTimeRemaining > 0.0f;
 		m_LastFileChanged = filePath;
 
 		if (!bIgnoreFileChange)
@@ -71,6 +71,11 @@ public:
 
 	virtual void RemoveListener( IFileChangeListener *pListener );
 
+	virtual void SetLogger( ICompilerLogger* pLogger )
+	{
+		m_pFileWatcher->setLogger( pLogger );
+	}
+
 	// ~IFileChangeNotifier
 
 
@@ -24,6 +24,7 @@
 #include <set>
 
 struct IFileChangeListener;
+struct ICompilerLogger;
 
 struct IFileChangeNotifier
 {
@@ -41,6 +42,9 @@ struct IFileChangeNotifier
 	virtual void Watch( const char *filename, IFileChangeListener *pListener ) = 0; // can be file or directory
 
 	virtual void RemoveListener( IFileChangeListener *pListener ) = 0;
+
+	// Receives errors from watching files, reported during Update
+	virtual void SetLogger( ICompilerLogger* pLogger ) = 0;
     virtual ~IFileChangeNotifier() {}
 };
 
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "ObjectCache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace FileSystemUtils;
+
+static inline uint64_t RotL64( uint64_t x_, int r_ )
+{
+	return ( x_ << r_ ) | ( x_ >> ( 64 - r_ ) );
+}
+
+static inline uint64_t FMix64( uint64_t k_ )
+{
+	k_ ^= k_ >> 33;
+	k_ *= 0xff51afd7ed558ccdULL;
+	k_ ^= k_ >> 33;
+	k_ *= 0xc4ceb9fe1a85ec53ULL;
+	k_ ^= k_ >> 33;
+	return k_;
+}
+
+std::string ObjectCache::HashToHex( const std::string& data_ )
+{
+	const uint64_t c1 = 0x87c37b91114253d5ULL;
+	const uint64_t c2 = 0x4cf5ad432745937fULL;
+	const unsigned char* data = (const unsigned char*)data_.data();
+	const size_t len = data_.size();
+	const size_t nblocks = len / 16;
+	uint64_t h1 = 0;
+	uint64_t h2 = 0;
+
+	for( size_t i = 0; i < nblocks; ++i )
+	{
+		uint64_t k1, k2;
+		memcpy( &k1, data + i * 16, 8 );
+		memcpy( &k2, data + i * 16 + 8, 8 );
+
+		k1 *= c1; k1 = RotL64( k1, 31 ); k1 *= c2; h1 ^= k1;
+		h1 = RotL64( h1, 27 ); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+		k2 *= c2; k2 = RotL64( k2, 33 ); k2 *= c1; h2 ^= k2;
+		h2 = RotL64( h2, 31 ); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	const unsigned char* tail = data + nblocks * 16;
+	uint64_t k1 = 0;
+	uint64_t k2 = 0;
+	for( size_t i = len & 15; i > 8; --i )
+	{
+		k2 ^= uint64_t( tail[i - 1] ) << ( ( i - 9 ) * 8 );
+	}
+	if( len & 15 )
+	{
+		for( size_t i = std::min<size_t>( len & 15, 8 ); i > 0; --i )
+		{
+			k1 ^= uint64_t( tail[i - 1] ) << ( ( i - 1 ) * 8 );
+		}
+		k2 *= c2; k2 = RotL64( k2, 33 ); k2 *= c1; h2 ^= k2;
+		k1 *= c1; k1 = RotL64( k1, 31 ); k1 *= c2; h1 ^= k1;
+	}
+
+	h1 ^= len; h2 ^= len;
+	h1 += h2; h2 += h1;
+	h1 = FMix64( h1 ); h2 = FMix64( h2 );
+	h1 += h2; h2 += h1;
+
+	char hex[33];
+	sprintf( hex, "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2 );
+	return hex;
+}
+
+void ObjectCache::MarkUsed( const Path& object_ )
+{
+	object_.SetLastWriteTime( GetCurrentTime() );
+}
+
+namespace
+{
+	struct CachedFile
+	{
+		Path		path;
+		filetime_t	lastUsed;
+		uint64_t	size;
+
+		bool operator<( const CachedFile& rhs_ ) const
+		{
+			// Oldest first; names only break ties within the clock's resolution.
+			return lastUsed != rhs_.lastUsed ? lastUsed < rhs_.lastUsed : path.m_string < rhs_.path.m_string;
+		}
+	};
+}
+
+size_t ObjectCache::Trim( const Path& folder_, uint64_t maxBytes_ )
+{
+	std::vector<CachedFile> files;
+	uint64_t totalBytes = 0;
+	PathIterator pathIter( folder_ );
+	while( ++pathIter )
+	{
+		// Files still being copied in are not the cache's to remove.
+		const Path& path = pathIter.GetPath();
+		if( path.IsDirectory() || path.Extension() == ".tmp" )
+		{
+			continue;
+		}
+		CachedFile file = { path, path.GetLastWriteTime(), path.GetFileSize() };
+		files.push_back( file );
+		totalBytes += file.size;
+	}
+	if( totalBytes <= maxBytes_ )
+	{
+		return 0;
+	}
+
+	std::sort( files.begin(), files.end() );
+	size_t numRemoved = 0;
+	for( size_t i = 0; i < files.size() && totalBytes > maxBytes_; ++i )
+	{
+		if( files[i].path.Remove() )
+		{
+			totalBytes -= files[i].size;
+			++numRemoved;
+		}
+	}
+	return numRemoved;
+}
+
+size_t ObjectCache::Clear( const Path& folder_ )
+{
+	return Trim( folder_, 0 );
+}
@@ -0,0 +1,51 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#pragma once
+
+#ifndef OBJECTCACHE_INCLUDED
+#define OBJECTCACHE_INCLUDED
+
+#include <string>
+#include <stdint.h>
+
+#include "FileSystemUtils.h"
+
+// A folder of compiled objects named by the hash of everything that went into
+// them.  Objects are marked used when taken from the cache, and Trim removes
+// the least recently used ones once the folder grows over its budget.
+namespace ObjectCache
+{
+	// 256 MB, a few thousand objects of a typical runtime module.
+	const uint64_t DEFAULT_MAX_BYTES = 256 * 1024 * 1024;
+
+	// MurmurHash3 x64 128 (public domain, Austin Appleby) with seed 0, as the
+	// 32 hex digits of h1 then h2.
+	std::string HashToHex( const std::string& data_ );
+
+	// Makes the object the most recently used.
+	void MarkUsed( const FileSystemUtils::Path& object_ );
+
+	// Removes least recently used files until the folder holds at most
+	// maxBytes_.  Returns the number removed.
+	size_t Trim( const FileSystemUtils::Path& folder_, uint64_t maxBytes_ );
+
+	// Removes every file in the folder.  Returns the number removed.
+	size_t Clear( const FileSystemUtils::Path& folder_ );
+}
+
+#endif // OBJECTCACHE_INCLUDED
@@ -80,4 +80,16 @@ namespace FW
 		mImpl->update();
 	}
 
+	//--------
+	bool FileWatcher::coalescesChanges() const
+	{
+		return mImpl->coalescesChanges();
+	}
+
+	//--------
+	void FileWatcher::setLogger(ICompilerLogger* logger)
+	{
+		mImpl->setLogger(logger);
+	}
+
 }//namespace FW
@@ -35,6 +35,8 @@
 
 #include "../FileSystemUtils.h"
 
+struct ICompilerLogger;
+
 namespace FW
 {
 	/// Type for a string
@@ -94,6 +96,14 @@ namespace FW
 		/// Updates the watcher. Must be called often.
 		void update();
 
+		/// True when each change to a file is reported once, so listeners
+		/// need not filter out repeated events for the same change.
+		bool coalescesChanges() const;
+
+		/// Errors found while watching, such as the watch stopping, are reported to
+		/// the logger from update(), or to stderr without one.
+		void setLogger(ICompilerLogger* logger);
+
 	private:
 		/// The implementation
 		FileWatcherImpl* mImpl;
@@ -69,6 +69,13 @@ namespace FW
 		/// Updates the watcher. Must be called often.
 		virtual void update() = 0;
 
+		/// True when the implementation reports each change to a file once,
+		/// however many events the file system raised for it.
+		virtual bool coalescesChanges() const { return false; }
+
+		/// Implementations which can fail after addWatch report it here
+		virtual void setLogger(ICompilerLogger* logger) { (void)logger; }
+
 		/// Handles the action
 		virtual void handleAction(WatchStruct* watch, const String& filename, unsigned long action) = 0;
 
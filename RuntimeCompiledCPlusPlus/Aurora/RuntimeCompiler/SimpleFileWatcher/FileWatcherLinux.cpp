@@ -23,6 +23,7 @@
 */
 
 #include "FileWatcherLinux.h"
+#include "../ICompilerLogger.h"
 
 #if FILEWATCHER_PLATFORM == FILEWATCHER_PLATFORM_LINUX
 
@@ -31,9 +32,21 @@
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <stdint.h>
 #include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
-#define BUFF_SIZE ((sizeof(struct inotify_event)+FILENAME_MAX)*1024)
+#define BUFF_SIZE ((sizeof(struct inotify_event)+NAME_MAX+1)*64)
+
+// A file's changes have settled once it has had no events for SETTLE_TIME_MS and is not
+// open for writing, or its first event is MAX_SETTLE_TIME_MS old.
+#define SETTLE_TIME_MS 50
+#define MAX_SETTLE_TIME_MS 1000
 
 namespace FW
 {
@@ -45,22 +58,71 @@ namespace FW
 		FileWatchListener* mListener;		
 	};
 
+	static long long getTimeMS()
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+	}
+
 	//--------
 	FileWatcherLinux::FileWatcherLinux()
+		: mLogger(0)
+		, mFD(-1)
+		, mEpollFD(-1)
+		, mWakeFD(-1)
+		, mThreadStarted(false)
+		, mFirstEventTime(0)
+		, mLastEventTime(0)
+		, mOverflowed(false)
+		, mChangesReady(0)
 	{
-		mFD = inotify_init();
+		pthread_mutex_init(&mMutex, NULL);
+
+		// close on exec so compiler processes do not inherit the descriptors
+		mFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
 		if (mFD < 0)
-			fprintf (stderr, "Error: %s\n", strerror(errno));
-		
-		mTimeOut.tv_sec = 0;
-		mTimeOut.tv_usec = 0;
-	   		
-		FD_ZERO(&mDescriptorSet);
+		{
+			setError("inotify_init1", errno);
+			return;
+		}
+
+		mEpollFD = epoll_create1(EPOLL_CLOEXEC);
+		mWakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (mEpollFD < 0 || mWakeFD < 0)
+		{
+			setError(mEpollFD < 0 ? "epoll_create1" : "eventfd", errno);
+			return;
+		}
+
+		struct epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = mFD;
+		epoll_ctl(mEpollFD, EPOLL_CTL_ADD, mFD, &event);
+		event.data.fd = mWakeFD;
+		epoll_ctl(mEpollFD, EPOLL_CTL_ADD, mWakeFD, &event);
+
+		int error = pthread_create(&mThread, NULL, watchThread, this);
+		if (error)
+		{
+			setError("pthread_create", error);
+			return;
+		}
+		mThreadStarted = true;
 	}
 
 	//--------
 	FileWatcherLinux::~FileWatcherLinux()
 	{
+		if (mThreadStarted)
+		{
+			uint64_t stop = 1;
+			ssize_t written = write(mWakeFD, &stop, sizeof(stop));
+			(void)written;
+			pthread_join(mThread, NULL);
+		}
+
 		WatchMap::iterator iter = mWatches.begin();
 		WatchMap::iterator end = mWatches.end();
 		for(; iter != end; ++iter)
@@ -68,6 +130,14 @@ namespace FW
 			delete iter->second;
 		}
 		mWatches.clear();
+
+		if (mWakeFD >= 0)
+			close(mWakeFD);
+		if (mEpollFD >= 0)
+			close(mEpollFD);
+		if (mFD >= 0)
+			close(mFD);
+		pthread_mutex_destroy(&mMutex);
 	}
 
 	//--------
@@ -123,28 +193,41 @@ namespace FW
 	//--------
 	void FileWatcherLinux::update()
 	{
-		FD_SET(mFD, &mDescriptorSet);
+		if(!__atomic_load_n(&mChangesReady, __ATOMIC_ACQUIRE))
+			return;
+
+		ChangeList changes;
+		std::string error;
+		pthread_mutex_lock(&mMutex);
+		changes.swap(mReadyChanges);
+		error.swap(mError);
+		bool bOverflowed = mOverflowed;
+		mOverflowed = false;
+		__atomic_store_n(&mChangesReady, 0, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&mMutex);
 
-		int ret = select(mFD + 1, &mDescriptorSet, NULL, NULL, &mTimeOut);
-		if(ret < 0)
+		if(!error.empty())
 		{
-			perror("select");
+			if(mLogger)
+				mLogger->LogError("File watcher: %s, changes to files will not be seen\n", error.c_str());
+			else
+				fprintf(stderr, "File watcher: %s, changes to files will not be seen\n", error.c_str());
 		}
-		else if(FD_ISSET(mFD, &mDescriptorSet))
+
+		if(bOverflowed)
 		{
-			ssize_t len, i = 0;
-			//char action[81+FILENAME_MAX] = {0};
-			char buff[BUFF_SIZE] = {0};
+			if(mLogger)
+				mLogger->LogWarning("File watcher missed events, treating every watched file as modified\n");
+			rescanWatches();
+		}
 
-			len = read (mFD, buff, BUFF_SIZE);
-		   
-			while (i < len)
+		for(size_t i = 0; i < changes.size(); ++i)
+		{
+			// changes from watches removed since are dropped
+			WatchMap::iterator iter = mWatches.find(changes[i].mWatchID);
+			if(iter != mWatches.end())
 			{
-				struct inotify_event *pevent = (struct inotify_event *)&buff[i];
-
-				WatchStruct* watch = mWatches[pevent->wd];
-				handleAction(watch, pevent->name, pevent->mask);
-				i += sizeof(struct inotify_event) + pevent->len;
+				handleAction(iter->second, changes[i].mFilename, changes[i].mAction);
 			}
 		}
 	}
@@ -155,20 +238,183 @@ namespace FW
 		if(!watch->mListener)
 			return;
 
-		if( (IN_CLOSE_WRITE & action) || (IN_MODIFY & action) || ( IN_ATTRIB & action ) )
+		watch->mListener->handleFileAction(watch->mWatchID, watch->mDirName, filename, (Action)action);
+	}
+
+	//--------
+	void* FileWatcherLinux::watchThread(void* pWatcher)
+	{
+		((FileWatcherLinux*)pWatcher)->runWatchThread();
+		return NULL;
+	}
+
+	//--------
+	void FileWatcherLinux::runWatchThread()
+	{
+		char buff[BUFF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+		for(;;)
+		{
+			int timeout = -1;
+			if(!mPendingChanges.empty())
+			{
+				long long settleTime = mFirstEventTime + MAX_SETTLE_TIME_MS;
+				bool bWriting = false;
+				for(size_t i = 0; i < mPendingChanges.size(); ++i)
+				{
+					bWriting = bWriting || mPendingChanges[i].mWriting;
+				}
+				if(!bWriting && mLastEventTime + SETTLE_TIME_MS < settleTime)
+				{
+					settleTime = mLastEventTime + SETTLE_TIME_MS;
+				}
+				long long now = getTimeMS();
+				if(now >= settleTime)
+				{
+					publishChanges();
+					continue;
+				}
+				timeout = (int)(settleTime - now);
+			}
+
+			struct epoll_event events[2];
+			int numEvents = epoll_wait(mEpollFD, events, 2, timeout);
+			if(numEvents < 0)
+			{
+				if(errno == EINTR)
+					continue;
+				setError("epoll_wait", errno);
+				return;
+			}
+
+			for(int e = 0; e < numEvents; ++e)
+			{
+				if(events[e].data.fd == mWakeFD)
+				{
+					return;
+				}
+
+				ssize_t len;
+				while((len = read(mFD, buff, BUFF_SIZE)) > 0)
+				{
+					long long now = getTimeMS();
+					ssize_t i = 0;
+					while (i < len)
+					{
+						struct inotify_event *pevent = (struct inotify_event *)&buff[i];
+						if(pevent->mask & IN_Q_OVERFLOW)
+						{
+							// the events lost could be for any file, update() rescans
+							pthread_mutex_lock(&mMutex);
+							mOverflowed = true;
+							__atomic_store_n(&mChangesReady, 1, __ATOMIC_RELEASE);
+							pthread_mutex_unlock(&mMutex);
+						}
+						else if(pevent->len)
+						{
+							addEvent(pevent->wd, pevent->name, pevent->mask, now);
+						}
+						i += sizeof(struct inotify_event) + pevent->len;
+					}
+				}
+			}
+		}
+	}
+
+	//--------
+	void FileWatcherLinux::addEvent(int wd, const char* filename, unsigned int mask, long long time)
+	{
+		if(mPendingChanges.empty())
 		{
-			watch->mListener->handleFileAction(watch->mWatchID, watch->mDirName, filename,
-								Actions::Modified);
+			mFirstEventTime = time;
 		}
-		if( ( IN_MOVED_TO & action ) || ( IN_CREATE & action ) )
+		mLastEventTime = time;
+
+		std::pair<std::map<std::pair<int, std::string>, size_t>::iterator, bool> inserted =
+			mPendingIndex.insert(std::make_pair(std::make_pair(wd, std::string(filename)), mPendingChanges.size()));
+		if(inserted.second)
+		{
+			FileChange change;
+			change.mWatchID = wd;
+			change.mFilename = filename;
+			change.mFirstMask = mask;
+			change.mWriting = false;
+			change.mAction = Actions::Modified;
+			mPendingChanges.push_back(change);
+		}
+
+		// writes, including the truncate of an existing file, wait for the file to be closed
+		FileChange& change = mPendingChanges[inserted.first->second];
+		change.mLastMask = mask;
+		if(!(mask & IN_ISDIR) && (mask & (IN_CREATE | IN_MODIFY)))
 		{
-			watch->mListener->handleFileAction(watch->mWatchID, watch->mDirName, filename,
-								Actions::Add);
+			change.mWriting = true;
 		}
-		if(( IN_MOVED_FROM & action ) || ( IN_DELETE & action ) )
+		if(mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE))
 		{
-			watch->mListener->handleFileAction(watch->mWatchID, watch->mDirName, filename,
-								Actions::Delete);
+			change.mWriting = false;
+		}
+	}
+
+	//--------
+	void FileWatcherLinux::publishChanges()
+	{
+		// A file deleted or renamed away and then written again is modified, one
+		// renamed into place is added as inotify does not say what it replaced, and
+		// temporary files which came and went are left out.
+		ChangeList changes;
+		for(size_t i = 0; i < mPendingChanges.size(); ++i)
+		{
+			FileChange& change = mPendingChanges[i];
+			bool bExistedBefore = !(change.mFirstMask & (IN_CREATE | IN_MOVED_TO));
+			bool bExistsAfter = !(change.mLastMask & (IN_DELETE | IN_MOVED_FROM));
+			if(!bExistedBefore && !bExistsAfter)
+				continue;
+
+			change.mAction = bExistedBefore ? (bExistsAfter ? Actions::Modified : Actions::Delete) : Actions::Add;
+			changes.push_back(change);
+		}
+		mPendingChanges.clear();
+		mPendingIndex.clear();
+
+		if(changes.empty())
+			return;
+
+		pthread_mutex_lock(&mMutex);
+		mReadyChanges.insert(mReadyChanges.end(), changes.begin(), changes.end());
+		__atomic_store_n(&mChangesReady, 1, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&mMutex);
+	}
+
+	//--------
+	void FileWatcherLinux::setError(const char* operation, int error)
+	{
+		std::string message = std::string(operation) + " failed: " + strerror(error);
+		pthread_mutex_lock(&mMutex);
+		mError = message;
+		__atomic_store_n(&mChangesReady, 1, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&mMutex);
+	}
+
+	//--------
+	void FileWatcherLinux::rescanWatches()
+	{
+		// Files deleted while events were lost are reported modified too, as there
+		// is no record of what was there.
+		WatchMap::iterator iter = mWatches.begin();
+		WatchMap::iterator end = mWatches.end();
+		for(; iter != end; ++iter)
+		{
+			DIR* dir = opendir(iter->second->mDirName.c_str());
+			if(!dir)
+				continue;
+			while(struct dirent* entry = readdir(dir))
+			{
+				if(entry->d_type == DT_DIR)
+					continue;
+				handleAction(iter->second, entry->d_name, Actions::Modified);
+			}
+			closedir(dir);
 		}
 	}
 
@@ -33,11 +33,20 @@
 #if FILEWATCHER_PLATFORM == FILEWATCHER_PLATFORM_LINUX
 
 #include <map>
+#include <vector>
+#include <string>
 #include <sys/types.h>
+#include <pthread.h>
 
 namespace FW
 {
 	/// Implementation for Linux based on inotify.
+	/// A thread waits on the inotify descriptor with epoll and merges the events for each
+	/// file until its changes settle, so an editor's save arrives as one change however
+	/// it was written. update() only hands over the changes the thread has finished
+	/// merging, and does no system calls when there are none. Should inotify drop events
+	/// every file in every watched directory is reported modified, and errors which stop
+	/// the thread go to the logger.
 	/// @class FileWatcherLinux
 	class FileWatcherLinux : public FileWatcherImpl
 	{
@@ -67,20 +76,63 @@ namespace FW
 		/// Updates the watcher. Must be called often.
 		void update();
 
-		/// Handles the action
+		/// Each file changes once per settled set of events
+		bool coalescesChanges() const { return true; }
+
+		/// Handles the action, one of Actions merged from the inotify events for the file
 		void handleAction(WatchStruct* watch, const String& filename, unsigned long action);
 
+		/// Errors are reported from update(), so on the calling thread
+		void setLogger(ICompilerLogger* logger) { mLogger = logger; }
+
 	private:
-		/// Map of WatchID to WatchStruct pointers
+		/// A file's events since its changes last settled
+		struct FileChange
+		{
+			int mWatchID;
+			std::string mFilename;
+			unsigned int mFirstMask;
+			unsigned int mLastMask;
+			bool mWriting;			///< modified and not yet closed
+			Action mAction;			///< what the events add up to, once settled
+		};
+		typedef std::vector<FileChange> ChangeList;
+
+		static void* watchThread(void* pWatcher);
+		void runWatchThread();
+		void addEvent(int wd, const char* filename, unsigned int mask, long long time);
+		void publishChanges();
+		void setError(const char* operation, int error);
+		void rescanWatches();
+
+		/// Map of WatchID to WatchStruct pointers, used on the calling thread only
 		WatchMap mWatches;
-		/// The last watchid
-		WatchID mLastWatchID;
+		ICompilerLogger* mLogger;
 		/// inotify file descriptor
 		int mFD;
-		/// time out data
-		struct timeval mTimeOut;
-		/// File descriptor set
-		fd_set mDescriptorSet;
+		/// epoll descriptor waiting on mFD and mWakeFD
+		int mEpollFD;
+		/// eventfd written to stop the thread
+		int mWakeFD;
+		pthread_t mThread;
+		bool mThreadStarted;
+
+		/// Used on the watch thread only
+		ChangeList mPendingChanges;
+		std::map<std::pair<int, std::string>, size_t> mPendingIndex;
+		long long mFirstEventTime;
+		long long mLastEventTime;
+
+		/// Merged changes waiting for update(), guarded by mMutex
+		pthread_mutex_t mMutex;
+		ChangeList mReadyChanges;
+		/// inotify dropped events, so any file may have changed
+		bool mOverflowed;
+		/// What failed, empty when nothing has
+		std::string mError;
+		/// Set while there are ready changes, an overflow or an error to hand over, read
+		/// without mMutex
+		int mChangesReady;
 
 	};//end FileWatcherLinux
 
@@ -0,0 +1,135 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "FileDependencyGraph.h"
+
+#include <algorithm>
+
+FileDependencyGraph::TFileId FileDependencyGraph::Find( const std::string& file_ ) const
+{
+	std::unordered_map<std::string, TFileId>::const_iterator it = m_FileIds.find( file_ );
+	if( it == m_FileIds.end() )
+	{
+		return INVALID_FILE_ID;
+	}
+	return it->second;
+}
+
+FileDependencyGraph::TFileId FileDependencyGraph::Intern( const FileSystemUtils::Path& file_ )
+{
+	std::pair<std::unordered_map<std::string, TFileId>::iterator, bool> inserted =
+		m_FileIds.insert( std::make_pair( file_.m_string, (TFileId)m_Files.size() ) );
+	if( inserted.second )
+	{
+		FileNode node;
+		node.path				= file_;
+		node.bIsHeader			= file_.Extension() == ".h"; //TODO: change to check for .cpp and .c as could have .inc files etc.?
+		node.bTracked			= false;
+		node.visitGeneration	= 0;
+		m_Files.push_back( node );
+	}
+	return inserted.first->second;
+}
+
+bool FileDependencyGraph::AddTrackedFile( TFileId id_ )
+{
+	if( m_Files[ id_ ].bTracked )
+	{
+		return false;
+	}
+	m_Files[ id_ ].bTracked = true;
+	m_TrackedFiles.push_back( id_ );
+	return true;
+}
+
+void FileDependencyGraph::RemoveTrackedFile( TFileId id_ )
+{
+	if( m_Files[ id_ ].bTracked )
+	{
+		m_Files[ id_ ].bTracked = false;
+		m_TrackedFiles.erase( std::find( m_TrackedFiles.begin(), m_TrackedFiles.end(), id_ ) );
+	}
+}
+
+void FileDependencyGraph::GetTrackedPaths( std::vector<FileSystemUtils::Path>& paths_ ) const
+{
+	paths_.reserve( paths_.size() + m_TrackedFiles.size() );
+	for( size_t i = 0; i < m_TrackedFiles.size(); ++i )
+	{
+		paths_.push_back( m_Files[ m_TrackedFiles[ i ] ].path );
+	}
+}
+
+void FileDependencyGraph::AddInclude( TFileId include_, TFileId dependent_ )
+{
+	m_Files[ include_ ].dependents.insert( dependent_ );
+	m_Files[ dependent_ ].includes.insert( include_ );
+}
+
+void FileDependencyGraph::AddSourceDependency( TFileId source_, TFileId dependency_ )
+{
+	m_Files[ source_ ].sourceDependencies.insert( dependency_ );
+	m_Files[ dependency_ ].sourceDependents.insert( source_ );
+}
+
+void FileDependencyGraph::RemoveDependencies( TFileId source_ )
+{
+	FileNode& source = m_Files[ source_ ];
+	for( std::set<TFileId>::iterator it = source.includes.begin(); it != source.includes.end(); ++it )
+	{
+		m_Files[ *it ].dependents.erase( source_ );
+	}
+	source.includes.clear();
+
+	for( std::set<TFileId>::iterator it = source.sourceDependencies.begin(); it != source.sourceDependencies.end(); ++it )
+	{
+		m_Files[ *it ].sourceDependents.erase( source_ );
+	}
+	source.sourceDependencies.clear();
+}
+
+void FileDependencyGraph::GetDependentSources( TFileId include_, std::vector<TFileId>& sources_ )
+{
+	// generations mark visited files without clearing a flag on every file per query
+	++m_VisitGeneration;
+	m_Files[ include_ ].visitGeneration = m_VisitGeneration;
+	m_VisitStack.clear();
+	m_VisitStack.push_back( include_ );
+	while( !m_VisitStack.empty() )
+	{
+		TFileId current = m_VisitStack.back();
+		m_VisitStack.pop_back();
+		const std::set<TFileId>& dependents = m_Files[ current ].dependents;
+		for( std::set<TFileId>::const_iterator it = dependents.begin(); it != dependents.end(); ++it )
+		{
+			FileNode& dependent = m_Files[ *it ];
+			if( dependent.visitGeneration == m_VisitGeneration )
+			{
+				continue;
+			}
+			dependent.visitGeneration = m_VisitGeneration;
+			if( dependent.bIsHeader )
+			{
+				m_VisitStack.push_back( *it );
+			}
+			else
+			{
+				sources_.push_back( *it );
+			}
+		}
+	}
+}
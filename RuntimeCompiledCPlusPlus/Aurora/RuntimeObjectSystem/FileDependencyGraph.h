@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#pragma once
+
+#ifndef FILEDEPENDENCYGRAPH_INCLUDED
+#define FILEDEPENDENCYGRAPH_INCLUDED
+
+#include <vector>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "../RuntimeCompiler/FileSystemUtils.h"
+
+// class FileDependencyGraph
+// The runtime files of a project and what depends on them, so that a change to a file
+// can be turned into the files to compile without searching every tracked file.
+// Paths are interned once into ids, found by hash, and every edge is stored in both
+// directions so that the tracking of a source file can be replaced in time proportional
+// to the number of its own dependencies.
+class FileDependencyGraph
+{
+public:
+	typedef unsigned int TFileId;
+	enum { INVALID_FILE_ID = 0xFFFFFFFF };
+
+	FileDependencyGraph()
+		: m_VisitGeneration( 0 )
+	{
+	}
+
+	// Find returns INVALID_FILE_ID for paths never interned, Intern adds them.
+	// Paths are compared exactly, so should already be clean and in OS canonical case.
+	TFileId						Find( const std::string& file_ ) const;
+	// Interning may move the paths, so references from GetPath do not outlive it.
+	TFileId						Intern( const FileSystemUtils::Path& file_ );
+	const FileSystemUtils::Path& GetPath( TFileId id_ ) const
+	{
+		return m_Files[ id_ ].path;
+	}
+	bool						IsHeader( TFileId id_ ) const
+	{
+		return m_Files[ id_ ].bIsHeader;
+	}
+
+	// Tracked files are those watched for changes, kept in the order they were added.
+	// AddTrackedFile returns false if the file was already tracked.
+	bool						AddTrackedFile( TFileId id_ );
+	void						RemoveTrackedFile( TFileId id_ );
+	bool						IsTracked( TFileId id_ ) const
+	{
+		return m_Files[ id_ ].bTracked;
+	}
+	const std::vector<TFileId>&	GetTrackedFiles() const
+	{
+		return m_TrackedFiles;
+	}
+	void						GetTrackedPaths( std::vector<FileSystemUtils::Path>& paths_ ) const;
+
+	// dependent_ must be compiled when include_ changes.
+	void						AddInclude( TFileId include_, TFileId dependent_ );
+	// dependency_ is compiled along with source_, and source_ when dependency_ changes.
+	void						AddSourceDependency( TFileId source_, TFileId dependency_ );
+	// Removes the includes and source dependencies added for source_, but not those
+	// of other files on it.
+	void						RemoveDependencies( TFileId source_ );
+
+	bool						HasDependents( TFileId include_ ) const
+	{
+		return !m_Files[ include_ ].dependents.empty();
+	}
+	const std::set<TFileId>&	GetSourceDependencies( TFileId source_ ) const
+	{
+		return m_Files[ source_ ].sourceDependencies;
+	}
+	const std::set<TFileId>&	GetSourceDependents( TFileId dependency_ ) const
+	{
+		return m_Files[ dependency_ ].sourceDependents;
+	}
+
+	// Appends the files which are not headers that depend on include_, following
+	// dependents which are themselves headers. Each file is appended once.
+	void						GetDependentSources( TFileId include_, std::vector<TFileId>& sources_ );
+
+private:
+	struct FileNode
+	{
+		FileSystemUtils::Path	path;
+		bool					bIsHeader;
+		bool					bTracked;
+		unsigned int			visitGeneration;
+		std::set<TFileId>		includes;				// files which when changed compile this
+		std::set<TFileId>		dependents;				// files compiled when this changes
+		std::set<TFileId>		sourceDependencies;
+		std::set<TFileId>		sourceDependents;
+	};
+
+	std::vector<FileNode>						m_Files;
+	std::unordered_map<std::string, TFileId>	m_FileIds;
+	std::vector<TFileId>						m_TrackedFiles;
+	unsigned int								m_VisitGeneration;
+	std::vector<TFileId>						m_VisitStack;
+};
+
+#endif // FILEDEPENDENCYGRAPH_INCLUDED
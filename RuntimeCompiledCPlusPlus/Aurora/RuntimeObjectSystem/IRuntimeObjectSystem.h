@@ -109,12 +109,19 @@ struct IRuntimeObjectSystem : public ITestBuildNotifier
 	// defaults to current directory plus /Runtime
     virtual void SetIntermediateDir(            const char* path_,      unsigned short projectId_ = 0 ) = 0;
 
+	// Header included before anything else in every file of the project, and
+	// precompiled once per intermediate folder; pass a full path, or "" for none.
+    virtual void SetPrecompiledHeader(          const char* header_,    unsigned short projectId_ = 0 ) = 0;
+
 	virtual void SetAutoCompile( bool autoCompile ) = 0;
 	virtual bool GetAutoCompile() const = 0;
 
     // see Compiler::SetFastCompileMode
     virtual void SetFastCompileMode( bool bFast ) = 0;
 
+    // see Compiler::SetMaxCompileJobs
+    virtual void SetMaxCompileJobs( unsigned int maxJobs ) = 0;
+
     // clean up temporary object files
     virtual void CleanObjectFiles() const = 0;
 
@@ -90,6 +90,7 @@ bool RuntimeObjectSystem::Initialise( ICompilerLogger * pLogger, SystemTable* pS
 	m_pSystemTable = pSystemTable;
 
 	m_pBuildTool->Initialise(m_pCompilerLogger);
+	m_pFileChangeNotifier->SetLogger(m_pCompilerLogger);
 
 	// We start by using the code in the current module
 	IPerModuleInterface* pPerModuleInterface = PerModuleInterface::GetInstance();
@@ -123,9 +124,10 @@ void RuntimeObjectSystem::OnFileChange(const IAUDynArray<const char*>& filelist)
 		return;
 	}
 
+    std::vector<FileDependencyGraph::TFileId> dependentSources;
     for( unsigned short proj = 0; proj < m_Projects.size(); ++proj )
     {
-
+        FileDependencyGraph& runtimeFiles = m_Projects[ proj ].m_RuntimeFiles;
         std::vector<BuildTool::FileToBuild>* pBuildFileList = &m_Projects[ proj ].m_BuildFileList;
         if( m_bCompiling )
         {
@@ -137,42 +139,33 @@ void RuntimeObjectSystem::OnFileChange(const IAUDynArray<const char*>& filelist)
         for( size_t i = 0; i < filelist.Size(); ++i )
         {
             // check this file is in our project list
-            TFileList::iterator it = std::find( m_Projects[ proj ].m_RuntimeFileList.begin( ), m_Projects[ proj ].m_RuntimeFileList.end( ), filelist[i] );
-            if( it == m_Projects[ proj ].m_RuntimeFileList.end() )
+            FileDependencyGraph::TFileId fileId = runtimeFiles.Find( filelist[ i ] );
+            if( fileId == FileDependencyGraph::INVALID_FILE_ID || !runtimeFiles.IsTracked( fileId ) )
             {
                 continue;
             }
 
             if (m_pCompilerLogger) { m_pCompilerLogger->LogInfo( "    File %s\n", filelist[ i ] ); }
-            BuildTool::FileToBuild fileToBuild( filelist[ i ] );
 
-            bool bFindIncludeDependencies = true;  // if this is a header or a source dependency need to find include dependencies
-            bool bForceIncludeDependencies = true;
-            if( fileToBuild.filePath.Extension() != ".h" ) //TODO: change to check for .cpp and .c as could have .inc files etc.?
+            if( !runtimeFiles.IsHeader( fileId ) )
             {
-                bFindIncludeDependencies = false;
-                pBuildFileList->push_back( fileToBuild );
+                pBuildFileList->push_back( BuildTool::FileToBuild( runtimeFiles.GetPath( fileId ) ) );
 
-                // file may be a source dependency, check
-                TFileToFilesIterator itrCurr = m_Projects[ proj ].m_RuntimeSourceDependencyMap.begin( );
-                while( itrCurr != m_Projects[ proj ].m_RuntimeSourceDependencyMap.end( ) )
+                // file may be a source dependency of other files
+                const std::set<FileDependencyGraph::TFileId>& sourceDependents = runtimeFiles.GetSourceDependents( fileId );
+                for( std::set<FileDependencyGraph::TFileId>::const_iterator it = sourceDependents.begin(); it != sourceDependents.end(); ++it )
                 {
-                    if( itrCurr->second == fileToBuild.filePath )
-                    {
-                        BuildTool::FileToBuild fileToBuild2( itrCurr->first );
-                        pBuildFileList->push_back( fileToBuild2 );
-                    }
-                    ++itrCurr;
+                    pBuildFileList->push_back( BuildTool::FileToBuild( runtimeFiles.GetPath( *it ) ) );
                 }
-           }
-
-            if( bFindIncludeDependencies )
+            }
+            else
             {
-                TFileToFilesEqualRange range = m_Projects[ proj ].m_RuntimeIncludeMap.equal_range( fileToBuild.filePath );
-                for( TFileToFilesIterator it2 = range.first; it2 != range.second; ++it2 )
+                // sources including a header are force compiled
+                dependentSources.clear();
+                runtimeFiles.GetDependentSources( fileId, dependentSources );
+                for( size_t dep = 0; dep < dependentSources.size(); ++dep )
                 {
-                    BuildTool::FileToBuild fileToBuildFromIncludes( ( *it2 ).second, bForceIncludeDependencies );
-                    pBuildFileList->push_back( fileToBuildFromIncludes );
+                    pBuildFileList->push_back( BuildTool::FileToBuild( runtimeFiles.GetPath( dependentSources[ dep ] ), true ) );
                 }
             }
         }
@@ -205,11 +198,12 @@ void RuntimeObjectSystem::CompileAllInProject( bool bForceRecompile, unsigned sh
 	}
 
 	// add all files except headers
-    for( size_t i = 0; i < m_Projects[ projectId_ ].m_RuntimeFileList.size( ); ++i )
+    const std::vector<FileDependencyGraph::TFileId>& trackedFiles = project.m_RuntimeFiles.GetTrackedFiles();
+    for( size_t i = 0; i < trackedFiles.size( ); ++i )
 	{
-        BuildTool::FileToBuild fileToBuild( project.m_RuntimeFileList[ i ], true ); //force re-compile on compile all
-		if( fileToBuild.filePath.Extension() != ".h") //TODO: change to check for .cpp and .c as could have .inc files etc.?
+		if( !project.m_RuntimeFiles.IsHeader( trackedFiles[ i ] ) )
 		{
+            BuildTool::FileToBuild fileToBuild( project.m_RuntimeFiles.GetPath( trackedFiles[ i ] ), true ); //force re-compile on compile all
             project.m_BuildFileList.push_back( fileToBuild );
 		}
 	}
@@ -247,10 +241,8 @@ void RuntimeObjectSystem::AddToRuntimeFileList( const char* filename, unsigned s
 void RuntimeObjectSystem::AddToRuntimeFileListImp( const FileSystemUtils::Path& filename, unsigned short projectId_ )
 {
     ProjectSettings& project = GetProject( projectId_ );
-    TFileList::iterator it = std::find( project.m_RuntimeFileList.begin( ), project.m_RuntimeFileList.end( ), filename );
-    if( it == project.m_RuntimeFileList.end( ) )
+    if( project.m_RuntimeFiles.AddTrackedFile( project.m_RuntimeFiles.Intern( filename ) ) )
 	{
-        project.m_RuntimeFileList.push_back( filename );
         m_pFileChangeNotifier->Watch( filename.c_str(), this );
 	}
 }
@@ -266,10 +258,10 @@ void RuntimeObjectSystem::RemoveFromRuntimeFileList( const char* filename, unsig
 void RuntimeObjectSystem::RemoveFromRuntimeFileListImp( const FileSystemUtils::Path& filename, unsigned short projectId_ )
 {
     ProjectSettings& project = GetProject( projectId_ );
-    TFileList::iterator it = std::find( project.m_RuntimeFileList.begin( ), project.m_RuntimeFileList.end( ), filename );
-    if( it != project.m_RuntimeFileList.end( ) )
+    FileDependencyGraph::TFileId fileId = project.m_RuntimeFiles.Find( filename.m_string );
+    if( fileId != FileDependencyGraph::INVALID_FILE_ID )
 	{
-        project.m_RuntimeFileList.erase( it );
+        project.m_RuntimeFiles.RemoveTrackedFile( fileId );
 	}
 }
 
@@ -352,14 +344,19 @@ void RuntimeObjectSystem::StartRecompile()
 	}
 
     //Add dependency source files
+    const FileDependencyGraph& runtimeFiles = m_Projects[ project ].m_RuntimeFiles;
     size_t buildListSize = ourBuildFileList.size(); // we will add to the build list, so get the size before the loop
 	for( size_t i = 0; i < buildListSize; ++ i )
 	{
-
-        TFileToFilesEqualRange range = m_Projects[ project ].m_RuntimeSourceDependencyMap.equal_range( ourBuildFileList[ i ].filePath );
-		for(TFileToFilesIterator it=range.first; it!=range.second; ++it)
+        FileDependencyGraph::TFileId fileId = runtimeFiles.Find( ourBuildFileList[ i ].filePath.m_string );
+        if( fileId == FileDependencyGraph::INVALID_FILE_ID )
+        {
+            continue;
+        }
+        const std::set<FileDependencyGraph::TFileId>& sourceDependencies = runtimeFiles.GetSourceDependencies( fileId );
+		for( std::set<FileDependencyGraph::TFileId>::const_iterator it = sourceDependencies.begin(); it != sourceDependencies.end(); ++it )
 		{
-		    BuildTool::FileToBuild reqFile( it->second, false );	//don't force compile of these
+		    BuildTool::FileToBuild reqFile( runtimeFiles.GetPath( *it ), false );	//don't force compile of these
 			ourBuildFileList.push_back( reqFile );
 		}
 	}
@@ -467,9 +464,6 @@ void RuntimeObjectSystem::SetupObjectConstructors(IPerModuleInterface* pPerModul
 void RuntimeObjectSystem::SetupRuntimeFileTracking(const IAUDynArray<IObjectConstructor*>& constructors_)
 {
 #ifndef RCCPPOFF
-	// for optimization purposes we skip some actions when running for the first time (i.e. no previous constructors)
-	static bool bFirstTime = true;
-
 	for (size_t i = 0, iMax = constructors_.Size(); i < iMax; ++i)
 	{
 		const char* pFilename = constructors_[i]->GetFileName(); // GetFileName returns full path including GetCompiledPath()
@@ -493,31 +487,13 @@ void RuntimeObjectSystem::SetupRuntimeFileTracking(const IAUDynArray<IObjectCons
         unsigned short projectId = constructors_[ i ]->GetProjectId();
         ProjectSettings& project = GetProject( projectId );
         AddToRuntimeFileListImp( filePath, projectId );
+        FileDependencyGraph::TFileId fileId = project.m_RuntimeFiles.Find( filePath.m_string );
 
-		if( !bFirstTime )
-		{
- 			//remove old include file mappings for this file
-            TFileToFilesIterator itrCurr = project.m_RuntimeIncludeMap.begin( );
-            while( itrCurr != project.m_RuntimeIncludeMap.end( ) )
-			{
-				if( itrCurr->second == filePath )
-				{
-                    TFileToFilesIterator itrErase = itrCurr;
-                    ++itrCurr;
-                    project.m_RuntimeIncludeMap.erase( itrErase );
-				}
-				else
-				{
-					++itrCurr;
-				}
-			}
+        //remove old include file mappings and source dependencies for this file
+        project.m_RuntimeFiles.RemoveDependencies( fileId );
 
-            //remove previous link libraries for this file
-            project.m_RuntimeLinkLibraryMap.erase( filePath );
-
-            //remove previous source dependencies
-            project.m_RuntimeSourceDependencyMap.erase( filePath );
-		}
+        //remove previous link libraries for this file
+        project.m_RuntimeLinkLibraryMap.erase( filePath );
 
         //we need the compile path for some platforms where the __FILE__ path is relative to the compile path
 		FileSystemUtils::Path compileDir = constructors_[i]->GetCompiledPath();
@@ -533,11 +509,8 @@ void RuntimeObjectSystem::SetupRuntimeFileTracking(const IAUDynArray<IObjectCons
 			{
                 FileSystemUtils::Path pathInc = compileDir / pIncludeFile;
                 pathInc = FindFile( pathInc.GetCleanPath() );
-				TFileToFilePair includePathPair;
-				includePathPair.first = pathInc;
-				includePathPair.second = filePath;
                 AddToRuntimeFileListImp( pathInc, projectId );
-                project.m_RuntimeIncludeMap.insert( includePathPair );
+                project.m_RuntimeFiles.AddInclude( project.m_RuntimeFiles.Find( pathInc.m_string ), fileId );
 			}
 
 			//add link library file mappings
@@ -584,32 +557,25 @@ void RuntimeObjectSystem::SetupRuntimeFileTracking(const IAUDynArray<IObjectCons
 					pathSrc.ReplaceExtension( sourceDependency.extension );
 				}
 				pathSrc = FindFile( pathSrc.GetCleanPath() );
-				TFileToFilePair sourcePathPair;
-				sourcePathPair.first = filePath;
-				sourcePathPair.second = pathSrc;
-                project.m_RuntimeSourceDependencyMap.insert( sourcePathPair );
+                FileDependencyGraph::TFileId sourceId = project.m_RuntimeFiles.Intern( pathSrc );
+                project.m_RuntimeFiles.AddSourceDependency( fileId, sourceId );
                 
                 // if the include file with a source dependancy is logged as an runtime include, then we mark this .cpp as compile dependencies on change
 				for( int inc=0; inc<2; ++inc )
 				{
-					TFileToFilesEqualRange range = project.m_RuntimeIncludeMap.equal_range( pathInc[inc] );
-					if( range.first != range.second )
+					FileDependencyGraph::TFileId includeId = project.m_RuntimeFiles.Find( pathInc[inc].m_string );
+					if( includeId != FileDependencyGraph::INVALID_FILE_ID && project.m_RuntimeFiles.HasDependents( includeId ) )
 					{
 						// add source file to runtime file list
 						AddToRuntimeFileListImp( pathSrc, projectId );
 
 						// also add this as a source dependency, so it gets force compiled on change of header (and not just compiled)
-						TFileToFilePair includePathPair;
-						includePathPair.first = pathInc[inc];
-						includePathPair.second = pathSrc;
-						project.m_RuntimeIncludeMap.insert( includePathPair );
+						project.m_RuntimeFiles.AddInclude( includeId, sourceId );
 					}
 				}
 			}
 		}
 	}
-
-    bFirstTime = false;
 #endif
 }
 
@@ -664,6 +630,11 @@ void RuntimeObjectSystem::SetIntermediateDir(            const char* path_,
 	GetProject( projectId_ ).m_CompilerOptions.baseIntermediatePath = path_;
 }
 
+void RuntimeObjectSystem::SetPrecompiledHeader(          const char* header_,    unsigned short projectId_ )
+{
+	GetProject( projectId_ ).m_CompilerOptions.precompiledHeader = header_;
+}
+
 void RuntimeObjectSystem::CleanObjectFiles() const
 {
     if( m_pBuildTool )
@@ -991,7 +962,7 @@ int RuntimeObjectSystem::TestBuildAllRuntimeSourceFiles(  ITestBuildNotifier* ca
     size_t numFilesToBuild = 0;
     for( unsigned short proj = 0; proj < m_Projects.size( ); ++proj )
     {
-        numFilesToBuild += m_Projects[ proj ].m_RuntimeFileList.size( );
+        numFilesToBuild += m_Projects[ proj ].m_RuntimeFiles.GetTrackedFiles().size( );
     }
 
     if( 0 == numFilesToBuild )
@@ -1001,7 +972,8 @@ int RuntimeObjectSystem::TestBuildAllRuntimeSourceFiles(  ITestBuildNotifier* ca
     
     for( unsigned short proj = 0; proj < m_Projects.size(); ++proj )
     {
-        TFileList filesToTest = m_Projects[ proj ].m_RuntimeFileList; // m_RuntimeFileList could change if file content changes (new includes or source dependencies) so make copy to ensure iterators valid.
+        TFileList filesToTest; // tracked files could change if file content changes (new includes or source dependencies) so make copy to ensure iterators valid.
+        m_Projects[ proj ].m_RuntimeFiles.GetTrackedPaths( filesToTest );
         for( TFileList::iterator it = filesToTest.begin(); it != filesToTest.end(); ++it )
         {
             const Path& file = *it;
@@ -1048,7 +1020,7 @@ int RuntimeObjectSystem::TestBuildAllRuntimeHeaders(      ITestBuildNotifier* ca
     size_t numFilesToBuild = 0;
     for( unsigned short proj = 0; proj < m_Projects.size( ); ++proj )
     {
-        numFilesToBuild += m_Projects[ proj ].m_RuntimeFileList.size( );
+        numFilesToBuild += m_Projects[ proj ].m_RuntimeFiles.GetTrackedFiles().size( );
     }
 
     if( 0 == numFilesToBuild )
@@ -1058,7 +1030,8 @@ int RuntimeObjectSystem::TestBuildAllRuntimeHeaders(      ITestBuildNotifier* ca
 
     for( unsigned short proj = 0; proj < m_Projects.size(); ++proj )
     {
-        TFileList filesToTest = m_Projects[ proj ].m_RuntimeFileList; // m_RuntimeFileList could change if file content changes (new includes or source dependencies) so make copy to ensure iterators valid.
+        TFileList filesToTest; // tracked files could change if file content changes (new includes or source dependencies) so make copy to ensure iterators valid.
+        m_Projects[ proj ].m_RuntimeFiles.GetTrackedPaths( filesToTest );
         for( TFileList::iterator it = filesToTest.begin( ); it != filesToTest.end( ); ++it )
         {
             const Path& file = *it;
@@ -25,6 +25,7 @@
 #include "../RuntimeCompiler/AUArray.h"
 #include "ObjectInterface.h"
 #include "IRuntimeObjectSystem.h"
+#include "FileDependencyGraph.h"
 
 #ifdef _WIN32
     #define WIN32_LEAN_AND_MEAN
@@ -86,6 +87,7 @@ public:
     virtual void SetOptimizationLevel( RCppOptimizationLevel optimizationLevel_,	unsigned short projectId_ = 0 );
     virtual RCppOptimizationLevel GetOptimizationLevel(					unsigned short projectId_ = 0 );
     virtual void SetIntermediateDir(            const char* path_,      unsigned short projectId_ = 0 );
+    virtual void SetPrecompiledHeader(          const char* header_,    unsigned short projectId_ = 0 );
 
 	virtual void SetAutoCompile( bool autoCompile );
 	virtual bool GetAutoCompile() const
@@ -101,6 +103,14 @@ public:
         }
     }
 
+    virtual void SetMaxCompileJobs( unsigned int maxJobs )
+    {
+        if( m_pBuildTool )
+        {
+            m_pBuildTool->SetMaxCompileJobs( maxJobs );
+        }
+    }
+
     virtual void CleanObjectFiles() const;
 
 	virtual bool GetLastLoadModuleSuccess() const
@@ -192,10 +202,8 @@ private:
 
 		CompilerOptions						m_CompilerOptions;
 
-		TFileList                           m_RuntimeFileList;
-        TFileToFilesMap                     m_RuntimeIncludeMap;
+		FileDependencyGraph                 m_RuntimeFiles;   // files tracked, with their include and source dependencies
         TFileToFilesMap			            m_RuntimeLinkLibraryMap;
-        TFileToFilesMap                     m_RuntimeSourceDependencyMap;
 
         std::vector<BuildTool::FileToBuild> m_BuildFileList;
         std::vector<BuildTool::FileToBuild> m_PendingBuildFileList; // if a compile is already underway, store files here.
@@ -0,0 +1,230 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+// Saves files the ways editors and tools do and checks the Linux file watcher
+// reports each save as one change, with the file complete by the time the
+// change is handed to listeners.
+//
+// Usage: FileWatcherTests <scratch folder>
+
+#include "TestUtils.h"
+#include "../RuntimeCompiler/FileChangeNotifier.h"
+#include "../RuntimeCompiler/SimpleFileWatcher/FileWatcher.h"
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	// What the watcher reported, as "<file>:<action>"
+	class ActionRecorder : public FW::FileWatchListener
+	{
+	public:
+		void handleFileAction( FW::WatchID, const FW::String&, const FW::String& filename_, FW::Action action_ )
+		{
+			const char* action = action_ == FW::Actions::Add ? "Add" : action_ == FW::Actions::Delete ? "Delete" : "Modified";
+			m_Actions.push_back( filename_.m_string + ":" + action );
+		}
+
+		std::vector<std::string> m_Actions;
+	};
+
+	// Each notification, and the size of each file when it was notified
+	class ChangeRecorder : public IFileChangeListener
+	{
+	public:
+		virtual void OnFileChange( const IAUDynArray<const char*>& filelist_ )
+		{
+			m_NumNotifications += 1;
+			for( size_t i = 0; i < filelist_.Size(); ++i )
+			{
+				struct stat fileStat;
+				m_Sizes.push_back( stat( filelist_[i], &fileStat ) == 0 ? (long)fileStat.st_size : -1 );
+			}
+		}
+
+		ChangeRecorder() : m_NumNotifications( 0 ) {}
+
+		int					m_NumNotifications;
+		std::vector<long>	m_Sizes;
+	};
+
+	void Sleep( int milliseconds_ )
+	{
+		usleep( milliseconds_ * 1000 );
+	}
+
+	void WriteSlowly( const FileSystemUtils::Path& path_, const std::string& contents_, int pauseMilliseconds_ )
+	{
+		int fd = open( path_.c_str(), O_WRONLY | O_TRUNC );
+		Sleep( pauseMilliseconds_ );
+		ssize_t written = write( fd, contents_.data(), contents_.size() );
+		(void)written;
+		close( fd );
+	}
+
+	// Runs save_ on another thread while updating the watcher or notifier at
+	// 60Hz, as an application would, for duration_ milliseconds.
+	void RunSave( const std::function<void()>& save_, int duration_, FW::FileWatcher* pWatcher_, FileChangeNotifier* pNotifier_ )
+	{
+		std::thread saver( save_ );
+		const double end = GetTimeSeconds() + duration_ * 1e-3;
+		while( GetTimeSeconds() < end )
+		{
+			if( pWatcher_ )
+			{
+				pWatcher_->update();
+			}
+			if( pNotifier_ )
+			{
+				pNotifier_->Update( 0.016f );
+			}
+			Sleep( 16 );
+		}
+		saver.join();
+	}
+
+	std::string Join( const std::vector<std::string>& strings_ )
+	{
+		std::string joined;
+		for( size_t i = 0; i < strings_.size(); ++i )
+		{
+			joined += strings_[i] + " ";
+		}
+		return joined;
+	}
+
+	void CheckSave( FW::FileWatcher& watcher_, ActionRecorder& recorder_, const char* name_,
+		const std::function<void()>& save_, const std::vector<std::string>& expected_ )
+	{
+		recorder_.m_Actions.clear();
+		RunSave( save_, 600, &watcher_, 0 );
+		if( recorder_.m_Actions != expected_ )
+		{
+			fprintf( stderr, "%s: reported %s, expected %s\n", name_, Join( recorder_.m_Actions ).c_str(), Join( expected_ ).c_str() );
+		}
+		CHECK( recorder_.m_Actions == expected_ );
+	}
+
+	void TestSaves( const FileSystemUtils::Path& folder_, TestLogger& logger_ )
+	{
+		const FileSystemUtils::Path a = folder_ / "a.cpp";
+		const FileSystemUtils::Path b = folder_ / "b.h";
+		const FileSystemUtils::Path c = folder_ / "c.cpp";
+		const FileSystemUtils::Path temp = folder_ / ".a.cpp.tmp";
+		const FileSystemUtils::Path backup = folder_ / "a.cpp~";
+		const FileSystemUtils::Path probe = folder_ / "4913";
+
+		FW::FileWatcher watcher;
+		watcher.setLogger( &logger_ );
+		ActionRecorder recorder;
+		watcher.addWatch( folder_, &recorder );
+		Sleep( 50 );
+
+		typedef std::vector<std::string> Actions;
+		CheckSave( watcher, recorder, "plain write", [&]{ WriteFile( a, "int a = 1;\n" ); }, Actions( 1, "a.cpp:Modified" ) );
+		CheckSave( watcher, recorder, "truncate, pause, write", [&]{ WriteSlowly( a, "int a = 2;\n", 200 ); }, Actions( 1, "a.cpp:Modified" ) );
+		CheckSave( watcher, recorder, "rename over", [&]
+		{
+			WriteFile( temp, "int a = 3;\n" );
+			rename( temp.c_str(), a.c_str() );
+		}, Actions( 1, "a.cpp:Add" ) );
+		CheckSave( watcher, recorder, "vim backup rename", [&]
+		{
+			rename( a.c_str(), backup.c_str() );
+			WriteFile( probe, "" );
+			probe.Remove();
+			WriteFile( a, "int a = 4;\n" );
+			backup.Remove();
+		}, Actions( 1, "a.cpp:Modified" ) );
+		CheckSave( watcher, recorder, "touch", [&]{ b.SetLastWriteTime( FileSystemUtils::GetCurrentTime() ); }, Actions( 1, "b.h:Modified" ) );
+		CheckSave( watcher, recorder, "create", [&]{ WriteFile( c, "int c;\n" ); }, Actions( 1, "c.cpp:Add" ) );
+		CheckSave( watcher, recorder, "delete", [&]{ c.Remove(); }, Actions( 1, "c.cpp:Delete" ) );
+
+		Actions both;
+		both.push_back( "a.cpp:Modified" );
+		both.push_back( "b.h:Modified" );
+		CheckSave( watcher, recorder, "two files", [&]{ WriteFile( a, "int a = 5;\n" ); WriteFile( b, "int b = 5;\n" ); }, both );
+
+		// Nothing to hand over should cost next to nothing.
+		recorder.m_Actions.clear();
+		const int numUpdates = 1000000;
+		const double start = GetTimeSeconds();
+		for( int i = 0; i < numUpdates; ++i )
+		{
+			watcher.update();
+		}
+		printf( "idle update: %.1fns\n", ( GetTimeSeconds() - start ) * 1e9 / numUpdates );
+		CHECK( recorder.m_Actions.empty() );
+	}
+
+	void TestNotifier( const FileSystemUtils::Path& folder_, TestLogger& logger_ )
+	{
+		const FileSystemUtils::Path a = folder_ / "a.cpp";
+		const FileSystemUtils::Path b = folder_ / "b.h";
+
+		FileChangeNotifier notifier;
+		notifier.SetLogger( &logger_ );
+		ChangeRecorder recorder;
+		notifier.Watch( a, &recorder );
+		notifier.Watch( b, &recorder );
+		Sleep( 50 );
+
+		// Saves close together are one notification.
+		RunSave( [&]{ WriteFile( a, "int a = 6;\n" ); WriteFile( b, "int b = 6;\n" ); }, 800, 0, &notifier );
+		CHECK( recorder.m_NumNotifications == 1 );
+		CHECK( recorder.m_Sizes.size() == 2 );
+
+		// A file is written in full before it is notified.
+		recorder.m_NumNotifications = 0;
+		recorder.m_Sizes.clear();
+		RunSave( [&]{ WriteSlowly( a, "int a = 7;\n", 150 ); }, 800, 0, &notifier );
+		CHECK( recorder.m_NumNotifications == 1 );
+		CHECK( recorder.m_Sizes.size() == 1 && recorder.m_Sizes[0] == 11 );
+
+		// Saving again soon after is not lost to the limit on notifications.
+		RunSave( []{}, 1200, 0, &notifier );
+		recorder.m_NumNotifications = 0;
+		RunSave( [&]{ WriteFile( a, "int a = 8;\n" ); Sleep( 300 ); WriteFile( a, "int a = 9;\n" ); }, 2500, 0, &notifier );
+		CHECK( recorder.m_NumNotifications == 2 );
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		fprintf( stderr, "usage: %s <scratch folder>\n", argv[0] );
+		return 2;
+	}
+	const FileSystemUtils::Path folder = MakeEmptyDir( argv[1] );
+	WriteFile( folder / "a.cpp", "int a;\n" );
+	WriteFile( folder / "b.h", "int b;\n" );
+
+	TestLogger logger;
+	TestSaves( folder, logger );
+	TestNotifier( folder, logger );
+	CHECK( logger.m_NumErrors == 0 );
+
+	return TestResult();
+}
@@ -0,0 +1,204 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+// Times FileDependencyGraph on a synthetic project of 20000 sources and 2000
+// headers, each source including 12 headers and some headers including
+// others, against searching every include as a list.  Fails if the graph
+// finds different files to compile for a change than the search does.
+//
+// Usage: GraphBenchmark [number of sources]
+
+#include "TestUtils.h"
+#include "../RuntimeObjectSystem/FileDependencyGraph.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+
+namespace
+{
+	typedef FileDependencyGraph::TFileId TFileId;
+	typedef std::multimap<std::string, std::string> TIncludeMap;	// include, dependent
+
+	const int NUM_INCLUDES		= 12;
+	const int NUM_CHANGES		= 200;
+
+	std::string SourcePath( int index_ )
+	{
+		return "/project/src/File" + std::to_string( index_ ) + ".cpp";
+	}
+
+	std::string HeaderPath( int index_ )
+	{
+		return "/project/include/Header" + std::to_string( index_ ) + ".h";
+	}
+
+	bool IsHeaderPath( const std::string& path_ )
+	{
+		return path_.size() > 2 && path_.compare( path_.size() - 2, 2, ".h" ) == 0;
+	}
+
+	// The search the graph replaces: every include of a changed file, followed
+	// through headers, by walking the whole list each time.
+	void SearchDependentSources( const TIncludeMap& includes_, const std::string& changed_, std::vector<std::string>& sources_ )
+	{
+		std::vector<std::string> toVisit( 1, changed_ );
+		std::vector<std::string> visited( 1, changed_ );
+		while( !toVisit.empty() )
+		{
+			const std::string include = toVisit.back();
+			toVisit.pop_back();
+			for( TIncludeMap::const_iterator it = includes_.begin(); it != includes_.end(); ++it )
+			{
+				if( it->first != include || std::find( visited.begin(), visited.end(), it->second ) != visited.end() )
+				{
+					continue;
+				}
+				visited.push_back( it->second );
+				if( IsHeaderPath( it->second ) )
+				{
+					toVisit.push_back( it->second );
+				}
+				else
+				{
+					sources_.push_back( it->second );
+				}
+			}
+		}
+	}
+
+	void GraphDependentSources( FileDependencyGraph& graph_, const std::string& changed_, std::vector<std::string>& sources_ )
+	{
+		std::vector<TFileId> ids;
+		graph_.GetDependentSources( graph_.Find( changed_ ), ids );
+		for( size_t i = 0; i < ids.size(); ++i )
+		{
+			sources_.push_back( graph_.GetPath( ids[i] ).m_string );
+		}
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	const int numSources = argc > 1 ? atoi( argv[1] ) : 20000;
+	const int numHeaders = numSources / 10;
+	std::mt19937 random( 1 );
+
+	// Every source includes NUM_INCLUDES headers, and one header in ten
+	// includes another so that changes follow chains of headers.
+	FileDependencyGraph graph;
+	TIncludeMap includes;
+	double start = GetTimeSeconds();
+	for( int h = 0; h < numHeaders; ++h )
+	{
+		graph.AddTrackedFile( graph.Intern( HeaderPath( h ) ) );
+	}
+	for( int h = 0; h < numHeaders; h += 10 )
+	{
+		const int included = random() % numHeaders;
+		if( included != h )
+		{
+			graph.AddInclude( graph.Find( HeaderPath( included ) ), graph.Find( HeaderPath( h ) ) );
+			includes.insert( TIncludeMap::value_type( HeaderPath( included ), HeaderPath( h ) ) );
+		}
+	}
+	for( int s = 0; s < numSources; ++s )
+	{
+		const TFileId source = graph.Intern( SourcePath( s ) );
+		graph.AddTrackedFile( source );
+		for( int i = 0; i < NUM_INCLUDES; ++i )
+		{
+			const int header = random() % numHeaders;
+			graph.AddInclude( graph.Find( HeaderPath( header ) ), source );
+			includes.insert( TIncludeMap::value_type( HeaderPath( header ), SourcePath( s ) ) );
+		}
+	}
+	const double setup = GetTimeSeconds() - start;
+	printf( "%d sources, %d headers, %d includes each: graph built in %.1fms\n",
+		numSources, numHeaders, NUM_INCLUDES, setup * 1e3 );
+
+	// Lookups
+	CHECK( (int)graph.GetTrackedFiles().size() == numSources + numHeaders );
+	CHECK( graph.Find( "/project/src/Missing.cpp" ) == (TFileId)FileDependencyGraph::INVALID_FILE_ID );
+	start = GetTimeSeconds();
+	int numFound = 0;
+	for( int s = 0; s < numSources; ++s )
+	{
+		const TFileId id = graph.Find( SourcePath( s ) );
+		numFound += id != (TFileId)FileDependencyGraph::INVALID_FILE_ID && graph.GetPath( id ).m_string == SourcePath( s ) &&
+			graph.IsTracked( id ) && !graph.IsHeader( id );
+	}
+	const double lookups = GetTimeSeconds() - start;
+	CHECK( numFound == numSources );
+	printf( "lookup: %.3fus per path\n", lookups * 1e6 / numSources );
+
+	// Files to compile when a header changes, as a set each way
+	std::vector<std::string> changes;
+	for( int i = 0; i < NUM_CHANGES; ++i )
+	{
+		changes.push_back( HeaderPath( random() % numHeaders ) );
+	}
+	double searchSeconds = 0.0;
+	double graphSeconds = 0.0;
+	int numDifferent = 0;
+	size_t numToCompile = 0;
+	for( size_t i = 0; i < changes.size(); ++i )
+	{
+		std::vector<std::string> searched;
+		std::vector<std::string> found;
+		start = GetTimeSeconds();
+		SearchDependentSources( includes, changes[i], searched );
+		searchSeconds += GetTimeSeconds() - start;
+		start = GetTimeSeconds();
+		GraphDependentSources( graph, changes[i], found );
+		graphSeconds += GetTimeSeconds() - start;
+
+		numToCompile += found.size();
+		std::sort( searched.begin(), searched.end() );
+		std::sort( found.begin(), found.end() );
+		numDifferent += searched != found;
+	}
+	CHECK( numDifferent == 0 );
+	printf( "header change, %.1f sources to compile: search %.1fus, graph %.1fus\n",
+		(double)numToCompile / changes.size(), searchSeconds * 1e6 / changes.size(), graphSeconds * 1e6 / changes.size() );
+
+	// Replacing one source's includes, as after it is compiled
+	const std::string retracked = SourcePath( numSources / 2 );
+	const TFileId retrackedId = graph.Find( retracked );
+	std::vector<TFileId> retrackedIncludes;
+	for( TIncludeMap::const_iterator it = includes.begin(); it != includes.end(); ++it )
+	{
+		if( it->second == retracked )
+		{
+			retrackedIncludes.push_back( graph.Find( it->first ) );
+		}
+	}
+	start = GetTimeSeconds();
+	graph.RemoveDependencies( retrackedId );
+	const double removal = GetTimeSeconds() - start;
+	for( size_t i = 0; i < retrackedIncludes.size(); ++i )
+	{
+		std::vector<TFileId> sources;
+		graph.GetDependentSources( retrackedIncludes[i], sources );
+		CHECK( std::find( sources.begin(), sources.end(), retrackedId ) == sources.end() );
+	}
+	CHECK( graph.IsTracked( retrackedId ) );
+	printf( "removing a source's %d includes: %.1fus\n", (int)retrackedIncludes.size(), removal * 1e6 );
+
+	return TestResult();
+}
@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+// Prints ObjectCache::HashToHex of inputs of every length from 0 to 69 bytes,
+// one per line, for MurmurHash3Reference.py to compare against.
+
+#include "../RuntimeCompiler/ObjectCache.h"
+
+#include <stdio.h>
+
+int main()
+{
+	// Lengths up to 69 cover no blocks, several, and every tail length.
+	for( int n = 0; n < 70; ++n )
+	{
+		std::string data;
+		for( int i = 0; i < n; ++i )
+		{
+			data += (char)( ( i * 37 + n ) & 0xff );
+		}
+		printf( "%s\n", ObjectCache::HashToHex( data ).c_str() );
+	}
+	return 0;
+}
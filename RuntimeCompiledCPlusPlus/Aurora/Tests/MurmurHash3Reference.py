@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+#
+# Checks ObjectCache::HashToHex against MurmurHash3_x64_128 written out here
+# from Austin Appleby's public domain reference, MurmurHash3.cpp in SMHasher.
+#
+# Usage: MurmurHash3Reference.py <MurmurHash3Dump executable>
+#
+
+import subprocess
+import sys
+
+MASK = 0xffffffffffffffff
+C1 = 0x87c37b91114253d5
+C2 = 0x4cf5ad432745937f
+
+
+def rotl64(x, r):
+    return ((x << r) | (x >> (64 - r))) & MASK
+
+
+def fmix64(k):
+    k ^= k >> 33
+    k = (k * 0xff51afd7ed558ccd) & MASK
+    k ^= k >> 33
+    k = (k * 0xc4ceb9fe1a85ec53) & MASK
+    k ^= k >> 33
+    return k
+
+
+def murmurhash3_x64_128(data, seed=0):
+    length = len(data)
+    nblocks = length // 16
+    h1 = seed
+    h2 = seed
+
+    for i in range(nblocks):
+        k1 = int.from_bytes(data[i * 16:i * 16 + 8], 'little')
+        k2 = int.from_bytes(data[i * 16 + 8:i * 16 + 16], 'little')
+
+        k1 = (k1 * C1) & MASK
+        k1 = rotl64(k1, 31)
+        k1 = (k1 * C2) & MASK
+        h1 ^= k1
+        h1 = rotl64(h1, 27)
+        h1 = (h1 + h2) & MASK
+        h1 = (h1 * 5 + 0x52dce729) & MASK
+
+        k2 = (k2 * C2) & MASK
+        k2 = rotl64(k2, 33)
+        k2 = (k2 * C1) & MASK
+        h2 ^= k2
+        h2 = rotl64(h2, 31)
+        h2 = (h2 + h1) & MASK
+        h2 = (h2 * 5 + 0x38495ab5) & MASK
+
+    tail = data[nblocks * 16:]
+    k1 = int.from_bytes(tail[:8], 'little')
+    k2 = int.from_bytes(tail[8:], 'little')
+    if len(tail) > 8:
+        k2 = (k2 * C2) & MASK
+        k2 = rotl64(k2, 33)
+        k2 = (k2 * C1) & MASK
+        h2 ^= k2
+    if len(tail) > 0:
+        k1 = (k1 * C1) & MASK
+        k1 = rotl64(k1, 31)
+        k1 = (k1 * C2) & MASK
+        h1 ^= k1
+
+    h1 ^= length
+    h2 ^= length
+    h1 = (h1 + h2) & MASK
+    h2 = (h2 + h1) & MASK
+    h1 = fmix64(h1)
+    h2 = fmix64(h2)
+    h1 = (h1 + h2) & MASK
+    h2 = (h2 + h1) & MASK
+    return '%016x%016x' % (h1, h2)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: %s <MurmurHash3Dump executable>' % sys.argv[0], file=sys.stderr)
+        return 2
+
+    # Published value, so a mistake in this port does not pass unnoticed.
+    fox = murmurhash3_x64_128(b'The quick brown fox jumps over the lazy dog')
+    if fox != 'e34bbc7bbc071b6c7a433ca9c49a9347':
+        print('reference port is wrong: %s' % fox, file=sys.stderr)
+        return 1
+
+    # The same inputs as MurmurHash3Dump.cpp.
+    lines = subprocess.check_output([sys.argv[1]]).decode().split()
+    expected = [murmurhash3_x64_128(bytes((i * 37 + n) & 0xff for i in range(n))) for n in range(70)]
+    failures = 0
+    for n, (got, want) in enumerate(zip(lines, expected)):
+        if got != want:
+            print('%d bytes: HashToHex gives %s, reference %s' % (n, got, want), file=sys.stderr)
+            failures += 1
+    if len(lines) != len(expected):
+        print('%d hashes printed, expected %d' % (len(lines), len(expected)), file=sys.stderr)
+        failures += 1
+
+    print('%d hashes checked, %d differ' % (len(expected), failures))
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
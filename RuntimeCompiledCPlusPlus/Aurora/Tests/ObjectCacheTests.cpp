@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+// Checks the object cache removes its least recently used objects first, that
+// a build keeps the cache within its budget, and that cleaning empties it.
+//
+// Usage: ObjectCacheTests <Aurora folder> <scratch folder>
+
+#include "TestUtils.h"
+#include "../RuntimeCompiler/BuildTool.h"
+#include "../RuntimeCompiler/ObjectCache.h"
+
+#include <unistd.h>
+
+namespace
+{
+	struct FolderContents
+	{
+		int			numFiles;
+		uint64_t	numBytes;
+	};
+
+	FolderContents GetFolderContents( const FileSystemUtils::Path& folder_ )
+	{
+		FolderContents contents = { 0, 0 };
+		FileSystemUtils::PathIterator pathIter( folder_ );
+		while( ++pathIter )
+		{
+			if( !pathIter.GetPath().IsDirectory() )
+			{
+				++contents.numFiles;
+				contents.numBytes += pathIter.GetPath().GetFileSize();
+			}
+		}
+		return contents;
+	}
+
+	void WriteCachedFile( const FileSystemUtils::Path& path_, FileSystemUtils::filetime_t lastUsed_ )
+	{
+		WriteFile( path_, std::string( 100, 'x' ) );
+		path_.SetLastWriteTime( lastUsed_ );
+	}
+
+	void TestTrim( const FileSystemUtils::Path& scratch_ )
+	{
+		const FileSystemUtils::Path cache = MakeEmptyDir( scratch_ / "Trim" );
+		WriteCachedFile( cache / "a.o", 1000 );
+		WriteCachedFile( cache / "b.o", 3000 );
+		WriteCachedFile( cache / "c.o", 2000 );
+		WriteCachedFile( cache / "d.o.tmp", 500 );
+
+		// Within budget, nothing goes.
+		CHECK( ObjectCache::Trim( cache, 400 ) == 0 );
+		CHECK( GetFolderContents( cache ).numFiles == 4 );
+
+		// Oldest first, and files being copied in are left alone.
+		CHECK( ObjectCache::Trim( cache, 250 ) == 1 );
+		CHECK( !( cache / "a.o" ).Exists() );
+		CHECK( ( cache / "d.o.tmp" ).Exists() );
+
+		// Taking b from the cache makes c the least recently used.
+		( cache / "b.o" ).SetLastWriteTime( 1500 );
+		ObjectCache::MarkUsed( cache / "b.o" );
+		CHECK( ObjectCache::Trim( cache, 100 ) == 1 );
+		CHECK( !( cache / "c.o" ).Exists() );
+		CHECK( ( cache / "b.o" ).Exists() );
+
+		CHECK( ObjectCache::Clear( cache ) == 1 );
+		CHECK( !( cache / "b.o" ).Exists() );
+	}
+
+	void Build( BuildTool& buildTool_, const std::vector<BuildTool::FileToBuild>& files_,
+		const FileSystemUtils::Path& aurora_, const FileSystemUtils::Path& intermediate_ )
+	{
+		CompilerOptions options;
+		options.optimizationLevel = RCCPPOPTIMIZATIONLEVEL_DEBUG;
+		options.intermediatePath = intermediate_;
+		options.includeDirList.push_back( aurora_ );
+
+		buildTool_.BuildModule( files_, options, std::vector<FileSystemUtils::Path>(), intermediate_ / "module.so" );
+		while( !buildTool_.GetIsComplete() )
+		{
+			usleep( 1000 );
+		}
+	}
+
+	void TestBuild( const FileSystemUtils::Path& aurora_, const FileSystemUtils::Path& scratch_ )
+	{
+		TestLogger logger;
+		BuildTool buildTool;
+		buildTool.Initialise( &logger );
+
+		std::vector<BuildTool::FileToBuild> files;
+		files.push_back( BuildTool::FileToBuild( aurora_ / "Examples/ConsoleExample/RuntimeObject01.cpp", true ) );
+		files.push_back( BuildTool::FileToBuild( aurora_ / "RuntimeObjectSystem/ObjectInterfacePerModuleSource.cpp", true ) );
+
+		// A budget smaller than any object leaves nothing cached.
+		const FileSystemUtils::Path small = MakeEmptyDir( scratch_ / "Small" );
+		buildTool.SetMaxObjectCacheBytes( 1 );
+		Build( buildTool, files, aurora_, small );
+		CHECK( ( small / "module.so" ).Exists() );
+		CHECK( GetFolderContents( small / "ObjectCache" ).numFiles == 0 );
+
+		// The default budget keeps every object, until the folder is cleaned.
+		const FileSystemUtils::Path large = MakeEmptyDir( scratch_ / "Large" );
+		buildTool.SetMaxObjectCacheBytes( ObjectCache::DEFAULT_MAX_BYTES );
+		Build( buildTool, files, aurora_, large );
+		CHECK( ( large / "module.so" ).Exists() );
+		CHECK( GetFolderContents( large / "ObjectCache" ).numFiles == (int)files.size() );
+
+		buildTool.Clean( large );
+		CHECK( GetFolderContents( large / "ObjectCache" ).numFiles == 0 );
+		CHECK( logger.m_NumErrors == 0 );
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 3 )
+	{
+		fprintf( stderr, "usage: %s <Aurora folder> <scratch folder>\n", argv[0] );
+		return 2;
+	}
+	const FileSystemUtils::Path aurora = AbsolutePath( argv[1] );
+	const FileSystemUtils::Path scratch = MakeEmptyDir( argv[2] );
+
+	TestTrim( scratch );
+	TestBuild( aurora, scratch );
+
+	return TestResult();
+}
@@ -0,0 +1,167 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+// Times rebuilding a runtime module after editing one of its sources, with
+// the header every source includes read as text and precompiled.  Fails if a
+// build does not load or does not pick up the edit, or if no precompiled
+// header is made.
+//
+// Usage: PchBenchmark <compiler> <scratch folder>
+
+#include "TestUtils.h"
+#include "../RuntimeCompiler/BuildTool.h"
+
+#include <sstream>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+namespace
+{
+	const int NUM_SOURCES	= 4;
+	const int NUM_EDITS		= 3;
+
+	// Large enough that parsing it is most of each compile, as in a real project.
+	const char* HEADER_TEXT =
+		"#pragma once\n"
+		"#include <algorithm>\n"
+		"#include <functional>\n"
+		"#include <iostream>\n"
+		"#include <map>\n"
+		"#include <memory>\n"
+		"#include <random>\n"
+		"#include <regex>\n"
+		"#include <sstream>\n"
+		"#include <string>\n"
+		"#include <unordered_map>\n"
+		"#include <vector>\n";
+
+	// Source index_ returns index_ * 100 + edit_, so each build shows which
+	// edit it was built from.
+	void WriteSource( const FileSystemUtils::Path& folder_, int index_, int edit_ )
+	{
+		std::stringstream source;
+		source << "#include \"Common.h\"\n"
+			"extern \"C\" __attribute__((visibility(\"default\"))) int Value" << index_ << "()\n"
+			"{\n"
+			"	std::map<std::string, std::vector<int> > values;\n"
+			"	values[\"a\"].push_back( " << edit_ << " );\n"
+			"	std::regex pattern( \"a+\" );\n"
+			"	return " << index_ * 100 << " + values[\"a\"].back() + ( std::regex_match( \"b\", pattern ) ? 1000 : 0 );\n"
+			"}\n";
+		WriteFile( folder_ / ( "Source" + std::to_string( index_ ) + ".cpp" ), source.str() );
+	}
+
+	// Builds the sources into scratch_/<name>.so, intermediates in
+	// scratch_/<intermediate_>.  Returns the time taken, and what Value0()
+	// returns, or -1 when the module does not load.
+	double Build( BuildTool& buildTool_, const std::vector<BuildTool::FileToBuild>& files_, const CompilerOptions& options_,
+		const FileSystemUtils::Path& scratch_, const std::string& name_, int& value0_ )
+	{
+		const FileSystemUtils::Path module = scratch_ / ( name_ + ".so" );
+		const double start = GetTimeSeconds();
+		buildTool_.BuildModule( files_, options_, std::vector<FileSystemUtils::Path>(), module );
+		while( !buildTool_.GetIsComplete() )
+		{
+			usleep( 1000 );
+		}
+		const double seconds = GetTimeSeconds() - start;
+
+		value0_ = -1;
+		if( void* handle = dlopen( module.c_str(), RTLD_NOW | RTLD_LOCAL ) )
+		{
+			typedef int ( *ValueFunction )();
+			if( ValueFunction value = (ValueFunction)dlsym( handle, "Value0" ) )
+			{
+				value0_ = value();
+			}
+			dlclose( handle );
+		}
+		return seconds;
+	}
+
+	// Builds every source once, then times rebuilding after each edit of
+	// Source0.cpp.  Returns the mean time of a rebuild.
+	double TimeEdits( BuildTool& buildTool_, const std::string& compiler_, const FileSystemUtils::Path& scratch_,
+		const FileSystemUtils::Path& sources_, bool bPrecompile_ )
+	{
+		const std::string name = bPrecompile_ ? "pch" : "text";
+		CompilerOptions options;
+		options.optimizationLevel = RCCPPOPTIMIZATIONLEVEL_DEBUG;
+		options.compilerLocation = compiler_ + " ";
+		options.intermediatePath = MakeEmptyDir( scratch_ / name );
+		options.includeDirList.push_back( sources_ );
+		if( bPrecompile_ )
+		{
+			options.precompiledHeader = sources_ / "Common.h";
+		}
+
+		std::vector<BuildTool::FileToBuild> files;
+		for( int i = 0; i < NUM_SOURCES; ++i )
+		{
+			WriteSource( sources_, i, 0 );
+			files.push_back( BuildTool::FileToBuild( sources_ / ( "Source" + std::to_string( i ) + ".cpp" ), true ) );
+		}
+
+		int value0 = -1;
+		const double first = Build( buildTool_, files, options, scratch_, name + "0", value0 );
+		CHECK( value0 == 0 );
+
+		double edits = 0.0;
+		for( int edit = 1; edit <= NUM_EDITS; ++edit )
+		{
+			WriteSource( sources_, 0, edit );
+			edits += Build( buildTool_, files, options, scratch_, name + std::to_string( edit ), value0 );
+			CHECK( value0 == edit );
+		}
+
+		if( bPrecompile_ )
+		{
+			const bool bClang = compiler_.find( "clang" ) != std::string::npos;
+			CHECK( ( options.intermediatePath / "PCH" / ( bClang ? "Common.h.pch" : "Common.h.gch" ) ).Exists() );
+		}
+
+		printf( "%s, header %s: first build %.2fs, %.2fs per edit\n", compiler_.c_str(),
+			bPrecompile_ ? "precompiled" : "as text", first, edits / NUM_EDITS );
+		return edits / NUM_EDITS;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 3 )
+	{
+		fprintf( stderr, "usage: %s <compiler> <scratch folder>\n", argv[0] );
+		return 2;
+	}
+	const std::string compiler = argv[1];
+	const FileSystemUtils::Path scratch = MakeEmptyDir( argv[2] );
+	const FileSystemUtils::Path sources = MakeEmptyDir( scratch / "Sources" );
+	WriteFile( sources / "Common.h", HEADER_TEXT );
+
+	TestLogger logger;
+	BuildTool buildTool;
+	buildTool.Initialise( &logger );
+
+	const double text = TimeEdits( buildTool, compiler, scratch, sources, false );
+	const double precompiled = TimeEdits( buildTool, compiler, scratch, sources, true );
+	printf( "%s: precompiling the header makes an edit %.2fx as fast\n", compiler.c_str(), text / precompiled );
+	CHECK( logger.m_NumErrors == 0 );
+
+	return TestResult();
+}
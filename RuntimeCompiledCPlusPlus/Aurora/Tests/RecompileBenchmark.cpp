@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+// Times building the ConsoleExample runtime module through BuildTool, with one
+// compile job at a time and with one per processor, then rebuilding it
+// unchanged.  Fails if the module does not load and export its interface, or
+// if a missing source still produces a module.
+//
+// Usage: RecompileBenchmark <Aurora folder> <scratch folder>
+
+#include "TestUtils.h"
+#include "../RuntimeCompiler/BuildTool.h"
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+namespace
+{
+	// Builds the files into scratch_/<name>.so, intermediates in scratch_/<name>.
+	// Returns the time taken, and whether the module loads.
+	double Build( BuildTool& buildTool_, const std::vector<BuildTool::FileToBuild>& files_,
+		const FileSystemUtils::Path& aurora_, const FileSystemUtils::Path& scratch_, const char* name_, bool& bLoads_ )
+	{
+		CompilerOptions options;
+		options.optimizationLevel = RCCPPOPTIMIZATIONLEVEL_DEBUG;
+		options.intermediatePath = scratch_ / name_;
+		options.includeDirList.push_back( aurora_ );
+
+		FileSystemUtils::Path module = scratch_ / ( std::string( name_ ) + ".so" );
+		module.Remove();
+
+		const double start = GetTimeSeconds();
+		buildTool_.BuildModule( files_, options, std::vector<FileSystemUtils::Path>(), module );
+		while( !buildTool_.GetIsComplete() )
+		{
+			usleep( 1000 );
+		}
+		const double seconds = GetTimeSeconds() - start;
+
+		bLoads_ = false;
+		if( void* handle = dlopen( module.c_str(), RTLD_NOW | RTLD_LOCAL ) )
+		{
+			bLoads_ = dlsym( handle, "GetPerModuleInterface" ) != 0;
+			dlclose( handle );
+		}
+		return seconds;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 3 )
+	{
+		fprintf( stderr, "usage: %s <Aurora folder> <scratch folder>\n", argv[0] );
+		return 2;
+	}
+	const FileSystemUtils::Path aurora = AbsolutePath( argv[1] );
+	const FileSystemUtils::Path scratch = MakeEmptyDir( argv[2] );
+
+	TestLogger logger;
+	BuildTool buildTool;
+	buildTool.Initialise( &logger );
+
+	std::vector<BuildTool::FileToBuild> files;
+	files.push_back( BuildTool::FileToBuild( aurora / "Examples/ConsoleExample/RuntimeObject01.cpp", true ) );
+	files.push_back( BuildTool::FileToBuild( aurora / "RuntimeObjectSystem/ObjectInterfacePerModuleSource.cpp", true ) );
+
+	bool bLoads = false;
+	buildTool.SetMaxCompileJobs( 1 );
+	const double serial = Build( buildTool, files, aurora, scratch, "serial", bLoads );
+	CHECK( bLoads );
+
+	buildTool.SetMaxCompileJobs( 0 );
+	const double parallel = Build( buildTool, files, aurora, scratch, "parallel", bLoads );
+	CHECK( bLoads );
+
+	// Same intermediate folder: every object comes from the cache.
+	const double unchanged = Build( buildTool, files, aurora, scratch, "parallel", bLoads );
+	CHECK( bLoads );
+
+	printf( "ConsoleExample module, %d files, %ld processors: one job %.2fs, a job per processor %.2fs, unchanged %.2fs\n",
+		(int)files.size(), sysconf( _SC_NPROCESSORS_ONLN ), serial, parallel, unchanged );
+
+	// A file that does not compile stops the build before the link.
+	const int errorsBefore = logger.m_NumErrors;
+	files.push_back( BuildTool::FileToBuild( scratch / "Missing.cpp", true ) );
+	Build( buildTool, files, aurora, scratch, "missing", bLoads );
+	CHECK( !bLoads );
+	CHECK( !( scratch / "missing.so" ).Exists() );
+	CHECK( logger.m_NumErrors > errorsBefore );
+
+	return TestResult();
+}
@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2010-2011 Matthew Jack and Doug Binks
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#pragma once
+
+// What the tests and benchmarks share: a CHECK that reports and carries on,
+// a clock, scratch folders and loggers.  The helpers are inline so a test
+// that does not call one of them builds without warnings.
+
+#include "../RuntimeCompiler/ICompilerLogger.h"
+#include "../RuntimeCompiler/FileSystemUtils.h"
+
+#include <fstream>
+#include <string>
+
+#include <ftw.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static int s_NumChecksFailed = 0;
+
+#define CHECK( expr_ ) \
+	do { if( !( expr_ ) ) { fprintf( stderr, "%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #expr_ ); ++s_NumChecksFailed; } } while( 0 )
+
+// Exit code for main: non zero when any CHECK failed.
+inline int TestResult()
+{
+	if( s_NumChecksFailed )
+	{
+		fprintf( stderr, "%d checks failed\n", s_NumChecksFailed );
+	}
+	return s_NumChecksFailed ? 1 : 0;
+}
+
+inline double GetTimeSeconds()
+{
+	timeval now;
+	gettimeofday( &now, 0 );
+	return now.tv_sec + now.tv_usec * 1e-6;
+}
+
+inline int RemoveEntry( const char* path_, const struct stat*, int, struct FTW* )
+{
+	return remove( path_ );
+}
+
+// Removes a folder and everything in it, if it exists.
+inline void RemoveTree( const FileSystemUtils::Path& path_ )
+{
+	if( path_.Exists() )
+	{
+		nftw( path_.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS );
+	}
+}
+
+// Compiles run in their intermediate folder, so paths handed to them must
+// not be relative.  The path must exist.
+inline FileSystemUtils::Path AbsolutePath( const FileSystemUtils::Path& path_ )
+{
+	char* resolved = realpath( path_.c_str(), 0 );
+	FileSystemUtils::Path absolute = resolved ? FileSystemUtils::Path( resolved ) : path_;
+	free( resolved );
+	return absolute;
+}
+
+// An empty folder, with whatever was there before removed.
+inline FileSystemUtils::Path MakeEmptyDir( const FileSystemUtils::Path& path_ )
+{
+	RemoveTree( path_ );
+	path_.CreateDir();
+	return AbsolutePath( path_ );
+}
+
+inline bool WriteFile( const FileSystemUtils::Path& path_, const std::string& contents_ )
+{
+	std::ofstream file( path_.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+	return (bool)( file << contents_ );
+}
+
+// Prints errors and warnings; info only when verbose, as compiles are chatty.
+class TestLogger : public ICompilerLogger
+{
+public:
+	TestLogger() : m_bVerbose( false ), m_NumErrors( 0 ) {}
+
+	virtual void LogError( const char * format, ... )
+	{
+		++m_NumErrors;
+		va_list args;
+		va_start( args, format );
+		vfprintf( stderr, format, args );
+		va_end( args );
+	}
+	virtual void LogWarning( const char * format, ... )
+	{
+		va_list args;
+		va_start( args, format );
+		vfprintf( stderr, format, args );
+		va_end( args );
+	}
+	virtual void LogInfo( const char * format, ... )
+	{
+		if( m_bVerbose )
+		{
+			va_list args;
+			va_start( args, format );
+			vfprintf( stdout, format, args );
+			va_end( args );
+		}
+	}
+
+	bool	m_bVerbose;
+	int		m_NumErrors;
+};
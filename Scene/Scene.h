@@ -8,6 +8,12 @@
 #include "imgui.h"
 #include "../Common/d3dUtil.h"
 #include "../Common/Camera.h"
+#include "../Common/ConstantBufferStore.h"
+#include "../Common/FramePacer.h"
+#include "../Common/Culling.h"
+#include "../Common/DrawQueue.h"
+#include "../Common/TextureStreamer.h"
+#include "../Common/TransformHierarchy.h"
 #include "../Common/StepTimer.h"
 #include "../FrameResource/FrameResource.h"
 #include "../DirectXTK12/Inc/DescriptorHeap.h"
@@ -102,10 +108,22 @@ public:
     void Render();
 
 private:
+    // Descriptors reserved for streamed textures.
+    static const UINT TextureCapacity = 16;
+
+    // A material whose SRV indices follow streamed textures; -1 for none.
+    struct StreamedMaterial
+    {
+        Material* Mat;
+        int DiffuseTexture;
+        int NormalTexture;
+    };
 
     std::vector<std::unique_ptr<FrameResource>> mFrameResources;
     FrameResource* mCurrFrameResource = nullptr;
     int mCurrFrameResourceIndex = 0;
+    std::unique_ptr<FramePacer> mFramePacer;
+    std::unique_ptr<ConstantBufferStore<ObjectConstants>> mObjectConstants;
 
     ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 
@@ -113,10 +131,12 @@ private:
 
     std::unique_ptr<DescriptorHeap> m_resourceDescriptors;
 
-    std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+    std::unordered_map<std::string, std::shared_ptr<MeshGeometry>> mGeometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
-    std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
-    std::unordered_map<std::string, UINT> mTexturesHeapIndex;
+    std::unique_ptr<TextureStreamer> mTextureStreamer;
+    std::unordered_map<std::string, UINT> mTextureHandles;
+    std::vector<StreamedMaterial> mStreamedMaterials;
+    UINT64 mFrameCount = 0;
     std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
@@ -128,6 +148,23 @@ private:
     // Render items divided by PSO.
     std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+    // Places the render items; see RenderItem::TransformNode.
+    std::unique_ptr<TransformHierarchy> mTransforms;
+
+    // Render items by CullIndex, and what is left of them after culling.
+    std::unique_ptr<CullingStage> mCulling;
+    std::unique_ptr<OcclusionBuffer> mOcclusion;
+    std::vector<RenderItem*> mCulledRitems;
+
+    // Opaque PSOs by the pipeline field of draw keys, and the frame's draws.
+    std::vector<ID3D12PipelineState*> mDrawPipelines;
+    std::unique_ptr<DrawQueue> mDrawQueue;
+    // Record draws on worker threads once there are enough for two chunks.
+    // The scene has few draws, so the chunk size can be lowered to try it.
+    bool mParallelRecording = true;
+    int mMinDrawsPerList = DrawQueue::MinDrawsPerChunk;
+    UINT mRecordingChunks = 1;
+
     UINT mSkyTexHeapIndex = 0;
     UINT mShadowMapHeapIndex = 0;
 
@@ -7,6 +7,7 @@
 #include "../DirectXTK12/Inc/EffectPipelineStateDescription.h"
 #include "../DirectXTK12/Inc/CommonStates.h"
 #include "../ModelLoader/ModelLoader.h"
+#include "../Common/VertexCompression.h"
 
 
 
@@ -38,49 +39,47 @@ void SceneMain::Initialize()
     GeometricPrimitive::CreateBox(vertices, indices,
         (Vector3(0,2,2)));
 
-    auto boxMesh = make_unique<MeshGeometry>();
-    boxMesh->Set(devRes, "box", vertices, indices);
-    mGeometries["box"] = std::move(boxMesh);
-    
-    auto model = make_unique<ModelLoader>();
-    model->Load("Assets/Models/Rumba Dancingout/Rumba Dancingout.fbx");
-    mGeometries["model"] = std::move(model->mGeometries[0]);
-    // Load textures
+    // Meshes come from the registry so a scene entered again, or another scene
+    // using the same model, does not load them twice.
+    auto registry = g_pSys->pAssetRegistry.get();
+    mGeometries["box"] = registry->Acquire<MeshGeometry>("Primitives/box", [&](UINT64& bytes)
     {
-        
-
-        ResourceUploadBatch upload(devRes->GetD3DDevice());
-
-        upload.Begin();
-
-        auto water = make_unique<Texture>();
-        DX::ThrowIfFailed((CreateDDSTextureFromFile(devRes->GetD3DDevice(),
-            upload, L"Assets/Textures/water1.dds", water->Resource.ReleaseAndGetAddressOf())));
-        mTextures["water"] = std::move(water);
-
-        // model texture
-        auto diffuse = make_unique<Texture>();
-        DX::ThrowIfFailed((CreateWICTextureFromFile(devRes->GetD3DDevice(),
-            upload, model->mMaterialData[0].diffuse.c_str(), diffuse->Resource.ReleaseAndGetAddressOf())));
-        mTextures["diffuse"] = std::move(diffuse);
+        auto boxMesh = std::make_shared<MeshGeometry>();
+        boxMesh->Set(devRes, "box", vertices, indices);
+        bytes = boxMesh->VertexBufferByteSize + boxMesh->IndexBufferByteSize;
+        return boxMesh;
+    });
 
-        auto normal = make_unique<Texture>();
-        DX::ThrowIfFailed((CreateWICTextureFromFile(devRes->GetD3DDevice(),
-            upload, model->mMaterialData[0].normal.c_str(), normal->Resource.ReleaseAndGetAddressOf())));
-        mTextures["normal"] = std::move(normal);
-        //
-
-        // Upload the resources to the GPU.
-        auto cmdQueue = devRes->GetCommandQueue();
-        auto finish = upload.End(cmdQueue);
-
-        // Wait for the upload thread to terminate
-        finish.wait();
+    auto model = registry->Acquire<ModelLoader>("Assets/Models/Rumba Dancingout/Rumba Dancingout.fbx", [](UINT64& bytes)
+    {
+        auto loader = std::make_shared<ModelLoader>();
+        loader->Load("Assets/Models/Rumba Dancingout/Rumba Dancingout.fbx");
+        if (loader->mGeometries.empty())
+        {
+            return std::shared_ptr<ModelLoader>();
+        }
+        for (const auto& geometry : loader->mGeometries)
+        {
+            bytes += geometry->VertexBufferByteSize + geometry->IndexBufferByteSize;
+        }
+        return loader;
+    });
+    if (model)
+    {
+        // The geometry keeps the whole model alive.
+        mGeometries["model"] = std::shared_ptr<MeshGeometry>(model, model->mGeometries[0].get());
+    }
+    else
+    {
+        // Like a texture that fails to stream, a missing model is reported
+        // and something else is drawn in its place.
+        OutputDebugStringA("SceneMain: failed to load Assets/Models/Rumba Dancingout/Rumba Dancingout.fbx; drawing the box instead\n");
+        mGeometries["model"] = mGeometries["box"];
     }
     // Create root signatures
     {
         CD3DX12_DESCRIPTOR_RANGE cubeAndShadow(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1 + 1 /* cube map + shadow map */, 0);
-        CD3DX12_DESCRIPTOR_RANGE textureSRV(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, mTextures.size(), 2);
+        CD3DX12_DESCRIPTOR_RANGE textureSRV(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, TextureStreamer::DescriptorCount(TextureCapacity), 2);
         CD3DX12_DESCRIPTOR_RANGE textureSampler(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 7, 0);
 
         // Root parameter can be a table, root descriptor or root constants.
@@ -125,11 +124,18 @@ void SceneMain::Initialize()
             NULL, NULL
         };
 
+        const D3D_SHADER_MACRO compactVertexDefines[] =
+        {
+            "COMPACT_VERTEX", "1",
+            NULL, NULL
+        };
+
         mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
         mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_1");
 
         mShaders["VertexPositionNormalTexture_VS"] = d3dUtil::CompileShader(L"Shaders\\VertexPositionNormalTexture.hlsl", nullptr, "VS", "vs_5_1");
         mShaders["VertexPositionNormalTexture_PS"] = d3dUtil::CompileShader(L"Shaders\\VertexPositionNormalTexture.hlsl", nullptr, "PS", "ps_5_1");
+        mShaders["VertexPositionNormalTextureCompact_VS"] = d3dUtil::CompileShader(L"Shaders\\VertexPositionNormalTexture.hlsl", compactVertexDefines, "VS", "vs_5_1");
 
         mShaders["shadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "VS", "vs_5_1");
         mShaders["shadowOpaquePS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "PS", "ps_5_1");
@@ -170,6 +176,19 @@ void SceneMain::Initialize()
             { reinterpret_cast<BYTE*>(mShaders["VertexPositionNormalTexture_PS"]->GetBufferPointer()), mShaders["VertexPositionNormalTexture_PS"]->GetBufferSize() },
             mPSOs["VertexPositionNormalTexture"].GetAddressOf());
 
+        EffectPipelineStateDescription compactPd(
+            &VertexPositionNormalTextureCompact::InputLayout,
+            CommonStates::Opaque,
+            CommonStates::DepthDefault,
+            CommonStates::CullNone,
+            rtState);
+
+        compactPd.CreatePipelineState(devRes->GetD3DDevice(),
+            mRootSignature.Get(),
+            { reinterpret_cast<BYTE*>(mShaders["VertexPositionNormalTextureCompact_VS"]->GetBufferPointer()), mShaders["VertexPositionNormalTextureCompact_VS"]->GetBufferSize() },
+            { reinterpret_cast<BYTE*>(mShaders["VertexPositionNormalTexture_PS"]->GetBufferPointer()), mShaders["VertexPositionNormalTexture_PS"]->GetBufferSize() },
+            mPSOs["VertexPositionNormalTextureCompact"].GetAddressOf());
+
 
 
         D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
@@ -270,50 +289,38 @@ void SceneMain::Initialize()
         m_resourceDescriptors = std::make_unique<DescriptorHeap>(devRes->GetD3DDevice(),
             D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
             D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
-            mTextures.size());
+            TextureStreamer::DescriptorCount(TextureCapacity));
     }
-    // Create SRV
+    // Request textures.  They stream in after Initialize returns; until then
+    // the materials sample the null SRV.
     {
-        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Texture2D.MostDetailedMip = 0;
-        srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-        //srvDesc.Texture2D.MipLevels = 1;
-        srvDesc.Texture2D.MipLevels = mTextures["water"]->Resource->GetDesc().MipLevels;
-        srvDesc.Format = mTextures["water"]->Resource->GetDesc().Format;
-        devRes->GetD3DDevice()->CreateShaderResourceView(
-            mTextures["water"]->Resource.Get(), 
-            &srvDesc,
-            m_resourceDescriptors->GetCpuHandle(mTexturesHeapIndex.size()));
-        mTexturesHeapIndex["water"] = mTexturesHeapIndex.size();
-
-        srvDesc.Texture2D.MipLevels = mTextures["diffuse"]->Resource->GetDesc().MipLevels;
-        srvDesc.Format = mTextures["diffuse"]->Resource->GetDesc().Format;
-        devRes->GetD3DDevice()->CreateShaderResourceView(
-            mTextures["diffuse"]->Resource.Get(),
-            &srvDesc,
-            m_resourceDescriptors->GetCpuHandle(mTexturesHeapIndex.size()));
-        mTexturesHeapIndex["diffuse"] = mTexturesHeapIndex.size();
-
-        srvDesc.Texture2D.MipLevels = mTextures["normal"]->Resource->GetDesc().MipLevels;
-        srvDesc.Format = mTextures["normal"]->Resource->GetDesc().Format;
-        devRes->GetD3DDevice()->CreateShaderResourceView(
-            mTextures["normal"]->Resource.Get(),
-            &srvDesc,
-            m_resourceDescriptors->GetCpuHandle(mTexturesHeapIndex.size()));
-        mTexturesHeapIndex["normal"] = mTexturesHeapIndex.size();
-
+        mTextureStreamer = std::make_unique<TextureStreamer>(devRes, m_resourceDescriptors.get(), 0, TextureCapacity);
+        mTextureStreamer->SetRegistry(registry);
+        mTextureHandles["water"] = mTextureStreamer->Request(L"Assets/Textures/water1.dds");
+        if (model && !model->mMaterialData.empty())
+        {
+            mTextureHandles["diffuse"] = mTextureStreamer->Request(model->mMaterialData[0].diffuse);
+            mTextureHandles["normal"] = mTextureStreamer->Request(model->mMaterialData[0].normal);
+        }
     }
     // Create material
     {
+        // Textures that were never requested stay on the null SRV.
+        auto handle = [this](const char* name)
+        {
+            auto found = mTextureHandles.find(name);
+            return found == mTextureHandles.end() ? -1 : (int)found->second;
+        };
+
         auto waterMat = make_unique<Material>();
-        waterMat->SetDiffuse("water", mMaterials.size(), mTexturesHeapIndex["water"]);
+        waterMat->SetDiffuse("water", mMaterials.size(), mTextureStreamer->NullSrvIndex());
+        mStreamedMaterials.push_back({ waterMat.get(), handle("water"), -1 });
         mMaterials["water"] = std::move(waterMat);
 
         auto modelMat = make_unique<Material>();
         modelMat->SetDiffuseNormal("model", mMaterials.size(),
-            mTexturesHeapIndex["diffuse"], mTexturesHeapIndex["normal"]);
+            mTextureStreamer->NullSrvIndex(), mTextureStreamer->NullSrvIndex());
+        mStreamedMaterials.push_back({ modelMat.get(), handle("diffuse"), handle("normal") });
         mMaterials["model"] = std::move(modelMat);
         
     }
@@ -328,6 +335,50 @@ void SceneMain::Initialize()
         mRitemLayer[(int)RenderLayer::Opaque].push_back(modelRenderItem.get());
         mAllRitems.push_back(std::move(modelRenderItem));
     }
+    // Place render items under one scene root.
+    {
+        mTransforms = make_unique<TransformHierarchy>();
+        const UINT root = mTransforms->Add();
+        for (auto& ri : mAllRitems)
+        {
+            ri->TransformNode = mTransforms->Add(root);
+        }
+        mTransforms->SetLocal(mAllRitems[1]->TransformNode, Vector3(0.0f, -2.0f, 0.0f),
+            Quaternion::Identity, Vector3(.05f, .05f, .05f));
+    }
+    // Register render items for culling.  Update passes on the worlds the
+    // hierarchy changes; items outside it keep the world they have now.  The
+    // box is solid, so its own bounds can hide what is behind it.
+    {
+        mCulling = make_unique<CullingStage>();
+        mOcclusion = make_unique<OcclusionBuffer>();
+        for (int layer = 0; layer < (int)RenderLayer::Count; layer++)
+        {
+            for (auto ri : mRitemLayer[layer])
+            {
+                ri->CullIndex = mCulling->Add(ri->Geo->Bounds, (RenderLayer)layer);
+                mCulling->SetWorld(ri->CullIndex, ri->world);
+                mCulledRitems.push_back(ri);
+            }
+        }
+        mCulling->SetOccluder(mAllRitems[0]->CullIndex, mAllRitems[0]->Geo->Bounds);
+    }
+    // Sort keys, so draws are grouped by PSO, material and geometry.
+    {
+        mDrawQueue = make_unique<DrawQueue>();
+        mDrawPipelines = { mPSOs["VertexPositionNormalTexture"].Get(), mPSOs["VertexPositionNormalTextureCompact"].Get() };
+
+        std::unordered_map<MeshGeometry*, UINT> geometryIds;
+        for (int layer = 0; layer < (int)RenderLayer::Count; layer++)
+        {
+            for (auto ri : mRitemLayer[layer])
+            {
+                const UINT geometry = geometryIds.emplace(ri->Geo, (UINT)geometryIds.size()).first->second;
+                ri->DrawKey = DrawQueue::MakeKey((RenderLayer)layer, ri->Geo->CompactVertices ? 1 : 0,
+                    ri->Mat->MatCBIndex, geometry);
+            }
+        }
+    }
     // Create frame resources
     for (int i = 0; i < gNumFrameResources; ++i)
     {
@@ -337,62 +388,78 @@ void SceneMain::Initialize()
             mMaterials.size()   // materials
             ));
     }
+    mObjectConstants = make_unique<ConstantBufferStore<ObjectConstants>>(mAllRitems.size(), gNumFrameResources,
+        mFrameResources[0]->ObjectCB->ElementByteSize());
+    // MoveToNextFrame waits for the frame that last used the next back
+    // buffer, whose command allocator it resets, so no more frames than there
+    // are back buffers can be queued whatever the pacer allows.
+    mFramePacer = make_unique<FramePacer>(make_unique<D3D12FrameFence>(devRes),
+        std::min<UINT>(gNumFrameResources, devRes->GetBackBufferCount()));
 }
 
 void SceneMain::Update(DX::StepTimer const& timer)
 {
 
-    auto fence = g_pSys->pDeviceResources->GetFence();
-
-    // Cycle through the circular frame resource array.
-    mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
+    // Wait until the GPU is done with the frame resource this frame uses.
+    mCurrFrameResourceIndex = mFramePacer->BeginFrame();
     mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
-    // Has the GPU finished processing the commands of the current frame resource?
-    // If not, wait until the GPU has completed commands up to this fence point.
-    if (mCurrFrameResource->Fence != 0 && fence->GetCompletedValue() < mCurrFrameResource->Fence)
-    {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        DX::ThrowIfFailed(fence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
-    }
-
-
     // Update camera
     mCamera.UpdateViewMatrix();
 
     // Update object scale rot pos
     static float angle = 0.0f;
     angle += timer.GetElapsedSeconds();
-    Matrix rot = Matrix::CreateFromYawPitchRoll(DirectX::XMConvertToRadians(angle * 10.0f), 
+    Quaternion rot = Quaternion::CreateFromYawPitchRoll(DirectX::XMConvertToRadians(angle * 10.0f), 
         DirectX::XMConvertToRadians(angle * 10.0f),
         0.0f);
+    mTransforms->SetLocal(mAllRitems[0]->TransformNode, Vector3::Zero, rot);
+    mTransforms->Update();
 
-    Matrix scale = Matrix::CreateScale(.05f, .05f, .05f);
-    Matrix pos = Matrix::CreateTranslation(0.0f, -2.0f, 0.0f);
-    mAllRitems[0]->world = rot;
-    mAllRitems[1]->world = scale * pos;
+    for (auto& e : mAllRitems)
+    {
+        if (e->TransformNode != UINT(-1) && mTransforms->WorldChanged(e->TransformNode))
+        {
+            e->world = mTransforms->World(e->TransformNode);
+            e->NumFramesDirty = gNumFrameResources;
+            mCulling->SetWorld(e->CullIndex, e->world);
+        }
+    }
     //
 
     // Update object buffer
-    auto currObjectCB = mCurrFrameResource->ObjectCB.get();
     for (auto& e : mAllRitems)
     {
-        // Only update the cbuffer data if the constants have changed.  
-        // This needs to be tracked per frame resource.
+        // Only hand over the constants that have changed; the store takes
+        // care of writing them to every FrameResource.
         if (e->NumFramesDirty > 0)
         {
-            
             ObjectConstants objConstants;
             objConstants.world = e->world;
             objConstants.texTransform = e->TexTransform;
             objConstants.materialIndex = e->Mat->MatCBIndex;
+            objConstants.posScale = e->Geo->PositionScale;
+            objConstants.posBias = e->Geo->PositionBias;
 
-            currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+            mObjectConstants->Set(e->ObjCBIndex, objConstants);
 
-            // Next FrameResource need to be updated too.
-            //e->NumFramesDirty--;
+            e->NumFramesDirty = 0;
+        }
+    }
+    auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+    mObjectConstants->Flush(mCurrFrameResourceIndex, currObjectCB->MappedData());
+
+    // Upload streamed texture mips and point the materials at what is resident.
+    mTextureStreamer->Update(++mFrameCount, mFramePacer->FramesInFlight());
+    for (auto& e : mStreamedMaterials)
+    {
+        const int diffuse = e.DiffuseTexture < 0 ? e.Mat->DiffuseSrvHeapIndex : (int)mTextureStreamer->SrvIndex(e.DiffuseTexture);
+        const int normal = e.NormalTexture < 0 ? e.Mat->NormalSrvHeapIndex : (int)mTextureStreamer->SrvIndex(e.NormalTexture);
+        if (diffuse != e.Mat->DiffuseSrvHeapIndex || normal != e.Mat->NormalSrvHeapIndex)
+        {
+            e.Mat->DiffuseSrvHeapIndex = diffuse;
+            e.Mat->NormalSrvHeapIndex = normal;
+            e.Mat->NumFramesDirty = gNumFrameResources;
         }
     }
 
@@ -432,6 +499,8 @@ void SceneMain::Update(DX::StepTimer const& timer)
 
     mMainPassCB.ViewProj = viewProj;
     mMainPassCB.InvViewProj = viewProj.Invert();
+
+    mCulling->Cull(viewProj, mOcclusion.get());
     mMainPassCB.ShadowTransform = shadowTransform;
     mMainPassCB.EyePosW = mCamera.GetPosition();
 
@@ -466,6 +535,25 @@ void SceneMain::Update(DX::StepTimer const& timer)
     }
     ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+    ImGui::Text("Frames in flight %u, latency p50 %.1f ms p90 %.1f ms, CPU wait p90 %.1f ms", mFramePacer->FramesInFlight(),
+        mFramePacer->Latencies().Percentile(0.5) * 1000.0, mFramePacer->Latencies().Percentile(0.9) * 1000.0,
+        mFramePacer->CpuWaits().Percentile(0.9) * 1000.0);
+    float latencyTarget = (float)mFramePacer->LatencyTarget() * 1000.0f;
+    if (ImGui::SliderFloat("Latency target (ms, 0 = off)", &latencyTarget, 0.0f, 100.0f))
+    {
+        mFramePacer->SetLatencyTarget(latencyTarget / 1000.0f);
+    }
+    ImGui::Checkbox("Parallel recording", &mParallelRecording);
+    ImGui::SameLine();
+    ImGui::Text("%u command lists", mRecordingChunks);
+    ImGui::SliderInt("Min draws per list", &mMinDrawsPerList, 1, DrawQueue::MinDrawsPerChunk);
+    const auto& drawStats = mDrawQueue->GetStats();
+    ImGui::Text("Draws %u: PSO %u, VB %u, IB %u, CBV %u changes, %u redundant skipped", drawStats.Draws,
+        drawStats.PipelineChanges, drawStats.VertexBufferChanges, drawStats.IndexBufferChanges,
+        drawStats.ConstantBufferChanges, drawStats.RedundantSkipped);
+    const auto& cullStats = mCulling->GetStats();
+    ImGui::Text("Culled %u of %u (frustum %u, occlusion %u)", cullStats.FrustumCulled + cullStats.OcclusionCulled,
+        cullStats.Tested, cullStats.FrustumCulled, cullStats.OcclusionCulled);
     ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
     ImGui::Text("");
     ImGui::End();
@@ -479,48 +567,73 @@ void SceneMain::Render()
 
     auto cmdList = g_pSys->pDeviceResources->GetCommandList();
 
-    ID3D12DescriptorHeap* descriptorHeaps[] = { m_resourceDescriptors->Heap() };
-    cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-
-    // Set render state
-    cmdList->SetGraphicsRootSignature(mRootSignature.Get());
-
     auto passCB = mCurrFrameResource->PassCB->Resource();
-    cmdList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
-
     auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-    cmdList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
-
-    cmdList->SetGraphicsRootDescriptorTable(3, m_resourceDescriptors->GetFirstGpuHandle());
 
-    // Set the viewport and scissor rect.
-    auto viewport = g_pSys->pDeviceResources->GetScreenViewport();
-    auto scissorRect = g_pSys->pDeviceResources->GetScissorRect();
-    cmdList->RSSetViewports(1, &viewport);
-    cmdList->RSSetScissorRects(1, &scissorRect);
+    // Set render state
+    auto setRenderState = [=](ID3D12GraphicsCommandList* list)
+    {
+        ID3D12DescriptorHeap* descriptorHeaps[] = { m_resourceDescriptors->Heap() };
+        list->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+        list->SetGraphicsRootSignature(mRootSignature.Get());
+        list->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+        list->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
+        list->SetGraphicsRootDescriptorTable(3, m_resourceDescriptors->GetFirstGpuHandle());
+
+        // Set the viewport and scissor rect.
+        auto viewport = g_pSys->pDeviceResources->GetScreenViewport();
+        auto scissorRect = g_pSys->pDeviceResources->GetScissorRect();
+        list->RSSetViewports(1, &viewport);
+        list->RSSetScissorRects(1, &scissorRect);
+    };
+    setRenderState(cmdList);
 
     // Render opaque objects
     UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 
     auto objectCB = mCurrFrameResource->ObjectCB->Resource();
 
-    cmdList->SetPipelineState(mPSOs["VertexPositionNormalTexture"].Get());
-
-    // For each render item...
-    for (size_t i = 0; i < mRitemLayer[(int)RenderLayer::Opaque].size(); ++i)
+    // Queue the visible render items and draw them in key order.
+    mDrawQueue->Clear();
+    for (UINT item : mCulling->Visible(RenderLayer::Opaque))
     {
-        auto ri = mRitemLayer[(int)RenderLayer::Opaque][i];
-
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-        cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
-
-        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
-
-        cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
-
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+        auto ri = mCulledRitems[item];
+
+        DrawCommand command;
+        command.Pso = mDrawPipelines[ri->Geo->CompactVertices ? 1 : 0];
+        command.Topology = ri->PrimitiveType;
+        command.VertexBuffer = ri->Geo->VertexBufferView();
+        command.IndexBuffer = ri->Geo->IndexBufferView();
+        command.ObjectConstants = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+        command.IndexCount = ri->IndexCount;
+        command.StartIndexLocation = ri->StartIndexLocation;
+        command.BaseVertexLocation = ri->BaseVertexLocation;
+        command.IndexRanges = &ri->Geo->IndexRanges;
+
+        const Vector3 center = Vector3::Transform(Vector3::Transform(ri->Geo->Bounds.Center, ri->world), mMainPassCB.View);
+        mDrawQueue->Add(DrawQueue::SetDepth(ri->DrawKey, center.z / mMainPassCB.FarZ), command);
     }
+    mDrawQueue->Sort();
 
-
+    // Worker command lists start empty, so they also need the render targets
+    // the main list got when it was cleared.
+    if (mParallelRecording && mDrawQueue->Size() >= 2 * (UINT)mMinDrawsPerList)
+    {
+        auto rtvDescriptor = g_pSys->pDeviceResources->GetRenderTargetView();
+        auto dsvDescriptor = g_pSys->pDeviceResources->GetDepthStencilView();
+        mCurrFrameResource->DrawLists->SetChunkState(0, [=](ID3D12GraphicsCommandList* list)
+        {
+            list->OMSetRenderTargets(1, &rtvDescriptor, FALSE, &dsvDescriptor);
+            setRenderState(list);
+        });
+        mRecordingChunks = mDrawQueue->RecordParallel(*mCurrFrameResource->DrawLists,
+            std::max<unsigned>(1u, std::thread::hardware_concurrency()), (UINT)mMinDrawsPerList);
+    }
+    else
+    {
+        D3D12DrawRecorder recorder(cmdList, 0);
+        mDrawQueue->Record(recorder);
+        mRecordingChunks = 1;
+    }
 }
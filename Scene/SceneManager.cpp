@@ -1,4 +1,5 @@
 #include "Scene.h"
+#include "../SystemTable.h"
 
 void SceneManager::Update(DX::StepTimer const& timer)
 {
@@ -12,7 +13,13 @@ void SceneManager::Render()
 
 void SceneManager::ChangeScene(Scene* new_scene)
 {
+    // Assets the old scene released stay cached until the GPU is done with them.
+    if (currentScene)
+    {
+        g_pSys->pDeviceResources->WaitForGpu();
+    }
     currentScene.reset(new_scene);
+    g_pSys->pAssetRegistry->Trim();
 
     if (!currentScene->initialized)
     {
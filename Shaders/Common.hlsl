@@ -59,6 +59,10 @@ cbuffer cbPerObject : register(b0)
 	uint gObjPad0;
 	uint gObjPad1;
 	uint gObjPad2;
+	float3 gPosScale;
+	float gObjPad3;
+	float3 gPosBias;
+	float gObjPad4;
 };
 
 cbuffer cbPass : register(b1)
@@ -87,6 +91,23 @@ cbuffer cbPass : register(b1)
     Light gLights[MaxLights];
 };
 
+//---------------------------------------------------------------------------------------
+// Decoding of VertexPositionNormalTextureCompact (COMPACT_VERTEX).  Positions
+// are unorm relative to the mesh bounds; normals and tangents are octahedral.
+//---------------------------------------------------------------------------------------
+float3 DecodePosition(float3 unorm)
+{
+	return unorm * gPosScale + gPosBias;
+}
+
+float3 DecodeOctahedral(float2 e)
+{
+	float3 v = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-v.z, 0.0f);
+	v.xy += (v.xy >= 0.0f) ? -t : t;
+	return normalize(v);
+}
+
 //---------------------------------------------------------------------------------------
 // Transforms a normal map sample to world space.
 //---------------------------------------------------------------------------------------
@@ -20,10 +20,17 @@
 
 struct VertexIn
 {
+#ifdef COMPACT_VERTEX
+	// Matches VertexPositionNormalTextureCompact::InputLayout.
+	float4 PosL    : SV_Position;
+	float4 NormalTangentOct : NORMAL;
+	float2 TexC    : TEXCOORD;
+#else
 	float3 PosL    : POSITION;
     float3 NormalL : NORMAL;
 	float2 TexC    : TEXCOORD;
 	float3 TangentU : TANGENT;
+#endif
 };
 
 struct VertexOut
@@ -44,14 +51,25 @@ VertexOut VS(VertexIn vin)
 	// Fetch the material data.
 	MaterialData matData = gMaterialData[gMaterialIndex];
 	
+#ifdef COMPACT_VERTEX
+	float3 posL = DecodePosition(vin.PosL.xyz);
+	float3 normalL = DecodeOctahedral(vin.NormalTangentOct.xy);
+	// Derived from the UVs when encoding (VertexCompression::ComputeTangents).
+	float3 tangentL = DecodeOctahedral(vin.NormalTangentOct.zw);
+#else
+	float3 posL = vin.PosL;
+	float3 normalL = vin.NormalL;
+	float3 tangentL = vin.TangentU;
+#endif
+
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(posL, 1.0f), gWorld);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(normalL, (float3x3)gWorld);
 	
-	vout.TangentW = mul(vin.TangentU, (float3x3)gWorld);
+	vout.TangentW = mul(tangentL, (float3x3)gWorld);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
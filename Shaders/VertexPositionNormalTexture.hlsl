@@ -20,8 +20,13 @@
 
 struct VertexIn
 {
+#ifdef COMPACT_VERTEX
+    float4 PosL    : SV_Position;
+    float4 NormalTangentOct : NORMAL;
+#else
     float3 PosL    : SV_Position;
     float3 NormalL : NORMAL;
+#endif
     float2 TexC : TEXCOORD;
 };
 
@@ -40,12 +45,20 @@ VertexOut VS(VertexIn vin)
     // Fetch the material data.
     MaterialData matData = gMaterialData[gMaterialIndex];
 
+#ifdef COMPACT_VERTEX
+    float3 posL = DecodePosition(vin.PosL.xyz);
+    float3 normalL = DecodeOctahedral(vin.NormalTangentOct.xy);
+#else
+    float3 posL = vin.PosL;
+    float3 normalL = vin.NormalL;
+#endif
+
     // Transform to world space.
-    float4 posW = mul(gWorld, float4(vin.PosL, 1.0f));
+    float4 posW = mul(gWorld, float4(posL, 1.0f));
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul((float3x3)gWorld, vin.NormalL);
+    vout.NormalW = mul((float3x3)gWorld, normalL);
     
     // Transform to homogeneous clip space.
     vout.PosH = mul(gViewProj, posW );
@@ -5,6 +5,7 @@ RUNTIME_MODIFIABLE_INCLUDE; //recompile runtime files when this changes
 
 #include "ObjectInterfacePerModule.h"
 #include "Common/DeviceResources.h"
+#include "Common/AssetRegistry.h"
 #include "Scene/Scene.h"
 #include "DirectXTK12/Inc/DescriptorHeap.h"
 
@@ -31,6 +32,7 @@ struct SystemTable
     
     std::unique_ptr<DX::DeviceResources>            pDeviceResources = NULL;
     std::unique_ptr<DescriptorHeap>                 pd3dSrvDescHeap = NULL;
+    std::unique_ptr<AssetRegistry>                  pAssetRegistry = NULL;
 
     ImGui_ImplDX12_RenderDrawDataFunc ImGui_ImplDX12_RenderDrawData = NULL;
     
@@ -0,0 +1,161 @@
+#include "Test.h"
+#include "../Common/AssetRegistry.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+    struct TestAsset
+    {
+        int Value = 0;
+    };
+
+    struct OtherAsset
+    {
+        int Value = 0;
+    };
+
+    void WriteFile(const char* path, const std::string& contents)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << contents;
+    }
+
+    // Loads a TestAsset whose value is the number of loads so far.
+    std::shared_ptr<TestAsset> AcquireCounting(AssetRegistry& registry, const std::string& path, int& loads)
+    {
+        return registry.Acquire<TestAsset>(path, [&](UINT64& bytes)
+        {
+            auto asset = std::make_shared<TestAsset>();
+            asset->Value = ++loads;
+            bytes = 16;
+            return asset;
+        });
+    }
+
+    // Removes the files it was given when the case ends.
+    struct TemporaryFiles
+    {
+        ~TemporaryFiles()
+        {
+            for (const char* path : Paths)
+            {
+                remove(path);
+            }
+        }
+
+        std::vector<const char*> Paths;
+    };
+}
+
+TEST_CASE(AssetRegistryFindsPathsWithoutHashing)
+{
+    TemporaryFiles files;
+    files.Paths = { "AssetRegistryTests_a.bin", "AssetRegistryTests_long.bin" };
+    WriteFile(files.Paths[0], "0123456789");
+    WriteFile(files.Paths[1], "a longer file");
+
+    AssetRegistry registry;
+    int loads = 0;
+    auto first = AcquireCounting(registry, "AssetRegistryTests_a.bin", loads);
+    auto again = AcquireCounting(registry, "./ASSETREGISTRYTESTS_A.BIN", loads);
+    CHECK(first && first == again);
+    CHECK(loads == 1);
+
+    // No other file has its size, so nothing is hashed.
+    auto other = AcquireCounting(registry, "AssetRegistryTests_long.bin", loads);
+    CHECK(other && other != first);
+    CHECK(loads == 2);
+
+    const AssetRegistry::Stats stats = registry.GetStats();
+    CHECK(stats.PathHits == 1);
+    CHECK(stats.Loads == 2);
+    CHECK(stats.FilesHashed == 0);
+}
+
+TEST_CASE(AssetRegistryHashesFilesOfTheSameSize)
+{
+    TemporaryFiles files;
+    files.Paths = { "AssetRegistryTests_a.bin", "AssetRegistryTests_copy.bin", "AssetRegistryTests_b.bin" };
+    WriteFile(files.Paths[0], "0123456789");
+    WriteFile(files.Paths[1], "0123456789");
+    WriteFile(files.Paths[2], "9876543210");
+
+    AssetRegistry registry;
+    int loads = 0;
+    auto original = AcquireCounting(registry, files.Paths[0], loads);
+    CHECK(registry.GetStats().FilesHashed == 0);
+
+    // Same size: both files are hashed and the copy shares the asset.
+    auto copy = AcquireCounting(registry, files.Paths[1], loads);
+    CHECK(copy == original);
+    CHECK(loads == 1);
+    CHECK(registry.GetStats().ContentHits == 1);
+    CHECK(registry.GetStats().FilesHashed == 2);
+
+    // The copy is now another name for it.
+    CHECK(AcquireCounting(registry, files.Paths[1], loads) == original);
+    CHECK(registry.GetStats().FilesHashed == 2);
+
+    // Same size, other contents: only the new file needs hashing.
+    auto different = AcquireCounting(registry, files.Paths[2], loads);
+    CHECK(different && different != original);
+    CHECK(loads == 2);
+    CHECK(registry.GetStats().FilesHashed == 3);
+
+    // Other asset types never match.
+    auto typed = registry.Acquire<OtherAsset>(files.Paths[0], [](UINT64& bytes)
+    {
+        bytes = 16;
+        return std::make_shared<OtherAsset>();
+    });
+    CHECK(typed != nullptr);
+    CHECK(registry.GetStats().Loads == 3);
+    CHECK(registry.GetStats().FilesHashed == 3);
+    CHECK(registry.AssetCount() == 3);
+}
+
+TEST_CASE(AssetRegistryReloadsEditedFiles)
+{
+    TemporaryFiles files;
+    files.Paths = { "AssetRegistryTests_a.bin" };
+    WriteFile(files.Paths[0], "0123456789");
+
+    AssetRegistry registry;
+    int loads = 0;
+    auto before = AcquireCounting(registry, files.Paths[0], loads);
+    CHECK(before && before->Value == 1);
+
+    WriteFile(files.Paths[0], "edited, and longer");
+    auto after = AcquireCounting(registry, files.Paths[0], loads);
+    CHECK(after && after->Value == 2);
+    CHECK(AcquireCounting(registry, files.Paths[0], loads) == after);
+
+    // The old asset lives on for whoever still holds it, until trimmed.
+    CHECK(before->Value == 1);
+    CHECK(registry.AssetCount() == 2);
+    before.reset();
+    registry.SetBudget(16);
+    CHECK(registry.AssetCount() == 1);
+    CHECK(AcquireCounting(registry, files.Paths[0], loads) == after);
+}
+
+TEST_CASE(AssetRegistryKeepsGeneratedAssetsByPath)
+{
+    AssetRegistry registry;
+    int loads = 0;
+    auto first = AcquireCounting(registry, "Primitives/box", loads);
+    auto again = AcquireCounting(registry, "primitives\\box", loads);
+    CHECK(first && first == again);
+    CHECK(loads == 1);
+    CHECK(registry.GetStats().FilesHashed == 0);
+
+    // A failed load is not registered, so the next call tries again.
+    auto failed = registry.Acquire<OtherAsset>("Primitives/missing", [](UINT64&)
+    {
+        return std::shared_ptr<OtherAsset>();
+    });
+    CHECK(failed == nullptr);
+    CHECK(registry.AssetCount() == 1);
+}
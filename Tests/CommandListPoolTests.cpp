@@ -0,0 +1,173 @@
+#include "Test.h"
+#include "../Common/CommandListPool.h"
+
+#include <atomic>
+
+namespace
+{
+    struct PoolFixture
+    {
+        PoolFixture()
+        {
+            auto backend = std::make_unique<NullCommandListBackend>();
+            mBackend = backend.get();
+            mPool = std::make_unique<CommandListPool>(std::move(backend));
+        }
+
+        // Sets the chunk state with a setup that only counts its calls.
+        void SetChunkState(UINT objectConstantsParameter)
+        {
+            mPool->SetChunkState(objectConstantsParameter, [this](ID3D12GraphicsCommandList* list)
+            {
+                mSetupCount++;
+            });
+        }
+
+        NullCommandListBackend* mBackend;
+        std::unique_ptr<CommandListPool> mPool;
+        std::atomic<UINT> mSetupCount{ 0 };
+    };
+
+    // count draws, each with its own constants, over a few pipelines and
+    // vertex buffers; the index count names the draw.
+    void FillQueue(DrawQueue& queue, UINT count)
+    {
+        queue.Clear();
+        for (UINT i = 0; i < count; i++)
+        {
+            DrawCommand command;
+            command.Pso = reinterpret_cast<ID3D12PipelineState*>((UINT_PTR)(0x1000 * (1 + i % 3)));
+            command.VertexBuffer.BufferLocation = 0x10000 * (1 + i % 5);
+            command.ObjectConstants = 0x100 * (i + 1);
+            command.IndexCount = i + 1;
+            queue.Add(DrawQueue::MakeKey(RenderLayer::Opaque, 1 + i % 3, 0, i % 5, (float)(i % 97) / 97.0f), command);
+        }
+        queue.Sort();
+    }
+
+    std::vector<UINT64> Draws(const MockDrawRecorder& recorder)
+    {
+        std::vector<UINT64> draws;
+        for (const auto& call : recorder.mCalls)
+        {
+            if (call.Type == MockDrawRecorder::Call::DrawIndexed)
+            {
+                draws.push_back(call.Value);
+            }
+        }
+        return draws;
+    }
+}
+
+TEST_CASE(CommandListPoolKeepsListsAndRecorders)
+{
+    PoolFixture fixture;
+    CommandListPool& pool = *fixture.mPool;
+    const std::vector<NullCommandListBackend::List>& lists = fixture.mBackend->mLists;
+
+    fixture.SetChunkState(2);
+    pool.Reset(3);
+    CHECK(pool.ListCount() == 3 && lists.size() == 3);
+    for (UINT chunk = 0; chunk < 3; chunk++)
+    {
+        DrawRecorder& recorder = pool.BeginChunk(chunk);
+        CHECK(&recorder == &lists[chunk].Recorder);
+        CHECK(lists[chunk].Open && lists[chunk].ObjectConstantsParameter == 2);
+        recorder.DrawIndexed(3, 0, 0);
+        pool.EndChunk(chunk);
+        CHECK(!lists[chunk].Open);
+    }
+    pool.Submit(3);
+    CHECK((fixture.mBackend->mExecuted == std::vector<UINT>{ 3 }));
+    CHECK(fixture.mSetupCount == 3);
+
+    // The next frame needs fewer lists: none are created, and the recorders
+    // are the same ones, reset for the new state.
+    fixture.SetChunkState(5);
+    pool.Reset(2);
+    CHECK(pool.ListCount() == 3 && lists.size() == 3);
+    DrawRecorder& again = pool.BeginChunk(1);
+    CHECK(&again == &lists[1].Recorder);
+    CHECK(lists[1].Recorder.mCalls.empty());
+    CHECK(lists[1].ObjectConstantsParameter == 5 && lists[1].OpenCount == 2);
+    pool.EndChunk(1);
+    CHECK(fixture.mSetupCount == 4);
+
+    // Without a setup the lists are only opened.
+    pool.SetChunkState(0, nullptr);
+    pool.BeginChunk(0);
+    pool.EndChunk(0);
+    CHECK(fixture.mSetupCount == 4 && lists[0].OpenCount == 2);
+}
+
+TEST_CASE(CommandListPoolRecordsDrawQueueInParallel)
+{
+    PoolFixture fixture;
+    const std::vector<NullCommandListBackend::List>& lists = fixture.mBackend->mLists;
+    DrawQueue queue;
+
+    // Four chunks' worth of draws, more than the scene's threshold for
+    // recording in parallel.
+    FillQueue(queue, 4 * DrawQueue::MinDrawsPerChunk);
+    MockDrawRecorder single;
+    queue.Record(single);
+
+    fixture.SetChunkState(0);
+    CHECK(queue.RecordParallel(*fixture.mPool, 4) == 4);
+    CHECK(lists.size() == 4);
+    CHECK((fixture.mBackend->mExecuted == std::vector<UINT>{ 4 }));
+    CHECK(fixture.mSetupCount == 4);
+
+    std::vector<UINT64> recorded;
+    bool closedOnce = true;
+    for (const auto& list : lists)
+    {
+        const std::vector<UINT64> draws = Draws(list.Recorder);
+        recorded.insert(recorded.end(), draws.begin(), draws.end());
+        closedOnce = closedOnce && !list.Open && list.OpenCount == 1;
+    }
+    CHECK(closedOnce);
+    CHECK(recorded == Draws(single));
+
+    // A smaller frame reuses the first lists and leaves the rest alone.
+    FillQueue(queue, 2 * DrawQueue::MinDrawsPerChunk);
+    CHECK(queue.RecordParallel(*fixture.mPool, 4) == 2);
+    CHECK(lists.size() == 4);
+    CHECK((fixture.mBackend->mExecuted == std::vector<UINT>{ 4, 2 }));
+    CHECK(lists[0].OpenCount == 2 && lists[1].OpenCount == 2);
+    CHECK(lists[2].OpenCount == 1 && lists[3].OpenCount == 1);
+    CHECK(Draws(lists[0].Recorder).size() + Draws(lists[1].Recorder).size() == 2 * DrawQueue::MinDrawsPerChunk);
+}
+
+TEST_CASE(CommandListPoolSplitsSceneSizedQueuesWithALowerMinimum)
+{
+    PoolFixture fixture;
+    const std::vector<NullCommandListBackend::List>& lists = fixture.mBackend->mLists;
+    DrawQueue queue;
+
+    // As many draws as the scene has: one list at the default chunk size, a
+    // list per draw once chunks may hold a single one.
+    FillQueue(queue, 3);
+    MockDrawRecorder single;
+    queue.Record(single);
+
+    fixture.SetChunkState(0);
+    CHECK(queue.RecordParallel(*fixture.mPool, 4) == 1);
+    CHECK(queue.RecordParallel(*fixture.mPool, 4, 1) == 3);
+    CHECK(lists.size() == 3);
+    CHECK((fixture.mBackend->mExecuted == std::vector<UINT>{ 1, 3 }));
+    CHECK(fixture.mSetupCount == 4);
+
+    std::vector<UINT64> recorded;
+    for (const auto& list : lists)
+    {
+        const std::vector<UINT64> draws = Draws(list.Recorder);
+        CHECK(draws.size() == 1);
+        recorded.insert(recorded.end(), draws.begin(), draws.end());
+    }
+    CHECK(recorded == Draws(single));
+
+    // Never more lists than allowed, and a minimum of 0 counts as 1.
+    CHECK(queue.RecordParallel(*fixture.mPool, 2, 1) == 2);
+    CHECK(queue.RecordParallel(*fixture.mPool, 4, 0) == 3);
+}
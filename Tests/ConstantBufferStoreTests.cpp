@@ -0,0 +1,191 @@
+#include "Test.h"
+#include "../Common/d3dUtil.h"
+#include "../Common/ConstantBufferStore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    struct TestConstants
+    {
+        float Values[4];
+    };
+
+    // Constant buffer elements are padded to 256 bytes.
+    const size_t ElementByteSize = 256;
+
+    TestConstants MakeConstants(float value)
+    {
+        return { { value, value + 1.0f, value + 2.0f, value + 3.0f } };
+    }
+
+    // Stands in for the mapped upload buffers of the frame resources, with the
+    // contents every one of them should have after its flush alongside.
+    struct MappedFrames
+    {
+        MappedFrames(size_t elementCount) :
+            Expected(elementCount * ElementByteSize, 0)
+        {
+            for (int i = 0; i < gNumFrameResources; i++)
+            {
+                // Garbage, as in a freshly created upload heap.
+                Frames.emplace_back(elementCount * ElementByteSize, 0xCD);
+            }
+        }
+
+        void Set(ConstantBufferStore<TestConstants>& store, size_t element, float value)
+        {
+            const TestConstants constants = MakeConstants(value);
+            store.Set(element, constants);
+            memcpy(&Expected[element * ElementByteSize], &constants, sizeof(constants));
+        }
+
+        bool Flush(ConstantBufferStore<TestConstants>& store, size_t frameIndex)
+        {
+            store.Flush(frameIndex, Frames[frameIndex].data());
+            return Frames[frameIndex] == Expected;
+        }
+
+        std::vector<std::vector<uint8_t>> Frames;
+        std::vector<uint8_t> Expected;
+    };
+}
+
+TEST_CASE(ConstantBufferStoreCoalescesDirtyRuns)
+{
+    ConstantBufferStore<TestConstants> store(16, gNumFrameResources, ElementByteSize);
+    MappedFrames mapped(16);
+    for (size_t i = 0; i < 16; i++)
+    {
+        mapped.Set(store, i, (float)i);
+    }
+
+    // Every frame resource starts with the whole buffer, padding included.
+    for (int frame = 0; frame < gNumFrameResources; frame++)
+    {
+        CHECK(mapped.Flush(store, frame));
+        CHECK(store.LastFlush().Runs == 1);
+        CHECK(store.LastFlush().Elements == 16);
+        CHECK(store.LastFlush().Bytes == 16 * ElementByteSize);
+    }
+
+    // Adjacent elements, set in any order and more than once, make one run.
+    mapped.Set(store, 4, 40.0f);
+    mapped.Set(store, 2, 20.0f);
+    mapped.Set(store, 3, 30.0f);
+    mapped.Set(store, 2, 21.0f);
+    mapped.Set(store, 9, 90.0f);
+    CHECK(mapped.Flush(store, 0));
+    CHECK(store.LastFlush().Runs == 2);
+    CHECK(store.LastFlush().Elements == 4);
+    CHECK(store.LastFlush().Bytes == 4 * ElementByteSize);
+    CHECK(store.Get(2).Values[0] == 21.0f);
+
+    // Nothing changed since frame 0's flush, but frame 1 missed those sets.
+    CHECK(mapped.Flush(store, 1));
+    CHECK(store.LastFlush().Runs == 2 && store.LastFlush().Elements == 4);
+
+    // Frame 0 is up to date.
+    CHECK(mapped.Flush(store, 0));
+    CHECK(store.LastFlush().Runs == 0 && store.LastFlush().Bytes == 0);
+}
+
+TEST_CASE(ConstantBufferStoreRollsGenerationsOverFrameResources)
+{
+    const size_t elementCount = 64;
+    ConstantBufferStore<TestConstants> store(elementCount, gNumFrameResources, ElementByteSize);
+    MappedFrames mapped(elementCount);
+
+    // The frame loop: a few sets, then a flush of the next frame resource.
+    // Every flush has to leave its buffer exactly like the staging copy,
+    // however the changes are spread over the generations it missed.
+    std::mt19937 random(7);
+    bool allMatched = true;
+    size_t partialFlushes = 0;
+    for (int frame = 0; frame < 200; frame++)
+    {
+        const int sets = (int)(random() % 6);
+        for (int i = 0; i < sets; i++)
+        {
+            mapped.Set(store, random() % elementCount, (float)frame);
+        }
+        allMatched = mapped.Flush(store, frame % gNumFrameResources) && allMatched;
+        partialFlushes += store.LastFlush().Elements < elementCount ? 1 : 0;
+    }
+    CHECK(allMatched);
+    CHECK(partialFlushes > 150);
+
+    // Round robin, each frame resource is gNumFrameResources generations
+    // behind and gets the changes of all of them.
+    for (int frame = 0; frame < gNumFrameResources; frame++)
+    {
+        mapped.Flush(store, frame);
+    }
+    for (int frame = 0; frame < gNumFrameResources; frame++)
+    {
+        mapped.Set(store, 10 + frame, 1000.0f + frame);
+        CHECK(mapped.Flush(store, frame));
+        CHECK(store.LastFlush().Elements == (size_t)frame + 1);
+    }
+
+    // Skipping frame 0 once leaves it a generation further behind than the
+    // changes are kept for, so it gets everything.
+    mapped.Set(store, 20, 2000.0f);
+    CHECK(mapped.Flush(store, 1));
+    CHECK(mapped.Flush(store, 0));
+    CHECK(store.LastFlush().Elements == elementCount);
+}
+
+// 50k objects of which a few hundred move each frame: flushes should copy
+// about that many elements, not the whole buffer.
+TEST_CASE(ConstantBufferStoreFlushesMostlyStaticScenes)
+{
+    const size_t elementCount = 50000;
+    const size_t movingPerFrame = 500;
+    ConstantBufferStore<TestConstants> store(elementCount, gNumFrameResources, ElementByteSize);
+    MappedFrames mapped(elementCount);
+    for (size_t i = 0; i < elementCount; i++)
+    {
+        mapped.Set(store, i, (float)i);
+    }
+    for (int frame = 0; frame < gNumFrameResources; frame++)
+    {
+        CHECK(mapped.Flush(store, frame));
+    }
+
+    std::mt19937 random(11);
+    bool allMatched = true;
+    size_t maxElements = 0;
+    double flushSeconds = 0.0;
+    const int frameCount = 60;
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        // A contiguous group plus scattered objects.
+        const size_t group = random() % (elementCount - 100);
+        for (size_t i = 0; i < movingPerFrame; i++)
+        {
+            const size_t element = i < 100 ? group + i : random() % elementCount;
+            const TestConstants constants = MakeConstants((float)frame);
+            store.Set(element, constants);
+            memcpy(&mapped.Expected[element * ElementByteSize], &constants, sizeof(constants));
+        }
+
+        const size_t frameIndex = frame % gNumFrameResources;
+        const auto start = std::chrono::steady_clock::now();
+        store.Flush(frameIndex, mapped.Frames[frameIndex].data());
+        flushSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        maxElements = std::max<size_t>(maxElements, store.LastFlush().Elements);
+        if (frame % 10 == 0 || frame == frameCount - 1)
+        {
+            allMatched = mapped.Frames[frameIndex] == mapped.Expected && allMatched;
+        }
+    }
+
+    printf("    %zu of %zu elements moving: Flush %.3f ms\n", movingPerFrame, elementCount,
+        1000.0 * flushSeconds / frameCount);
+    CHECK(allMatched);
+    CHECK(maxElements <= movingPerFrame * gNumFrameResources);
+}
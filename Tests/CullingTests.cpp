@@ -0,0 +1,230 @@
+#include "Test.h"
+#include "../Common/d3dUtil.h"
+#include "../Common/Culling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    const UINT SyntheticItemCount = 100000;
+
+    // A camera at the origin turned a little about y, 90 degree field of view.
+    Matrix MakeViewProj()
+    {
+        return XMMatrixMultiply(XMMatrixRotationY(0.3f), XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.5f, 500.0f));
+    }
+
+    // Small boxes scattered around the camera in every direction and past
+    // the far plane, rotated and stretched, spread over the layers.
+    struct SyntheticItems
+    {
+        std::vector<BoundingBox> LocalBounds;
+        std::vector<Matrix> Worlds;
+        std::vector<RenderLayer> Layers;
+    };
+
+    SyntheticItems MakeSyntheticItems(UINT count)
+    {
+        std::mt19937 random(2024);
+        std::uniform_real_distribution<float> position(-700.0f, 700.0f);
+        std::uniform_real_distribution<float> size(0.2f, 4.0f);
+        std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+
+        SyntheticItems items;
+        for (UINT i = 0; i < count; i++)
+        {
+            items.LocalBounds.push_back(BoundingBox(XMFLOAT3(0.0f, 0.5f, 0.0f), XMFLOAT3(size(random), size(random), size(random))));
+            const Matrix rotation = XMMatrixRotationY(angle(random));
+            const Matrix translation = XMMatrixTranslation(position(random), position(random) * 0.1f, position(random));
+            items.Worlds.push_back(rotation * translation);
+            items.Layers.push_back((RenderLayer)(i % (UINT)RenderLayer::Count));
+        }
+        return items;
+    }
+
+    void AddItems(CullingStage& culling, const SyntheticItems& items)
+    {
+        for (size_t i = 0; i < items.LocalBounds.size(); i++)
+        {
+            const UINT item = culling.Add(items.LocalBounds[i], items.Layers[i]);
+            culling.SetWorld(item, items.Worlds[i]);
+        }
+    }
+
+    // How far inside the frustum the world AABB of localBox reaches, in clip
+    // space units: over the six planes, the least distance of the corner
+    // furthest inside, so it is negative exactly when some plane has all
+    // eight corners of the AABB outside it.  Computed one corner at a time,
+    // without the packed arrays.
+    float FrustumMargin(const BoundingBox& localBox, const Matrix& world, const Matrix& viewProj)
+    {
+        XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+        localBox.GetCorners(corners);
+        XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (const XMFLOAT3& corner : corners)
+        {
+            XMFLOAT3 p;
+            XMStoreFloat3(&p, XMVector3Transform(XMLoadFloat3(&corner), world));
+            lo = XMFLOAT3(std::min<float>(lo.x, p.x), std::min<float>(lo.y, p.y), std::min<float>(lo.z, p.z));
+            hi = XMFLOAT3(std::max<float>(hi.x, p.x), std::max<float>(hi.y, p.y), std::max<float>(hi.z, p.z));
+        }
+
+        float planeBest[6];
+        std::fill(planeBest, planeBest + 6, -FLT_MAX);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            const XMFLOAT3 p(corner & 1 ? hi.x : lo.x, corner & 2 ? hi.y : lo.y, corner & 4 ? hi.z : lo.z);
+            XMFLOAT4 clip;
+            XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&p), viewProj));
+            const float distances[6] =
+            {
+                clip.w + clip.x, clip.w - clip.x, clip.w + clip.y, clip.w - clip.y, clip.z, clip.w - clip.z,
+            };
+            for (int plane = 0; plane < 6; plane++)
+            {
+                planeBest[plane] = std::max<float>(planeBest[plane], distances[plane]);
+            }
+        }
+        return *std::min_element(planeBest, planeBest + 6);
+    }
+}
+
+TEST_CASE(CullingMatchesPerItemFrustumTest)
+{
+    const SyntheticItems items = MakeSyntheticItems(SyntheticItemCount);
+    const Matrix viewProj = MakeViewProj();
+    CullingStage culling;
+    AddItems(culling, items);
+    culling.Cull(viewProj);
+
+    std::vector<uint8_t> visible(SyntheticItemCount, 0);
+    bool ascending = true;
+    bool rightLayer = true;
+    UINT visibleCount = 0;
+    for (int layer = 0; layer < (int)RenderLayer::Count; layer++)
+    {
+        const std::vector<UINT>& list = culling.Visible((RenderLayer)layer);
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            ascending = ascending && (i == 0 || list[i - 1] < list[i]);
+            rightLayer = rightLayer && items.Layers[list[i]] == (RenderLayer)layer;
+            visible[list[i]] = 1;
+        }
+        visibleCount += (UINT)list.size();
+    }
+    CHECK(ascending);
+    CHECK(rightLayer);
+
+    // Boxes within rounding distance of a plane may go either way.
+    UINT mismatches = 0;
+    UINT expectedVisible = 0;
+    for (UINT i = 0; i < SyntheticItemCount; i++)
+    {
+        const float margin = FrustumMargin(items.LocalBounds[i], items.Worlds[i], viewProj);
+        expectedVisible += margin >= 0.0f ? 1 : 0;
+        if (std::abs(margin) > 1e-3f && (margin >= 0.0f) != (visible[i] != 0))
+        {
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(expectedVisible > SyntheticItemCount / 20);
+    CHECK(expectedVisible < SyntheticItemCount / 2);
+
+    const CullingStage::Stats& stats = culling.GetStats();
+    CHECK(stats.Tested == SyntheticItemCount);
+    CHECK(stats.OcclusionCulled == 0);
+    CHECK(stats.FrustumCulled + visibleCount == SyntheticItemCount);
+}
+
+TEST_CASE(CullingOccludesItemsBehindAWall)
+{
+    // A camera at the origin looking down +z, near plane at 0.5, at a wall 10
+    // units away that covers about 27 degrees either side of the view
+    // direction.
+    const Matrix viewProj = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 0.5f, 500.0f);
+    CullingStage culling;
+    const UINT wall = culling.Add(BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(5.0f, 5.0f, 0.5f)), RenderLayer::Opaque);
+    culling.SetWorld(wall, XMMatrixTranslation(0.0f, 0.0f, 10.0f));
+    culling.SetOccluder(wall, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(5.0f, 5.0f, 0.5f)));
+
+    const BoundingBox unitBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+    const UINT behind = culling.Add(unitBox, RenderLayer::Opaque);
+    culling.SetWorld(behind, XMMatrixTranslation(0.0f, 0.0f, 30.0f));
+    const UINT beside = culling.Add(unitBox, RenderLayer::Opaque);
+    culling.SetWorld(beside, XMMatrixTranslation(20.0f, 0.0f, 30.0f));
+    const UINT inFront = culling.Add(unitBox, RenderLayer::Opaque);
+    culling.SetWorld(inFront, XMMatrixTranslation(0.0f, 0.0f, 5.0f));
+    const UINT peeking = culling.Add(unitBox, RenderLayer::Opaque);
+    culling.SetWorld(peeking, XMMatrixTranslation(0.0f, 15.5f, 30.0f));
+    const UINT tooNear = culling.Add(BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.1f, 0.1f, 0.1f)), RenderLayer::Opaque);
+    culling.SetWorld(tooNear, XMMatrixTranslation(0.0f, 0.0f, 0.3f));
+
+    OcclusionBuffer occlusion;
+    culling.Cull(viewProj, &occlusion);
+    const std::vector<UINT>& visible = culling.Visible(RenderLayer::Opaque);
+    auto isVisible = [&](UINT item) { return std::find(visible.begin(), visible.end(), item) != visible.end(); };
+    CHECK(isVisible(wall));
+    CHECK(!isVisible(behind));
+    CHECK(isVisible(beside));
+    CHECK(isVisible(inFront));
+    CHECK(isVisible(peeking));
+    CHECK(!isVisible(tooNear));
+    CHECK(culling.GetStats().FrustumCulled == 1);
+    CHECK(culling.GetStats().OcclusionCulled == 1);
+
+    // Without the buffer only the frustum counts.
+    culling.Cull(viewProj);
+    CHECK(culling.Visible(RenderLayer::Opaque).size() == 5);
+}
+
+// Reports the time to cull 100k synthetic items against the frustum, then
+// against the frustum and an occlusion buffer with a wall of occluders in
+// front of the camera.  Checks only that the counts add up.  Run on its own
+// with "Tests.exe CullingTime".
+TEST_CASE(CullingTime100kItems)
+{
+    const int repeatCount = 20;
+    const SyntheticItems items = MakeSyntheticItems(SyntheticItemCount);
+    const Matrix viewProj = MakeViewProj();
+    CullingStage culling;
+    AddItems(culling, items);
+
+    // 64 wall panels across the view, 60 units out.
+    for (int i = 0; i < 64; i++)
+    {
+        const BoundingBox panel(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(4.0f, 8.0f, 0.5f));
+        const UINT item = culling.Add(panel, RenderLayer::Opaque);
+        culling.SetWorld(item, XMMatrixMultiply(XMMatrixTranslation(8.0f * (i - 32), 0.0f, 60.0f), XMMatrixRotationY(-0.3f)));
+        culling.SetOccluder(item, panel);
+    }
+
+    OcclusionBuffer occlusion;
+    for (int withOcclusion = 0; withOcclusion < 2; withOcclusion++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeatCount; i++)
+        {
+            culling.Cull(viewProj, withOcclusion ? &occlusion : nullptr);
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeatCount;
+
+        const CullingStage::Stats& stats = culling.GetStats();
+        UINT visibleCount = 0;
+        for (int layer = 0; layer < (int)RenderLayer::Count; layer++)
+        {
+            visibleCount += (UINT)culling.Visible((RenderLayer)layer).size();
+        }
+        printf("    %u items, %s: %.3f ms (%.1f items/us), %u frustum culled, %u occlusion culled, %u visible\n",
+            stats.Tested, withOcclusion ? "frustum + occlusion" : "frustum", 1000.0 * seconds,
+            stats.Tested / seconds / 1.0e6, stats.FrustumCulled, stats.OcclusionCulled, visibleCount);
+        CHECK(stats.Tested == culling.ItemCount());
+        CHECK(stats.FrustumCulled + stats.OcclusionCulled + visibleCount == stats.Tested);
+        CHECK(withOcclusion ? stats.OcclusionCulled > 0 : stats.OcclusionCulled == 0);
+    }
+}
@@ -0,0 +1,199 @@
+#include "Test.h"
+#include "../Common/DrawQueue.h"
+
+#include <random>
+
+namespace
+{
+    // Never dereferenced: recorders below only keep the value.
+    ID3D12PipelineState* FakePso(UINT id)
+    {
+        return reinterpret_cast<ID3D12PipelineState*>((UINT_PTR)(0x1000 * id));
+    }
+
+    // The index count doubles as the draw's name in recorded calls.
+    DrawCommand MakeCommand(UINT pso, D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer, D3D12_GPU_VIRTUAL_ADDRESS constants, UINT indexCount)
+    {
+        DrawCommand command;
+        command.Pso = FakePso(pso);
+        command.VertexBuffer.BufferLocation = vertexBuffer;
+        command.ObjectConstants = constants;
+        command.IndexCount = indexCount;
+        return command;
+    }
+
+    std::vector<UINT64> Values(const std::vector<MockDrawRecorder::Record>& calls, MockDrawRecorder::Call type)
+    {
+        std::vector<UINT64> values;
+        for (const auto& call : calls)
+        {
+            if (call.Type == type)
+            {
+                values.push_back(call.Value);
+            }
+        }
+        return values;
+    }
+
+    // True if the calls start by setting every piece of state before drawing.
+    bool SetsAllStateFirst(const std::vector<MockDrawRecorder::Record>& calls)
+    {
+        using Call = MockDrawRecorder::Call;
+        const Call expected[] = { Call::PipelineState, Call::PrimitiveTopology, Call::VertexBuffer,
+            Call::IndexBuffer, Call::ObjectConstants, Call::DrawIndexed };
+        if (calls.size() < _countof(expected))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < _countof(expected); i++)
+        {
+            if (calls[i].Type != expected[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // count draws over a few pipelines and buffers in random key order; every
+    // eighth draws three index ranges.
+    void FillRandomQueue(DrawQueue& queue, UINT count, std::vector<SubmeshGeometry>& ranges)
+    {
+        ranges = { { 100001, 0, 0 }, { 100002, 30, 0 }, { 100003, 60, 0 } };
+
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+        for (UINT i = 0; i < count; i++)
+        {
+            const UINT pso = 1 + random() % 4;
+            const UINT geometry = random() % 8;
+            DrawCommand command = MakeCommand(pso, 0x10000 * (geometry + 1), 0x100 * (i + 1), i + 1);
+            if (i % 8 == 0)
+            {
+                command.IndexRanges = &ranges;
+            }
+            queue.Add(DrawQueue::MakeKey(RenderLayer::Opaque, pso, random() % 16, geometry, depth(random)), command);
+        }
+    }
+}
+
+TEST_CASE(DrawQueueSortsByKeyAndSkipsRedundantState)
+{
+    DrawQueue queue;
+    const UINT64 sameKey = DrawQueue::MakeKey(RenderLayer::Opaque, 1, 0, 0, 0.5f);
+
+    // Added out of order; the last two share a key and keep their order.
+    queue.Add(DrawQueue::MakeKey(RenderLayer::Sky, 1, 0, 0), MakeCommand(1, 0x300, 0x4000, 4));
+    queue.Add(DrawQueue::MakeKey(RenderLayer::Opaque, 2, 0, 0), MakeCommand(2, 0x200, 0x3000, 3));
+    queue.Add(sameKey, MakeCommand(1, 0x100, 0x2000, 1));
+    queue.Add(sameKey, MakeCommand(1, 0x100, 0x2000, 5));
+    queue.Add(DrawQueue::MakeKey(RenderLayer::Opaque, 1, 0, 0, 0.1f), MakeCommand(1, 0x100, 0x1000, 2));
+    queue.Sort();
+
+    MockDrawRecorder recorder;
+    queue.Record(recorder);
+    CHECK(SetsAllStateFirst(recorder.mCalls));
+    CHECK((Values(recorder.mCalls, MockDrawRecorder::Call::DrawIndexed) == std::vector<UINT64>{ 2, 1, 5, 3, 4 }));
+    CHECK((Values(recorder.mCalls, MockDrawRecorder::Call::PipelineState) ==
+        std::vector<UINT64>{ (UINT64)FakePso(1), (UINT64)FakePso(2), (UINT64)FakePso(1) }));
+    CHECK((Values(recorder.mCalls, MockDrawRecorder::Call::ObjectConstants) ==
+        std::vector<UINT64>{ 0x1000, 0x2000, 0x3000, 0x4000 }));
+
+    // Five draws of five state sets each; only changes reach the recorder.
+    const DrawQueue::Stats& stats = queue.GetStats();
+    CHECK(stats.Draws == 5);
+    CHECK(stats.PipelineChanges == 3);
+    CHECK(stats.TopologyChanges == 1);
+    CHECK(stats.VertexBufferChanges == 3);
+    CHECK(stats.IndexBufferChanges == 1);
+    CHECK(stats.ConstantBufferChanges == 4);
+    CHECK(stats.RedundantSkipped == 25 - 12);
+    CHECK(recorder.mCalls.size() == 12 + 5);
+
+    // Cleared queues record nothing.
+    queue.Clear();
+    MockDrawRecorder empty;
+    queue.Record(empty);
+    CHECK(empty.mCalls.empty() && queue.GetStats().Draws == 0);
+}
+
+TEST_CASE(DrawQueueDrawsIndexRangesInOrder)
+{
+    const std::vector<SubmeshGeometry> ranges = { { 7, 0, 0 }, { 8, 7, 0 }, { 9, 15, 2 } };
+    DrawCommand ranged = MakeCommand(1, 0x100, 0x1000, 1000);
+    ranged.IndexRanges = &ranges;
+
+    DrawQueue queue;
+    queue.Add(DrawQueue::MakeKey(RenderLayer::Opaque, 1, 0, 1), ranged);
+    queue.Add(DrawQueue::MakeKey(RenderLayer::Opaque, 1, 0, 0), MakeCommand(1, 0x100, 0x2000, 6));
+    queue.Sort();
+
+    MockDrawRecorder recorder;
+    queue.Record(recorder);
+    CHECK((Values(recorder.mCalls, MockDrawRecorder::Call::DrawIndexed) == std::vector<UINT64>{ 6, 7, 8, 9 }));
+    CHECK(queue.GetStats().Draws == 4);
+    CHECK(queue.GetStats().ConstantBufferChanges == 2);
+}
+
+TEST_CASE(DrawQueueRecordsChunksLikeOneList)
+{
+    std::vector<SubmeshGeometry> ranges;
+    DrawQueue queue;
+    FillRandomQueue(queue, 2000, ranges);
+    queue.Sort();
+
+    MockDrawRecorder single;
+    queue.Record(single);
+    const DrawQueue::Stats serial = queue.GetStats();
+    const std::vector<UINT64> serialDraws = Values(single.mCalls, MockDrawRecorder::Call::DrawIndexed);
+    CHECK(serial.Draws == 2000 + 250 * 2);
+
+    MockChunkRecorders chunks;
+    const UINT chunkCount = queue.RecordParallel(chunks, 4);
+    CHECK(chunkCount == 4);
+    CHECK((chunks.mSubmitted == std::vector<UINT>{ 0, 1, 2, 3 }));
+
+    const std::vector<UINT>& starts = queue.ChunkStarts();
+    CHECK(starts.size() == chunkCount + 1);
+    CHECK(starts.front() == 0 && starts.back() == queue.Size());
+
+    // Chunks split the draws evenly, to within one packet's ranges, and
+    // together draw what one list would, in the same order.  Each starts
+    // from unknown state, so sets everything again.
+    std::vector<UINT64> parallelDraws;
+    bool balanced = true;
+    bool setsState = true;
+    for (const auto& chunk : chunks.mChunks)
+    {
+        const std::vector<UINT64> draws = Values(chunk.Recorder.mCalls, MockDrawRecorder::Call::DrawIndexed);
+        balanced = balanced && draws.size() + 3 >= serial.Draws / chunkCount && draws.size() <= serial.Draws / chunkCount + 3;
+        setsState = setsState && SetsAllStateFirst(chunk.Recorder.mCalls) && chunk.Thread != std::thread::id();
+        parallelDraws.insert(parallelDraws.end(), draws.begin(), draws.end());
+    }
+    CHECK(balanced);
+    CHECK(setsState);
+    CHECK(parallelDraws == serialDraws);
+
+    const DrawQueue::Stats& parallel = queue.GetStats();
+    CHECK(parallel.Draws == serial.Draws);
+    CHECK(parallel.PipelineChanges >= serial.PipelineChanges);
+    CHECK(parallel.PipelineChanges <= serial.PipelineChanges + chunkCount - 1);
+    CHECK(parallel.RedundantSkipped + 5 * (chunkCount - 1) >= serial.RedundantSkipped);
+}
+
+TEST_CASE(DrawQueueKeepsSmallQueuesInOneChunk)
+{
+    std::vector<SubmeshGeometry> ranges;
+    DrawQueue queue;
+    FillRandomQueue(queue, DrawQueue::MinDrawsPerChunk, ranges);
+    queue.Sort();
+
+    // Fewer than two chunks' worth of draws, however many are allowed.
+    MockChunkRecorders chunks;
+    CHECK(queue.RecordParallel(chunks, 8) == 1);
+    CHECK(queue.RecordParallel(chunks, 0) == 1);
+    CHECK(chunks.mChunks.size() == 1 && chunks.mChunks[0].Ended);
+    CHECK((chunks.mSubmitted == std::vector<UINT>{ 0 }));
+    CHECK((queue.ChunkStarts() == std::vector<UINT>{ 0, queue.Size() }));
+    CHECK(queue.GetStats().Draws == DrawQueue::MinDrawsPerChunk + DrawQueue::MinDrawsPerChunk / 8 * 2);
+}
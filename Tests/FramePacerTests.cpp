@@ -0,0 +1,72 @@
+#include "Test.h"
+#include "../Common/FramePacer.h"
+
+namespace
+{
+    // Starts frameCount frames of cpuSeconds of CPU and gpuSeconds of GPU
+    // work each.  Returns false if a frame started before the frame
+    // FramesInFlight() before it completed, or used the wrong slot.
+    bool RunFrames(FramePacer& pacer, SimulatedFrameFence& fence, int frameCount, double cpuSeconds, double gpuSeconds)
+    {
+        bool paced = true;
+        for (int i = 0; i < frameCount; i++)
+        {
+            const UINT64 frame = fence.Submitted();
+            const UINT slot = pacer.BeginFrame();
+            paced = paced && slot == frame % pacer.Capacity();
+
+            // Frame n - FramesInFlight() is fence value n - FramesInFlight() + 1.
+            if (frame >= pacer.FramesInFlight())
+            {
+                paced = paced && fence.Completed() >= frame - pacer.FramesInFlight() + 1;
+            }
+            fence.Advance(cpuSeconds);
+            fence.Submit(gpuSeconds);
+        }
+        return paced;
+    }
+}
+
+TEST_CASE(FramePacerKeepsFramesInFlightQueued)
+{
+    auto simulated = std::make_unique<SimulatedFrameFence>();
+    SimulatedFrameFence& fence = *simulated;
+    FramePacer pacer(std::move(simulated), 3);
+    CHECK(pacer.FramesInFlight() == 3);
+
+    // GPU bound: the CPU runs ahead as far as it is allowed, and no further.
+    CHECK(RunFrames(pacer, fence, 20, 0.001, 0.010));
+    CHECK(fence.Submitted() - fence.Completed() <= 3);
+
+    // The count can change between frames; the next frame waits for more.
+    pacer.SetFramesInFlight(1);
+    CHECK(RunFrames(pacer, fence, 20, 0.001, 0.010));
+    CHECK(fence.Submitted() - fence.Completed() <= 1);
+    pacer.SetFramesInFlight(2);
+    CHECK(RunFrames(pacer, fence, 20, 0.001, 0.010));
+
+    // Clamped to the frame resources there are.
+    pacer.SetFramesInFlight(8);
+    CHECK(pacer.FramesInFlight() == 3);
+    pacer.SetFramesInFlight(0);
+    CHECK(pacer.FramesInFlight() == 1);
+}
+
+TEST_CASE(FramePacerAdaptsToLatencyTarget)
+{
+    auto simulated = std::make_unique<SimulatedFrameFence>();
+    SimulatedFrameFence& fence = *simulated;
+    FramePacer pacer(std::move(simulated), 3);
+
+    // 10 ms of GPU per frame: three frames queued take about 30 ms from
+    // start to completion, two about 20 ms.
+    pacer.SetLatencyTarget(0.025);
+    CHECK(RunFrames(pacer, fence, 5 * FramePacer::AdaptInterval, 0.001, 0.010));
+    CHECK(pacer.FramesInFlight() == 2);
+    CHECK(pacer.Latencies().Total > 0);
+
+    // With a looser target the CPU waits, and a third frame fits again.
+    pacer.SetLatencyTarget(0.050);
+    CHECK(RunFrames(pacer, fence, 5 * FramePacer::AdaptInterval, 0.001, 0.010));
+    CHECK(pacer.FramesInFlight() == 3);
+}
@@ -0,0 +1,162 @@
+#include "Test.h"
+#include "../ModelLoader/MeshCache.h"
+#include "../ModelLoader/ModelLoader.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+    const char* const SourcePath = "MeshCacheTests_source.bin";
+    const char* const CachePath = "MeshCacheTests.meshcache";
+    const uint64_t FlagsHash = 1;
+
+    void WriteFile(const char* path, const std::string& contents)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << contents;
+    }
+
+    // Removes the source and cache files when the case ends.
+    struct TemporaryFiles
+    {
+        ~TemporaryFiles()
+        {
+            remove(SourcePath);
+            remove(CachePath);
+        }
+    };
+
+    // A quad as two triangles, or as two ranges of one triangle each when split.
+    ModelMeshData MakeQuad(bool split)
+    {
+        ModelMeshData mesh;
+        mesh.name = "quad";
+        mesh.vertices.resize(4);
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            mesh.vertices[i].position = Vector3(float(i & 1), float(i >> 1), 0.0f);
+        }
+        if (split)
+        {
+            mesh.indices = { 0, 1, 2, 0, 1, 2 };
+            mesh.ranges.resize(2);
+            mesh.ranges[0].IndexCount = 3;
+            mesh.ranges[1].IndexCount = 3;
+            mesh.ranges[1].StartIndexLocation = 3;
+            mesh.ranges[1].BaseVertexLocation = 1;
+        }
+        else
+        {
+            mesh.indices = { 0, 1, 2, 2, 1, 3 };
+        }
+        return mesh;
+    }
+
+    bool WriteAndOpen(const ModelMeshData& mesh)
+    {
+        MeshCache::SourceKey key;
+        if (!MeshCache::GetSourceKey(SourcePath, key) ||
+            !MeshCache::HashSource(key) ||
+            !MeshCache::Write(CachePath, key, FlagsHash, { mesh }, {}))
+        {
+            return false;
+        }
+        MeshCache cache;
+        std::vector<ModelMaterialData> materials;
+        return cache.Open(CachePath, key, FlagsHash, materials) && cache.mMeshes.size() == 1;
+    }
+}
+
+TEST_CASE(MeshCacheHashesOnlyWhenTheStampDiffers)
+{
+    TemporaryFiles files;
+    WriteFile(SourcePath, "model bytes");
+
+    // Bake with a hash that matches nothing, so any hashing on open would
+    // reject the cache.
+    MeshCache::SourceKey key;
+    CHECK(MeshCache::GetSourceKey(SourcePath, key));
+    CHECK(!key.hashed);
+    key.hash = 0;
+    key.hashed = true;
+    CHECK(MeshCache::Write(CachePath, key, FlagsHash, { MakeQuad(false) }, {}));
+
+    MeshCache cache;
+    std::vector<ModelMaterialData> materials;
+    MeshCache::SourceKey same;
+    CHECK(MeshCache::GetSourceKey(SourcePath, same));
+    CHECK(cache.Open(CachePath, same, FlagsHash, materials));
+    CHECK(!same.hashed);
+
+    MeshCache::SourceKey touched = same;
+    touched.stamp.writeTime++;
+    CHECK(!cache.Open(CachePath, touched, FlagsHash, materials));
+    CHECK(touched.hashed);
+
+    // Baked with the real hash, a touched but unchanged source still hits.
+    CHECK(MeshCache::HashSource(same));
+    CHECK(MeshCache::Write(CachePath, same, FlagsHash, { MakeQuad(false) }, {}));
+    touched = same;
+    touched.hashed = false;
+    touched.stamp.writeTime++;
+    CHECK(cache.Open(CachePath, touched, FlagsHash, materials));
+    CHECK(touched.hashed);
+}
+
+TEST_CASE(MeshCacheRejectsEditedSources)
+{
+    TemporaryFiles files;
+    WriteFile(SourcePath, "model bytes");
+
+    MeshCache::SourceKey key;
+    CHECK(MeshCache::GetSourceKey(SourcePath, key));
+    CHECK(MeshCache::HashSource(key));
+    CHECK(MeshCache::Write(CachePath, key, FlagsHash, { MakeQuad(false) }, {}));
+
+    // Same size, different bytes, so only the hash can tell.
+    WriteFile(SourcePath, "MODEL BYTES");
+    MeshCache::SourceKey edited;
+    CHECK(MeshCache::GetSourceKey(SourcePath, edited));
+    edited.stamp.writeTime = key.stamp.writeTime + 1;
+
+    MeshCache cache;
+    std::vector<ModelMaterialData> materials;
+    CHECK(!cache.Open(CachePath, edited, FlagsHash, materials));
+    CHECK(edited.hashed);
+    CHECK(cache.mMeshes.empty());
+
+    // A different size is rejected without reading the source at all.
+    WriteFile(SourcePath, "a longer model");
+    MeshCache::SourceKey resized;
+    CHECK(MeshCache::GetSourceKey(SourcePath, resized));
+    CHECK(!cache.Open(CachePath, resized, FlagsHash, materials));
+    CHECK(!resized.hashed);
+}
+
+TEST_CASE(MeshCacheRejectsIndicesPastTheVertices)
+{
+    TemporaryFiles files;
+    WriteFile(SourcePath, "model bytes");
+
+    CHECK(WriteAndOpen(MakeQuad(false)));
+    CHECK(WriteAndOpen(MakeQuad(true)));
+
+    ModelMeshData mesh = MakeQuad(false);
+    mesh.indices[5] = 4;
+    CHECK(!WriteAndOpen(mesh));
+
+    mesh = MakeQuad(false);
+    mesh.indices32 = { 0, 1, 2, 2, 1, 3 };
+    mesh.indices.clear();
+    CHECK(WriteAndOpen(mesh));
+    mesh.indices32[0] = 0x10000;
+    CHECK(!WriteAndOpen(mesh));
+
+    // Range indices are relative to the range's base vertex.
+    mesh = MakeQuad(true);
+    mesh.ranges[1].BaseVertexLocation = 2;
+    CHECK(!WriteAndOpen(mesh));
+    mesh.ranges[1].BaseVertexLocation = -1;
+    CHECK(!WriteAndOpen(mesh));
+}
@@ -0,0 +1,150 @@
+#include "Test.h"
+#include "../ModelLoader/MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // A gridSize x gridSize vertex grid with its triangles in a fixed
+    // pseudo-random order, the worst case for a post-transform cache.
+    void MakeShuffledGrid(uint32_t gridSize, vector<VertexPositionNormalTexture>& vertices, vector<uint32_t>& indices)
+    {
+        vertices.resize(size_t(gridSize) * gridSize);
+        for (uint32_t i = 0; i < vertices.size(); i++)
+        {
+            vertices[i].position = Vector3(float(i % gridSize), float(i / gridSize), 0.0f);
+        }
+
+        vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t y = 0; y + 1 < gridSize; y++)
+        {
+            for (uint32_t x = 0; x + 1 < gridSize; x++)
+            {
+                const uint32_t corner = y * gridSize + x;
+                triangles.push_back({ { corner, corner + gridSize, corner + 1 } });
+                triangles.push_back({ { corner + 1, corner + gridSize, corner + gridSize + 1 } });
+            }
+        }
+
+        uint32_t state = 12345;
+        for (size_t i = triangles.size() - 1; i > 0; i--)
+        {
+            state = state * 1664525u + 1013904223u;
+            std::swap(triangles[i], triangles[state % (i + 1)]);
+        }
+
+        indices.clear();
+        for (const auto& triangle : triangles)
+        {
+            indices.insert(indices.end(), triangle.begin(), triangle.end());
+        }
+    }
+
+    // The triangles as position triples, each rotated to start at its
+    // smallest corner and then sorted, so any reordering of triangles,
+    // vertices or corners that keeps the winding compares equal.
+    vector<std::array<float, 6>> CanonicalTriangles(const vector<VertexPositionNormalTexture>& vertices, const vector<uint32_t>& indices)
+    {
+        vector<std::array<float, 6>> triangles;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            std::array<std::array<float, 2>, 3> corners;
+            for (size_t c = 0; c < 3; c++)
+            {
+                const Vector3& p = vertices[indices[t + c]].position;
+                corners[c] = { { p.x, p.y } };
+            }
+            std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+            triangles.push_back({ { corners[0][0], corners[0][1], corners[1][0], corners[1][1], corners[2][0], corners[2][1] } });
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+}
+
+TEST_CASE(MeshOptimizerReducesACMRAndATVR)
+{
+    vector<VertexPositionNormalTexture> vertices;
+    vector<uint32_t> indices;
+    MakeShuffledGrid(64, vertices, indices);
+    const vector<std::array<float, 6>> triangles = CanonicalTriangles(vertices, indices);
+
+    const MeshOptimizer::Report report = MeshOptimizer::Optimize(vertices, indices);
+    printf("    64x64 shuffled grid: %s\n", report.ToString().c_str());
+
+    // A shuffled grid misses on nearly every corner; Tipsify on a 16 entry
+    // cache gets a regular grid well under one transform per triangle.
+    CHECK(report.before.acmr > 2.5f);
+    CHECK(report.after.acmr < 0.8f);
+    CHECK(report.after.atvr < 1.5f);
+    CHECK(report.vertexCountAfter == 64 * 64);
+
+    // Analyze agrees with the report, and no triangle was lost or flipped.
+    const MeshOptimizer::Stats after = MeshOptimizer::Analyze(indices.data(), indices.size(), vertices.size());
+    CHECK(after.acmr == report.after.acmr);
+    CHECK(CanonicalTriangles(vertices, indices) == triangles);
+}
+
+TEST_CASE(MeshOptimizerIsDeterministic)
+{
+    vector<VertexPositionNormalTexture> vertices[2];
+    vector<uint32_t> indices[2];
+    for (int run = 0; run < 2; run++)
+    {
+        MakeShuffledGrid(32, vertices[run], indices[run]);
+        MeshOptimizer::Optimize(vertices[run], indices[run]);
+    }
+    CHECK(indices[0] == indices[1]);
+    CHECK(vertices[0].size() == vertices[1].size());
+    CHECK(memcmp(vertices[0].data(), vertices[1].data(), vertices[0].size() * sizeof(VertexPositionNormalTexture)) == 0);
+}
+
+TEST_CASE(MeshOptimizerMergesDuplicateVertices)
+{
+    // Each triangle of a 16x16 grid with its own three vertices, as an
+    // importer that does not weld produces.
+    vector<VertexPositionNormalTexture> grid;
+    vector<uint32_t> gridIndices;
+    MakeShuffledGrid(16, grid, gridIndices);
+
+    vector<VertexPositionNormalTexture> vertices;
+    vector<uint32_t> indices;
+    for (uint32_t index : gridIndices)
+    {
+        indices.push_back(uint32_t(vertices.size()));
+        vertices.push_back(grid[index]);
+    }
+    const vector<std::array<float, 6>> triangles = CanonicalTriangles(vertices, indices);
+
+    const MeshOptimizer::Report report = MeshOptimizer::Optimize(vertices, indices);
+    CHECK(report.vertexCountBefore == gridIndices.size());
+    CHECK(report.vertexCountAfter == 16 * 16);
+    CHECK(report.before.atvr == 1.0f);
+    CHECK(report.after.acmr < report.before.acmr);
+    CHECK(CanonicalTriangles(vertices, indices) == triangles);
+}
+
+TEST_CASE(MeshOptimizerSkipsCandidatesThatWouldBeEvicted)
+{
+    // Random triangles over few vertices give every vertex a high valence,
+    // so after a fan most candidates would fall out of a small cache before
+    // their remaining triangles were emitted.  Fanning from one of those
+    // anyway measured 2.211 here; the dead-end stack does better.
+    const uint32_t vertexCount = 1000;
+    const UINT cacheSize = 8;
+    vector<uint32_t> indices;
+    uint32_t state = 99;
+    for (uint32_t i = 0; i < vertexCount * 12; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        indices.push_back((state >> 8) % vertexCount);
+    }
+
+    MeshOptimizer::OptimizeVertexCache(indices.data(), indices.size(), vertexCount, cacheSize);
+    const MeshOptimizer::Stats stats = MeshOptimizer::Analyze(indices.data(), indices.size(), vertexCount, cacheSize);
+    printf("    random triangles, %u entry cache: ACMR %.3f\n", cacheSize, stats.acmr);
+    CHECK(stats.acmr < 2.18f);
+}
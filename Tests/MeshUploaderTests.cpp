@@ -0,0 +1,187 @@
+#include "Test.h"
+#include "../Common/MeshUploader.h"
+
+namespace
+{
+    struct TestVertex
+    {
+        float Position[3];
+    };
+
+    std::vector<TestVertex> MakeVertices(size_t count, float base)
+    {
+        std::vector<TestVertex> vertices(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            vertices[i].Position[0] = base + (float)i;
+            vertices[i].Position[1] = 0.0f;
+            vertices[i].Position[2] = 0.0f;
+        }
+        return vertices;
+    }
+
+    template <typename T>
+    bool BufferHolds(const std::vector<uint8_t>& buffer, UINT64 offset, const T* data, size_t count)
+    {
+        return offset + count * sizeof(T) <= buffer.size() &&
+            memcmp(buffer.data() + offset, data, count * sizeof(T)) == 0;
+    }
+}
+
+TEST_CASE(BufferRangeAllocatorPacksAlignedRanges)
+{
+    BufferRangeAllocator allocator(256);
+
+    const BufferRangeAllocator::Range first = allocator.Allocate(10, 16);
+    const BufferRangeAllocator::Range second = allocator.Allocate(20, 16);
+    CHECK(first.Page == 0 && first.Offset == 0);
+    CHECK(second.Page == 0 && second.Offset == 16);
+
+    // Does not fit behind the others, so starts a page.
+    const BufferRangeAllocator::Range third = allocator.Allocate(240, 16);
+    CHECK(third.Page == 1 && third.Offset == 0);
+
+    // Larger than a page, so gets one of its own.
+    const BufferRangeAllocator::Range huge = allocator.Allocate(1000, 16);
+    CHECK(huge.Page == 2 && huge.Offset == 0);
+
+    CHECK(allocator.PageSizes().size() == 3);
+    CHECK(allocator.PageSizes()[0] == 36);
+    CHECK(allocator.PageSizes()[1] == 240);
+    CHECK(allocator.PageSizes()[2] == 1000);
+
+    allocator.Reset();
+    CHECK(allocator.PageSizes().empty());
+    CHECK(allocator.Allocate(8, 16).Page == 0);
+}
+
+TEST_CASE(MeshUploaderBatchesMeshesIntoSharedBuffers)
+{
+    auto backend = std::make_unique<NullMeshUploadBackend>();
+    NullMeshUploadBackend* null = backend.get();
+    MeshUploader uploader(std::move(backend));
+
+    const std::vector<TestVertex> verticesA = MakeVertices(3, 0.0f);
+    const std::vector<TestVertex> verticesB = MakeVertices(5, 100.0f);
+    const std::vector<uint16_t> indicesA = { 0, 1, 2 };
+    const std::vector<uint16_t> indicesB = { 4, 3, 2, 1, 0, 1 };
+
+    MeshGeometry a;
+    MeshGeometry b;
+    uploader.Add(&a, "a", verticesA, indicesA);
+    uploader.Add(&b, "b", verticesB, indicesB);
+    CHECK(uploader.PendingCount() == 2);
+
+    uploader.Upload();
+    CHECK(uploader.PendingCount() == 0);
+
+    // One vertex and one index buffer for both meshes, submitted once.
+    CHECK(null->mSubmitCount == 1);
+    CHECK(null->mBuffers.size() == 2);
+    const std::vector<uint8_t>& vertexBuffer = null->mBuffers[0];
+    const std::vector<uint8_t>& indexBuffer = null->mBuffers[1];
+
+    CHECK(a.Name == "a" && b.Name == "b");
+    CHECK(a.VertexBufferOffset == 0);
+    CHECK(b.VertexBufferOffset % 16 == 0 && b.VertexBufferOffset >= sizeof(TestVertex) * 3);
+    CHECK(a.VertexByteStride == sizeof(TestVertex) && b.VertexByteStride == sizeof(TestVertex));
+    CHECK(a.VertexBufferByteSize == sizeof(TestVertex) * 3);
+    CHECK(b.VertexBufferByteSize == sizeof(TestVertex) * 5);
+    CHECK(BufferHolds(vertexBuffer, a.VertexBufferOffset, verticesA.data(), verticesA.size()));
+    CHECK(BufferHolds(vertexBuffer, b.VertexBufferOffset, verticesB.data(), verticesB.size()));
+
+    CHECK(a.IndexFormat == DXGI_FORMAT_R16_UINT && b.IndexFormat == DXGI_FORMAT_R16_UINT);
+    CHECK(a.TotalIndexCount == 3 && b.TotalIndexCount == 6);
+    CHECK(a.IndexBufferByteSize == 6 && b.IndexBufferByteSize == 12);
+    CHECK(b.IndexBufferOffset % 16 == 0 && b.IndexBufferOffset >= a.IndexBufferByteSize);
+    CHECK(BufferHolds(indexBuffer, a.IndexBufferOffset, indicesA.data(), indicesA.size()));
+    CHECK(BufferHolds(indexBuffer, b.IndexBufferOffset, indicesB.data(), indicesB.size()));
+}
+
+TEST_CASE(MeshUploaderNarrowsReachableIndices)
+{
+    auto backend = std::make_unique<NullMeshUploadBackend>();
+    NullMeshUploadBackend* null = backend.get();
+    MeshUploader uploader(std::move(backend));
+
+    // Every vertex is reachable with 16 bits, so the indices are narrowed.
+    const std::vector<TestVertex> smallVertices = MakeVertices(4, 0.0f);
+    const std::vector<uint32_t> smallIndices = { 0, 1, 2, 2, 3, 0 };
+    MeshGeometry small;
+    uploader.Add(&small, "small", smallVertices, smallIndices);
+
+    // Past 65536 vertices they have to stay 32-bit.
+    const std::vector<TestVertex> largeVertices = MakeVertices(0x10001, 0.0f);
+    const std::vector<uint32_t> largeIndices = { 0, 0x8000, 0x10000 };
+    MeshGeometry large;
+    uploader.Add(&large, "large", largeVertices, largeIndices);
+
+    uploader.Upload();
+    CHECK(null->mBuffers.size() == 2);
+    const std::vector<uint8_t>& indexBuffer = null->mBuffers[1];
+
+    const uint16_t narrowed[] = { 0, 1, 2, 2, 3, 0 };
+    CHECK(small.IndexFormat == DXGI_FORMAT_R16_UINT);
+    CHECK(small.IndexBufferByteSize == sizeof(narrowed));
+    CHECK(BufferHolds(indexBuffer, small.IndexBufferOffset, narrowed, 6));
+
+    CHECK(large.IndexFormat == DXGI_FORMAT_R32_UINT);
+    CHECK(large.IndexBufferByteSize == 3 * sizeof(uint32_t));
+    CHECK(BufferHolds(indexBuffer, large.IndexBufferOffset, largeIndices.data(), largeIndices.size()));
+}
+
+TEST_CASE(MeshUploaderStartsPagesAndCanBeReused)
+{
+    // Pages hold two of these meshes' vertex ranges but not three.
+    const UINT64 pageSize = 2 * 16 * sizeof(TestVertex);
+    auto backend = std::make_unique<NullMeshUploadBackend>();
+    NullMeshUploadBackend* null = backend.get();
+    MeshUploader uploader(std::move(backend), pageSize);
+
+    const std::vector<TestVertex> vertices = MakeVertices(16, 0.0f);
+    const std::vector<uint16_t> indices = { 0, 1, 2 };
+    MeshGeometry meshes[3];
+    for (MeshGeometry& mesh : meshes)
+    {
+        uploader.Add(&mesh, "mesh", vertices, indices);
+    }
+    uploader.Upload();
+
+    // Two vertex pages and one index page.
+    CHECK(null->mSubmitCount == 1);
+    CHECK(null->mBuffers.size() == 3);
+    CHECK(null->mBuffers[0].size() == pageSize);
+    CHECK(null->mBuffers[1].size() == 16 * sizeof(TestVertex));
+    CHECK(meshes[0].VertexBufferOffset == 0);
+    CHECK(meshes[1].VertexBufferOffset == 16 * sizeof(TestVertex));
+    CHECK(meshes[2].VertexBufferOffset == 0);
+    CHECK(BufferHolds(null->mBuffers[1], 0, vertices.data(), vertices.size()));
+
+    // The allocators start over for the next batch.
+    MeshGeometry again;
+    uploader.Add(&again, "again", vertices, indices);
+    uploader.Upload();
+    CHECK(null->mSubmitCount == 2);
+    CHECK(null->mBuffers.size() == 5);
+    CHECK(again.VertexBufferOffset == 0 && again.IndexBufferOffset == 0);
+
+    // Nothing pending means nothing submitted.
+    uploader.Upload();
+    CHECK(null->mSubmitCount == 2);
+}
+
+TEST_CASE(MeshUploaderGivesEmptyMeshesNoBuffer)
+{
+    auto backend = std::make_unique<NullMeshUploadBackend>();
+    NullMeshUploadBackend* null = backend.get();
+    MeshUploader uploader(std::move(backend));
+
+    MeshGeometry empty;
+    uploader.Add(&empty, "empty", std::vector<TestVertex>(), std::vector<uint16_t>());
+    uploader.Upload();
+
+    CHECK(null->mSubmitCount == 1);
+    CHECK(null->mBuffers.empty());
+    CHECK(empty.VertexBufferByteSize == 0 && empty.IndexBufferByteSize == 0);
+    CHECK(empty.TotalIndexCount == 0);
+}
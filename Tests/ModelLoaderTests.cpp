@@ -0,0 +1,286 @@
+#include "Test.h"
+#include "../ModelLoader/ModelLoader.h"
+#include "../ModelLoader/MeshOptimizer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const char* const ModelAssets[] =
+    {
+        "Assets/Models/kachujin/kachujin.fbx",
+        "Assets/Models/nuoaier/nuoaier.pmx",
+        "Assets/Models/Rumba Dancingout/Rumba Dancingout.fbx",
+    };
+
+    // Tests.exe runs from the solution directory or from Tests/.
+    std::string FindAsset(const char* path)
+    {
+        const std::string candidates[] = { path, std::string("../") + path };
+        for (const auto& candidate : candidates)
+        {
+            if (std::ifstream(candidate, std::ios::binary).is_open())
+            {
+                return candidate;
+            }
+        }
+        return std::string();
+    }
+
+    template <typename T>
+    bool SameElements(const std::vector<T>& a, const std::vector<T>& b)
+    {
+        return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    bool SameMeshes(const std::vector<ModelMeshData>& a, const std::vector<ModelMeshData>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i].name != b[i].name ||
+                !SameElements(a[i].vertices, b[i].vertices) ||
+                !SameElements(a[i].indices, b[i].indices) ||
+                !SameElements(a[i].indices32, b[i].indices32) ||
+                a[i].ranges.size() != b[i].ranges.size())
+            {
+                return false;
+            }
+            for (size_t r = 0; r < a[i].ranges.size(); r++)
+            {
+                if (a[i].ranges[r].IndexCount != b[i].ranges[r].IndexCount ||
+                    a[i].ranges[r].StartIndexLocation != b[i].ranges[r].StartIndexLocation ||
+                    a[i].ranges[r].BaseVertexLocation != b[i].ranges[r].BaseVertexLocation)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // A strip of vertexCount vertices along x, one triangle per vertex after
+    // the first two, so every index is distinct from its neighbours'.
+    std::unique_ptr<aiMesh> MakeStrip(unsigned int vertexCount)
+    {
+        std::unique_ptr<aiMesh> mesh(new aiMesh());
+        mesh->mName.Set("strip");
+        mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+        mesh->mNumVertices = vertexCount;
+        mesh->mVertices = new aiVector3D[vertexCount];
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            mesh->mVertices[i] = aiVector3D(float(i), float(i & 1), 0.0f);
+        }
+        mesh->mNumFaces = vertexCount - 2;
+        mesh->mFaces = new aiFace[mesh->mNumFaces];
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            aiFace& face = mesh->mFaces[i];
+            face.mNumIndices = 3;
+            face.mIndices = new unsigned int[3] { i, i + 1, i + 2 };
+        }
+        return mesh;
+    }
+
+    // Whether corner c of the converted mesh is the same vertex as corner c
+    // of the source faces, whatever index width or ranges were chosen.
+    bool SameCorners(const aiMesh& source, const ModelMeshData& mesh)
+    {
+        const size_t cornerCount = size_t(source.mNumFaces) * 3;
+        std::vector<SubmeshGeometry> ranges = mesh.ranges;
+        if (ranges.empty())
+        {
+            ranges.resize(1);
+            ranges[0].IndexCount = UINT(cornerCount);
+        }
+        for (const auto& range : ranges)
+        {
+            for (UINT c = range.StartIndexLocation; c < range.StartIndexLocation + range.IndexCount; c++)
+            {
+                const size_t index = range.BaseVertexLocation +
+                    (mesh.indices32.empty() ? size_t(mesh.indices[c]) : size_t(mesh.indices32[c]));
+                const aiVector3D& expected = source.mVertices[source.mFaces[c / 3].mIndices[c % 3]];
+                if (index >= mesh.vertices.size() ||
+                    mesh.vertices[index].position.x != expected.x ||
+                    mesh.vertices[index].position.y != expected.y)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Average seconds per ConvertMeshes call over repeatCount calls.
+    double TimeConvert(ModelLoader& loader, const std::vector<aiMesh*>& sceneMeshes,
+        std::vector<ModelMeshData>& meshes, int repeatCount)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeatCount; i++)
+        {
+            loader.ConvertMeshes(sceneMeshes, meshes);
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeatCount;
+    }
+}
+
+// Reports serial against parallel mesh conversion for each model under
+// Assets/Models, after the Assimp import that neither mode affects.  Models
+// that are missing or fail to import are skipped.  Run on its own with
+// "Tests.exe ModelLoaderTime".
+TEST_CASE(ModelLoaderTimeConvertAssetsModels)
+{
+    const unsigned int importFlags = aiProcess_Triangulate | aiProcess_ConvertToLeftHanded;
+    const int repeatCount = 5;
+
+    for (const char* asset : ModelAssets)
+    {
+        const std::string path = FindAsset(asset);
+        Assimp::Importer importer;
+        const aiScene* scene = path.empty() ? nullptr : importer.ReadFile(path, importFlags);
+        if (!scene)
+        {
+            printf("    %s: not found or not importable, skipped\n", asset);
+            continue;
+        }
+
+        std::vector<aiMesh*> sceneMeshes(scene->mMeshes, scene->mMeshes + scene->mNumMeshes);
+        size_t vertexCount = 0;
+        for (const aiMesh* mesh : sceneMeshes)
+        {
+            vertexCount += mesh->mNumVertices;
+        }
+
+        ModelLoader serial;
+        serial.mParallelProcessing = false;
+        std::vector<ModelMeshData> serialMeshes;
+        const double serialSeconds = TimeConvert(serial, sceneMeshes, serialMeshes, repeatCount);
+
+        ModelLoader parallel;
+        parallel.mParallelProcessing = true;
+        std::vector<ModelMeshData> parallelMeshes;
+        const double parallelSeconds = TimeConvert(parallel, sceneMeshes, parallelMeshes, repeatCount);
+
+        printf("    %s: %zu meshes, %zu vertices: serial %.2f ms, parallel %.2f ms (%.1fx)\n", asset,
+            sceneMeshes.size(), vertexCount, 1000.0 * serialSeconds, 1000.0 * parallelSeconds,
+            serialSeconds / parallelSeconds);
+        CHECK(serialMeshes.size() == sceneMeshes.size());
+        CHECK(SameMeshes(serialMeshes, parallelMeshes));
+    }
+}
+
+// Reports the ACMR and ATVR MeshOptimizer reaches on each model under
+// Assets/Models, summed over its triangle meshes.  Models that are missing or
+// fail to import are skipped.  Run on its own with "Tests.exe ModelLoaderACMR".
+TEST_CASE(ModelLoaderACMRAssetsModels)
+{
+    const unsigned int importFlags = aiProcess_Triangulate | aiProcess_ConvertToLeftHanded;
+
+    for (const char* asset : ModelAssets)
+    {
+        const std::string path = FindAsset(asset);
+        Assimp::Importer importer;
+        const aiScene* scene = path.empty() ? nullptr : importer.ReadFile(path, importFlags);
+        if (!scene)
+        {
+            printf("    %s: not found or not importable, skipped\n", asset);
+            continue;
+        }
+
+        std::vector<aiMesh*> sceneMeshes;
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            if (scene->mMeshes[i]->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+            {
+                sceneMeshes.push_back(scene->mMeshes[i]);
+            }
+        }
+        ModelLoader loader;
+        std::vector<ModelMeshData> meshes;
+        loader.ConvertMeshes(sceneMeshes, meshes);
+
+        double triangles = 0.0, verticesBefore = 0.0, verticesAfter = 0.0;
+        double transformsBefore = 0.0, transformsAfter = 0.0;
+        bool improved = true;
+        for (auto& mesh : meshes)
+        {
+            std::vector<uint32_t> indices(mesh.indices.begin(), mesh.indices.end());
+            indices.insert(indices.end(), mesh.indices32.begin(), mesh.indices32.end());
+            const MeshOptimizer::Report report = MeshOptimizer::Optimize(mesh.vertices, indices);
+            improved = improved && report.after.acmr <= report.before.acmr;
+
+            const double meshTriangles = indices.size() / 3.0;
+            triangles += meshTriangles;
+            verticesBefore += report.vertexCountBefore;
+            verticesAfter += report.vertexCountAfter;
+            transformsBefore += report.before.acmr * meshTriangles;
+            transformsAfter += report.after.acmr * meshTriangles;
+        }
+
+        printf("    %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", asset,
+            transformsBefore / triangles, transformsAfter / triangles,
+            transformsBefore / verticesBefore, transformsAfter / verticesAfter);
+        CHECK(improved);
+    }
+}
+
+TEST_CASE(ModelLoaderPicksIndexWidthByVertexCount)
+{
+    std::unique_ptr<aiMesh> small = MakeStrip(ModelLoader::MaxRangeVertices);
+    std::unique_ptr<aiMesh> large = MakeStrip(ModelLoader::MaxRangeVertices + 1);
+
+    ModelLoader loader;
+    std::vector<ModelMeshData> meshes;
+    loader.ConvertMeshes({ small.get(), large.get() }, meshes);
+    CHECK(meshes.size() == 2);
+
+    CHECK(meshes[0].indices.size() == size_t(small->mNumFaces) * 3);
+    CHECK(meshes[0].indices32.empty());
+    CHECK(meshes[0].ranges.empty());
+    CHECK(SameCorners(*small, meshes[0]));
+
+    CHECK(meshes[1].indices.empty());
+    CHECK(meshes[1].indices32.size() == size_t(large->mNumFaces) * 3);
+    CHECK(meshes[1].ranges.empty());
+    CHECK(SameCorners(*large, meshes[1]));
+}
+
+TEST_CASE(ModelLoaderSplitsLargeMeshesInto16BitRanges)
+{
+    std::unique_ptr<aiMesh> large = MakeStrip(200000);
+
+    ModelLoader loader;
+    loader.mSplitLargeMeshes = true;
+    std::vector<ModelMeshData> meshes;
+    loader.ConvertMeshes({ large.get() }, meshes);
+    CHECK(meshes.size() == 1);
+
+    const ModelMeshData& mesh = meshes[0];
+    CHECK(mesh.indices32.empty());
+    CHECK(mesh.indices.size() == size_t(large->mNumFaces) * 3);
+    CHECK(mesh.ranges.size() == 4);
+    CHECK(SameCorners(*large, mesh));
+
+    // The ranges tile the index buffer, and each one reaches at most 65536
+    // vertices from its base.
+    UINT nextIndex = 0;
+    for (size_t r = 0; r < mesh.ranges.size(); r++)
+    {
+        const SubmeshGeometry& range = mesh.ranges[r];
+        CHECK(range.StartIndexLocation == nextIndex);
+        nextIndex += range.IndexCount;
+        const INT rangeEnd = r + 1 < mesh.ranges.size() ? mesh.ranges[r + 1].BaseVertexLocation : INT(mesh.vertices.size());
+        CHECK(rangeEnd - range.BaseVertexLocation <= INT(ModelLoader::MaxRangeVertices));
+    }
+    CHECK(nextIndex == mesh.indices.size());
+
+    // Only the two vertices each boundary triangle shares are duplicated.
+    CHECK(mesh.vertices.size() == large->mNumVertices + 2 * (mesh.ranges.size() - 1));
+}
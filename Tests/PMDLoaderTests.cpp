@@ -0,0 +1,317 @@
+#include "Test.h"
+#include "../ModelLoader/PMDLoader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // Appends the little-endian bytes of a PMD image, field by field.
+    class PMDWriter
+    {
+    public:
+        template <typename T>
+        void Put(const T& value)
+        {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+            mBytes.insert(mBytes.end(), bytes, bytes + sizeof(T));
+        }
+
+        void PutString(const char* str, size_t length)
+        {
+            const size_t used = std::min<size_t>(strlen(str), length);
+            mBytes.insert(mBytes.end(), str, str + used);
+            mBytes.insert(mBytes.end(), length - used, '\0');
+        }
+
+        size_t Size()const { return mBytes.size(); }
+        const std::vector<uint8_t>& Bytes()const { return mBytes; }
+
+    private:
+        std::vector<uint8_t> mBytes;
+    };
+
+    struct SyntheticPMD
+    {
+        std::vector<uint8_t> bytes;
+        size_t requiredSize = 0;	// bytes up to the end of the display lists
+    };
+
+    // A grid of gridSize^2 vertices and every optional section, with bones
+    // and morphs sized so each one has something to check.
+    SyntheticPMD MakePMD(uint16_t gridSize)
+    {
+        PMDWriter writer;
+
+        PMDHeader header = {};
+        memcpy(header.m_magic, "Pmd", 3);
+        header.m_version = 1.0f;
+        strcpy_s(header.m_modelName, "Synthetic");
+        writer.Put(header);
+
+        const uint32_t vertexCount = uint32_t(gridSize) * gridSize;
+        writer.Put(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++)
+        {
+            PMDVertex vertex = {};
+            vertex.m_position = Vector3(float(i % gridSize), float(i / gridSize), 0.0f);
+            vertex.m_normal = Vector3(0.0f, 0.0f, -1.0f);
+            vertex.m_uv = Vector2(float(i % gridSize) / gridSize, float(i / gridSize) / gridSize);
+            vertex.m_bone[0] = uint16_t(i % 3);
+            vertex.m_bone[1] = uint16_t((i + 1) % 3);
+            vertex.m_boneWeight = 100;
+            writer.Put(vertex);
+        }
+
+        std::vector<uint16_t> indices;
+        for (uint16_t y = 0; y + 1 < gridSize; y++)
+        {
+            for (uint16_t x = 0; x + 1 < gridSize; x++)
+            {
+                const uint16_t corner = uint16_t(y * gridSize + x);
+                const uint16_t quad[] = { corner, uint16_t(corner + gridSize), uint16_t(corner + 1),
+                    uint16_t(corner + 1), uint16_t(corner + gridSize), uint16_t(corner + gridSize + 1) };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        writer.Put(uint32_t(indices.size()));
+        for (uint16_t index : indices)
+        {
+            writer.Put(index);
+        }
+
+        // Two materials split the faces between them.
+        const uint32_t firstMaterialIndices = uint32_t(indices.size() / 6 * 3);
+        const uint32_t materialIndexCounts[] = { firstMaterialIndices, uint32_t(indices.size()) - firstMaterialIndices };
+        const char* textures[] = { "body.bmp*sphere.spa", "" };
+        writer.Put(uint32_t(2));
+        for (int i = 0; i < 2; i++)
+        {
+            PMDMaterial material = {};
+            material.m_diffuse = Vector3(1.0f, 0.5f, 0.25f);
+            material.m_alpha = 1.0f;
+            material.m_toonIndex = uint8_t(i);
+            material.m_faceVertexCount = materialIndexCounts[i];
+            strncpy_s(material.m_textureName, textures[i], _TRUNCATE);
+            writer.Put(material);
+        }
+
+        const uint16_t boneCount = 3;
+        writer.Put(boneCount);
+        for (uint16_t i = 0; i < boneCount; i++)
+        {
+            PMDBone bone = {};
+            sprintf_s(bone.m_boneName, "bone%u", i);
+            bone.m_parent = i == 0 ? 0xFFFF : uint16_t(i - 1);
+            bone.m_position = Vector3(0.0f, float(i), 0.0f);
+            writer.Put(bone);
+        }
+
+        // One IK chain of two links.
+        writer.Put(uint16_t(1));
+        writer.Put(uint16_t(2));
+        writer.Put(uint16_t(1));
+        writer.Put(uint8_t(2));
+        writer.Put(uint16_t(40));
+        writer.Put(0.5f);
+        writer.Put(uint16_t(1));
+        writer.Put(uint16_t(0));
+
+        // A base morph of three vertices and an eye morph of two.
+        writer.Put(uint16_t(2));
+        const uint32_t morphVertexCounts[] = { 3, 2 };
+        const PMDMorph::MorphType morphTypes[] = { PMDMorph::Base, PMDMorph::Eye };
+        for (int m = 0; m < 2; m++)
+        {
+            writer.PutString(m == 0 ? "base" : "blink", 20);
+            writer.Put(morphVertexCounts[m]);
+            writer.Put(morphTypes[m]);
+            for (uint32_t i = 0; i < morphVertexCounts[m]; i++)
+            {
+                PMDMorph::Vertex morphVertex = { i, Vector3(0.0f, 0.1f * m, 0.0f) };
+                writer.Put(morphVertex);
+            }
+        }
+
+        writer.Put(uint8_t(1));
+        writer.Put(uint16_t(1));
+
+        // Two display frames; bones 1 and 2 in the first, bone 0 in the second.
+        writer.Put(uint8_t(2));
+        writer.PutString("upper", 50);
+        writer.PutString("lower", 50);
+        writer.Put(uint32_t(3));
+        const uint16_t displayBones[] = { 1, 2, 0 };
+        const uint8_t displayFrames[] = { 1, 1, 2 };
+        for (int i = 0; i < 3; i++)
+        {
+            writer.Put(displayBones[i]);
+            writer.Put(displayFrames[i]);
+        }
+
+        SyntheticPMD pmd;
+        pmd.requiredSize = writer.Size();
+
+        writer.Put(uint8_t(1));
+        writer.PutString("Synthetic", 20);
+        writer.PutString("", 256);
+        for (uint16_t i = 0; i < boneCount; i++)
+        {
+            writer.PutString("bone", 20);
+        }
+        writer.PutString("Blink", 20);
+        writer.PutString("Upper", 50);
+        writer.PutString("Lower", 50);
+
+        for (int i = 0; i < 10; i++)
+        {
+            char toonName[100] = {};
+            sprintf_s(toonName, "toon%02d.bmp", i + 1);
+            writer.PutString(toonName, 100);
+        }
+
+        writer.Put(uint32_t(1));
+        PMDRigidBodyExt body = {};
+        strcpy_s(body.m_rigidBodyName, "head");
+        body.m_boneIndex = 2;
+        body.m_shapeType = PMDRigidBodyShape::Capsule;
+        body.m_rigidBodyType = PMDRigidBodyOperation::Dynamic;
+        writer.Put(body);
+
+        writer.Put(uint32_t(1));
+        PMDJointExt joint = {};
+        strcpy_s(joint.m_jointName, "neck");
+        joint.m_rigidBodyA = 0;
+        joint.m_rigidBodyB = 0;
+        writer.Put(joint);
+
+        pmd.bytes = writer.Bytes();
+        return pmd;
+    }
+}
+
+TEST_CASE(PMDParseReadsEverySection)
+{
+    const SyntheticPMD image = MakePMD(16);
+    PMDFile pmd;
+    CHECK(PMDLoader::Parse(image.bytes.data(), image.bytes.size(), pmd));
+
+    CHECK(strcmp(pmd.m_header.m_modelName, "Synthetic") == 0);
+    CHECK(pmd.m_vertices.size() == 256);
+    CHECK(pmd.m_vertices[17].m_position.x == 1.0f && pmd.m_vertices[17].m_position.y == 1.0f);
+    CHECK(pmd.m_vertices[17].m_bone[1] == 0 && pmd.m_vertices[17].m_boneWeight == 100);
+    CHECK(pmd.m_faces.size() == 15 * 15 * 2);
+    CHECK(pmd.m_faces[1].m_vertices[2] == 17);
+
+    CHECK(pmd.m_materials.size() == 2);
+    CHECK(pmd.m_materials[0].m_faceVertexCount + pmd.m_materials[1].m_faceVertexCount == pmd.m_faces.size() * 3);
+    CHECK(strcmp(pmd.m_materials[0].m_textureName, "body.bmp*sphere.spa") == 0);
+
+    CHECK(pmd.m_bones.size() == 3);
+    CHECK(pmd.m_bones[2].m_parent == 1 && pmd.m_bones[2].m_position.y == 2.0f);
+    CHECK(pmd.m_iks.size() == 1);
+    CHECK(pmd.m_iks[0].m_numIteration == 40 && pmd.m_iks[0].m_chanins.size() == 2);
+
+    CHECK(pmd.m_morphs.size() == 2);
+    CHECK(pmd.m_morphs[1].m_morphType == PMDMorph::Eye && pmd.m_morphs[1].m_vertices.size() == 2);
+    CHECK(strcmp(pmd.m_morphs[1].m_englishShapeNameExt, "Blink") == 0);
+    CHECK(pmd.m_morphDisplayList.m_displayList.size() == 1);
+
+    CHECK(pmd.m_boneDisplayLists.size() == 2);
+    CHECK(pmd.m_boneDisplayLists[0].m_displayList.size() == 2 && pmd.m_boneDisplayLists[1].m_displayList.size() == 1);
+    CHECK(strcmp(pmd.m_boneDisplayLists[1].m_englishNameExt, "Lower") == 0);
+
+    CHECK(strcmp(pmd.m_toonTextureNames[9].data(), "toon10.bmp") == 0);
+    CHECK(pmd.m_rigidBodies.size() == 1 && pmd.m_rigidBodies[0].m_shapeType == PMDRigidBodyShape::Capsule);
+    CHECK(pmd.m_joints.size() == 1 && strcmp(pmd.m_joints[0].m_jointName, "neck") == 0);
+}
+
+TEST_CASE(PMDParseRejectsTruncatedFiles)
+{
+    const SyntheticPMD image = MakePMD(4);
+    PMDFile pmd;
+
+    // Everything up to the display lists is required.
+    bool anyParsed = false;
+    for (size_t size = 0; size < image.requiredSize; size++)
+    {
+        anyParsed = anyParsed || PMDLoader::Parse(image.bytes.data(), size, pmd);
+    }
+    CHECK(!anyParsed);
+
+    // Older exporters stop there, which leaves the extensions empty.
+    CHECK(PMDLoader::Parse(image.bytes.data(), image.requiredSize, pmd));
+    CHECK(pmd.m_rigidBodies.empty() && pmd.m_joints.empty());
+    CHECK(pmd.m_toonTextureNames[0][0] == '\0');
+
+    // But a file cut off inside the rigid bodies is corrupt.
+    CHECK(!PMDLoader::Parse(image.bytes.data(), image.bytes.size() - 1, pmd));
+}
+
+TEST_CASE(PMDParseRejectsFacesAndMaterialsOutsideTheMesh)
+{
+    const SyntheticPMD image = MakePMD(4);
+    const size_t vertexCountOffset = sizeof(PMDHeader);
+    const size_t faceCountOffset = vertexCountOffset + sizeof(uint32_t) + 16 * sizeof(PMDVertex);
+    const size_t firstFaceOffset = faceCountOffset + sizeof(uint32_t);
+    const size_t firstMaterialOffset = firstFaceOffset + 18 * sizeof(PMDFace) + sizeof(uint32_t);
+    PMDFile pmd;
+
+    std::vector<uint8_t> badFace = image.bytes;
+    const uint16_t pastTheEnd = 16;
+    memcpy(&badFace[firstFaceOffset], &pastTheEnd, sizeof(pastTheEnd));
+    CHECK(!PMDLoader::Parse(badFace.data(), badFace.size(), pmd));
+
+    std::vector<uint8_t> badMaterial = image.bytes;
+    PMDMaterial material;
+    memcpy(&material, &badMaterial[firstMaterialOffset], sizeof(material));
+    material.m_faceVertexCount += 3;
+    memcpy(&badMaterial[firstMaterialOffset], &material, sizeof(material));
+    CHECK(!PMDLoader::Parse(badMaterial.data(), badMaterial.size(), pmd));
+
+    // A face count that is not a whole number of triangles.
+    std::vector<uint8_t> badFaceCount = image.bytes;
+    const uint32_t faceVertexCount = 18 * 3 - 1;
+    memcpy(&badFaceCount[faceCountOffset], &faceVertexCount, sizeof(faceVertexCount));
+    CHECK(!PMDLoader::Parse(badFaceCount.data(), badFaceCount.size(), pmd));
+
+    CHECK(PMDLoader::Parse(image.bytes.data(), image.bytes.size(), pmd));
+}
+
+TEST_CASE(PMDParseReplacesAnEarlierModel)
+{
+    const SyntheticPMD large = MakePMD(16);
+    const SyntheticPMD small = MakePMD(4);
+    PMDFile pmd;
+    CHECK(PMDLoader::Parse(large.bytes.data(), large.bytes.size(), pmd));
+    CHECK(PMDLoader::Parse(small.bytes.data(), small.bytes.size(), pmd));
+
+    CHECK(pmd.m_vertices.size() == 16);
+    CHECK(pmd.m_faces.size() == 18);
+    CHECK(pmd.m_boneDisplayLists.size() == 2);
+    CHECK(pmd.m_boneDisplayLists[0].m_displayList.size() == 2);
+    CHECK(pmd.m_boneDisplayLists[1].m_displayList.size() == 1);
+}
+
+// Reports how fast a model of 65536 vertices parses from memory, the part of
+// a load that is not disk bound.  Run on its own with "Tests.exe PMDParseTime".
+TEST_CASE(PMDParseTimeMBPerSecond)
+{
+    const SyntheticPMD image = MakePMD(256);
+    const int parseCount = 50;
+
+    PMDFile pmd;
+    int parsedCount = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < parseCount; i++)
+    {
+        parsedCount += PMDLoader::Parse(image.bytes.data(), image.bytes.size(), pmd) ? 1 : 0;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double megabytes = double(image.bytes.size()) * parseCount / (1024.0 * 1024.0);
+    printf("    %.1f MB model: %.0f MB/s\n", image.bytes.size() / (1024.0 * 1024.0), megabytes / seconds);
+    CHECK(parsedCount == parseCount);
+    CHECK(pmd.m_vertices.size() == 65536);
+}
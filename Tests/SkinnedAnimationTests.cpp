@@ -0,0 +1,180 @@
+#include "Test.h"
+#include "../Common/SkinnedAnimation.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    UINT Sum(const uint8_t* quantized)
+    {
+        UINT sum = 0;
+        for (UINT i = 0; i < MaxBoneInfluences; i++)
+        {
+            sum += quantized[i];
+        }
+        return sum;
+    }
+
+    // A binary tree of boneCount bones with identity bind poses, so every
+    // parent comes before its children.
+    Skeleton MakeSkeleton(UINT boneCount)
+    {
+        Skeleton skeleton;
+        for (UINT i = 0; i < boneCount; i++)
+        {
+            skeleton.BoneNames.push_back("bone" + std::to_string(i));
+            skeleton.ParentIndices.push_back(i == 0 ? -1 : int(i - 1) / 2);
+            Matrix identity;
+            XMStoreFloat4x4(&identity, XMMatrixIdentity());
+            skeleton.InverseBindPose.push_back(identity);
+        }
+        return skeleton;
+    }
+
+    // One second of every bone turning about z at its own rate.
+    AnimationClip MakeClip(UINT boneCount)
+    {
+        AnimationClip clip;
+        clip.Name = "turn";
+        clip.BoneCount = boneCount;
+        clip.KeyCount = 31;
+        for (UINT key = 0; key < clip.KeyCount; key++)
+        {
+            for (UINT bone = 0; bone < boneCount; bone++)
+            {
+                const float angle = 0.01f * float(key * (bone + 1));
+                clip.Rotations.push_back(XMFLOAT4(0.0f, 0.0f, sinf(angle / 2.0f), cosf(angle / 2.0f)));
+                clip.Translations.push_back(XMFLOAT3(0.0f, 1.0f, 0.0f));
+                clip.Scales.push_back(XMFLOAT3(1.0f, 1.0f, 1.0f));
+            }
+        }
+        return clip;
+    }
+}
+
+TEST_CASE(QuantizeWeightsSumsTo255)
+{
+    const float thirds[] = { 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f };
+    uint8_t quantized[MaxBoneInfluences];
+    SkinnedAnimation::QuantizeWeights(thirds, 3, quantized);
+    CHECK(Sum(quantized) == 255);
+    CHECK(quantized[0] == 85 && quantized[1] == 85 && quantized[2] == 85);
+    CHECK(quantized[3] == 0);
+
+    // Every one of these rounds down, so the lost units go somewhere.
+    const float even[] = { 0.25f, 0.25f, 0.25f, 0.25f };
+    SkinnedAnimation::QuantizeWeights(even, 4, quantized);
+    CHECK(Sum(quantized) == 255);
+    for (UINT i = 0; i < 4; i++)
+    {
+        CHECK(quantized[i] == 63 || quantized[i] == 64);
+    }
+
+    // Weights that do not sum to 1 are normalized first.
+    const float unnormalized[] = { 3.0f, 1.0f };
+    SkinnedAnimation::QuantizeWeights(unnormalized, 2, quantized);
+    CHECK(Sum(quantized) == 255);
+    CHECK(quantized[0] == 191 && quantized[1] == 64);
+}
+
+TEST_CASE(QuantizeWeightsGivesRoundingToLargestRemainders)
+{
+    // 0.7 * 255 = 178.5, 0.2 * 255 = 51, 0.1 * 255 = 25.5: one unit is missing
+    // after rounding down and the halves tie, so the first of them takes it.
+    const float weights[] = { 0.7f, 0.2f, 0.1f };
+    uint8_t quantized[MaxBoneInfluences];
+    SkinnedAnimation::QuantizeWeights(weights, 3, quantized);
+    CHECK(Sum(quantized) == 255);
+    CHECK(quantized[0] >= quantized[1] && quantized[1] >= quantized[2]);
+    CHECK(quantized[1] == 51);
+
+    // Each weight stays within one unit of its exact value.
+    const float uneven[] = { 0.41f, 0.33f, 0.17f, 0.09f };
+    SkinnedAnimation::QuantizeWeights(uneven, 4, quantized);
+    CHECK(Sum(quantized) == 255);
+    for (UINT i = 0; i < 4; i++)
+    {
+        const float exact = uneven[i] * 255.0f;
+        CHECK(quantized[i] >= exact - 1.0f && quantized[i] <= exact + 1.0f);
+    }
+}
+
+TEST_CASE(QuantizeWeightsHandlesDegenerateInput)
+{
+    uint8_t quantized[MaxBoneInfluences] = { 1, 2, 3, 4 };
+
+    // No influences leaves the vertex unweighted rather than dividing by zero.
+    const float zeros[] = { 0.0f, 0.0f };
+    SkinnedAnimation::QuantizeWeights(zeros, 2, quantized);
+    CHECK(Sum(quantized) == 0);
+
+    SkinnedAnimation::QuantizeWeights(nullptr, 0, quantized);
+    CHECK(Sum(quantized) == 0);
+
+    // Negative weights count as zero.
+    const float negative[] = { -0.5f, 1.0f };
+    SkinnedAnimation::QuantizeWeights(negative, 2, quantized);
+    CHECK(quantized[0] == 0 && quantized[1] == 255);
+
+    // A single influence gets all of it.
+    const float single[] = { 0.01f };
+    SkinnedAnimation::QuantizeWeights(single, 1, quantized);
+    CHECK(quantized[0] == 255 && quantized[1] == 0 && quantized[2] == 0 && quantized[3] == 0);
+}
+
+TEST_CASE(SkinnedVertexMatchesItsInputLayout)
+{
+    const D3D12_INPUT_LAYOUT_DESC& layout = VertexPositionNormalTextureSkinned::InputLayout;
+    CHECK(layout.NumElements == 5);
+    CHECK(layout.pInputElementDescs[3].Format == DXGI_FORMAT_R8G8B8A8_UINT);
+    CHECK(layout.pInputElementDescs[4].Format == DXGI_FORMAT_R8G8B8A8_UNORM);
+    CHECK(sizeof(VertexPositionNormalTextureSkinned) == 40);
+}
+
+// Reports palette bones evaluated per microsecond for a crowd of 64-bone
+// instances, and checks the parallel evaluation against one instance at a
+// time.  Run on its own with "Tests.exe SkinnedAnimationTime".
+TEST_CASE(SkinnedAnimationTimeBonesPerMicrosecond)
+{
+    const UINT boneCount = 64;
+    const size_t instanceCount = 1024;
+    const int evaluationCount = 20;
+
+    const Skeleton skeleton = MakeSkeleton(boneCount);
+    const AnimationClip clip = MakeClip(boneCount);
+    std::vector<float> times(instanceCount);
+    for (size_t i = 0; i < instanceCount; i++)
+    {
+        times[i] = 0.0037f * float(i);
+    }
+
+    std::vector<Matrix> palettes(instanceCount * boneCount);
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < evaluationCount; i++)
+    {
+        SkinnedAnimation::EvaluateInstances(skeleton, clip, times.data(), instanceCount, palettes.data());
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double bones = double(boneCount) * instanceCount * evaluationCount;
+    printf("    %zu instances of %u bones: %.1f bones/us\n", instanceCount, boneCount, bones / (seconds * 1e6));
+
+    std::vector<XMMATRIX> local(boneCount);
+    std::vector<XMMATRIX> global(boneCount);
+    std::vector<Matrix> expected(boneCount);
+    bool matches = true;
+    for (size_t i = 0; i < instanceCount; i++)
+    {
+        SkinnedAnimation::SampleLocalPose(clip, times[i], local.data());
+        SkinnedAnimation::ConcatenateHierarchy(skeleton, local.data(), global.data());
+        SkinnedAnimation::BuildPalette(skeleton, global.data(), expected.data());
+        matches = matches && memcmp(expected.data(), &palettes[i * boneCount], boneCount * sizeof(Matrix)) == 0;
+    }
+    CHECK(matches);
+
+    // The root only turns, so its translation stays where the clip put it.
+    CHECK(palettes[0]._41 == 0.0f && palettes[0]._42 == 1.0f && palettes[0]._43 == 0.0f);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+// Just enough of a test framework for the Tests project: TEST_CASE bodies
+// register themselves, CHECK records a failure and carries on, and
+// TestMain.cpp runs every case and returns non-zero if any check failed.
+
+typedef void (*TestFunction)();
+
+struct TestCase
+{
+    const char* Name;
+    TestFunction Function;
+};
+
+std::vector<TestCase>& TestCases();
+void ReportCheckFailure(const char* expression, const char* file, int line);
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* name, TestFunction function)
+    {
+        TestCases().push_back({ name, function });
+    }
+};
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(expression) \
+    ((expression) ? (void)0 : ReportCheckFailure(#expression, __FILE__, __LINE__))
@@ -0,0 +1,56 @@
+#include "Test.h"
+#include "../Common/d3dUtil.h"
+#include "ObjectInterfacePerModule.h"
+
+#include <cstdio>
+#include <cstring>
+
+// The app defines this in FrameResource.cpp.
+const int gNumFrameResources = 3;
+
+// The app defines this in ObjectInterfacePerModuleSource.cpp; loaders reach the device through it.
+SystemTable* PerModuleInterface::g_pSystemTable = 0;
+
+namespace
+{
+    int sFailureCount = 0;
+}
+
+std::vector<TestCase>& TestCases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+void ReportCheckFailure(const char* expression, const char* file, int line)
+{
+    printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+    sFailureCount++;
+}
+
+// Tests.exe [filter] runs the cases whose name contains filter, or all of them.
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+
+    int runCount = 0;
+    int failedCount = 0;
+    for (const TestCase& test : TestCases())
+    {
+        if (strstr(test.Name, filter) == nullptr)
+        {
+            continue;
+        }
+
+        const int failuresBefore = sFailureCount;
+        test.Function();
+        runCount++;
+
+        const bool passed = sFailureCount == failuresBefore;
+        failedCount += passed ? 0 : 1;
+        printf("%s %s\n", passed ? "[ OK ]" : "[FAIL]", test.Name);
+    }
+
+    printf("%d of %d test cases passed\n", runCount - failedCount, runCount);
+    return failedCount == 0 ? 0 : 1;
+}
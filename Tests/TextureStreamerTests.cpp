@@ -0,0 +1,298 @@
+#include "Test.h"
+#include "../Common/TextureStreamer.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+    // Hands out textures whose mips are the given sizes in bytes, most
+    // detailed first, without touching a device.  Paths it does not know fail.
+    class FakeTextureDecoder : public TextureDecoder
+    {
+    public:
+        HRESULT Decode(const std::wstring& path, DecodedTexture& texture) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDecodeCount++;
+            auto found = mMipSizes.find(path);
+            if (found == mMipSizes.end())
+            {
+                return E_FAIL;
+            }
+
+            size_t total = 0;
+            for (UINT64 size : found->second)
+            {
+                total += (size_t)size;
+            }
+            texture.Data.reset(new uint8_t[total]);
+            texture.Mips.clear();
+            size_t offset = 0;
+            for (UINT64 size : found->second)
+            {
+                D3D12_SUBRESOURCE_DATA mip = {};
+                mip.pData = texture.Data.get() + offset;
+                mip.RowPitch = (LONG_PTR)size;
+                mip.SlicePitch = (LONG_PTR)size;
+                texture.Mips.push_back(mip);
+                offset += (size_t)size;
+            }
+            return S_OK;
+        }
+
+        std::mutex mMutex;
+        std::unordered_map<std::wstring, std::vector<UINT64>> mMipSizes;
+        UINT mDecodeCount = 0;
+    };
+
+    const UINT FirstDescriptor = 10;
+    const UINT FramesInFlight = 3;
+
+    struct StreamerFixture
+    {
+        StreamerFixture(UINT64 frameBudget, UINT workerCount = 0)
+        {
+            auto decoder = std::make_unique<FakeTextureDecoder>();
+            auto backend = std::make_unique<NullTextureUploadBackend>();
+            mDecoder = decoder.get();
+            mBackend = backend.get();
+            mDecoder->mMipSizes[L"textures/big.dds"] = { 4096, 1024, 256, 64 };
+            mDecoder->mMipSizes[L"textures/small.dds"] = { 256, 64 };
+            mStreamer = std::make_unique<TextureStreamer>(std::move(decoder), std::move(backend),
+                FirstDescriptor, 4, frameBudget, workerCount);
+        }
+
+        FakeTextureDecoder* mDecoder;
+        NullTextureUploadBackend* mBackend;
+        std::unique_ptr<TextureStreamer> mStreamer;
+    };
+
+    UINT SlotDescriptor(UINT texture, UINT slot)
+    {
+        return FirstDescriptor + 1 + texture * TextureStreamer::SlotsPerTexture + slot;
+    }
+}
+
+TEST_CASE(TextureStreamerUploadsSmallestMipsFirstWithinBudget)
+{
+    StreamerFixture fixture(300);
+    TextureStreamer& streamer = *fixture.mStreamer;
+    const std::vector<NullTextureUploadBackend::UploadRecord>& uploads = fixture.mBackend->mUploads;
+
+    const UINT big = streamer.Request(L"textures/big.dds");
+    CHECK(fixture.mBackend->mSrvs[FirstDescriptor] == UINT(-1));
+    CHECK(streamer.SrvIndex(big) == streamer.NullSrvIndex());
+
+    // 64 + 256 bytes is over the budget, so only the smallest mip goes up.
+    UINT64 frame = 1;
+    streamer.Update(frame++, FramesInFlight);
+    CHECK(uploads.size() == 1);
+    CHECK(uploads[0].FirstMip == 3 && uploads[0].MipCount == 1 && uploads[0].Bytes == 64);
+    CHECK(streamer.BytesUploadedLastFrame() == 64);
+    CHECK(streamer.ResidentMipCount(big) == 0);
+    CHECK(streamer.SrvIndex(big) == streamer.NullSrvIndex());
+
+    // A mip larger than the whole budget still goes up, on its own.
+    streamer.Update(frame++, FramesInFlight);
+    streamer.Update(frame++, FramesInFlight);
+    CHECK(uploads.size() == 3);
+    CHECK(uploads[1].FirstMip == 2 && uploads[1].Bytes == 256);
+    CHECK(uploads[2].FirstMip == 1 && uploads[2].Bytes == 1024);
+    CHECK(uploads[1].Submission < uploads[2].Submission);
+
+    for (int i = 0; i < 16 && !streamer.Idle(); i++)
+    {
+        streamer.Update(frame++, FramesInFlight);
+    }
+    CHECK(streamer.Idle());
+    CHECK(uploads.size() == 4);
+    CHECK(uploads[3].FirstMip == 0 && uploads[3].Bytes == 4096);
+    CHECK(streamer.ResidentMipCount(big) == 4);
+    CHECK(fixture.mBackend->mSrvs[streamer.SrvIndex(big)] == 0);
+    CHECK(fixture.mDecoder->mDecodeCount == 1);
+}
+
+TEST_CASE(TextureStreamerAlternatesDescriptorsAfterFramesInFlight)
+{
+    StreamerFixture fixture(1);
+    TextureStreamer& streamer = *fixture.mStreamer;
+    const UINT big = streamer.Request(L"textures/big.dds");
+
+    // Frame 1 uploads the smallest mip, frame 2 publishes it in the first slot.
+    streamer.Update(1, FramesInFlight);
+    streamer.Update(2, FramesInFlight);
+    CHECK(streamer.SrvIndex(big) == SlotDescriptor(big, 0));
+    CHECK(streamer.ResidentMipCount(big) == 1);
+    CHECK(fixture.mBackend->mSrvs[SlotDescriptor(big, 0)] == 3);
+
+    // The next mip is resident from frame 3, but the other slot may still be
+    // in use by frames in flight until FramesInFlight frames have passed.
+    UINT64 frame = 3;
+    for (; frame < 2 + FramesInFlight; frame++)
+    {
+        streamer.Update(frame, FramesInFlight);
+        CHECK(streamer.SrvIndex(big) == SlotDescriptor(big, 0));
+        CHECK(streamer.ResidentMipCount(big) == 1);
+    }
+
+    // By then every mip has finished, so the second slot shows all of them
+    // and the first still holds what older frames sampled.
+    streamer.Update(frame, FramesInFlight);
+    CHECK(streamer.SrvIndex(big) == SlotDescriptor(big, 1));
+    CHECK(streamer.ResidentMipCount(big) == 4);
+    CHECK(fixture.mBackend->mSrvs[SlotDescriptor(big, 1)] == 0);
+    CHECK(fixture.mBackend->mSrvs[SlotDescriptor(big, 0)] == 3);
+}
+
+TEST_CASE(TextureStreamerFollowsFramesInFlight)
+{
+    StreamerFixture fixture(1);
+    TextureStreamer& streamer = *fixture.mStreamer;
+    const UINT big = streamer.Request(L"textures/big.dds");
+
+    // With one frame in flight the previous frame has completed by the time
+    // the next starts, so every frame can switch slots.
+    streamer.Update(1, 1);
+    streamer.Update(2, 1);
+    CHECK(streamer.SrvIndex(big) == SlotDescriptor(big, 0));
+    streamer.Update(3, 1);
+    CHECK(streamer.SrvIndex(big) == SlotDescriptor(big, 1));
+    CHECK(streamer.ResidentMipCount(big) == 2);
+
+    // The pacer allowing two frames in flight holds the next switch back a
+    // frame.
+    streamer.Update(4, 2);
+    CHECK(streamer.SrvIndex(big) == SlotDescriptor(big, 1));
+    CHECK(streamer.ResidentMipCount(big) == 2);
+    streamer.Update(5, 2);
+    CHECK(streamer.SrvIndex(big) == SlotDescriptor(big, 0));
+    CHECK(streamer.ResidentMipCount(big) == 4);
+}
+
+TEST_CASE(TextureStreamerFavorsPriorityThenFewestMips)
+{
+    StreamerFixture fixture(1);
+    TextureStreamer& streamer = *fixture.mStreamer;
+    const std::vector<NullTextureUploadBackend::UploadRecord>& uploads = fixture.mBackend->mUploads;
+
+    streamer.Request(L"textures/big.dds");
+    const UINT small = streamer.Request(L"textures/small.dds");
+    streamer.SetPriority(small, 1);
+
+    // The small texture goes up entirely before the big one starts.
+    UINT64 frame = 1;
+    for (int i = 0; i < 3; i++)
+    {
+        streamer.Update(frame++, FramesInFlight);
+    }
+    CHECK(uploads.size() == 3);
+    CHECK(uploads[0].Bytes == 64 && uploads[1].Bytes == 256);
+    CHECK(uploads[0].FirstMip == 1 && uploads[1].FirstMip == 0);
+    CHECK(uploads[2].FirstMip == 3 && uploads[2].Bytes == 64);
+
+    // At equal priority each texture gets its small mips before any gets a
+    // large one.
+    StreamerFixture equal(1);
+    equal.mStreamer->Request(L"textures/big.dds");
+    equal.mStreamer->Request(L"textures/small.dds");
+    for (int i = 0; i < 4; i++)
+    {
+        equal.mStreamer->Update(1 + i, FramesInFlight);
+    }
+    const std::vector<NullTextureUploadBackend::UploadRecord>& interleaved = equal.mBackend->mUploads;
+    CHECK(interleaved.size() == 4);
+    CHECK(interleaved[0].FirstMip == 3 && interleaved[1].FirstMip == 1);
+    CHECK(interleaved[2].FirstMip == 2 && interleaved[3].FirstMip == 0);
+    CHECK(interleaved[3].Bytes == 256);
+}
+
+TEST_CASE(TextureStreamerSharesRequestsAndReportsFailures)
+{
+    StreamerFixture fixture(TextureStreamer::DefaultFrameBudget);
+    TextureStreamer& streamer = *fixture.mStreamer;
+
+    const UINT small = streamer.Request(L"textures/small.dds");
+    CHECK(streamer.Request(L"Textures\\.\\Small.dds", 5) == small);
+    CHECK(streamer.TextureCount() == 1);
+
+    const UINT missing = streamer.Request(L"textures/missing.dds");
+    for (UINT64 frame = 1; frame < 8 && !streamer.Idle(); frame++)
+    {
+        streamer.Update(frame, FramesInFlight);
+    }
+    CHECK(streamer.Idle());
+    CHECK(!streamer.Failed(small) && streamer.ResidentMipCount(small) == 2);
+    CHECK(streamer.Failed(missing));
+    CHECK(streamer.SrvIndex(missing) == streamer.NullSrvIndex());
+    CHECK(streamer.ResidentMipCount(missing) == 0);
+    CHECK(fixture.mDecoder->mDecodeCount == 2);
+}
+
+TEST_CASE(TextureStreamerDecodesOnWorkerThreads)
+{
+    StreamerFixture fixture(TextureStreamer::DefaultFrameBudget, 2);
+    TextureStreamer& streamer = *fixture.mStreamer;
+
+    const UINT big = streamer.Request(L"textures/big.dds");
+    const UINT small = streamer.Request(L"textures/small.dds");
+    UINT64 frame = 1;
+    for (; frame < 100000 && !streamer.Idle(); frame++)
+    {
+        streamer.Update(frame, FramesInFlight);
+        std::this_thread::yield();
+    }
+    CHECK(streamer.Idle());
+    CHECK(streamer.ResidentMipCount(big) == 4);
+    CHECK(streamer.ResidentMipCount(small) == 2);
+    CHECK(fixture.mDecoder->mDecodeCount == 2);
+}
+
+TEST_CASE(TextureStreamerHashesOnlyFilesTheSizeOfAResidentTexture)
+{
+    struct TemporaryFiles
+    {
+        ~TemporaryFiles()
+        {
+            remove("TextureStreamerTests_a.dds");
+            remove("TextureStreamerTests_long.dds");
+            remove("TextureStreamerTests_b.dds");
+        }
+    } files;
+    std::ofstream("TextureStreamerTests_a.dds", std::ios::binary) << "0123456789";
+    std::ofstream("TextureStreamerTests_long.dds", std::ios::binary) << "a longer file";
+    std::ofstream("TextureStreamerTests_b.dds", std::ios::binary) << "9876543210";
+
+    AssetRegistry registry;
+    StreamerFixture fixture(TextureStreamer::DefaultFrameBudget);
+    TextureStreamer& streamer = *fixture.mStreamer;
+    streamer.SetRegistry(&registry);
+    for (const wchar_t* path : { L"TextureStreamerTests_a.dds", L"TextureStreamerTests_long.dds", L"TextureStreamerTests_b.dds" })
+    {
+        fixture.mDecoder->mMipSizes[path] = { 256, 64 };
+    }
+
+    auto stream = [&](const wchar_t* path)
+    {
+        const UINT texture = streamer.Request(path);
+        for (UINT64 frame = 1; frame < 16 && !streamer.Idle(); frame++)
+        {
+            streamer.Update(frame, FramesInFlight);
+        }
+        CHECK(streamer.Idle());
+        CHECK(streamer.ResidentMipCount(texture) == 2);
+    };
+
+    // No other texture has either size, so neither file is read twice.
+    stream(L"TextureStreamerTests_a.dds");
+    stream(L"TextureStreamerTests_long.dds");
+    CHECK(registry.GetStats().FilesHashed == 0);
+    CHECK(registry.GetStats().Loads == 2);
+
+    // Same size as the first one: both are hashed, and differ.
+    stream(L"TextureStreamerTests_b.dds");
+    CHECK(registry.GetStats().FilesHashed == 2);
+    CHECK(registry.GetStats().ContentHits == 0);
+    CHECK(registry.GetStats().Loads == 3);
+    CHECK(fixture.mDecoder->mDecodeCount == 3);
+}
@@ -0,0 +1,203 @@
+#include "Test.h"
+#include "../Common/d3dUtil.h"
+#include "../Common/TransformHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    const UINT SyntheticNodeCount = 100000;
+
+    struct LocalTransform
+    {
+        Vector3 Translation;
+        Quaternion Rotation;
+        Vector3 Scale;
+    };
+
+    LocalTransform RandomLocal(std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> scale(0.8f, 1.2f);
+        Vector3 axis(unit(random), unit(random), unit(random));
+        const float length = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z) + 1e-3f;
+        axis = Vector3(axis.x / length, axis.y / length, axis.z / length);
+        return { Vector3(unit(random), unit(random), unit(random)),
+            Quaternion::CreateFromAxisAngle(axis, XM_PI * unit(random)), Vector3(scale(random), scale(random), scale(random)) };
+    }
+
+    // A random tree: each node's parent is any earlier node, or none for
+    // about one node in a thousand, so depths go up and down as nodes are
+    // added and Update has to reorder them.
+    struct SyntheticTree
+    {
+        std::vector<UINT> Parents;
+        std::vector<LocalTransform> Locals;
+    };
+
+    SyntheticTree MakeSyntheticTree(UINT count, TransformHierarchy& hierarchy)
+    {
+        std::mt19937 random(77);
+        SyntheticTree tree;
+        for (UINT i = 0; i < count; i++)
+        {
+            const UINT parent = i == 0 || random() % 1000 == 0 ? TransformHierarchy::NoParent : UINT(random() % i);
+            tree.Parents.push_back(parent);
+            tree.Locals.push_back(RandomLocal(random));
+            CHECK(hierarchy.Add(parent) == i);
+            hierarchy.SetLocal(i, tree.Locals[i].Translation, tree.Locals[i].Rotation, tree.Locals[i].Scale);
+        }
+        return tree;
+    }
+
+    // Scale, then rotate, then translate, composed with the parent's world
+    // by walking up the tree, one node at a time.
+    XMMATRIX ExpectedWorld(const SyntheticTree& tree, UINT node, std::vector<Matrix>& worlds, std::vector<uint8_t>& known)
+    {
+        if (known[node])
+        {
+            return worlds[node];
+        }
+        const LocalTransform& local = tree.Locals[node];
+        XMMATRIX world = XMMatrixMultiply(
+            XMMatrixMultiply(XMMatrixScalingFromVector(XMLoadFloat3(&local.Scale)), XMMatrixRotationQuaternion(XMLoadFloat4(&local.Rotation))),
+            XMMatrixTranslation(local.Translation.x, local.Translation.y, local.Translation.z));
+        if (tree.Parents[node] != TransformHierarchy::NoParent)
+        {
+            world = XMMatrixMultiply(world, ExpectedWorld(tree, tree.Parents[node], worlds, known));
+        }
+        worlds[node] = world;
+        known[node] = 1;
+        return world;
+    }
+
+    // Largest difference of any element, relative to the size of the translation.
+    float MaxWorldError(const SyntheticTree& tree, const TransformHierarchy& hierarchy)
+    {
+        std::vector<Matrix> worlds(tree.Parents.size());
+        std::vector<uint8_t> known(tree.Parents.size(), 0);
+        float maxError = 0.0f;
+        for (UINT node = 0; node < tree.Parents.size(); node++)
+        {
+            const Matrix expected = ExpectedWorld(tree, node, worlds, known);
+            const Matrix& actual = hierarchy.World(node);
+            const float size = 1.0f + std::abs(expected._41) + std::abs(expected._42) + std::abs(expected._43);
+            for (int i = 0; i < 4; i++)
+            {
+                for (int j = 0; j < 4; j++)
+                {
+                    maxError = std::max<float>(maxError, std::abs(actual.m[i][j] - expected.m[i][j]) / size);
+                }
+            }
+        }
+        return maxError;
+    }
+
+    // Nodes at or below node.
+    std::vector<uint8_t> Subtree(const SyntheticTree& tree, UINT node)
+    {
+        std::vector<uint8_t> inside(tree.Parents.size(), 0);
+        for (UINT i = 0; i < tree.Parents.size(); i++)
+        {
+            for (UINT n = i; n != TransformHierarchy::NoParent && !inside[i]; n = tree.Parents[n])
+            {
+                inside[i] = n == node;
+            }
+        }
+        return inside;
+    }
+}
+
+TEST_CASE(TransformHierarchyMatchesParentChains)
+{
+    TransformHierarchy hierarchy;
+    const SyntheticTree tree = MakeSyntheticTree(SyntheticNodeCount, hierarchy);
+    hierarchy.Update();
+
+    // Wide enough that some levels take the parallel path.
+    UINT widestLevel = 0;
+    std::vector<UINT> depth(SyntheticNodeCount, 0);
+    std::vector<UINT> levelSize(1, 0);
+    for (UINT node = 0; node < SyntheticNodeCount; node++)
+    {
+        depth[node] = tree.Parents[node] == TransformHierarchy::NoParent ? 0 : depth[tree.Parents[node]] + 1;
+        levelSize.resize(std::max<size_t>(levelSize.size(), depth[node] + 1), 0);
+        widestLevel = std::max<UINT>(widestLevel, ++levelSize[depth[node]]);
+    }
+    CHECK(widestLevel >= TransformHierarchy::ParallelThreshold);
+    CHECK(hierarchy.LevelCount() == levelSize.size());
+
+    CHECK(hierarchy.NodeCount() == SyntheticNodeCount);
+    CHECK(hierarchy.UpdatedLastFrame() == SyntheticNodeCount);
+    CHECK(MaxWorldError(tree, hierarchy) < 1e-5f);
+}
+
+TEST_CASE(TransformHierarchyUpdatesOnlyChangedSubtrees)
+{
+    TransformHierarchy hierarchy;
+    SyntheticTree tree = MakeSyntheticTree(20000, hierarchy);
+    hierarchy.Update();
+
+    hierarchy.Update();
+    CHECK(hierarchy.UpdatedLastFrame() == 0);
+
+    // Move a node near the top and everything below it follows, nothing else.
+    const UINT moved = 3;
+    std::mt19937 random(5);
+    tree.Locals[moved] = RandomLocal(random);
+    hierarchy.SetLocal(moved, tree.Locals[moved].Translation, tree.Locals[moved].Rotation, tree.Locals[moved].Scale);
+    hierarchy.Update();
+
+    const std::vector<uint8_t> subtree = Subtree(tree, moved);
+    UINT subtreeSize = 0;
+    bool changedMatchesSubtree = true;
+    for (UINT node = 0; node < tree.Parents.size(); node++)
+    {
+        subtreeSize += subtree[node];
+        changedMatchesSubtree = changedMatchesSubtree && hierarchy.WorldChanged(node) == (subtree[node] != 0);
+    }
+    CHECK(subtreeSize > 1);
+    CHECK(hierarchy.UpdatedLastFrame() == subtreeSize);
+    CHECK(changedMatchesSubtree);
+    CHECK(MaxWorldError(tree, hierarchy) < 1e-5f);
+}
+
+// Reports Update over 100k nodes with every node moved, with the last 1%
+// added moved (mostly leaves), and with none; checks only the update counts.
+// Run on its own with "Tests.exe TransformHierarchyTime".
+TEST_CASE(TransformHierarchyTime100kNodes)
+{
+    const int repeatCount = 10;
+    TransformHierarchy hierarchy;
+    const SyntheticTree tree = MakeSyntheticTree(SyntheticNodeCount, hierarchy);
+    hierarchy.Update();
+
+    const UINT firstMoved[] = { 0, SyntheticNodeCount - SyntheticNodeCount / 100, SyntheticNodeCount };
+    for (UINT first : firstMoved)
+    {
+        double seconds = 0.0;
+        for (int repeat = 0; repeat < repeatCount; repeat++)
+        {
+            for (UINT node = first; node < SyntheticNodeCount; node++)
+            {
+                hierarchy.SetLocal(node, tree.Locals[node].Translation, tree.Locals[node].Rotation, tree.Locals[node].Scale);
+            }
+            const auto start = std::chrono::steady_clock::now();
+            hierarchy.Update();
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        seconds /= repeatCount;
+
+        const UINT moved = SyntheticNodeCount - first;
+        const UINT updated = hierarchy.UpdatedLastFrame();
+        printf("    %u nodes, %u moved: %.3f ms, %u updated (%.1f nodes/us)\n", SyntheticNodeCount, moved,
+            1000.0 * seconds, updated, updated / seconds / 1.0e6);
+        CHECK(updated >= moved);
+        CHECK(first != 0 || updated == SyntheticNodeCount);
+        CHECK(moved != 0 || updated == 0);
+    }
+}
@@ -0,0 +1,309 @@
+#include "Test.h"
+#include "../Common/VertexCompression.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    VertexPositionNormalTexture MakeVertex(const Vector3& position, const Vector3& normal, float u, float v)
+    {
+        VertexPositionNormalTexture vertex;
+        vertex.position = position;
+        vertex.normal = normal;
+        vertex.textureCoordinate.x = u;
+        vertex.textureCoordinate.y = v;
+        return vertex;
+    }
+
+    Vector3 Normalized(Vector3 v)
+    {
+        v.Normalize();
+        return v;
+    }
+
+    float AngleDegrees(const Vector3& a, const Vector3& b)
+    {
+        const float cosine = std::max<float>(-1.0f, std::min<float>(1.0f, a.Dot(b) / (a.Length() * b.Length())));
+        return XMConvertToDegrees(acosf(cosine));
+    }
+
+    bool IsUnit(const Vector3& v)
+    {
+        return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z) &&
+            fabsf(v.Length() - 1.0f) < 1e-5f;
+    }
+
+    float OctahedralRoundTripDegrees(const Vector3& n)
+    {
+        int8_t encoded[2];
+        VertexCompression::EncodeOctahedral(n, encoded);
+        return AngleDegrees(n, VertexCompression::DecodeOctahedral(encoded));
+    }
+
+    // A fixed mesh: the corners of a box with axis and diagonal normals and
+    // UVs outside [0, 1], so every field is exercised.
+    std::vector<VertexPositionNormalTexture> FixedVertices()
+    {
+        std::vector<VertexPositionNormalTexture> vertices;
+        for (int i = 0; i < 8; i++)
+        {
+            const Vector3 position((i & 1) ? 12.5f : -3.25f, (i & 2) ? 0.75f : -100.0f, (i & 4) ? 4096.0f : 4000.0f);
+            const Vector3 normal = Normalized(Vector3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f));
+            vertices.push_back(MakeVertex(position, normal, -2.0f + 0.5f * i, 7.0f - 1.25f * i));
+        }
+        vertices.push_back(MakeVertex(Vector3(0.0f, 0.0f, 4050.0f), Vector3(0.0f, 0.0f, -1.0f), 0.0f, 1.0f));
+        vertices.push_back(MakeVertex(Vector3(1.0f, -50.0f, 4010.0f), Vector3(1.0f, 0.0f, 0.0f), 1.0f, 0.0f));
+        vertices.push_back(MakeVertex(Vector3(-1.0f, -20.0f, 4020.0f), Vector3(0.0f, -1.0f, 0.0f), 0.5f, 0.5f));
+        return vertices;
+    }
+}
+
+TEST_CASE(OctahedralNormalsStayWithinToleranceOverTheSphere)
+{
+    const float tolerance = VertexCompressionError::Tolerance(VertexQuantization()).NormalDegrees;
+
+    // Fibonacci sphere, so both hemispheres are covered evenly.
+    const int count = 20000;
+    float worst = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        const float z = 1.0f - 2.0f * (i + 0.5f) / count;
+        const float r = sqrtf(std::max<float>(0.0f, 1.0f - z * z));
+        const float phi = 2.39996323f * i;
+        worst = std::max<float>(worst, OctahedralRoundTripDegrees(Vector3(r * cosf(phi), r * sinf(phi), z)));
+    }
+    CHECK(worst <= tolerance);
+}
+
+TEST_CASE(OctahedralNormalsAcrossTheSeam)
+{
+    const float tolerance = VertexCompressionError::Tolerance(VertexQuantization()).NormalDegrees;
+
+    // The lower hemisphere is folded over the diamond's edges, so directions
+    // just either side of z = 0 and of the x and y axes land on opposite
+    // sides of the seam.
+    const float zs[] = { 0.0f, -1e-6f, -1e-3f, -0.05f, 1e-3f };
+    const float offsets[] = { 0.0f, 1e-6f, -1e-6f, 1e-3f, -1e-3f };
+    for (float z : zs)
+    {
+        for (float offset : offsets)
+        {
+            CHECK(OctahedralRoundTripDegrees(Normalized(Vector3(1.0f, offset, z))) <= tolerance);
+            CHECK(OctahedralRoundTripDegrees(Normalized(Vector3(-1.0f, offset, z))) <= tolerance);
+            CHECK(OctahedralRoundTripDegrees(Normalized(Vector3(offset, 1.0f, z))) <= tolerance);
+            CHECK(OctahedralRoundTripDegrees(Normalized(Vector3(offset, -1.0f, z))) <= tolerance);
+            CHECK(OctahedralRoundTripDegrees(Normalized(Vector3(0.7f + offset, -0.7f, z))) <= tolerance);
+        }
+    }
+
+    // -z maps to every corner of the square.
+    CHECK(OctahedralRoundTripDegrees(Vector3(0.0f, 0.0f, -1.0f)) <= tolerance);
+    CHECK(OctahedralRoundTripDegrees(Normalized(Vector3(1e-4f, -1e-4f, -1.0f))) <= tolerance);
+    CHECK(OctahedralRoundTripDegrees(Vector3(0.0f, 0.0f, 1.0f)) <= tolerance);
+}
+
+TEST_CASE(DegenerateNormalsDecodeToUnitVectors)
+{
+    int8_t encoded[2] = { 1, 1 };
+    VertexCompression::EncodeOctahedral(Vector3(0.0f, 0.0f, 0.0f), encoded);
+    CHECK(encoded[0] == 0 && encoded[1] == 0);
+    CHECK(IsUnit(VertexCompression::DecodeOctahedral(encoded)));
+
+    // Unnormalized and tiny inputs keep their direction.
+    CHECK(OctahedralRoundTripDegrees(Vector3(0.0f, 300.0f, 0.0f)) <= 1.0f);
+    CHECK(OctahedralRoundTripDegrees(Vector3(1e-30f, 0.0f, -1e-30f)) <= 1.0f);
+
+    // Every code decodes to a unit vector.
+    bool allUnit = true;
+    for (int x = -128; x <= 127; x++)
+    {
+        for (int y = -128; y <= 127; y++)
+        {
+            const int8_t code[2] = { (int8_t)x, (int8_t)y };
+            allUnit = allUnit && IsUnit(VertexCompression::DecodeOctahedral(code));
+        }
+    }
+    CHECK(allUnit);
+
+    // A zero normal in a mesh produces no NaNs in the tangent either.
+    const VertexPositionNormalTexture vertices[3] =
+    {
+        MakeVertex(Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, 0.0f), 0.0f, 0.0f),
+        MakeVertex(Vector3(1.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, 0.0f), 1.0f, 0.0f),
+        MakeVertex(Vector3(0.0f, 1.0f, 0.0f), Vector3(0.0f, 0.0f, 0.0f), 0.0f, 1.0f),
+    };
+    const uint16_t indices[3] = { 0, 1, 2 };
+    Vector3 tangents[3];
+    VertexCompression::ComputeTangents(vertices, 3, indices, 3, nullptr, 0, tangents);
+    for (const Vector3& tangent : tangents)
+    {
+        CHECK(IsUnit(tangent));
+    }
+}
+
+TEST_CASE(FixedVertexSetRoundTripsWithinTolerance)
+{
+    const std::vector<VertexPositionNormalTexture> vertices = FixedVertices();
+    const VertexQuantization quantization = VertexQuantization::FromVertices(vertices.data(), vertices.size());
+    CHECK(quantization.Bias.x == -3.25f && quantization.Bias.y == -100.0f && quantization.Bias.z == 4000.0f);
+
+    std::vector<Vector3> tangents(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        Vector3 normal = vertices[i].normal;
+        tangents[i] = Normalized(Vector3(normal.y, -normal.x, 0.0f) + Vector3(0.0f, 0.0f, 0.25f));
+    }
+
+    std::vector<VertexPositionNormalTextureCompact> compact(vertices.size());
+    VertexCompression::Encode(vertices.data(), tangents.data(), vertices.size(), quantization, compact.data());
+
+    const VertexCompressionError error = VertexCompression::MeasureError(
+        vertices.data(), tangents.data(), compact.data(), vertices.size(), quantization);
+    const VertexCompressionError tolerance = VertexCompressionError::Tolerance(quantization);
+    CHECK(error.Within(tolerance));
+    CHECK(error.Position <= tolerance.Position);
+    CHECK(error.NormalDegrees <= tolerance.NormalDegrees);
+    CHECK(error.TangentDegrees <= tolerance.TangentDegrees);
+    CHECK(error.TexCoord <= tolerance.TexCoord);
+
+    // The bounds themselves are representable exactly.
+    CHECK(compact[0].position[0] == 0 && compact[0].position[1] == 0 && compact[0].position[2] == 0);
+    CHECK(compact[7].position[0] == 65535 && compact[7].position[1] == 65535 && compact[7].position[2] == 65535);
+    const VertexPositionNormalTexture corner = VertexCompression::Decode(compact[7], quantization);
+    CHECK(fabsf(corner.position.x - 12.5f) <= tolerance.Position);
+    CHECK(fabsf(corner.position.z - 4096.0f) <= tolerance.Position);
+
+    // A corrupted encoding is caught by the error bounds.
+    compact[3].position[1] = (uint16_t)(compact[3].position[1] ^ 0x0100);
+    CHECK(!VertexCompression::MeasureError(vertices.data(), tangents.data(), compact.data(),
+        vertices.size(), quantization).Within(tolerance));
+}
+
+TEST_CASE(FlatMeshesQuantizeToTheirBias)
+{
+    // Zero extent on every axis: all positions decode to the single point.
+    std::vector<VertexPositionNormalTexture> vertices(4,
+        MakeVertex(Vector3(5.0f, -6.0f, 7.0f), Vector3(0.0f, 1.0f, 0.0f), 0.25f, 0.75f));
+    const VertexQuantization quantization = VertexQuantization::FromVertices(vertices.data(), vertices.size());
+    const std::vector<Vector3> tangents(vertices.size(), Vector3(1.0f, 0.0f, 0.0f));
+
+    std::vector<VertexPositionNormalTextureCompact> compact(vertices.size());
+    VertexCompression::Encode(vertices.data(), tangents.data(), vertices.size(), quantization, compact.data());
+
+    const VertexCompressionError error = VertexCompression::MeasureError(
+        vertices.data(), tangents.data(), compact.data(), vertices.size(), quantization);
+    CHECK(error.Position == 0.0f);
+    CHECK(error.Within(VertexCompressionError::Tolerance(quantization)));
+}
+
+TEST_CASE(TangentsFollowTheUDirection)
+{
+    // A quad in the xy plane facing -z, with u along +x and v along -y as
+    // DirectX lays out textures.
+    const Vector3 normal(0.0f, 0.0f, -1.0f);
+    const VertexPositionNormalTexture vertices[4] =
+    {
+        MakeVertex(Vector3(0.0f, 1.0f, 0.0f), normal, 0.0f, 0.0f),
+        MakeVertex(Vector3(1.0f, 1.0f, 0.0f), normal, 1.0f, 0.0f),
+        MakeVertex(Vector3(1.0f, 0.0f, 0.0f), normal, 1.0f, 1.0f),
+        MakeVertex(Vector3(0.0f, 0.0f, 0.0f), normal, 0.0f, 1.0f),
+    };
+    const uint16_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+    Vector3 tangents[4];
+    VertexCompression::ComputeTangents(vertices, 4, indices, 6, nullptr, 0, tangents);
+    for (const Vector3& tangent : tangents)
+    {
+        CHECK(AngleDegrees(tangent, Vector3(1.0f, 0.0f, 0.0f)) < 1e-3f);
+    }
+
+    // Rotating the UVs a quarter turn rotates the tangent with them.
+    VertexPositionNormalTexture rotated[4];
+    for (int i = 0; i < 4; i++)
+    {
+        rotated[i] = vertices[i];
+        rotated[i].textureCoordinate.x = 1.0f - vertices[i].textureCoordinate.y;
+        rotated[i].textureCoordinate.y = vertices[i].textureCoordinate.x;
+    }
+    VertexCompression::ComputeTangents(rotated, 4, indices, 6, nullptr, 0, tangents);
+    for (const Vector3& tangent : tangents)
+    {
+        CHECK(AngleDegrees(tangent, Vector3(0.0f, 1.0f, 0.0f)) < 1e-3f);
+    }
+
+    // The tangent is made orthogonal to a normal that is not the face normal.
+    VertexPositionNormalTexture tilted[4];
+    for (int i = 0; i < 4; i++)
+    {
+        tilted[i] = vertices[i];
+        tilted[i].normal = Normalized(Vector3(1.0f, 0.0f, -1.0f));
+    }
+    VertexCompression::ComputeTangents(tilted, 4, indices, 6, nullptr, 0, tangents);
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK(IsUnit(tangents[i]));
+        CHECK(fabsf(tangents[i].Dot(tilted[i].normal)) < 1e-5f);
+        CHECK(AngleDegrees(tangents[i], Normalized(Vector3(1.0f, 0.0f, 1.0f))) < 1e-3f);
+    }
+}
+
+TEST_CASE(TangentsFallBackWithoutUsableUVs)
+{
+    // All corners share one UV, and the fourth vertex is not used at all.
+    const Vector3 normal(0.0f, 1.0f, 0.0f);
+    const VertexPositionNormalTexture vertices[4] =
+    {
+        MakeVertex(Vector3(0.0f, 0.0f, 0.0f), normal, 0.5f, 0.5f),
+        MakeVertex(Vector3(1.0f, 0.0f, 0.0f), normal, 0.5f, 0.5f),
+        MakeVertex(Vector3(0.0f, 0.0f, 1.0f), normal, 0.5f, 0.5f),
+        MakeVertex(Vector3(9.0f, 9.0f, 9.0f), normal, 0.0f, 0.0f),
+    };
+    const uint32_t indices[3] = { 0, 1, 2 };
+    Vector3 tangents[4];
+    VertexCompression::ComputeTangents(vertices, 4, indices, 3, nullptr, 0, tangents);
+    for (const Vector3& tangent : tangents)
+    {
+        CHECK(IsUnit(tangent));
+        CHECK(fabsf(tangent.Dot(normal)) < 1e-5f);
+    }
+}
+
+TEST_CASE(TangentsOfSplitMeshesUseEachRangesBaseVertex)
+{
+    // Two copies of a triangle, the second addressed relative to vertex 3 as
+    // ModelLoader::splitMesh lays out ranges.  Its u runs along +z.
+    const Vector3 normal(0.0f, 1.0f, 0.0f);
+    const VertexPositionNormalTexture vertices[6] =
+    {
+        MakeVertex(Vector3(0.0f, 0.0f, 0.0f), normal, 0.0f, 0.0f),
+        MakeVertex(Vector3(1.0f, 0.0f, 0.0f), normal, 1.0f, 0.0f),
+        MakeVertex(Vector3(0.0f, 0.0f, 1.0f), normal, 0.0f, 1.0f),
+        MakeVertex(Vector3(0.0f, 0.0f, 0.0f), normal, 0.0f, 0.0f),
+        MakeVertex(Vector3(0.0f, 0.0f, 1.0f), normal, 1.0f, 0.0f),
+        MakeVertex(Vector3(1.0f, 0.0f, 0.0f), normal, 0.0f, 1.0f),
+    };
+    const uint16_t indices[6] = { 0, 1, 2, 0, 1, 2 };
+    SubmeshGeometry ranges[2];
+    ranges[0].IndexCount = 3;
+    ranges[0].StartIndexLocation = 0;
+    ranges[0].BaseVertexLocation = 0;
+    ranges[1].IndexCount = 3;
+    ranges[1].StartIndexLocation = 3;
+    ranges[1].BaseVertexLocation = 3;
+
+    Vector3 tangents[6];
+    VertexCompression::ComputeTangents(vertices, 6, indices, 6, ranges, 2, tangents);
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(AngleDegrees(tangents[i], Vector3(1.0f, 0.0f, 0.0f)) < 1e-3f);
+        CHECK(AngleDegrees(tangents[i + 3], Vector3(0.0f, 0.0f, 1.0f)) < 1e-3f);
+    }
+
+    // The derived tangents survive encoding within tolerance.
+    const VertexQuantization quantization = VertexQuantization::FromVertices(vertices, 6);
+    VertexPositionNormalTextureCompact compact[6];
+    VertexCompression::Encode(vertices, tangents, 6, quantization, compact);
+    const VertexCompressionError error = VertexCompression::MeasureError(vertices, tangents, compact, 6, quantization);
+    CHECK(error.Within(VertexCompressionError::Tolerance(quantization)));
+    CHECK(AngleDegrees(VertexCompression::DecodeTangent(compact[4]), Vector3(0.0f, 0.0f, 1.0f)) <= 1.0f);
+}
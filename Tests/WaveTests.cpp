@@ -0,0 +1,483 @@
+#include "Test.h"
+#include "../Wave/WaveEmitters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    // Rain and a circling wake over a grid for frameCount frames, every
+    // emitter seeded with seed.
+    std::vector<float> RunSeededWaves(uint32_t seed, int frameCount)
+    {
+        const float dt = 1.0f / 60.0f;
+        Waves waves(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+        RainEmitter rain(seed, 2000.0f, 0.2f, 0.8f, 4);
+        WakeEmitter wake(seed + 1, 2.0f, 0.5f, 1.5f, 4);
+        const Waves::SplatKernel kernel = Waves::GaussianKernel(2, 1.0f);
+
+        std::vector<Waves::Impulse> impulses;
+        for (int frame = 0; frame < frameCount; frame++)
+        {
+            impulses.clear();
+            rain.Emit(waves, dt, impulses);
+            const float angle = frame * 0.05f;
+            wake.Emit(waves, 64.0f + 40.0f * sinf(angle), 64.0f + 40.0f * cosf(angle), impulses);
+            waves.Disturb(impulses.data(), impulses.size(), kernel);
+            waves.Update(dt);
+        }
+
+        std::vector<float> heights;
+        for (int i = 0; i < waves.RowCount(); i++)
+        {
+            const float* row = waves.Heights() + i * waves.RowPitch();
+            heights.insert(heights.end(), row, row + waves.ColumnCount());
+        }
+        return heights;
+    }
+
+    bool SameBits(const std::vector<float>& a, const std::vector<float>& b)
+    {
+        return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+    }
+
+    // The interior heights of waves, row by row without the padding.
+    std::vector<float> InteriorHeights(const Waves& waves)
+    {
+        std::vector<float> heights;
+        for (int i = 1; i + 1 < waves.RowCount(); i++)
+        {
+            const float* row = waves.Heights() + i * waves.RowPitch();
+            heights.insert(heights.end(), row + 1, row + waves.ColumnCount() - 1);
+        }
+        return heights;
+    }
+
+    // A rows x cols grid with every tile awake and an impulse per 16 points,
+    // scattered so waves cross every strip and tile boundary from the start.
+    std::unique_ptr<Waves> MakeDisturbedWaves(int rows, int cols, int maxSubsteps)
+    {
+        std::unique_ptr<Waves> waves(new Waves(rows, cols, 1.0f, 0.03f, 4.0f, 0.2f));
+        waves->SetSleepThreshold(0.0f);
+        waves->SetMaxSubsteps(maxSubsteps);
+
+        std::vector<Waves::Impulse> impulses(size_t(rows) * cols / 16);
+        uint32_t state = 7;
+        for (auto& impulse : impulses)
+        {
+            state = state * 1664525u + 1013904223u;
+            impulse.Row = 2 + int((state >> 8) % uint32_t(rows - 4));
+            state = state * 1664525u + 1013904223u;
+            impulse.Col = 2 + int((state >> 8) % uint32_t(cols - 4));
+            impulse.Magnitude = float(int(state % 9) - 4) * 0.1f;
+        }
+        waves->Disturb(impulses.data(), impulses.size(), Waves::PointKernel());
+        return waves;
+    }
+
+    // The vertex format the wave demos draw with.
+    struct WaveVertex
+    {
+        DirectX::XMFLOAT3 Pos;
+        DirectX::XMFLOAT3 Normal;
+        DirectX::XMFLOAT3 TangentU;
+        DirectX::XMFLOAT2 TexC;
+    };
+
+    const Waves::VertexLayout WaveVertexLayout =
+    {
+        int(sizeof(WaveVertex)), int(offsetof(WaveVertex, Pos)), int(offsetof(WaveVertex, Normal)), int(offsetof(WaveVertex, TangentU))
+    };
+
+    // One step of Luna's wave equation over unpadded rows x cols planes with
+    // a spatial step of 1, written out plainly.  prev becomes the next solution, as in Waves.
+    void ReferenceStep(std::vector<float>& prev, const std::vector<float>& curr, int rows, int cols,
+        float dt, float speed, float damping)
+    {
+        const float d = damping * dt + 2.0f;
+        const float e = (speed * speed) * (dt * dt);
+        const float k1 = (damping * dt - 2.0f) / d;
+        const float k2 = (4.0f - 8.0f * e) / d;
+        const float k3 = (2.0f * e) / d;
+        for (int i = 1; i + 1 < rows; i++)
+        {
+            for (int j = 1; j + 1 < cols; j++)
+            {
+                const int p = i * cols + j;
+                prev[p] = (k1 * prev[p] + k2 * curr[p]) + k3 * ((curr[p + cols] + curr[p - cols]) + (curr[p + 1] + curr[p - 1]));
+            }
+        }
+    }
+}
+
+TEST_CASE(WaveEmittersAreDeterministicPerSeed)
+{
+    const std::vector<float> first = RunSeededWaves(1234, 120);
+    const std::vector<float> second = RunSeededWaves(1234, 120);
+    CHECK(SameBits(first, second));
+
+    bool disturbed = false;
+    for (float height : first)
+    {
+        disturbed = disturbed || height != 0.0f;
+    }
+    CHECK(disturbed);
+
+    CHECK(!SameBits(first, RunSeededWaves(4321, 120)));
+}
+
+TEST_CASE(WaveBatchedDisturbMatchesSingleImpulses)
+{
+    Waves single(64, 64, 1.0f, 0.03f, 4.0f, 0.2f);
+    Waves batched(64, 64, 1.0f, 0.03f, 4.0f, 0.2f);
+
+    // Overlapping impulses, so the order in which they sum matters.
+    std::vector<Waves::Impulse> impulses;
+    for (int i = 0; i < 500; i++)
+    {
+        impulses.push_back({ 2 + (i * 7) % 60, 2 + (i * 13) % 60, 0.01f * (i % 17) - 0.05f });
+    }
+    for (const Waves::Impulse& impulse : impulses)
+    {
+        single.Disturb(impulse.Row, impulse.Col, impulse.Magnitude);
+    }
+    batched.Disturb(impulses.data(), impulses.size(), Waves::PointKernel());
+
+    float maxError = 0.0f;
+    for (int i = 0; i < single.RowCount(); i++)
+    {
+        for (int j = 0; j < single.ColumnCount(); j++)
+        {
+            const int offset = i * single.RowPitch() + j;
+            maxError = std::max<float>(maxError, fabsf(single.Heights()[offset] - batched.Heights()[offset]));
+        }
+    }
+    // Sums may round differently, but only in the last bit or so.
+    CHECK(maxError <= 1e-5f);
+
+    // Impulses whose kernel would reach the boundary are skipped.
+    const size_t planeSize = (size_t)batched.RowCount() * batched.RowPitch();
+    const std::vector<float> before(batched.Heights(), batched.Heights() + planeSize);
+    const Waves::Impulse edge[] = { { 0, 10, 1.0f }, { 10, 63, 1.0f }, { 1, 1, 1.0f } };
+    batched.Disturb(edge, 3, Waves::PointKernel());
+    CHECK(memcmp(before.data(), batched.Heights(), planeSize * sizeof(float)) == 0);
+}
+
+// Reports the time per frame of 100k rain drops on a 1024^2 grid; checks only
+// that the batch lands.  Run on its own with "Tests.exe WaveTime".
+TEST_CASE(WaveTime100kImpulsesPerFrame)
+{
+    const int frameCount = 10;
+    const size_t impulsesPerFrame = 100000;
+    const float dt = 1.0f / 60.0f;
+
+    Waves waves(1024, 1024, 1.0f, 0.03f, 4.0f, 0.2f);
+    RainEmitter rain(42, impulsesPerFrame / dt, 0.1f, 0.5f, 4);
+    const Waves::SplatKernel kernel = Waves::GaussianKernel(2, 1.0f);
+
+    std::vector<Waves::Impulse> impulses;
+    double disturbSeconds = 0.0;
+    double updateSeconds = 0.0;
+    size_t emitted = 0;
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        impulses.clear();
+        rain.Emit(waves, dt, impulses);
+        emitted += impulses.size();
+
+        const auto start = std::chrono::steady_clock::now();
+        waves.Disturb(impulses.data(), impulses.size(), kernel);
+        const auto disturbed = std::chrono::steady_clock::now();
+        waves.Update(dt);
+        const auto updated = std::chrono::steady_clock::now();
+
+        disturbSeconds += std::chrono::duration<double>(disturbed - start).count();
+        updateSeconds += std::chrono::duration<double>(updated - disturbed).count();
+    }
+
+    printf("    %zu impulses per frame: Disturb %.2f ms, Update %.2f ms\n", emitted / frameCount,
+        1000.0 * disturbSeconds / frameCount, 1000.0 * updateSeconds / frameCount);
+    CHECK(emitted >= impulsesPerFrame * frameCount - frameCount);
+    CHECK(emitted <= impulsesPerFrame * frameCount + frameCount);
+}
+
+TEST_CASE(WaveUpdateMatchesScalarStencil)
+{
+    // Odd width, so rows end in the scalar tail of the SIMD kernel.
+    const int rows = 70, cols = 77;
+    const float dt = 0.03f, speed = 4.0f, damping = 0.2f;
+    Waves waves(rows, cols, 1.0f, dt, speed, damping);
+    waves.SetSleepThreshold(0.0f);
+    waves.Disturb(20, 30, 1.0f);
+    waves.Disturb(50, 70, -0.5f);
+
+    std::vector<float> prev(size_t(rows) * cols, 0.0f);
+    std::vector<float> curr(size_t(rows) * cols, 0.0f);
+    for (int i = 0; i < rows; i++)
+    {
+        memcpy(&curr[size_t(i) * cols], waves.Heights() + i * waves.RowPitch(), cols * sizeof(float));
+    }
+
+    float maxError = 0.0f;
+    float maxHeight = 0.0f;
+    for (int step = 0; step < 60; step++)
+    {
+        waves.Update(dt);
+        ReferenceStep(prev, curr, rows, cols, dt, speed, damping);
+        std::swap(prev, curr);
+        for (int i = 1; i + 1 < rows; i++)
+        {
+            for (int j = 1; j + 1 < cols; j++)
+            {
+                const float height = waves.Heights()[i * waves.RowPitch() + j];
+                maxError = std::max<float>(maxError, fabsf(height - curr[size_t(i) * cols + j]));
+                maxHeight = std::max<float>(maxHeight, fabsf(height));
+            }
+        }
+    }
+    CHECK(maxHeight > 0.01f);
+    CHECK(maxError <= 1e-6f);
+
+    // Normals of the final step are unit length and lean away from slopes.
+    const DirectX::XMFLOAT3 normal = waves.Normal(35 * cols + 38);
+    CHECK(fabsf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z - 1.0f) <= 1e-5f);
+    CHECK(normal.y > 0.0f);
+}
+
+// Reports wave equation throughput with every tile awake on square grids of
+// 256^2 to 4096^2 points; checks only that each grid stays finite.  Run on
+// its own with "Tests.exe WaveTime".
+TEST_CASE(WaveTimeCellsPerSecond)
+{
+    const float dt = 0.03f;
+    for (int size = 256; size <= 4096; size *= 2)
+    {
+        Waves waves(size, size, 1.0f, dt, 4.0f, 0.2f);
+        waves.SetSleepThreshold(0.0f);
+        waves.Disturb(size / 2, size / 2, 1.0f);
+
+        // About 2^26 cells per grid, and at least a few steps.
+        const double cells = double(size) * size;
+        const int stepCount = std::max<int>(4, int((1 << 26) / cells));
+        const auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < stepCount; step++)
+        {
+            waves.Update(dt);
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("    %4d^2: %d steps, %.2f ms per step, %.1f M cells/s\n", size, stepCount,
+            1000.0 * seconds / stepCount, cells * stepCount / seconds / 1.0e6);
+        const std::vector<float> heights = InteriorHeights(waves);
+        bool finite = true;
+        for (float height : heights)
+        {
+            finite = finite && std::isfinite(height);
+        }
+        CHECK(finite);
+    }
+}
+
+TEST_CASE(WaveBlockedSubstepsMatchSingleSteps)
+{
+    // Too wide for one strip's rows to fit the block even on a single core,
+    // with an odd width, and more substeps than one blocked sweep takes.
+    const int rows = 40, cols = 4801;
+    const float dt = 0.03f;
+    for (int substeps : { 2, 5, 11 })
+    {
+        std::unique_ptr<Waves> single = MakeDisturbedWaves(rows, cols, 1);
+        std::unique_ptr<Waves> blocked = MakeDisturbedWaves(rows, cols, substeps);
+        for (int frame = 0; frame < 3; frame++)
+        {
+            for (int step = 0; step < substeps; step++)
+            {
+                single->Update(dt);
+            }
+            // A little over, so rounding cannot lose a step.
+            blocked->Update(dt * (substeps + 0.01f));
+            CHECK(SameBits(InteriorHeights(*single), InteriorHeights(*blocked)));
+        }
+
+        // One more single step from each shows the previous solutions match too.
+        single->Update(dt);
+        blocked->Update(dt);
+        CHECK(SameBits(InteriorHeights(*single), InteriorHeights(*blocked)));
+
+        bool sameNormals = true;
+        for (int i = 0; i < single->VertexCount(); i++)
+        {
+            const DirectX::XMFLOAT3 a = single->Normal(i);
+            const DirectX::XMFLOAT3 b = blocked->Normal(i);
+            sameNormals = sameNormals && a.x == b.x && a.y == b.y && a.z == b.z;
+        }
+        CHECK(sameNormals);
+    }
+}
+
+// Reports catching up 8 steps per frame on a 2048^2 grid, one step per
+// Update against one blocked Update, with every tile awake.  Traffic is
+// modelled as whole planes moved to and from memory, 4 bytes per point:
+// a single step reads prev and curr and writes prev, then computes normals
+// (reads curr, writes 5 planes) and tile amplitudes (reads 2); a blocked
+// sweep reads and writes both solutions once and finishes once.  Checks only
+// that both agree.  Run on its own with "Tests.exe WaveTime".
+TEST_CASE(WaveTimeBlockedSubsteps)
+{
+    const int size = 2048;
+    const int substeps = 8;
+    const int frameCount = 4;
+    const float dt = 0.03f;
+    const double points = double(size) * size;
+    const double singleBytes = 4.0 * points * (3 + 6 + 2) * substeps;
+    const double blockedBytes = 4.0 * points * (4 + 6 + 2);
+
+    std::unique_ptr<Waves> single = MakeDisturbedWaves(size, size, 1);
+    std::unique_ptr<Waves> blocked = MakeDisturbedWaves(size, size, substeps);
+    double singleSeconds = 0.0;
+    double blockedSeconds = 0.0;
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < substeps; step++)
+        {
+            single->Update(dt);
+        }
+        const auto afterSingle = std::chrono::steady_clock::now();
+        blocked->Update(dt * (substeps + 0.01f));
+        const auto afterBlocked = std::chrono::steady_clock::now();
+
+        singleSeconds += std::chrono::duration<double>(afterSingle - start).count();
+        blockedSeconds += std::chrono::duration<double>(afterBlocked - afterSingle).count();
+    }
+    singleSeconds /= frameCount;
+    blockedSeconds /= frameCount;
+
+    printf("    %d^2, %d steps per frame: single %.1f ms (%.0f MB, %.1f M cells/s), blocked %.1f ms (%.0f MB, %.1f M cells/s)\n",
+        size, substeps, 1000.0 * singleSeconds, singleBytes / 1.0e6, points * substeps / singleSeconds / 1.0e6,
+        1000.0 * blockedSeconds, blockedBytes / 1.0e6, points * substeps / blockedSeconds / 1.0e6);
+    CHECK(SameBits(InteriorHeights(*single), InteriorHeights(*blocked)));
+}
+
+TEST_CASE(WaveStreamedVerticesMatchFullCopies)
+{
+    // Three buffers in flight, each streamed from its own version, against a
+    // full copy every frame.
+    const int size = 200;
+    const int tileCount = ((size + 31) / 32) * ((size + 31) / 32);
+    const int bufferCount = 3;
+    const float dt = 0.03f;
+    Waves waves(size, size, 1.0f, dt, 4.0f, 0.2f);
+
+    // Ripples spread out rather than die down, so sleep early enough for the
+    // water to calm within the test.
+    waves.SetSleepThreshold(0.01f);
+
+    std::vector<WaveVertex> full(waves.VertexCount());
+    std::vector<WaveVertex> streamed[bufferCount];
+    uint64_t versions[bufferCount] = {};
+    for (auto& buffer : streamed)
+    {
+        buffer.resize(waves.VertexCount());
+        memset(buffer.data(), 0, buffer.size() * sizeof(WaveVertex));
+    }
+    memset(full.data(), 0, full.size() * sizeof(WaveVertex));
+
+    bool allMatch = true;
+    int firstWrite = 0;
+    int disturbedWrite = tileCount;
+    int quietFrames = 0;
+    for (int frame = 0; frame < 2000 && quietFrames < bufferCount; frame++)
+    {
+        // Ripples in one corner for a while, then still water.
+        if (frame < 40 && frame % 4 == 0)
+        {
+            waves.Disturb(20 + frame % 7, 30 + frame % 5, 0.05f);
+        }
+        waves.Update(dt);
+
+        int tilesWritten = 0;
+        const int k = frame % bufferCount;
+        versions[k] = waves.WriteVertices(streamed[k].data(), WaveVertexLayout, versions[k], &tilesWritten);
+        waves.WriteVertices(full.data(), WaveVertexLayout, 0);
+        allMatch = allMatch && memcmp(streamed[k].data(), full.data(), full.size() * sizeof(WaveVertex)) == 0;
+
+        if (frame == 0)
+        {
+            firstWrite = tilesWritten;
+        }
+        else if (frame == 20)
+        {
+            disturbedWrite = tilesWritten;
+        }
+        quietFrames = tilesWritten == 0 ? quietFrames + 1 : 0;
+    }
+
+    CHECK(allMatch);
+    CHECK(firstWrite == tileCount);
+    CHECK(disturbedWrite > 0);
+    CHECK(disturbedWrite < tileCount);
+
+    // The water calmed down until nothing needed writing.
+    CHECK(quietFrames == bufferCount);
+    bool flat = true;
+    for (float height : InteriorHeights(waves))
+    {
+        flat = flat && height == 0.0f;
+    }
+    CHECK(flat);
+}
+
+// Reports writing the vertices of a 1024^2 grid each frame as a full copy
+// against streaming only changed tiles, for still water and for one moving
+// ripple; checks that both give the same vertices.  Run on its own with
+// "Tests.exe WaveTime".
+TEST_CASE(WaveTimeStreamedVertices)
+{
+    const int size = 1024;
+    const int frameCount = 30;
+    const float dt = 0.03f;
+    Waves waves(size, size, 1.0f, dt, 4.0f, 0.2f);
+    std::vector<WaveVertex> full(waves.VertexCount());
+    std::vector<WaveVertex> streamed(waves.VertexCount());
+    uint64_t version = waves.WriteVertices(streamed.data(), WaveVertexLayout, 0);
+    waves.WriteVertices(full.data(), WaveVertexLayout, 0);
+
+    for (int ripple = 0; ripple < 2; ripple++)
+    {
+        double fullSeconds = 0.0;
+        double streamedSeconds = 0.0;
+        size_t tilesWritten = 0;
+        for (int frame = 0; frame < frameCount; frame++)
+        {
+            if (ripple)
+            {
+                waves.Disturb(100 + 20 * frame, 300, 0.5f);
+            }
+            waves.Update(dt);
+
+            int tiles = 0;
+            const auto start = std::chrono::steady_clock::now();
+            waves.WriteVertices(full.data(), WaveVertexLayout, 0);
+            const auto afterFull = std::chrono::steady_clock::now();
+            version = waves.WriteVertices(streamed.data(), WaveVertexLayout, version, &tiles);
+            const auto afterStreamed = std::chrono::steady_clock::now();
+
+            fullSeconds += std::chrono::duration<double>(afterFull - start).count();
+            streamedSeconds += std::chrono::duration<double>(afterStreamed - afterFull).count();
+            tilesWritten += tiles;
+        }
+
+        const double tileBytes = 32.0 * 32.0 * sizeof(WaveVertex);
+        printf("    %s: full copy %.2f ms (%.1f MB), streamed %.3f ms (%.0f tiles, %.2f MB) per frame\n",
+            ripple ? "moving ripple" : "still water", 1000.0 * fullSeconds / frameCount,
+            full.size() * sizeof(WaveVertex) / 1.0e6, 1000.0 * streamedSeconds / frameCount,
+            double(tilesWritten) / frameCount, tileBytes * tilesWritten / frameCount / 1.0e6);
+        CHECK(memcmp(streamed.data(), full.data(), full.size() * sizeof(WaveVertex)) == 0);
+    }
+}
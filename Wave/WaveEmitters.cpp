@@ -0,0 +1,120 @@
+//***************************************************************************************
+// WaveEmitters.cpp
+//***************************************************************************************
+
+#include "WaveEmitters.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Uniform in [0, 1) from the top 24 bits, exactly representable as a float.
+    float Uniform(std::mt19937& random)
+    {
+        return (random() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float Uniform(std::mt19937& random, float low, float high)
+    {
+        return low + (high - low)*Uniform(random);
+    }
+
+    // Uniform in [low, high].
+    int UniformInt(std::mt19937& random, int low, int high)
+    {
+        return low + (int)(Uniform(random)*(high - low + 1));
+    }
+}
+
+RainEmitter::RainEmitter(uint32_t seed, float dropsPerSecond, float minMagnitude, float maxMagnitude, int margin) :
+    mRandom(seed),
+    mDropsPerSecond(dropsPerSecond),
+    mMinMagnitude(minMagnitude),
+    mMaxMagnitude(maxMagnitude),
+    mMargin(margin)
+{
+}
+
+void RainEmitter::Emit(const Waves& waves, float dt, std::vector<Waves::Impulse>& impulses)
+{
+    const int lastRow = waves.RowCount() - 1 - mMargin;
+    const int lastCol = waves.ColumnCount() - 1 - mMargin;
+    if( lastRow < mMargin || lastCol < mMargin )
+    {
+        return;
+    }
+
+    // Carry the fraction over so the rate holds at any frame rate.
+    mPendingDrops += mDropsPerSecond*dt;
+    const int drops = (int)mPendingDrops;
+    mPendingDrops -= drops;
+
+    impulses.reserve(impulses.size() + drops);
+    for(int k = 0; k < drops; ++k)
+    {
+        Waves::Impulse impulse;
+        impulse.Row = UniformInt(mRandom, mMargin, lastRow);
+        impulse.Col = UniformInt(mRandom, mMargin, lastCol);
+        impulse.Magnitude = Uniform(mRandom, mMinMagnitude, mMaxMagnitude);
+        impulses.push_back(impulse);
+    }
+}
+
+WakeEmitter::WakeEmitter(uint32_t seed, float spacing, float magnitude, float scatter, int margin) :
+    mRandom(seed),
+    mSpacing(std::max<float>(spacing, 0.01f)),
+    mMagnitude(magnitude),
+    mScatter(scatter),
+    mMargin(margin)
+{
+}
+
+void WakeEmitter::Emit(const Waves& waves, float row, float col, std::vector<Waves::Impulse>& impulses)
+{
+    if( !mStarted )
+    {
+        mStarted = true;
+        mRow = row;
+        mCol = col;
+        return;
+    }
+
+    const float dRow = row - mRow;
+    const float dCol = col - mCol;
+    const float length = std::sqrt(dRow*dRow + dCol*dCol);
+    const float startRow = mRow;
+    const float startCol = mCol;
+    mRow = row;
+    mCol = col;
+    if( length <= 0.0f )
+    {
+        return;
+    }
+
+    // Across the direction of travel.
+    const float sideRow = -dCol / length;
+    const float sideCol = dRow / length;
+
+    const int lastRow = waves.RowCount() - 1 - mMargin;
+    const int lastCol = waves.ColumnCount() - 1 - mMargin;
+    // Where along this segment the previous impulse was; negative when it
+    // was on an earlier one.
+    float last = -mTravelled;
+    for(float d = last + mSpacing; d <= length; d = last + mSpacing)
+    {
+        const float t = d / length;
+        const float offset = Uniform(mRandom, -mScatter, mScatter);
+        const float strength = Uniform(mRandom, 0.5f, 1.0f);
+
+        Waves::Impulse impulse;
+        impulse.Row = (int)std::floor(startRow + t*dRow + offset*sideRow + 0.5f);
+        impulse.Col = (int)std::floor(startCol + t*dCol + offset*sideCol + 0.5f);
+        impulse.Magnitude = mMagnitude*strength;
+        if( impulse.Row >= mMargin && impulse.Row <= lastRow && impulse.Col >= mMargin && impulse.Col <= lastCol )
+        {
+            impulses.push_back(impulse);
+        }
+        last = d;
+    }
+    mTravelled = length - last;
+}
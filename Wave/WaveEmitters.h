@@ -0,0 +1,60 @@
+//***************************************************************************************
+// WaveEmitters.h
+//
+// Seeded generators of impulses for Waves::Disturb.  The same seed and the same
+// sequence of calls produce the same impulses on every platform: they draw from
+// std::mt19937, whose output the standard fixes, and convert it to floats by hand
+// rather than through the implementation-defined standard distributions.
+//***************************************************************************************
+
+#ifndef WAVEEMITTERS_H
+#define WAVEEMITTERS_H
+
+#include "Waves.h"
+#include <random>
+
+// Drops scattered uniformly over the grid at a steady rate.
+class RainEmitter
+{
+public:
+    // margin keeps drops that many grid points away from the boundary; make
+    // it at least the splat kernel's radius + 1.
+    RainEmitter(uint32_t seed, float dropsPerSecond, float minMagnitude, float maxMagnitude, int margin = 2);
+
+    // Appends the drops that fall during dt.
+    void Emit(const Waves& waves, float dt, std::vector<Waves::Impulse>& impulses);
+
+private:
+    std::mt19937 mRandom;
+    float mDropsPerSecond;
+    float mMinMagnitude;
+    float mMaxMagnitude;
+    int mMargin;
+    float mPendingDrops = 0.0f;
+};
+
+// Impulses left behind a moving object, spaced evenly along its path with
+// some random scatter to either side.
+class WakeEmitter
+{
+public:
+    WakeEmitter(uint32_t seed, float spacing, float magnitude, float scatter, int margin = 2);
+
+    // Appends impulses along the path from the previous position to
+    // (row, col), in grid points.  The first call only sets the position.
+    void Emit(const Waves& waves, float row, float col, std::vector<Waves::Impulse>& impulses);
+
+private:
+    std::mt19937 mRandom;
+    float mSpacing;
+    float mMagnitude;
+    float mScatter;
+    int mMargin;
+    bool mStarted = false;
+    float mRow = 0.0f;
+    float mCol = 0.0f;
+    // Distance travelled since the last impulse.
+    float mTravelled = 0.0f;
+};
+
+#endif // WAVEEMITTERS_H
@@ -3,13 +3,139 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../Common/ParallelFor.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
 
 using namespace DirectX;
 
+namespace
+{
+    // The widest float vector the target was built for.  Rows are padded to a
+    // multiple of the AVX width whichever is picked.
+    const int RowAlignment = 8;
+
+    // Substeps fused into one sweep by Waves::stepBlocked, and the cache it
+    // aims to keep each strip's rows in.
+    const int MaxBlockDepth = 8;
+    const int BlockBytes = 256 * 1024;
+
+    // Grid points along each side of a sleep/dirty tile.
+    const int TileSize = 32;
+
+#if defined(__AVX__)
+    typedef __m256 Lanes;
+    const int LaneCount = 8;
+    inline Lanes Load(const float* p) { return _mm256_loadu_ps(p); }
+    inline void Store(float* p, Lanes v) { _mm256_storeu_ps(p, v); }
+    inline Lanes Splat(float f) { return _mm256_set1_ps(f); }
+    inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+    inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+    inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+    inline Lanes Div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+    inline Lanes Sqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    typedef __m128 Lanes;
+    const int LaneCount = 4;
+    inline Lanes Load(const float* p) { return _mm_loadu_ps(p); }
+    inline void Store(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+    inline Lanes Splat(float f) { return _mm_set1_ps(f); }
+    inline Lanes Add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+    inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+    inline Lanes Mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+    inline Lanes Div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+    inline Lanes Sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+#else
+    typedef float Lanes;
+    const int LaneCount = 1;
+    inline Lanes Load(const float* p) { return *p; }
+    inline void Store(float* p, Lanes v) { *p = v; }
+    inline Lanes Splat(float f) { return f; }
+    inline Lanes Add(Lanes a, Lanes b) { return a + b; }
+    inline Lanes Sub(Lanes a, Lanes b) { return a - b; }
+    inline Lanes Mul(Lanes a, Lanes b) { return a * b; }
+    inline Lanes Div(Lanes a, Lanes b) { return a / b; }
+    inline Lanes Sqrt(Lanes a) { return std::sqrt(a); }
+#endif
+
+    // Columns [begin, end) of one row of the wave equation.  prev is
+    // overwritten with the next solution; up and down are the rows of curr
+    // above and below.
+    void StepRow(float* prev, const float* curr, const float* up, const float* down,
+        int begin, int end, float k1, float k2, float k3)
+    {
+        const Lanes K1 = Splat(k1);
+        const Lanes K2 = Splat(k2);
+        const Lanes K3 = Splat(k3);
+
+        int j = begin;
+        for(; j + LaneCount <= end; j += LaneCount)
+        {
+            const Lanes neighbours = Add(Add(Load(down + j), Load(up + j)), Add(Load(curr + j + 1), Load(curr + j - 1)));
+            Store(prev + j, Add(Add(Mul(K1, Load(prev + j)), Mul(K2, Load(curr + j))), Mul(K3, neighbours)));
+        }
+        for(; j < end; ++j)
+        {
+            // Same association as the vector loop, so results do not depend
+            // on where a row splits between the two.
+            prev[j] = (k1*prev[j] + k2*curr[j]) + k3*((down[j] + up[j]) + (curr[j + 1] + curr[j - 1]));
+        }
+    }
+
+    // Normals and x tangents of columns [begin, end) of one row by central
+    // differences.
+    void NormalRow(const float* curr, const float* up, const float* down, int begin, int end, float dx,
+        float* normalX, float* normalY, float* normalZ, float* tangentX, float* tangentY)
+    {
+        const Lanes twoDx = Splat(2.0f*dx);
+        const Lanes one = Splat(1.0f);
+
+        int j = begin;
+        for(; j + LaneCount <= end; j += LaneCount)
+        {
+            const Lanes l = Load(curr + j - 1);
+            const Lanes r = Load(curr + j + 1);
+            const Lanes nx = Sub(l, r);
+            const Lanes nz = Sub(Load(down + j), Load(up + j));
+            const Lanes invN = Div(one, Sqrt(Add(Add(Mul(nx, nx), Mul(twoDx, twoDx)), Mul(nz, nz))));
+            Store(normalX + j, Mul(nx, invN));
+            Store(normalY + j, Mul(twoDx, invN));
+            Store(normalZ + j, Mul(nz, invN));
+
+            const Lanes ty = Sub(r, l);
+            const Lanes invT = Div(one, Sqrt(Add(Mul(twoDx, twoDx), Mul(ty, ty))));
+            Store(tangentX + j, Mul(twoDx, invT));
+            Store(tangentY + j, Mul(ty, invT));
+        }
+        for(; j < end; ++j)
+        {
+            const float l = curr[j - 1];
+            const float r = curr[j + 1];
+            const float nx = l - r;
+            const float ny = 2.0f*dx;
+            const float nz = down[j] - up[j];
+            const float invN = 1.0f / std::sqrt(nx*nx + ny*ny + nz*nz);
+            normalX[j] = nx*invN;
+            normalY[j] = ny*invN;
+            normalZ[j] = nz*invN;
+
+            const float ty = r - l;
+            const float invT = 1.0f / std::sqrt(ny*ny + ty*ty);
+            tangentX[j] = ny*invT;
+            tangentY[j] = ty*invT;
+        }
+    }
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
     mNumRows = m;
@@ -27,28 +153,26 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
     mK2 = (4.0f - 8.0f*e) / d;
     mK3 = (2.0f*e) / d;
 
-    mPrevSolution.resize(m*n);
-    mCurrSolution.resize(m*n);
-    mNormals.resize(m*n);
-    mTangentX.resize(m*n);
+    mRowPitch = (n + RowAlignment - 1) / RowAlignment * RowAlignment;
 
-    // Generate grid vertices in system memory.
+    // Flat water: zero heights, normals straight up, tangents along +x.
+    // x and z of the grid points follow from the indices.
+    mHalfWidth = (n - 1)*dx*0.5f;
+    mHalfDepth = (m - 1)*dx*0.5f;
 
-    float halfWidth = (n - 1)*dx*0.5f;
-    float halfDepth = (m - 1)*dx*0.5f;
-    for(int i = 0; i < m; ++i)
-    {
-        float z = halfDepth - i*dx;
-        for(int j = 0; j < n; ++j)
-        {
-            float x = -halfWidth + j*dx;
+    mPrevSolution.assign(m*mRowPitch, 0.0f);
+    mCurrSolution.assign(m*mRowPitch, 0.0f);
+    mNormalX.assign(m*mRowPitch, 0.0f);
+    mNormalY.assign(m*mRowPitch, 1.0f);
+    mNormalZ.assign(m*mRowPitch, 0.0f);
+    mTangentX.assign(m*mRowPitch, 1.0f);
+    mTangentY.assign(m*mRowPitch, 0.0f);
 
-            mPrevSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mCurrSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mNormals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            mTangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-        }
-    }
+    // Everything starts asleep and out of date.
+    mTileRows = (m + TileSize - 1) / TileSize;
+    mTileCols = (n + TileSize - 1) / TileSize;
+    mTileAmplitude.assign(mTileRows*mTileCols, 0.0f);
+    mTileVersion.assign(mTileRows*mTileCols, mVersion);
 }
 
 Waves::~Waves()
@@ -85,75 +209,344 @@ float Waves::Depth()const
 	return mNumRows*mSpatialStep;
 }
 
-void Waves::Update(float dt)
+XMFLOAT3 Waves::Position(int i)const
+{
+	return XMFLOAT3(-mHalfWidth + (i % mNumCols)*mSpatialStep,
+		mCurrSolution[PlaneIndex(i)],
+		mHalfDepth - (i / mNumCols)*mSpatialStep);
+}
+
+XMFLOAT3 Waves::Normal(int i)const
+{
+	const int k = PlaneIndex(i);
+	return XMFLOAT3(mNormalX[k], mNormalY[k], mNormalZ[k]);
+}
+
+XMFLOAT3 Waves::TangentX(int i)const
+{
+	const int k = PlaneIndex(i);
+	return XMFLOAT3(mTangentX[k], mTangentY[k], 0.0f);
+}
+
+void Waves::SetMaxSubsteps(int maxSubsteps)
+{
+	mMaxSubsteps = std::max<int>(1, maxSubsteps);
+}
+
+void Waves::SetSleepThreshold(float threshold)
 {
-	static float t = 0;
+	mSleepThreshold = std::max<float>(0.0f, threshold);
+}
 
+void Waves::Update(float dt)
+{
 	// Accumulate time.
-	t += dt;
+	mAccumulatedTime += dt;
+
+	// Only update the simulation at the specified time step, catching up by
+	// at most mMaxSubsteps steps.  Time beyond that is dropped.
+	int steps = (int)(mAccumulatedTime / mTimeStep);
+	if( steps == 0 )
+	{
+		return;
+	}
+	if( steps > mMaxSubsteps )
+	{
+		steps = mMaxSubsteps;
+		mAccumulatedTime = 0.0f;
+	}
+	else
+	{
+		mAccumulatedTime -= steps*mTimeStep;
+	}
+
+	++mVersion;
+	if( steps == 1 )
+	{
+		gatherAwakeTiles();
+		stepTiles();
+	}
+	else
+	{
+		// The blocked sweep steps every tile, so every tile is looked at
+		// afterwards.
+		for(int done = 0; done < steps; done += MaxBlockDepth)
+		{
+			stepBlocked(std::min<int>(MaxBlockDepth, steps - done));
+		}
+		mAwakeTiles.resize(mTileRows*mTileCols);
+		for(int tile = 0; tile < mTileRows*mTileCols; ++tile)
+		{
+			mAwakeTiles[tile] = tile;
+		}
+	}
+
+	// Only the final substep's normals are ever seen.
+	finishTiles();
+}
+
+Waves::TileBounds Waves::Bounds(int tile)const
+{
+	TileBounds bounds;
+	bounds.Row0 = tile / mTileCols * TileSize;
+	bounds.Row1 = std::min<int>(mNumRows, bounds.Row0 + TileSize);
+	bounds.Col0 = tile % mTileCols * TileSize;
+	bounds.Col1 = std::min<int>(mNumCols, bounds.Col0 + TileSize);
+	return bounds;
+}
+
+void Waves::gatherAwakeTiles()
+{
+	// A tile is awake if it or any of its neighbours is above the threshold;
+	// the others are flat and would stay flat.
+	mAwakeTiles.clear();
+	for(int ti = 0; ti < mTileRows; ++ti)
+	{
+		for(int tj = 0; tj < mTileCols; ++tj)
+		{
+			bool awake = false;
+			for(int i = std::max<int>(0, ti - 1); i <= std::min<int>(mTileRows - 1, ti + 1) && !awake; ++i)
+			{
+				for(int j = std::max<int>(0, tj - 1); j <= std::min<int>(mTileCols - 1, tj + 1) && !awake; ++j)
+				{
+					awake = mTileAmplitude[i*mTileCols + j] >= mSleepThreshold;
+				}
+			}
+			if( awake )
+			{
+				mAwakeTiles.push_back(ti*mTileCols + tj);
+			}
+		}
+	}
+}
+
+void Waves::stepTiles()
+{
+	// Only update interior points; we use zero boundary conditions.
+	ParallelFor(0, (int)mAwakeTiles.size(), [this](int k)
+	{
+		const TileBounds bounds = Bounds(mAwakeTiles[k]);
+		for(int i = std::max<int>(1, bounds.Row0); i < std::min<int>(mNumRows - 1, bounds.Row1); ++i)
+		{
+			// After this update we will be discarding the old previous
+			// buffer, so overwrite that buffer with the new update.
+			// Note how we can do this inplace (read/write to same element) 
+			// because we won't need prev_ij again and the assignment happens last.
+
+			// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+			// Moreover, our +z axis goes "down"; this is just to 
+			// keep consistent with our row indices going down.
+			const float* curr = &mCurrSolution[i*mRowPitch];
+			StepRow(&mPrevSolution[i*mRowPitch], curr, curr - mRowPitch, curr + mRowPitch,
+				std::max<int>(1, bounds.Col0), std::min<int>(mNumCols - 1, bounds.Col1), mK1, mK2, mK3);
+		}
+	});
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.  Sleeping
+	// tiles are zero in both.
+	std::swap(mPrevSolution, mCurrSolution);
+}
+
+void Waves::stepBlocked(int steps)
+{
+	// The grid is cut into strips of columns, each widened by a halo of
+	// steps columns so it can advance on its own.  A strip is swept top to
+	// bottom once, with substep s trailing substep s-1 by two rows: by the
+	// time s overwrites a row, s-1 has read it for the last time.  Only the
+	// 2*steps+4 rows around the sweep are live, in a ring small enough to
+	// stay in cache, so each cell is read and written once for all substeps.
+	const int ringRows = 2*steps + 4;
+	const int workers = std::max<int>(1, (int)std::thread::hardware_concurrency());
+	int stripWidth = std::min<int>(BlockBytes / (ringRows*2*(int)sizeof(float)), (mNumCols + workers - 1) / workers);
+	stripWidth = std::max<int>(stripWidth, 4*steps);
+	stripWidth = (stripWidth + RowAlignment - 1) / RowAlignment * RowAlignment;
+	const int stripCount = (mNumCols + stripWidth - 1) / stripWidth;
 
-	// Only update the simulation at the specified time step.
-	if( t >= mTimeStep )
+	// Strips read the halo from the old solution, so results go elsewhere.
+	mBlockPrev.resize(mPrevSolution.size());
+	mBlockCurr.resize(mCurrSolution.size());
+
+	ParallelFor(0, stripCount, [&](int strip)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows-1; ++i)
+		const int c0 = strip*stripWidth;
+		const int c1 = std::min<int>(mNumCols, c0 + stripWidth);
+		const int h0 = std::max<int>(0, c0 - steps);
+		const int h1 = std::min<int>(mNumCols, c1 + steps);
+		const int width = h1 - h0;
+		const int pitch = (width + RowAlignment - 1) / RowAlignment * RowAlignment;
+
+		// Plane 0 starts as the previous solution and plane 1 as the current
+		// one; substep s writes plane s&1 ? 0 : 1.
+		thread_local std::vector<float> ring;
+		ring.resize(2*ringRows*pitch);
+		auto row = [&](int plane, int i) { return &ring[(plane*ringRows + i % ringRows)*pitch]; };
+
+		auto load = [&](int i)
+		{
+			memcpy(row(0, i), &mPrevSolution[i*mRowPitch + h0], width*sizeof(float));
+			memcpy(row(1, i), &mCurrSolution[i*mRowPitch + h0], width*sizeof(float));
+		};
+		auto store = [&](int i)
+		{
+			const int last = steps & 1 ? 0 : 1;
+			memcpy(&mBlockCurr[i*mRowPitch + c0], row(last, i) + c0 - h0, (c1 - c0)*sizeof(float));
+			memcpy(&mBlockPrev[i*mRowPitch + c0], row(1 - last, i) + c0 - h0, (c1 - c0)*sizeof(float));
+		};
+
+		// Boundary rows and columns are never written; the halo loses one
+		// valid column per substep.
+		load(0);
+		store(0);
+		load(1);
+		const int lastRow = mNumRows - 1;
+		for(int p = 1; p < lastRow + 2*(steps - 1); ++p)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			if( p + 1 <= lastRow )
 			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i*mNumCols+j].y = 
-					mK1*mPrevSolution[i*mNumCols+j].y +
-					mK2*mCurrSolution[i*mNumCols+j].y +
-					mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
-					     mCurrSolution[(i-1)*mNumCols+j].y + 
-					     mCurrSolution[i*mNumCols+j+1].y + 
-						 mCurrSolution[i*mNumCols+j-1].y);
+				load(p + 1);
 			}
-		});
+			for(int s = 1; s <= steps; ++s)
+			{
+				const int i = p - 2*(s - 1);
+				if( i < 1 || i >= lastRow )
+				{
+					continue;
+				}
+				const int dst = s & 1 ? 0 : 1;
+				const float* curr = row(1 - dst, i);
+				StepRow(row(dst, i), curr, row(1 - dst, i - 1), row(1 - dst, i + 1),
+					h0 == 0 ? 1 : s, h1 == mNumCols ? width - 1 : width - s, mK1, mK2, mK3);
+			}
+			const int done = p - 2*(steps - 1);
+			if( done >= 1 && done < lastRow )
+			{
+				store(done);
+			}
+		}
+		store(lastRow);
+	});
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+	std::swap(mPrevSolution, mBlockPrev);
+	std::swap(mCurrSolution, mBlockCurr);
+}
 
-		t = 0.0f; // reset time
+void Waves::finishTiles()
+{
+	//
+	// Compute normals using finite difference scheme, and how far each
+	// stepped tile is from flat.
+	//
+	ParallelFor(0, (int)mAwakeTiles.size(), [this](int k)
+	{
+		const int tile = mAwakeTiles[k];
+		const TileBounds bounds = Bounds(tile);
+		for(int i = std::max<int>(1, bounds.Row0); i < std::min<int>(mNumRows - 1, bounds.Row1); ++i)
+		{
+			const int row = i*mRowPitch;
+			const float* curr = &mCurrSolution[row];
+			NormalRow(curr, curr - mRowPitch, curr + mRowPitch,
+				std::max<int>(1, bounds.Col0), std::min<int>(mNumCols - 1, bounds.Col1), mSpatialStep,
+				&mNormalX[row], &mNormalY[row], &mNormalZ[row], &mTangentX[row], &mTangentY[row]);
+		}
+
+		float amplitude = 0.0f;
+		for(int i = bounds.Row0; i < bounds.Row1; ++i)
+		{
+			for(int j = bounds.Col0; j < bounds.Col1; ++j)
+			{
+				amplitude = std::max<float>(amplitude, std::max<float>(std::fabs(mCurrSolution[i*mRowPitch + j]), std::fabs(mPrevSolution[i*mRowPitch + j])));
+			}
+		}
+		mTileAmplitude[tile] = amplitude;
+		mTileVersion[tile] = mVersion;
+	});
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows - 1; ++i)
+	// Flatten calm tiles with calm neighbours, so skipping them is exact.
+	for(int tile : mAwakeTiles)
+	{
+		const int ti = tile / mTileCols;
+		const int tj = tile % mTileCols;
+		bool calm = true;
+		for(int i = std::max<int>(0, ti - 1); i <= std::min<int>(mTileRows - 1, ti + 1) && calm; ++i)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			for(int j = std::max<int>(0, tj - 1); j <= std::min<int>(mTileCols - 1, tj + 1) && calm; ++j)
 			{
-				float l = mCurrSolution[i*mNumCols+j-1].y;
-				float r = mCurrSolution[i*mNumCols+j+1].y;
-				float t = mCurrSolution[(i-1)*mNumCols+j].y;
-				float b = mCurrSolution[(i+1)*mNumCols+j].y;
-				mNormals[i*mNumCols+j].x = -r+l;
-				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
-				mNormals[i*mNumCols+j].z = b-t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
+				calm = mTileAmplitude[i*mTileCols + j] < mSleepThreshold;
 			}
-		});
+		}
+		if( calm && mTileAmplitude[tile] > 0.0f )
+		{
+			flattenTile(tile);
+		}
 	}
 }
 
+void Waves::flattenTile(int tile)
+{
+	const TileBounds bounds = Bounds(tile);
+	for(int i = bounds.Row0; i < bounds.Row1; ++i)
+	{
+		const int row = i*mRowPitch;
+		std::fill(&mPrevSolution[row + bounds.Col0], &mPrevSolution[row + bounds.Col1], 0.0f);
+		std::fill(&mCurrSolution[row + bounds.Col0], &mCurrSolution[row + bounds.Col1], 0.0f);
+		std::fill(&mNormalX[row + bounds.Col0], &mNormalX[row + bounds.Col1], 0.0f);
+		std::fill(&mNormalY[row + bounds.Col0], &mNormalY[row + bounds.Col1], 1.0f);
+		std::fill(&mNormalZ[row + bounds.Col0], &mNormalZ[row + bounds.Col1], 0.0f);
+		std::fill(&mTangentX[row + bounds.Col0], &mTangentX[row + bounds.Col1], 1.0f);
+		std::fill(&mTangentY[row + bounds.Col0], &mTangentY[row + bounds.Col1], 0.0f);
+	}
+	mTileAmplitude[tile] = 0.0f;
+	mTileVersion[tile] = mVersion;
+}
+
+uint64_t Waves::WriteVertices(void* vertices, const VertexLayout& layout, uint64_t since, int* tilesWritten)const
+{
+	std::vector<int> tiles;
+	for(int tile = 0; tile < mTileRows*mTileCols; ++tile)
+	{
+		if( mTileVersion[tile] > since )
+		{
+			tiles.push_back(tile);
+		}
+	}
+
+	// Upload memory is usually write-combined, so it is only ever written.
+	uint8_t* base = static_cast<uint8_t*>(vertices);
+	ParallelFor(0, (int)tiles.size(), [&](int k)
+	{
+		const TileBounds bounds = Bounds(tiles[k]);
+		for(int i = bounds.Row0; i < bounds.Row1; ++i)
+		{
+			const float z = mHalfDepth - i*mSpatialStep;
+			for(int j = bounds.Col0; j < bounds.Col1; ++j)
+			{
+				const int p = i*mRowPitch + j;
+				uint8_t* vertex = base + (size_t)(i*mNumCols + j)*layout.Stride;
+				if( layout.Position != NoField )
+				{
+					*reinterpret_cast<XMFLOAT3*>(vertex + layout.Position) = XMFLOAT3(-mHalfWidth + j*mSpatialStep, mCurrSolution[p], z);
+				}
+				if( layout.Normal != NoField )
+				{
+					*reinterpret_cast<XMFLOAT3*>(vertex + layout.Normal) = XMFLOAT3(mNormalX[p], mNormalY[p], mNormalZ[p]);
+				}
+				if( layout.TangentX != NoField )
+				{
+					*reinterpret_cast<XMFLOAT3*>(vertex + layout.TangentX) = XMFLOAT3(mTangentX[p], mTangentY[p], 0.0f);
+				}
+			}
+		}
+	});
+
+	if( tilesWritten )
+	{
+		*tilesWritten = (int)tiles.size();
+	}
+	return mVersion;
+}
+
 void Waves::Disturb(int i, int j, float magnitude)
 {
 	// Don't disturb boundaries.
@@ -163,10 +556,130 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f*magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i*mNumCols+j].y     += magnitude;
-	mCurrSolution[i*mNumCols+j+1].y   += halfMag;
-	mCurrSolution[i*mNumCols+j-1].y   += halfMag;
-	mCurrSolution[(i+1)*mNumCols+j].y += halfMag;
-	mCurrSolution[(i-1)*mNumCols+j].y += halfMag;
+	++mVersion;
+	wakeTiles(i - 1, i + 1, j - 1, j + 1, std::fabs(magnitude));
+
+	mCurrSolution[i*mRowPitch+j]     += magnitude;
+	mCurrSolution[i*mRowPitch+j+1]   += halfMag;
+	mCurrSolution[i*mRowPitch+j-1]   += halfMag;
+	mCurrSolution[(i+1)*mRowPitch+j] += halfMag;
+	mCurrSolution[(i-1)*mRowPitch+j] += halfMag;
+}
+
+Waves::SplatKernel Waves::PointKernel()
+{
+	SplatKernel kernel;
+	kernel.Radius = 1;
+	kernel.Weights = { 0.0f, 0.5f, 0.0f,
+	                   0.5f, 1.0f, 0.5f,
+	                   0.0f, 0.5f, 0.0f };
+	return kernel;
+}
+
+Waves::SplatKernel Waves::GaussianKernel(int radius, float sigma)
+{
+	SplatKernel kernel;
+	kernel.Radius = radius;
+	for(int i = -radius; i <= radius; ++i)
+	{
+		for(int j = -radius; j <= radius; ++j)
+		{
+			kernel.Weights.push_back(std::exp(-(i*i + j*j) / (2.0f*sigma*sigma)));
+		}
+	}
+	return kernel;
+}
+
+void Waves::wakeTiles(int row0, int row1, int col0, int col1, float amplitude)
+{
+	for(int ti = row0 / TileSize; ti <= row1 / TileSize; ++ti)
+	{
+		for(int tj = col0 / TileSize; tj <= col1 / TileSize; ++tj)
+		{
+			const int tile = ti*mTileCols + tj;
+			mTileAmplitude[tile] = std::max<float>(mTileAmplitude[tile], amplitude);
+			mTileVersion[tile] = mVersion;
+		}
+	}
+}
+
+void Waves::Disturb(const Impulse* impulses, size_t count, const SplatKernel& kernel)
+{
+	const int r = kernel.Radius;
+	const int size = 2*r + 1;
+	assert((int)kernel.Weights.size() == size*size);
+
+	auto inside = [&](const Impulse& impulse)
+	{
+		return impulse.Row - r >= 1 && impulse.Row + r <= mNumRows - 2 &&
+			impulse.Col - r >= 1 && impulse.Col + r <= mNumCols - 2;
+	};
+
+	// Counting sort by row.  It is stable, so each height sums its impulses
+	// in the order they were given whichever thread applies them.
+	mImpulseRows.assign(mNumRows + 1, 0);
+	for(size_t k = 0; k < count; ++k)
+	{
+		if( inside(impulses[k]) )
+		{
+			++mImpulseRows[impulses[k].Row + 1];
+		}
+	}
+	for(int i = 0; i < mNumRows; ++i)
+	{
+		mImpulseRows[i + 1] += mImpulseRows[i];
+	}
+	if( mImpulseRows[mNumRows] == 0 )
+	{
+		return;
+	}
+
+	mSortedImpulses.resize(mImpulseRows[mNumRows]);
+	mImpulseCursor.assign(mImpulseRows.begin(), mImpulseRows.end() - 1);
+	float maxWeight = 0.0f;
+	for(float weight : kernel.Weights)
+	{
+		maxWeight = std::max<float>(maxWeight, std::fabs(weight));
+	}
+
+	++mVersion;
+	int firstRow = mNumRows;
+	int lastRow = 0;
+	for(size_t k = 0; k < count; ++k)
+	{
+		const Impulse& impulse = impulses[k];
+		if( inside(impulse) )
+		{
+			mSortedImpulses[mImpulseCursor[impulse.Row]++] = impulse;
+			wakeTiles(impulse.Row - r, impulse.Row + r, impulse.Col - r, impulse.Col + r,
+				std::fabs(impulse.Magnitude)*maxWeight);
+			firstRow = std::min<int>(firstRow, impulse.Row - r);
+			lastRow = std::max<int>(lastRow, impulse.Row + r);
+		}
+	}
+
+	// Each row gathers the kernel rows that land on it, so no two tasks
+	// write the same height.
+	ParallelFor(firstRow, lastRow + 1, [&](int i)
+	{
+		float* row = &mCurrSolution[i*mRowPitch];
+		for(int di = -r; di <= r; ++di)
+		{
+			const int source = i - di;
+			if( source < 0 || source >= mNumRows )
+			{
+				continue;
+			}
+			const float* weights = &kernel.Weights[(di + r)*size];
+			for(int k = mImpulseRows[source]; k < mImpulseRows[source + 1]; ++k)
+			{
+				const Impulse& impulse = mSortedImpulses[k];
+				float* heights = row + impulse.Col - r;
+				for(int j = 0; j < size; ++j)
+				{
+					heights[j] += impulse.Magnitude*weights[j];
+				}
+			}
+		}
+	});
 }
-	
@@ -4,12 +4,23 @@
 // Performs the calculations for the wave simulation.  After the simulation has been
 // updated, the client must copy the current solution into vertex buffers for rendering.
 // This class only does the calculations, it does not do any drawing.
+//
+// The grid is stored as planes of floats (heights, normal and tangent components) with
+// rows padded to RowPitch floats, so the stencils run over contiguous memory a SIMD
+// register at a time.  Positions, normals and tangents are assembled on request.
+//
+// The grid is also split into tiles.  Tiles whose water has calmed down below the sleep
+// threshold are flattened and skipped by Update until a disturbance or a neighbouring
+// wave wakes them, and each tile remembers the version in which it last changed, so
+// WriteVertices only rewrites the part of a vertex buffer that is out of date.
 //***************************************************************************************
 
 #ifndef WAVES_H
 #define WAVES_H
 
 #include <vector>
+#include <cstddef>
+#include <cstdint>
 #include <DirectXMath.h>
 
 class Waves
@@ -27,21 +38,101 @@ public:
 	float Width()const;
 	float Depth()const;
 
+	// Floats between the starts of two rows of Heights().
+	int RowPitch()const { return mRowPitch; }
+
+	// Current heights, row i starting at Heights() + i*RowPitch().
+	const float* Heights()const { return mCurrSolution.data(); }
+
 	// Returns the solution at the ith grid point.
-    const DirectX::XMFLOAT3& Position(int i)const { return mCurrSolution[i]; }
+	DirectX::XMFLOAT3 Position(int i)const;
 
 	// Returns the solution normal at the ith grid point.
-    const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+	DirectX::XMFLOAT3 Normal(int i)const;
 
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-    const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+	DirectX::XMFLOAT3 TangentX(int i)const;
+
+	// Steps run by one Update that has fallen behind by more than a time
+	// step; any further backlog is dropped.  Substeps are fused into a
+	// single cache-blocked sweep and only the last one computes normals.
+	// Defaults to 1.
+	void SetMaxSubsteps(int maxSubsteps);
+
+	// Tiles whose heights, and whose neighbours' heights, stay below threshold
+	// are flattened and left alone until disturbed.  0 keeps every tile awake.
+	void SetSleepThreshold(float threshold);
 
 	void Update(float dt);
 	void Disturb(int i, int j, float magnitude);
 
+	struct Impulse
+	{
+		int Row;
+		int Col;
+		float Magnitude;
+	};
+
+	// Heights added around an impulse, scaled by its magnitude.  Weights has
+	// (2*Radius + 1)^2 entries, row by row, the impulse at the centre.
+	struct SplatKernel
+	{
+		int Radius;
+		std::vector<float> Weights;
+	};
+
+	// The stencil Disturb applies: 1 at the centre, 0.5 at the four neighbours.
+	static SplatKernel PointKernel();
+	// Normalized so the centre weight is 1.
+	static SplatKernel GaussianKernel(int radius, float sigma);
+
+	// Applies a batch of impulses in one pass over the rows they touch.
+	// Impulses whose kernel would reach a boundary are skipped.  The result
+	// does not depend on thread count, only on the order of impulses.
+	void Disturb(const Impulse* impulses, size_t count, const SplatKernel& kernel);
+
+	// Byte offsets of the fields WriteVertices fills in, or NoField.
+	static const int NoField = -1;
+	struct VertexLayout
+	{
+		int Stride;
+		int Position;
+		int Normal;
+		int TangentX;
+	};
+
+	// Bumped by every Update and Disturb.
+	uint64_t Version()const { return mVersion; }
+
+	// Writes the grid points of every tile changed after version since into
+	// vertices, VertexCount() of them laid out as described by layout, and
+	// returns the version they are now up to date with.  since 0 writes them
+	// all.  Keep one version per buffer when several are in flight.
+	uint64_t WriteVertices(void* vertices, const VertexLayout& layout, uint64_t since, int* tilesWritten = nullptr)const;
+
 private:
+    // Offset of the ith grid point in the planes.
+    int PlaneIndex(int i)const { return (i / mNumCols)*mRowPitch + i % mNumCols; }
+
+    void gatherAwakeTiles();
+    void stepTiles();
+    void stepBlocked(int steps);
+    void finishTiles();
+    void flattenTile(int tile);
+
+    // Grid points [Row0, Row1) x [Col0, Col1) of a tile.
+    struct TileBounds
+    {
+        int Row0, Row1;
+        int Col0, Col1;
+    };
+    TileBounds Bounds(int tile)const;
+    // Marks the tiles covering rows [row0, row1] and columns [col0, col1] changed.
+    void wakeTiles(int row0, int row1, int col0, int col1, float amplitude);
+
     int mNumRows = 0;
     int mNumCols = 0;
+    int mRowPitch = 0;
 
     int mVertexCount = 0;
     int mTriangleCount = 0;
@@ -54,10 +145,43 @@ private:
     float mTimeStep = 0.0f;
     float mSpatialStep = 0.0f;
 
-    std::vector<DirectX::XMFLOAT3> mPrevSolution;
-    std::vector<DirectX::XMFLOAT3> mCurrSolution;
-    std::vector<DirectX::XMFLOAT3> mNormals;
-    std::vector<DirectX::XMFLOAT3> mTangentX;
+    float mAccumulatedTime = 0.0f;
+    int mMaxSubsteps = 1;
+
+    float mHalfWidth = 0.0f;
+    float mHalfDepth = 0.0f;
+
+    // Heights.
+    std::vector<float> mPrevSolution;
+    std::vector<float> mCurrSolution;
+
+    // Unit normal, and unit x tangent whose z is always 0.
+    std::vector<float> mNormalX;
+    std::vector<float> mNormalY;
+    std::vector<float> mNormalZ;
+    std::vector<float> mTangentX;
+    std::vector<float> mTangentY;
+
+    // Where stepBlocked writes the solution before swapping it in.
+    std::vector<float> mBlockPrev;
+    std::vector<float> mBlockCurr;
+
+    int mTileRows = 0;
+    int mTileCols = 0;
+    float mSleepThreshold = 1.0e-4f;
+    uint64_t mVersion = 1;
+
+    // Largest height in each tile after the last update that touched it.
+    // A tile below the threshold with calm neighbours has all heights zero.
+    std::vector<float> mTileAmplitude;
+    std::vector<uint64_t> mTileVersion;
+    std::vector<int> mAwakeTiles;
+
+    // Batched impulses bucketed by row: row i's are
+    // [mImpulseRows[i], mImpulseRows[i + 1]) of mSortedImpulses.
+    std::vector<int> mImpulseRows;
+    std::vector<int> mImpulseCursor;
+    std::vector<Impulse> mSortedImpulses;
 };
 
 #endif // WAVES_H
\ No newline at end of file
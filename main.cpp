@@ -79,6 +79,7 @@ int main(int, char**)
 
 
     g_graphicsMemory = std::make_unique<DirectX::GraphicsMemory>(g_systemTable.pDeviceResources->GetD3DDevice());
+    g_systemTable.pAssetRegistry = std::make_unique<AssetRegistry>();
     g_systemTable.pSceneManager = std::make_unique<SceneManager>();
     g_systemTable.pSceneManager->ChangeScene(new SceneLoad(new SceneTitle()));
 